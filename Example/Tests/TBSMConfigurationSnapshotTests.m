@@ -0,0 +1,93 @@
+//
+//  TBSMConfigurationSnapshotTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+
+SpecBegin(TBSMConfigurationSnapshot)
+
+__block TBSMStateMachine *stateMachine;
+__block TBSMState *a;
+__block TBSMSubState *b;
+__block TBSMState *b1;
+__block TBSMState *b2;
+
+describe(@"TBSMConfigurationSnapshot", ^{
+    
+    beforeEach(^{
+        stateMachine = [TBSMStateMachine stateMachineWithName:@"main"];
+        a = [TBSMState stateWithName:@"a"];
+        b = [TBSMSubState subStateWithName:@"b"];
+        b1 = [TBSMState stateWithName:@"b1"];
+        b2 = [TBSMState stateWithName:@"b2"];
+        b.states = @[b1, b2];
+        
+        [a addHandlerForEvent:@"a_b" target:b];
+        [b1 addHandlerForEvent:@"b1_b2" target:b2];
+        [b1 addHandlerForEvent:@"b1_b1" target:b1 kind:TBSMTransitionInternal];
+        [b2 addHandlerForEvent:@"b2_a" target:a];
+        stateMachine.states = @[a, b];
+    });
+    
+    afterEach(^{
+        [stateMachine tearDown:nil];
+        stateMachine = nil;
+    });
+    
+    it(@"is published after every step which has changed the active state configuration.", ^{
+        
+        expect(stateMachine.configurationSnapshot).to.beNil();
+        
+        [stateMachine setUp:nil];
+        TBSMConfigurationSnapshot *first = stateMachine.configurationSnapshot;
+        expect(first.activeStatePaths).to.equal(@[@"a"]);
+        expect(first.activeLeafStatePaths).to.equal(@[@"a"]);
+        
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        TBSMConfigurationSnapshot *second = stateMachine.configurationSnapshot;
+        expect(second.version).to.beGreaterThan(first.version);
+        expect(second.activeStatePaths).to.equal(@[@"b", @"b/b1"]);
+        expect(second.activeLeafStatePaths).to.equal(@[@"b/b1"]);
+        expect([second isActiveAtPath:@"b"]).to.beTruthy();
+        expect([second isActiveAtPath:@"a"]).to.beFalsy();
+        expect([second isActiveAtPath:@"x/y"]).to.beFalsy();
+        
+        expect(first.activeStatePaths).to.equal(@[@"a"]);
+        
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"b1_b1" data:nil]];
+        expect(stateMachine.configurationSnapshot).to.beIdenticalTo(second);
+        expect(b.stateMachine.configurationSnapshot).to.beIdenticalTo(second);
+        
+        [stateMachine tearDown:nil];
+        expect(stateMachine.configurationSnapshot.activeStatePaths).to.haveCountOf(0);
+    });
+    
+    it(@"can be read from other threads while the state machine is handling events.", ^{
+        
+        [stateMachine setUp:nil];
+        
+        __block BOOL inconsistent = NO;
+        dispatch_group_t group = dispatch_group_create();
+        for (NSUInteger reader = 0; reader < 4; reader++) {
+            dispatch_group_async(group, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+                for (NSUInteger index = 0; index < 100000; index++) {
+                    TBSMConfigurationSnapshot *snapshot = stateMachine.configurationSnapshot;
+                    if (snapshot.activeLeafStatePaths.count != 1) {
+                        inconsistent = YES;
+                    }
+                }
+            });
+        }
+        while (dispatch_group_wait(group, DISPATCH_TIME_NOW) != 0) {
+            [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+            [stateMachine handleEvent:[TBSMEvent eventWithName:@"b1_b2" data:nil]];
+            [stateMachine handleEvent:[TBSMEvent eventWithName:@"b2_a" data:nil]];
+        }
+        
+        expect(inconsistent).to.beFalsy();
+        expect(stateMachine.configurationSnapshot.activeStatePaths).to.equal(@[@"a"]);
+    });
+});
+
+SpecEnd
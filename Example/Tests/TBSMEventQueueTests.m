@@ -0,0 +1,203 @@
+//
+//  TBSMEventQueueTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+
+SpecBegin(TBSMEventQueue)
+
+__block TBSMEventQueue *queue;
+
+describe(@"TBSMEventQueue", ^{
+    
+    beforeEach(^{
+        queue = [TBSMEventQueue new];
+    });
+    
+    afterEach(^{
+        queue = nil;
+    });
+    
+    it(@"returns nil when empty.", ^{
+        expect([queue dequeueEvent]).to.beNil();
+        expect(queue.count).to.equal(0);
+    });
+    
+    it(@"drains higher lanes first and keeps FIFO order inside a lane.", ^{
+        
+        TBSMEvent *low = [TBSMEvent eventWithName:@"low" data:nil];
+        low.priority = TBSMEventPriorityLow;
+        TBSMEvent *normal1 = [TBSMEvent eventWithName:@"normal1" data:nil];
+        TBSMEvent *normal2 = [TBSMEvent eventWithName:@"normal2" data:nil];
+        TBSMEvent *high = [TBSMEvent eventWithName:@"high" data:nil];
+        high.priority = TBSMEventPriorityHigh;
+        
+        [queue enqueueEvent:low];
+        [queue enqueueEvent:normal1];
+        [queue enqueueEvent:normal2];
+        [queue enqueueEvent:high];
+        
+        expect(queue.count).to.equal(4);
+        expect([queue dequeueEvent]).to.equal(high);
+        expect([queue dequeueEvent]).to.equal(normal1);
+        expect([queue dequeueEvent]).to.equal(normal2);
+        expect([queue dequeueEvent]).to.equal(low);
+        expect([queue dequeueEvent]).to.beNil();
+    });
+    
+    it(@"serves a starving lane once it has been passed over too often.", ^{
+        
+        queue.starvationLimit = 2;
+        
+        TBSMEvent *low = [TBSMEvent eventWithName:@"low" data:nil];
+        low.priority = TBSMEventPriorityLow;
+        [queue enqueueEvent:low];
+        
+        for (NSUInteger i = 0; i < 4; i++) {
+            TBSMEvent *high = [TBSMEvent eventWithName:@"high" data:nil];
+            high.priority = TBSMEventPriorityHigh;
+            [queue enqueueEvent:high];
+        }
+        
+        expect([queue dequeueEvent].name).to.equal(@"high");
+        expect([queue dequeueEvent].name).to.equal(@"high");
+        expect([queue dequeueEvent]).to.equal(low);
+        expect([queue dequeueEvent].name).to.equal(@"high");
+    });
+    
+    describe(@"Bounded capacity.", ^{
+        
+        beforeEach(^{
+            queue.capacity = 2;
+            [queue enqueueEvent:[TBSMEvent eventWithName:@"a" data:nil]];
+            [queue enqueueEvent:[TBSMEvent eventWithName:@"b" data:nil]];
+        });
+        
+        it(@"rejects events at full capacity.", ^{
+            queue.overflowPolicy = TBSMEventQueueOverflowReject;
+            
+            expect([queue enqueueEvent:[TBSMEvent eventWithName:@"c" data:nil]]).to.equal(TBSMEventQueueStatusRejected);
+            expect(queue.count).to.equal(2);
+            expect(queue.rejectedCount).to.equal(1);
+        });
+        
+        it(@"drops the oldest event at full capacity.", ^{
+            queue.overflowPolicy = TBSMEventQueueOverflowDropOldest;
+            
+            expect([queue enqueueEvent:[TBSMEvent eventWithName:@"c" data:nil]]).to.equal(TBSMEventQueueStatusEnqueued);
+            expect([queue.events valueForKeyPath:@"name"]).to.equal(@[@"b", @"c"]);
+            expect(queue.droppedOldestCount).to.equal(1);
+        });
+        
+        it(@"notifies the discard block about the dropped oldest event.", ^{
+            queue.overflowPolicy = TBSMEventQueueOverflowDropOldest;
+            NSMutableArray *discardedEvents = [NSMutableArray new];
+            queue.discardBlock = ^(TBSMEvent *event) {
+                [discardedEvents addObject:event.name];
+            };
+            
+            [queue enqueueEvent:[TBSMEvent eventWithName:@"c" data:nil]];
+            expect(discardedEvents).to.equal(@[@"a"]);
+        });
+        
+        it(@"drops the newest event at full capacity.", ^{
+            queue.overflowPolicy = TBSMEventQueueOverflowDropNewest;
+            
+            expect([queue enqueueEvent:[TBSMEvent eventWithName:@"c" data:nil]]).to.equal(TBSMEventQueueStatusDropped);
+            expect([queue.events valueForKeyPath:@"name"]).to.equal(@[@"a", @"b"]);
+            expect(queue.droppedNewestCount).to.equal(1);
+        });
+        
+        it(@"blocks the producer until the queue has room.", ^{
+            queue.overflowPolicy = TBSMEventQueueOverflowBlock;
+            
+            waitUntil(^(DoneCallback done) {
+                dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    [queue enqueueEvent:[TBSMEvent eventWithName:@"c" data:nil]];
+                    done();
+                });
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.1 * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    [queue dequeueEvent];
+                });
+            });
+            
+            expect([queue.events valueForKeyPath:@"name"]).to.equal(@[@"b", @"c"]);
+            expect(queue.blockedCount).to.equal(1);
+        });
+        
+        it(@"rejects instead of blocking when blocking is not allowed.", ^{
+            queue.overflowPolicy = TBSMEventQueueOverflowBlock;
+            
+            expect([queue enqueueEvent:[TBSMEvent eventWithName:@"c" data:nil] allowBlocking:NO]).to.equal(TBSMEventQueueStatusRejected);
+        });
+    });
+    
+    describe(@"Coalescing.", ^{
+        
+        it(@"updates the data of a pending event in place.", ^{
+            [queue setCoalescingPolicy:TBSMEventCoalescingKeepPosition forEventNamed:@"progress"];
+            
+            TBSMEvent *progress = [TBSMEvent eventWithName:@"progress" data:@1];
+            [queue enqueueEvent:progress];
+            [queue enqueueEvent:[TBSMEvent eventWithName:@"other" data:nil]];
+            
+            expect([queue enqueueEvent:[TBSMEvent eventWithName:@"progress" data:@2]]).to.equal(TBSMEventQueueStatusCoalesced);
+            expect(queue.count).to.equal(2);
+            expect(queue.coalescedCount).to.equal(1);
+            
+            TBSMEvent *event = [queue dequeueEvent];
+            expect(event).to.equal(progress);
+            expect(event.data).to.equal(@2);
+        });
+        
+        it(@"moves a pending event to the tail.", ^{
+            [queue setCoalescingPolicy:TBSMEventCoalescingMoveToTail forEventNamed:@"progress"];
+            
+            [queue enqueueEvent:[TBSMEvent eventWithName:@"progress" data:@1]];
+            [queue enqueueEvent:[TBSMEvent eventWithName:@"other" data:nil]];
+            [queue enqueueEvent:[TBSMEvent eventWithName:@"progress" data:@2]];
+            
+            expect([queue.events valueForKeyPath:@"name"]).to.equal(@[@"other", @"progress"]);
+            expect(queue.events.lastObject.data).to.equal(@2);
+        });
+        
+        it(@"does not coalesce into an event which has already been dequeued.", ^{
+            [queue setCoalescingPolicy:TBSMEventCoalescingKeepPosition forEventNamed:@"progress"];
+            
+            [queue enqueueEvent:[TBSMEvent eventWithName:@"progress" data:@1]];
+            [queue dequeueEvent];
+            
+            expect([queue enqueueEvent:[TBSMEvent eventWithName:@"progress" data:@2]]).to.equal(TBSMEventQueueStatusEnqueued);
+            expect(queue.count).to.equal(1);
+        });
+    });
+    
+    it(@"discards expired events on dequeue.", ^{
+        
+        TBSMEvent *expired = [TBSMEvent eventWithName:@"expired" data:nil];
+        expired.deadline = [NSDate dateWithTimeIntervalSinceNow:-1.0];
+        TBSMEvent *valid = [TBSMEvent eventWithName:@"valid" data:nil];
+        valid.deadline = [NSDate dateWithTimeIntervalSinceNow:60.0];
+        
+        [queue enqueueEvent:expired];
+        [queue enqueueEvent:valid];
+        
+        NSMutableArray *discardedEvents = [NSMutableArray new];
+        queue.discardBlock = ^(TBSMEvent *event) {
+            [discardedEvents addObject:event];
+        };
+        
+        expect([queue dequeueEvent]).to.equal(valid);
+        expect(queue.expiredCount).to.equal(1);
+        expect(discardedEvents).to.equal(@[expired]);
+    });
+    
+    it(@"removes all events.", ^{
+        [queue enqueueEvent:[TBSMEvent eventWithName:@"a" data:nil]];
+        [queue removeAllEvents];
+        expect(queue.count).to.equal(0);
+    });
+});
+
+SpecEnd
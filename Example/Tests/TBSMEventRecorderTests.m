@@ -0,0 +1,179 @@
+//
+//  TBSMEventRecorderTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+#import <TBStateMachine/TBSMEventRecorder.h>
+#import <TBStateMachine/TBSMEventReplayer.h>
+
+SpecBegin(TBSMEventRecorder)
+
+__block TBSMStateMachine *stateMachine;
+__block NSOperationQueue *testQueue;
+__block NSOperationQueue *replayQueue;
+
+TBSMStateMachine *(^buildStateMachine)(void) = ^TBSMStateMachine *{
+    TBSMState *a = [TBSMState stateWithName:@"a"];
+    TBSMState *b = [TBSMState stateWithName:@"b"];
+    TBSMState *c = [TBSMState stateWithName:@"c"];
+    [a addHandlerForEvent:@"a_b" target:b];
+    [b addHandlerForEvent:@"b_c" target:c kind:TBSMTransitionExternal action:nil guard:^BOOL(id data) {
+        return [data[@"go"] boolValue];
+    }];
+    TBSMStateMachine *machine = [TBSMStateMachine stateMachineWithName:@"StateMachine"];
+    machine.states = @[a, b, c];
+    return machine;
+};
+
+describe(@"TBSMEventRecorder", ^{
+    
+    beforeEach(^{
+        testQueue = [NSOperationQueue new];
+        testQueue.maxConcurrentOperationCount = 1;
+        replayQueue = [NSOperationQueue new];
+        replayQueue.maxConcurrentOperationCount = 1;
+        stateMachine = buildStateMachine();
+        stateMachine.scheduledEventsQueue = testQueue;
+    });
+    
+    afterEach(^{
+        [stateMachine tearDown:nil];
+        stateMachine = nil;
+    });
+    
+    it(@"records scheduled events and replays them on a fresh state machine.", ^{
+        
+        TBSMEventRecorder *recorder = [[TBSMEventRecorder alloc] initWithStateMachine:stateMachine];
+        [stateMachine setUp:nil];
+        [recorder start];
+        
+        [stateMachine scheduleEventNamed:@"a_b" data:nil];
+        [stateMachine scheduleEventNamed:@"b_c" data:@{@"go" : @NO}];
+        [stateMachine scheduleEventNamed:@"b_c" data:@{@"go" : @YES} priority:TBSMEventPriorityLow];
+        [testQueue waitUntilAllOperationsAreFinished];
+        
+        [recorder stop];
+        expect(recorder.eventCount).to.equal(3);
+        expect(stateMachine.currentState.name).to.equal(@"c");
+        
+        NSError *error = nil;
+        TBSMEventReplayer *replayer = [TBSMEventReplayer replayerWithData:recorder.data error:&error];
+        expect(error).to.beNil();
+        expect(replayer.eventCount).to.equal(3);
+        expect(replayer.activeStatePaths).to.equal(@[@"c"]);
+        
+        TBSMStateMachine *replayStateMachine = buildStateMachine();
+        replayStateMachine.scheduledEventsQueue = replayQueue;
+        [replayStateMachine setUp:nil];
+        
+        expect([replayer replayOnStateMachine:replayStateMachine pacing:TBSMEventReplayPacingMaximum]).to.equal(YES);
+        expect(replayer.enqueuedEventCount).to.equal(3);
+        expect(replayStateMachine.currentState.name).to.equal(@"c");
+        
+        [replayStateMachine tearDown:nil];
+    });
+    
+    it(@"records neither events rejected by the event queue nor events scheduled from inside actions.", ^{
+        
+        TBSMStateMachine *(^buildChainingStateMachine)(void) = ^TBSMStateMachine *{
+            TBSMStateMachine *machine = buildStateMachine();
+            TBSMState *a = machine.states[0];
+            TBSMState *b = machine.states[1];
+            __weak TBSMStateMachine *weakMachine = machine;
+            [a addHandlerForEvent:@"a_chain" target:b kind:TBSMTransitionExternal action:^(id data) {
+                [weakMachine scheduleEventNamed:@"b_c" data:@{@"go" : @YES}];
+            }];
+            return machine;
+        };
+        
+        [stateMachine tearDown:nil];
+        stateMachine = buildChainingStateMachine();
+        stateMachine.scheduledEventsQueue = testQueue;
+        TBSMEventRecorder *recorder = [[TBSMEventRecorder alloc] initWithStateMachine:stateMachine];
+        [stateMachine setUp:nil];
+        [recorder start];
+        
+        testQueue.suspended = YES;
+        stateMachine.eventQueue.capacity = 1;
+        expect([stateMachine scheduleEventNamed:@"a_chain" data:nil]).to.equal(TBSMEventQueueStatusEnqueued);
+        expect([stateMachine scheduleEventNamed:@"a_b" data:nil]).to.equal(TBSMEventQueueStatusRejected);
+        testQueue.suspended = NO;
+        [testQueue waitUntilAllOperationsAreFinished];
+        
+        [recorder stop];
+        expect(recorder.eventCount).to.equal(1);
+        expect(stateMachine.currentState.name).to.equal(@"c");
+        
+        TBSMStateMachine *replayStateMachine = buildChainingStateMachine();
+        replayStateMachine.scheduledEventsQueue = replayQueue;
+        [replayStateMachine setUp:nil];
+        
+        TBSMEventReplayer *replayer = [TBSMEventReplayer replayerWithData:recorder.data error:nil];
+        expect(replayer.eventCount).to.equal(1);
+        expect([replayer replayOnStateMachine:replayStateMachine pacing:TBSMEventReplayPacingMaximum]).to.equal(YES);
+        expect(replayer.enqueuedEventCount).to.equal(1);
+        expect(replayStateMachine.currentState.name).to.equal(@"c");
+        
+        [replayStateMachine tearDown:nil];
+    });
+    
+    it(@"counts payloads which are not property lists.", ^{
+        
+        TBSMEventRecorder *recorder = [[TBSMEventRecorder alloc] initWithStateMachine:stateMachine];
+        [stateMachine setUp:nil];
+        [recorder start];
+        
+        [stateMachine scheduleEventNamed:@"a_b" data:[NSObject new]];
+        [stateMachine scheduleEventNamed:@"b_c" data:@{@"go" : @NO}];
+        [stateMachine scheduleEventNamed:@"b_c" data:@{@"go" : [NSObject new]}];
+        [testQueue waitUntilAllOperationsAreFinished];
+        [recorder stop];
+        
+        expect(recorder.eventCount).to.equal(3);
+        expect(recorder.droppedPayloadCount).to.equal(2);
+        
+        [recorder start];
+        expect(recorder.droppedPayloadCount).to.equal(0);
+    });
+    
+    it(@"detects a diverging active state configuration.", ^{
+        
+        TBSMEventRecorder *recorder = [[TBSMEventRecorder alloc] initWithStateMachine:stateMachine];
+        [stateMachine setUp:nil];
+        [recorder start];
+        [stateMachine scheduleEventNamed:@"a_b" data:nil];
+        [testQueue waitUntilAllOperationsAreFinished];
+        [recorder stop];
+        
+        TBSMEventReplayer *replayer = [TBSMEventReplayer replayerWithData:recorder.data error:nil];
+        
+        TBSMStateMachine *replayStateMachine = buildStateMachine();
+        replayStateMachine.scheduledEventsQueue = replayQueue;
+        [replayStateMachine setUp:nil];
+        [replayStateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        
+        expect([replayer replayOnStateMachine:replayStateMachine pacing:TBSMEventReplayPacingOriginal]).to.equal(YES);
+        
+        [replayStateMachine tearDown:nil];
+        
+        replayStateMachine = buildStateMachine();
+        replayStateMachine.initialState = replayStateMachine.states[2];
+        replayStateMachine.scheduledEventsQueue = replayQueue;
+        [replayStateMachine setUp:nil];
+        
+        expect([replayer replayOnStateMachine:replayStateMachine pacing:TBSMEventReplayPacingMaximum]).to.equal(NO);
+        
+        [replayStateMachine tearDown:nil];
+    });
+    
+    it(@"rejects invalid logs.", ^{
+        
+        NSError *error = nil;
+        TBSMEventReplayer *replayer = [TBSMEventReplayer replayerWithData:[@"invalid" dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+        expect(replayer).to.beNil();
+        expect(error.code).to.equal(TBSMErrorCodeInvalidEventLog);
+    });
+});
+
+SpecEnd
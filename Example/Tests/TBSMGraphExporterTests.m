@@ -0,0 +1,146 @@
+//
+//  TBSMGraphExporterTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+#import <TBStateMachine/TBSMGraphExporter.h>
+
+@interface TBSMQueueRecordingProfiler : TBSMProfiler
+@property (nonatomic, strong) NSOperationQueue *exportQueue;
+@end
+
+@implementation TBSMQueueRecordingProfiler
+
+- (NSUInteger)stepCount
+{
+    self.exportQueue = [NSOperationQueue currentQueue];
+    return [super stepCount];
+}
+
+@end
+
+SpecBegin(TBSMGraphExporter)
+
+__block TBSMStateMachine *stateMachine;
+__block TBSMGraphExporter *exporter;
+
+describe(@"TBSMGraphExporter", ^{
+    
+    beforeEach(^{
+        stateMachine = [TBSMStateMachine stateMachineWithName:@"main"];
+        stateMachine.profiler = [TBSMProfiler new];
+        
+        TBSMState *a = [TBSMState stateWithName:@"a"];
+        TBSMSubState *b = [TBSMSubState subStateWithName:@"b"];
+        TBSMState *b1 = [TBSMState stateWithName:@"b1"];
+        TBSMState *b2 = [TBSMState stateWithName:@"b2"];
+        TBSMJunction *j = [TBSMJunction junctionWithName:@"j"];
+        b.states = @[b1, b2];
+        
+        [a addHandlerForEvent:@"a_b" target:b kind:TBSMTransitionExternal action:nil guard:^BOOL(id data) {
+            return [data boolValue];
+        }];
+        [b1 addHandlerForEvent:@"b1_b2" target:b2];
+        [b2 addHandlerForEvent:@"b2_a" target:j];
+        [j addOutgoingPathWithTarget:a action:nil guard:^BOOL(id data) {
+            return YES;
+        }];
+        stateMachine.states = @[a, b];
+        [stateMachine setUp:nil];
+        
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:@NO]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:@YES]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"b1_b2" data:nil]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"b2_a" data:nil]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:@YES]];
+        
+        exporter = [TBSMGraphExporter exporterWithStateMachine:stateMachine];
+    });
+    
+    afterEach(^{
+        [stateMachine tearDown:nil];
+        stateMachine = nil;
+        exporter = nil;
+    });
+    
+    it(@"exports the hierarchy with runtime data as json.", ^{
+        
+        NSDictionary *graph = [exporter jsonRepresentation];
+        expect([NSJSONSerialization isValidJSONObject:graph]).to.beTruthy();
+        expect(graph[@"name"]).to.equal(@"main");
+        expect([graph[@"states"] valueForKey:@"path"]).to.equal(@[@"a", @"b"]);
+        
+        NSDictionary *b = graph[@"states"][1];
+        expect(b[@"type"]).to.equal(@"sub");
+        expect(b[@"active"]).to.equal(@YES);
+        expect(b[@"entries"]).to.equal(@2);
+        expect([b[@"states"] valueForKey:@"path"]).to.equal(@[@"b/b1", @"b/b2"]);
+        expect(graph[@"pseudo_states"]).to.equal(@[@{@"id" : @"junction:j", @"name" : @"j", @"type" : @"junction"}]);
+        
+        NSDictionary *transitions = [NSDictionary dictionaryWithObjects:graph[@"transitions"] forKeys:[graph[@"transitions"] valueForKey:@"name"]];
+        expect(transitions.allKeys).to.haveCountOf(4);
+        
+        NSDictionary *a_b = transitions[@"a --> b"];
+        expect(a_b[@"source"]).to.equal(@"a");
+        expect(a_b[@"target"]).to.equal(@"b");
+        expect(a_b[@"event"]).to.equal(@"a_b");
+        expect(a_b[@"guarded"]).to.equal(@YES);
+        expect(a_b[@"fires"]).to.equal(@2);
+        expect(a_b[@"rejections"]).to.equal(@1);
+        expect([a_b[@"rejection_rate"] doubleValue]).to.beCloseTo(1.0 / 3.0);
+        expect([a_b[@"p99_time"] doubleValue]).to.beGreaterThanOrEqualTo([a_b[@"mean_time"] doubleValue] / 2.0);
+        expect(a_b[@"heat"]).to.equal(@1.0);
+        
+        NSDictionary *j_a = transitions[@"j --> a"];
+        expect(j_a[@"source"]).to.equal(@"junction:j");
+        expect(j_a[@"target"]).to.equal(@"a");
+        expect(j_a[@"fires"]).to.equal(@1);
+        expect(j_a[@"heat"]).to.equal(@0.5);
+        
+        expect(transitions[@"b2 --> j --> [a]"][@"source"]).to.equal(@"b/b2");
+    });
+    
+    it(@"exports the hierarchy with runtime data as Graphviz DOT.", ^{
+        
+        NSString *dot = [exporter dotRepresentation];
+        expect(dot).to.beginWith(@"digraph \"main\" {\n");
+        expect(dot).to.contain(@"subgraph \"cluster_b\" {");
+        expect(dot).to.contain(@"\"b\" [shape=point, style=invis];");
+        expect(dot).to.contain(@"\"junction:j\" [shape=circle");
+        expect(dot).to.contain(@"\"a\" -> \"b\" [label=\"a_b\\n2 x, 33% rejected\\nmean ");
+        expect(dot).to.contain(@"lhead=\"cluster_b\"");
+        expect(dot).to.contain(@"\"b/b1\" -> \"b/b2\"");
+        expect(dot).to.contain(@"\"b/b2\" -> \"junction:j\"");
+        expect(dot).to.endWith(@"}\n");
+    });
+    
+    it(@"exports state machines without a profiler.", ^{
+        
+        exporter.profiler = nil;
+        NSDictionary *graph = [exporter jsonRepresentation];
+        
+        for (NSDictionary *transition in graph[@"transitions"]) {
+            expect(transition[@"fires"]).to.equal(@0);
+            expect(transition[@"heat"]).to.equal(@0);
+        }
+        expect([exporter dotRepresentation]).to.contain(@"color=\"gray60\"");
+    });
+    
+    it(@"exports on the scheduledEventsQueue.", ^{
+        
+        NSOperationQueue *queue = [NSOperationQueue new];
+        queue.maxConcurrentOperationCount = 1;
+        stateMachine.scheduledEventsQueue = queue;
+        
+        TBSMQueueRecordingProfiler *profiler = [TBSMQueueRecordingProfiler new];
+        exporter.profiler = profiler;
+        NSDictionary *graph = [exporter jsonRepresentation];
+        
+        expect(profiler.exportQueue).to.beIdenticalTo(queue);
+        expect(graph[@"name"]).to.equal(@"main");
+        expect([exporter dotRepresentation]).to.startWith(@"digraph \"main\"");
+    });
+});
+
+SpecEnd
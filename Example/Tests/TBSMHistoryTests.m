@@ -0,0 +1,58 @@
+//
+//  TBSMHistoryTests.m
+//  TBStateMachine
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+
+SpecBegin(TBSMHistory)
+
+__block TBSMState *a;
+__block TBSMSubState *sub;
+
+describe(@"TBSMHistory", ^{
+    
+    beforeEach(^{
+        a = [TBSMState stateWithName:@"a"];
+        sub = [TBSMSubState subStateWithName:@"sub"];
+        sub.states = @[[TBSMState stateWithName:@"b"]];
+    });
+    
+    afterEach(^{
+        a = nil;
+        sub = nil;
+    });
+    
+    describe(@"Exception handling.", ^{
+        
+        it (@"throws a TBSMException when name is an empty string.", ^{
+            
+            expect(^{
+                [TBSMHistory historyWithName:@"" kind:TBSMHistoryShallow];
+            }).to.raise(TBSMException);
+            
+        });
+        
+        it(@"throws a `TBSMException` when the containing state is not a sub or parallel state.", ^{
+            
+            expect(^{
+                TBSMHistory *history = [TBSMHistory historyWithName:@"History" kind:TBSMHistoryShallow];
+                [history setContainingState:a];
+            }).to.raiseWithReason(TBSMException, @"History 'History' must be contained in a sub or parallel state but 'a' is neither.");
+        });
+    });
+    
+    it(@"returns its name.", ^{
+        TBSMHistory *history = [TBSMHistory historyWithName:@"History" kind:TBSMHistoryDeep];
+        expect(history.name).to.equal(@"History");
+    });
+    
+    it(@"targets its containing state.", ^{
+        TBSMHistory *history = [TBSMHistory historyWithName:@"History" kind:TBSMHistoryDeep];
+        [history setContainingState:sub];
+        expect(history.kind).to.equal(TBSMHistoryDeep);
+        expect(history.targetState).to.equal(sub);
+    });
+});
+
+SpecEnd
@@ -0,0 +1,163 @@
+//
+//  TBSMLatencyTracerTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+
+SpecBegin(TBSMLatencyTracer)
+
+__block TBSMStateMachine *stateMachine;
+__block TBSMLatencyTracer *latencyTracer;
+__block TBSMState *a;
+__block TBSMState *b;
+__block TBSMState *c;
+
+TBSMEvent *(^childOfEvent)(TBSMEvent *, NSString *) = ^TBSMEvent *(TBSMEvent *parent, NSString *name) {
+    TBSMEvent *event = [TBSMEvent eventWithName:name data:nil];
+    event.enqueueTime = [NSProcessInfo processInfo].systemUptime;
+    event.parentIdentifier = parent.identifier;
+    event.rootIdentifier = parent.rootIdentifier;
+    event.rootEnqueueTime = parent.rootEnqueueTime;
+    return event;
+};
+
+describe(@"TBSMLatencyTracer", ^{
+    
+    beforeEach(^{
+        a = [TBSMState stateWithName:@"a"];
+        b = [TBSMState stateWithName:@"b"];
+        c = [TBSMState stateWithName:@"c"];
+        stateMachine = [TBSMStateMachine stateMachineWithName:@"StateMachine"];
+        stateMachine.states = @[a, b, c];
+        latencyTracer = [TBSMLatencyTracer new];
+        stateMachine.latencyTracer = latencyTracer;
+    });
+    
+    afterEach(^{
+        [stateMachine tearDown:nil];
+        stateMachine = nil;
+        latencyTracer = nil;
+        a = nil;
+        b = nil;
+        c = nil;
+    });
+    
+    it(@"assigns unique identifiers to new events.", ^{
+        
+        TBSMEvent *event = [TBSMEvent eventWithName:@"a_b" data:nil];
+        TBSMEvent *otherEvent = [TBSMEvent eventWithName:@"a_b" data:nil];
+        
+        expect(event.identifier).to.beGreaterThan(0);
+        expect(otherEvent.identifier).toNot.equal(event.identifier);
+        expect(event.rootIdentifier).to.equal(event.identifier);
+        expect(event.parentIdentifier).to.equal(0);
+        expect(event.enqueueTime).to.equal(0);
+    });
+    
+    it(@"links raised events to the event whose step has raised them.", ^{
+        
+        TBSMEvent *root = [TBSMEvent eventWithName:@"a_b" data:nil];
+        __block TBSMEvent *child;
+        [a addHandlerForEvent:@"a_b" target:b kind:TBSMTransitionExternal action:^(id data) {
+            child = [TBSMEvent eventWithName:@"b_c" data:nil];
+            [stateMachine raiseEvent:child];
+            usleep(5000);
+        }];
+        [b addHandlerForEvent:@"b_c" target:c kind:TBSMTransitionExternal action:^(id data) {
+            usleep(5000);
+        }];
+        
+        [stateMachine setUp:nil];
+        [stateMachine handleEvent:root];
+        
+        expect(stateMachine.currentState).to.equal(c);
+        expect(root.enqueueTime).to.beGreaterThan(0);
+        expect(child.parentIdentifier).to.equal(root.identifier);
+        expect(child.rootIdentifier).to.equal(root.identifier);
+        expect(child.rootEnqueueTime).to.equal(root.enqueueTime);
+        
+        expect(latencyTracer.eventCount).to.equal(2);
+        expect(latencyTracer.chainCount).to.equal(1);
+        expect(latencyTracer.pendingChainCount).to.equal(0);
+        
+        TBSMLatencyEntry *chain = latencyTracer.chainEntries.firstObject;
+        expect(latencyTracer.chainEntries).to.haveCountOf(1);
+        expect(chain.name).to.equal(@"a_b");
+        expect(chain.count).to.equal(1);
+        expect(chain.maximumTime).to.beGreaterThanOrEqualTo(0.01);
+        
+        TBSMLatencyEntry *wait = [latencyTracer.queueWaitEntries filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == 'b_c'"]].firstObject;
+        expect(wait.count).to.equal(1);
+        expect(wait.maximumTime).to.beGreaterThanOrEqualTo(0.005);
+        expect([latencyTracer report]).to.contain(@"b_c");
+        
+        [latencyTracer reset];
+        expect(latencyTracer.eventCount).to.equal(0);
+        expect(latencyTracer.processingEntries).to.haveCountOf(0);
+    });
+    
+    it(@"measures the time scheduled events have waited in the queue.", ^{
+        
+        [a addHandlerForEvent:@"a_b" target:b kind:TBSMTransitionExternal action:^(id data) {
+            [stateMachine scheduleEventNamed:@"b_c" data:nil];
+            usleep(10000);
+        }];
+        
+        [stateMachine setUp:nil];
+        
+        waitUntil(^(DoneCallback done) {
+            [b addHandlerForEvent:@"b_c" target:c kind:TBSMTransitionExternal action:^(id data) {
+                done();
+            }];
+            [stateMachine scheduleEventNamed:@"a_b" data:nil];
+        });
+        [stateMachine.scheduledEventsQueue waitUntilAllOperationsAreFinished];
+        
+        TBSMLatencyEntry *wait = [latencyTracer.queueWaitEntries filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == 'b_c'"]].firstObject;
+        expect(wait.maximumTime).to.beGreaterThanOrEqualTo(0.01);
+        
+        TBSMLatencyEntry *processing = [latencyTracer.processingEntries filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == 'a_b'"]].firstObject;
+        expect(processing.maximumTime).to.beGreaterThanOrEqualTo(0.01);
+        
+        expect(latencyTracer.chainCount).to.equal(1);
+        expect([latencyTracer.chainEntries.firstObject name]).to.equal(@"a_b");
+    });
+    
+    it(@"finishes a chain when its last pending event has been dropped.", ^{
+        
+        TBSMEvent *root = [TBSMEvent eventWithName:@"a_b" data:nil];
+        root.enqueueTime = [NSProcessInfo processInfo].systemUptime;
+        root.rootEnqueueTime = root.enqueueTime;
+        TBSMEvent *child = childOfEvent(root, @"b_c");
+        
+        [latencyTracer recordScheduledEvent:child];
+        expect(latencyTracer.pendingChainCount).to.equal(1);
+        
+        [latencyTracer recordEvent:root startTime:root.enqueueTime finishTime:root.enqueueTime];
+        expect(latencyTracer.pendingChainCount).to.equal(1);
+        
+        [latencyTracer recordDroppedEvent:child];
+        expect(latencyTracer.pendingChainCount).to.equal(0);
+        expect(latencyTracer.chainCount).to.equal(1);
+    });
+    
+    it(@"abandons the oldest chain when too many chains are pending.", ^{
+        
+        latencyTracer.maximumPendingChains = 1;
+        TBSMEvent *root = [TBSMEvent eventWithName:@"a_b" data:nil];
+        TBSMEvent *otherRoot = [TBSMEvent eventWithName:@"a_b" data:nil];
+        
+        [latencyTracer recordScheduledEvent:childOfEvent(root, @"b_c")];
+        [latencyTracer recordScheduledEvent:childOfEvent(otherRoot, @"b_c")];
+        
+        expect(latencyTracer.pendingChainCount).to.equal(1);
+        expect(latencyTracer.abandonedChainCount).to.equal(1);
+        
+        [latencyTracer recordEvent:root startTime:0.0 finishTime:0.0];
+        expect(latencyTracer.chainCount).to.equal(1);
+        expect(latencyTracer.pendingChainCount).to.equal(1);
+    });
+});
+
+SpecEnd
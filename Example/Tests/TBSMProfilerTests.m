@@ -0,0 +1,100 @@
+//
+//  TBSMProfilerTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+
+SpecBegin(TBSMProfiler)
+
+__block TBSMStateMachine *stateMachine;
+__block TBSMProfiler *profiler;
+
+describe(@"TBSMProfiler", ^{
+    
+    beforeEach(^{
+        TBSMState *a = [TBSMState stateWithName:@"a"];
+        TBSMState *b = [TBSMState stateWithName:@"b"];
+        b.enterBlock = ^(id data) {
+            usleep(5000);
+        };
+        [a addHandlerForEvent:@"a_b" target:b kind:TBSMTransitionExternal action:nil guard:^BOOL(id data) {
+            usleep(10000);
+            return YES;
+        }];
+        stateMachine = [TBSMStateMachine stateMachineWithName:@"StateMachine"];
+        stateMachine.states = @[a, b];
+        profiler = [TBSMProfiler new];
+        stateMachine.profiler = profiler;
+    });
+    
+    afterEach(^{
+        [stateMachine tearDown:nil];
+        stateMachine = nil;
+        profiler = nil;
+    });
+    
+    it(@"attributes the time of a step to framework and callbacks.", ^{
+        
+        [stateMachine setUp:nil];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        
+        expect([TBSMProfiler currentProfiler]).to.beNil();
+        expect(profiler.stepCount).to.equal(2);
+        expect(profiler.callbackTime).to.beGreaterThanOrEqualTo(0.015);
+        expect(profiler.frameworkTime).to.beLessThan(profiler.totalTime);
+        expect(profiler.totalTime).to.beCloseToWithin(profiler.frameworkTime + profiler.callbackTime, 0.000001);
+        
+        NSArray *entries = profiler.entries;
+        TBSMProfileEntry *guard = [entries filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"category == %lu", TBSMProfileCategoryGuard]].firstObject;
+        expect(guard.name).to.equal(@"a --> b");
+        expect(guard.count).to.equal(1);
+        expect(guard.totalTime).to.beGreaterThanOrEqualTo(0.01);
+        expect([entries.firstObject category]).to.equal(TBSMProfileCategoryGuard);
+        
+        TBSMProfileEntry *enter = [entries filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"category == %lu", TBSMProfileCategoryEnter]].firstObject;
+        expect(enter.name).to.equal(@"b");
+        expect(enter.count).to.equal(1);
+        
+        TBSMProfileEntry *framework = [entries filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"category == %lu AND name == 'a_b'", TBSMProfileCategoryFramework]].firstObject;
+        expect(framework.count).to.equal(1);
+        expect([profiler report]).to.contain(@"a --> b");
+        
+        [profiler reset];
+        expect(profiler.stepCount).to.equal(0);
+        expect(profiler.entries).to.haveCountOf(0);
+    });
+    
+    it(@"drops the statistics of removed event handlers.", ^{
+        
+        [stateMachine setUp:nil];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        
+        TBSMState *a = stateMachine.states[0];
+        TBSMEventHandler *eventHandler = [a.eventHandlers[@"a_b"] firstObject];
+        expect([profiler transitionStatisticsForKey:(__bridge const void *)eventHandler]).notTo.beNil();
+        
+        [a removeHandlersForEvent:@"a_b" passingTest:^BOOL(TBSMEventHandler *handler) {
+            return YES;
+        }];
+        expect([profiler transitionStatisticsForKey:(__bridge const void *)eventHandler]).to.beNil();
+        expect([profiler.entries filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"category == %lu", TBSMProfileCategoryGuard]]).to.haveCountOf(0);
+    });
+    
+    it(@"returns sampled copies of the state statistics.", ^{
+        
+        [stateMachine setUp:nil];
+        
+        TBSMState *a = stateMachine.states[0];
+        TBSMStateStatistics *first = [profiler stateStatisticsForKey:(__bridge const void *)a];
+        usleep(5000);
+        TBSMStateStatistics *second = [profiler stateStatisticsForKey:(__bridge const void *)a];
+        
+        expect(second).notTo.beIdenticalTo(first);
+        expect(second.active).to.beTruthy();
+        expect(second.entryCount).to.equal(1);
+        expect(second.totalDwellTime).to.beGreaterThanOrEqualTo(first.totalDwellTime + 0.005);
+    });
+});
+
+SpecEnd
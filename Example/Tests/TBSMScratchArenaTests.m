@@ -0,0 +1,97 @@
+//
+//  TBSMScratchArenaTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+
+SpecBegin(TBSMScratchArena)
+
+__block TBSMStateMachine *stateMachine;
+
+describe(@"TBSMScratchArena", ^{
+    
+    afterEach(^{
+        [stateMachine tearDown:nil];
+        stateMachine = nil;
+    });
+    
+    it(@"serves aligned allocations and reuses its blocks after a reset.", ^{
+        
+        TBSMScratchArena *arena = [[TBSMScratchArena alloc] initWithBlockSize:64];
+        void *first = [arena allocate:3];
+        void *second = [arena allocate:40];
+        void *large = [arena allocate:200];
+        
+        expect((uintptr_t)first % 16).to.equal(0);
+        expect((uintptr_t)second % 16).to.equal(0);
+        expect((uintptr_t)large % 16).to.equal(0);
+        expect((uint8_t *)second - (uint8_t *)first).to.equal(16);
+        expect(arena.allocatedBytes).to.equal(16 + 48 + 208);
+        expect(arena.capacity).to.equal(64 + 208);
+        
+        [arena reset];
+        expect(arena.allocatedBytes).to.equal(0);
+        expect([arena allocate:3] == first).to.beTruthy();
+        expect([arena allocate:200] == large).to.beTruthy();
+        expect(arena.capacity).to.equal(64 + 208);
+    });
+    
+    it(@"is current during every run-to-completion step of the state machine.", ^{
+        
+        __block TBSMScratchArena *currentArena = nil;
+        __block char *scratch = NULL;
+        TBSMState *a = [TBSMState stateWithName:@"a"];
+        TBSMState *b = [TBSMState stateWithName:@"b"];
+        [a addHandlerForEvent:@"a_b" target:b kind:TBSMTransitionExternal action:^(id data) {
+            currentArena = [TBSMScratchArena currentArena];
+            scratch = [currentArena allocate:16];
+            strcpy(scratch, "a --> b");
+        } guard:nil];
+        b.enterBlock = ^(id data) {
+            expect(strcmp(scratch, "a --> b")).to.equal(0);
+        };
+        stateMachine = [TBSMStateMachine stateMachineWithName:@"StateMachine"];
+        stateMachine.states = @[a, b];
+        [stateMachine setUp:nil];
+        
+        expect([TBSMScratchArena currentArena]).to.beNil();
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        
+        expect(currentArena).to.beIdenticalTo(stateMachine.scratchArena);
+        expect([TBSMScratchArena currentArena]).to.beNil();
+        expect(stateMachine.scratchArena.allocatedBytes).to.equal(0);
+        expect(stateMachine.scratchArena.capacity).to.beGreaterThan(0);
+    });
+    
+    it(@"is shared with sub state machines which are left during the step.", ^{
+        
+        __block TBSMScratchArena *currentArena = nil;
+        __block char *scratch = NULL;
+        TBSMState *a1 = [TBSMState stateWithName:@"a1"];
+        TBSMSubState *a = [TBSMSubState subStateWithName:@"a"];
+        TBSMState *b = [TBSMState stateWithName:@"b"];
+        a.states = @[a1];
+        a1.exitBlock = ^(id data) {
+            currentArena = [TBSMScratchArena currentArena];
+            scratch = [currentArena allocate:16];
+            strcpy(scratch, "a1 exit");
+        };
+        b.enterBlock = ^(id data) {
+            expect([TBSMScratchArena currentArena]).to.beIdenticalTo(currentArena);
+            expect(currentArena.allocatedBytes).to.equal(16);
+            expect(strcmp(scratch, "a1 exit")).to.equal(0);
+        };
+        [a addHandlerForEvent:@"a_b" target:b];
+        stateMachine = [TBSMStateMachine stateMachineWithName:@"StateMachine"];
+        stateMachine.states = @[a, b];
+        [stateMachine setUp:nil];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        
+        expect(currentArena).to.beIdenticalTo(stateMachine.scratchArena);
+        expect([TBSMScratchArena currentArena]).to.beNil();
+        expect(stateMachine.scratchArena.allocatedBytes).to.equal(0);
+    });
+});
+
+SpecEnd
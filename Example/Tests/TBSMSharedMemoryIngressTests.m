@@ -0,0 +1,102 @@
+//
+//  TBSMSharedMemoryIngressTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+#import <TBStateMachine/TBSMSharedMemoryIngress.h>
+#import <sys/mman.h>
+
+SpecBegin(TBSMSharedMemoryIngress)
+
+__block TBSMStateMachine *stateMachine;
+__block TBSMSharedMemoryIngress *ingress;
+__block NSOperationQueue *testQueue;
+
+describe(@"TBSMSharedMemoryIngress", ^{
+    
+    beforeEach(^{
+        testQueue = [NSOperationQueue new];
+        testQueue.maxConcurrentOperationCount = 1;
+        
+        TBSMState *a = [TBSMState stateWithName:@"a"];
+        TBSMState *b = [TBSMState stateWithName:@"b"];
+        [a addHandlerForEvent:@"a_b" target:b kind:TBSMTransitionExternal action:nil guard:^BOOL(NSData *data) {
+            return (data.length == 4 && ((const uint8_t *)data.bytes)[0] == 42);
+        }];
+        stateMachine = [TBSMStateMachine stateMachineWithName:@"StateMachine"];
+        stateMachine.states = @[a, b];
+        stateMachine.scheduledEventsQueue = testQueue;
+        [stateMachine setUp:nil];
+        
+        [TBSMSharedMemoryIngress unlinkRingWithName:@"test"];
+        ingress = [[TBSMSharedMemoryIngress alloc] initWithName:@"test" capacity:16 error:nil];
+        [ingress registerStateMachine:stateMachine identifier:1];
+        [ingress registerEventName:@"a_b" identifier:7];
+    });
+    
+    afterEach(^{
+        [ingress stop];
+        ingress = nil;
+        [TBSMSharedMemoryIngress unlinkRingWithName:@"test"];
+        [stateMachine tearDown:nil];
+        stateMachine = nil;
+    });
+    
+    it(@"schedules events published by a producer.", ^{
+        
+        expect(ingress).notTo.beNil();
+        [ingress start];
+        
+        tbsm_ingress *producer = tbsm_ingress_open("test", 0, 0);
+        expect(producer != NULL).to.beTruthy();
+        
+        uint8_t wrong[4] = {1, 0, 0, 0};
+        uint8_t right[4] = {42, 0, 0, 0};
+        expect(tbsm_ingress_send(producer, 1, 7, wrong, sizeof(wrong))).to.equal(0);
+        expect(tbsm_ingress_send(producer, 2, 7, NULL, 0)).to.equal(0);
+        expect(tbsm_ingress_send(producer, 1, 9, NULL, 0)).to.equal(0);
+        expect(tbsm_ingress_send(producer, 1, 7, right, sizeof(right))).to.equal(0);
+        tbsm_ingress_close(producer);
+        
+        expect(ingress.receivedCount).will.equal(4);
+        [testQueue waitUntilAllOperationsAreFinished];
+        
+        expect(ingress.droppedCount).to.equal(2);
+        expect(stateMachine.currentState.name).to.equal(@"b");
+    });
+    
+    it(@"rejects records when the ring is full.", ^{
+        
+        tbsm_ingress *producer = tbsm_ingress_open("test", 0, 0);
+        for (NSUInteger i = 0; i < 16; i++) {
+            expect(tbsm_ingress_send(producer, 1, 7, NULL, 0)).to.equal(0);
+        }
+        expect(tbsm_ingress_send(producer, 1, 7, NULL, 0)).to.equal(-1);
+        expect(tbsm_ingress_send(producer, 1, 7, NULL, TBSM_INGRESS_PAYLOAD_SIZE + 1)).to.equal(-1);
+        tbsm_ingress_close(producer);
+        
+        [ingress start];
+        expect(ingress.receivedCount).will.equal(16);
+    });
+    
+    it(@"does not map a ring which has not been initialized yet.", ^{
+        
+        int fd = shm_open("/tbsm.unsized", O_RDWR | O_CREAT, 0600);
+        expect(fd).to.beGreaterThanOrEqualTo(0);
+        close(fd);
+        
+        expect(tbsm_ingress_open("unsized", 0, 0) == NULL).to.beTruthy();
+        expect(errno).to.equal(EAGAIN);
+        
+        fd = shm_open("/tbsm.unsized", O_RDWR, 0600);
+        expect(ftruncate(fd, 4096)).to.equal(0);
+        close(fd);
+        
+        expect(tbsm_ingress_open("unsized", 0, 0) == NULL).to.beTruthy();
+        expect(errno).to.equal(EAGAIN);
+        tbsm_ingress_unlink("unsized");
+    });
+});
+
+SpecEnd
@@ -10,11 +10,27 @@
 #import <TBStateMachine/TBSMStateMachineBuilder.h>
 #import <TBStateMachine/TBSMDebugger.h>
 
+@interface TBSMBuilderTestObserver : NSObject
+@property (nonatomic, assign) NSUInteger notificationCount;
+@end
+
+@implementation TBSMBuilderTestObserver
+
+- (void)handleNotification:(NSNotification *)notification
+{
+    self.notificationCount++;
+}
+
+@end
+
 SpecBegin(TBSMStateMachineBuilderTests)
 
 __block NSString *simple;
 __block NSString *nested;
 __block NSString *pseudo;
+__block NSString *deferred;
+__block NSString *deferredEvents;
+__block NSString *simpleChanged;
 __block TBSMStateMachine *stateMachine;
 
 describe(@"TBSMStateMachineBuilder", ^{
@@ -23,6 +39,9 @@ describe(@"TBSMStateMachineBuilder", ^{
         simple = [[NSBundle bundleForClass:[self class]] pathForResource:@"simple" ofType:@"json"];
         nested = [[NSBundle bundleForClass:[self class]] pathForResource:@"nested" ofType:@"json"];
         pseudo = [[NSBundle bundleForClass:[self class]] pathForResource:@"pseudo" ofType:@"json"];
+        deferred = [[NSBundle bundleForClass:[self class]] pathForResource:@"deferred" ofType:@"json"];
+        deferredEvents = [[NSBundle bundleForClass:[self class]] pathForResource:@"deferred_events" ofType:@"json"];
+        simpleChanged = [[NSBundle bundleForClass:[self class]] pathForResource:@"simple_changed" ofType:@"json"];
     });
     
     afterEach(^{
@@ -56,6 +75,24 @@ describe(@"TBSMStateMachineBuilder", ^{
         expect(stateMachine.currentState).to.equal(a);
     });
     
+    it(@"builds a setup with deferred events", ^{
+        
+        stateMachine = [TBSMStateMachineBuilder buildFromFile:deferredEvents];
+        
+        TBSMState *a = stateMachine.states[0];
+        TBSMState *c = stateMachine.states[2];
+        expect(a.deferredEvents).to.equal([NSSet setWithObject:@"b_c"]);
+        
+        [stateMachine setUp:nil];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"b_c" data:nil]];
+        expect(stateMachine.currentState).to.equal(a);
+        expect(stateMachine.deferredEvents).to.haveCountOf(1);
+        
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        expect(stateMachine.currentState).to.equal(c);
+        expect(stateMachine.deferredEvents).to.haveCountOf(0);
+    });
+    
     it(@"builds a nested setup", ^{
         
         stateMachine = [TBSMStateMachineBuilder buildFromFile:nested];
@@ -127,5 +164,93 @@ describe(@"TBSMStateMachineBuilder", ^{
         expect(stateMachine.currentState).to.equal(c);
     });
 
+    it(@"builds a deferred setup", ^{
+        
+        stateMachine = [TBSMStateMachineBuilder buildFromFile:deferred];
+        expect(stateMachine.states.count).to.equal(3);
+        
+        TBSMState *a = stateMachine.states[0];
+        TBSMSubState *b = stateMachine.states[1];
+        TBSMParallelState *c = stateMachine.states[2];
+        expect(b.isMaterialized).to.beFalsy();
+        expect(c.isMaterialized).to.beFalsy();
+        
+        TBSMBuilderTestObserver *observer = [TBSMBuilderTestObserver new];
+        [stateMachine subscribeToEntryAtPath:@"b/b2" forObserver:observer selector:@selector(handleNotification:)];
+        expect([stateMachine isActiveAtPath:@"b/b1"]).to.beFalsy();
+        expect([stateMachine stateWithPath:@"b"]).to.equal(b);
+        expect([stateMachine pathOfState:b]).to.equal(@"b");
+        expect(b.isMaterialized).to.beFalsy();
+        
+        [stateMachine setUp:nil];
+        
+        waitUntil(^(DoneCallback done) {
+            [stateMachine scheduleEventNamed:@"a_b" data:nil];
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:@"b1_b2" data:nil] withCompletion:^{
+                done();
+            }];
+        });
+        
+        expect(b.isMaterialized).to.beTruthy();
+        expect([stateMachine isActiveAtPath:@"b/b2"]).to.beTruthy();
+        expect(observer.notificationCount).to.equal(1);
+        
+        waitUntil(^(DoneCallback done) {
+            [stateMachine scheduleEventNamed:@"b2_c" data:nil];
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:@"c11_a" data:nil] withCompletion:^{
+                done();
+            }];
+        });
+        
+        expect(stateMachine.currentState).to.equal(a);
+        expect(b.isMaterialized).to.beTruthy();
+        expect(c.isMaterialized).will.beFalsy();
+        expect([stateMachine isActiveAtPath:@"c@0/c11"]).to.beFalsy();
+        expect(c.isMaterialized).to.beFalsy();
+        
+        NSError *error = nil;
+        expect([stateMachine stateWithPath:@"c"]).to.equal(c);
+        expect([stateMachine stateWithPath:@"c@1/c21" error:&error]).to.beNil();
+        expect(error.code).to.equal(TBSMErrorCodeUnmaterializedPath);
+        expect(c.isMaterialized).to.beFalsy();
+        
+        [stateMachine unsubscribeFromEntryAtPath:@"b/b2" forObserver:observer];
+    });
+
+    it(@"applies a changed definition to a running state machine", ^{
+        
+        stateMachine = [TBSMStateMachineBuilder buildFromFile:simple];
+        [stateMachine setUp:nil];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"b_c" data:nil]];
+        
+        TBSMState *a = stateMachine.states[0];
+        
+        TBSMStateMachineDiff *diff = [TBSMStateMachineBuilder diffFromFile:simple toFile:simpleChanged];
+        expect(diff.addedStatePaths).to.equal(@[@"d"]);
+        expect(diff.removedStatePaths).to.equal(@[@"c"]);
+        expect(diff.changedContainerPaths).to.equal(@[@""]);
+        expect(diff.addedTransitions.count).to.equal(3);
+        expect(diff.removedTransitions.count).to.equal(2);
+        
+        NSError *error = nil;
+        expect([TBSMStateMachineBuilder applyDiff:diff toStateMachine:stateMachine fallbacks:@{} error:&error]).to.beFalsy();
+        expect(error.code).to.equal(TBSMErrorCodeIncompatibleDefinition);
+        expect(stateMachine.states.count).to.equal(3);
+        
+        expect([TBSMStateMachineBuilder applyDiff:diff toStateMachine:stateMachine fallbacks:@{@"c" : @"d/d2"} error:&error]).to.beTruthy();
+        expect([stateMachine.states valueForKey:@"name"]).to.equal(@[@"a", @"b", @"d"]);
+        expect([stateMachine isActiveAtPath:@"d/d2"]).to.beTruthy();
+        expect(stateMachine.configurationSnapshot.activeLeafStatePaths).to.equal(@[@"d/d2"]);
+        expect([stateMachine acceptsEvent:[TBSMEvent eventWithName:@"c_a" data:nil]]).to.beFalsy();
+        
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"d_a" data:nil]];
+        expect(stateMachine.currentState).to.equal(a);
+        
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"b_d" data:nil]];
+        expect([stateMachine isActiveAtPath:@"d/d1"]).to.beTruthy();
+    });
+
 });
 SpecEnd
@@ -398,6 +398,22 @@ describe(@"TBSMStateMachine", ^{
     });
     
     
+    it(@"keeps handling scheduled events after leaving a sub state.", ^{
+        
+        waitUntil(^(DoneCallback done) {
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:StateMachineEvents.a_guard data:@{event_data_key:@(1)}] withCompletion:^{
+                [executionSequence removeAllObjects];
+            }];
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:StateMachineEvents.a3_b2 data:nil]];
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:StateMachineEvents.b_b22 data:nil] withCompletion:^{
+                done();
+            }];
+        });
+        
+        expect(executionSequence).to.contain(@"a_exit");
+        expect(executionSequence.lastObject).to.equal(@"b22_enter");
+    });
+    
     it(@"switches deep from and into a sub state which enters initial state.", ^{
         
         waitUntil(^(DoneCallback done) {
@@ -726,6 +742,96 @@ describe(@"TBSMStateMachine", ^{
         expect(c.stateMachine.currentState.name).to.equal(@"c2");
     });
     
+    it(@"answers active state queries after a fork compound transition.", ^{
+
+        expect([stateMachine isActiveAtPath:@"a/a1"]).to.equal(YES);
+        expect([stateMachine isActiveAtPath:@"c"]).to.equal(NO);
+
+        waitUntil(^(DoneCallback done) {
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:StateMachineEvents.a_fork data:nil] withCompletion:^{
+                done();
+            }];
+        });
+
+        expect([stateMachine isActiveAtPath:@"a"]).to.equal(NO);
+        expect([stateMachine isActiveAtPath:@"a/a1"]).to.equal(NO);
+        expect([stateMachine isActiveAtPath:@"c"]).to.equal(YES);
+        expect([stateMachine isActiveAtPath:@"c/c2"]).to.equal(YES);
+        expect([stateMachine isActiveAtPath:@"c/c2@0/c212"]).to.equal(YES);
+        expect([stateMachine isActiveAtPath:@"c/c2@1/c221"]).to.equal(NO);
+        expect([stateMachine isActive:[stateMachine stateWithPath:@"c/c2@1/c222"]]).to.equal(YES);
+
+        NSMutableArray *leafStates = [NSMutableArray new];
+        [stateMachine enumerateActiveLeafStatesUsingBlock:^(TBSMState *state, BOOL *stop) {
+            [leafStates addObject:state.name];
+        }];
+        expect(leafStates).to.equal(@[@"c212", @"c222"]);
+    });
+
+    it(@"restores the last active configuration through a deep history.", ^{
+
+        TBSMState *a3 = [stateMachine stateWithPath:@"a/a3"];
+        TBSMHistory *history = [TBSMHistory historyWithName:@"history" kind:TBSMHistoryDeep];
+        [history setContainingState:[stateMachine stateWithPath:@"b"]];
+        [a3 addHandlerForEvent:@"a3_history" target:history];
+
+        [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.a_guard data:nil]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.b_b22 data:nil]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.b_a3 data:nil]];
+        [executionSequence removeAllObjects];
+
+        expect([stateMachine handleEvent:[TBSMEvent eventWithName:@"a3_history" data:nil]]).to.equal(YES);
+
+        NSArray *expectedExecutionSequence = @[@"a3_exit",
+                                               @"a_exit",
+                                               @"b_enter",
+                                               @"b2_enter",
+                                               @"b22_enter"];
+
+        expect(executionSequence).to.equal(expectedExecutionSequence);
+        expect([stateMachine isActiveAtPath:@"b/b2/b22"]).to.equal(YES);
+    });
+
+    it(@"restores only the last active state of the containing state through a shallow history.", ^{
+
+        TBSMState *a3 = [stateMachine stateWithPath:@"a/a3"];
+        TBSMHistory *history = [TBSMHistory historyWithName:@"history" kind:TBSMHistoryShallow];
+        [history setContainingState:[stateMachine stateWithPath:@"b"]];
+        [a3 addHandlerForEvent:@"a3_history" target:history];
+
+        [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.a_guard data:nil]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.b_b22 data:nil]];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.b_a3 data:nil]];
+        [executionSequence removeAllObjects];
+
+        expect([stateMachine handleEvent:[TBSMEvent eventWithName:@"a3_history" data:nil]]).to.equal(YES);
+
+        NSArray *expectedExecutionSequence = @[@"a3_exit",
+                                               @"a_exit",
+                                               @"b_enter",
+                                               @"b2_enter",
+                                               @"b21_enter"];
+
+        expect(executionSequence).to.equal(expectedExecutionSequence);
+    });
+
+    it(@"rejects events which can not be handled by any active state.", ^{
+
+        expect([stateMachine acceptsEvent:[TBSMEvent eventWithName:StateMachineEvents.a1_internal data:nil]]).to.equal(YES);
+        expect([stateMachine acceptsEvent:[TBSMEvent eventWithName:StateMachineEvents.b3xx_internal data:nil]]).to.equal(NO);
+        expect([stateMachine acceptsEvent:[TBSMEvent eventWithName:@"unknown" data:nil]]).to.equal(NO);
+        expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.b3xx_internal data:nil]]).to.equal(NO);
+
+        TBSMState *a1 = [stateMachine stateWithPath:@"a/a1"];
+        [a1 addHandlerForEvent:@"added_after_setup" target:a1 kind:TBSMTransitionInternal action:^(id data) {
+            [executionSequence addObject:@"a1_added_after_setup_action"];
+        }];
+
+        expect([stateMachine acceptsEvent:[TBSMEvent eventWithName:@"added_after_setup" data:nil]]).to.equal(YES);
+        expect([stateMachine handleEvent:[TBSMEvent eventWithName:@"added_after_setup" data:nil]]).to.equal(YES);
+        expect(executionSequence).to.equal(@[@"a1_added_after_setup_action"]);
+    });
+
     it(@"resolves a path", ^{
         
         waitUntil(^(DoneCallback done) {
@@ -9,6 +9,17 @@
 #import <TBStateMachine/TBSMStateMachine.h>
 #import <TBStateMachine/TBSMDebugger.h>
 
+static void TBSMTestAppendFunction(id data, void *context)
+{
+    NSMutableString *executionSequence = (__bridge NSMutableString *)context;
+    [executionSequence appendString:data];
+}
+
+static BOOL TBSMTestGuardFunction(id data, void *context)
+{
+    return (data != nil);
+}
+
 SpecBegin(TBSMStateMachineSimple)
 
 struct StateMachineEvents {
@@ -419,6 +430,385 @@ describe(@"TBSMStateMachine", ^{
         });
     });
     
+    describe(@"Event priorities.", ^{
+        
+        it(@"handles events of higher priority first.", ^{
+            
+            NSMutableString *executionSequence = [NSMutableString stringWithString:@""];
+            
+            [a addHandlerForEvent:@"low" target:a kind:TBSMTransitionInternal action:^(id data) {
+                [executionSequence appendString:@"-low"];
+            }];
+            [a addHandlerForEvent:@"normal" target:a kind:TBSMTransitionInternal action:^(id data) {
+                [executionSequence appendString:@"-normal"];
+            }];
+            [a addHandlerForEvent:@"high" target:a kind:TBSMTransitionInternal action:^(id data) {
+                [executionSequence appendString:@"-high"];
+            }];
+            
+            stateMachine.states = @[a];
+            stateMachine.scheduledEventsQueue = testQueue;
+            [stateMachine setUp:nil];
+            
+            waitUntil(^(DoneCallback done) {
+                testQueue.suspended = YES;
+                
+                TBSMEvent *low = [TBSMEvent eventWithName:@"low" data:nil];
+                low.priority = TBSMEventPriorityLow;
+                [stateMachine scheduleEvent:low withCompletion:^{
+                    done();
+                }];
+                [stateMachine scheduleEventNamed:@"normal" data:nil];
+                [stateMachine scheduleEventNamed:@"high" data:nil priority:TBSMEventPriorityHigh];
+                
+                testQueue.suspended = NO;
+            });
+            
+            expect(executionSequence).to.equal(@"-high-normal-low");
+        });
+    });
+    
+    describe(@"Completion transitions.", ^{
+        
+        it(@"performs completion transitions inside the same run-to-completion step.", ^{
+            
+            NSMutableString *executionSequence = [NSMutableString stringWithString:@""];
+            
+            b.enterBlock = ^(id data) {
+                [executionSequence appendString:@"-enterB"];
+            };
+            c.enterBlock = ^(id data) {
+                [executionSequence appendString:@"-enterC"];
+            };
+            
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:b];
+            [b addCompletionHandlerWithTarget:c kind:TBSMTransitionExternal action:^(id data) {
+                [executionSequence appendString:@"-completionB"];
+            } guard:^BOOL(id data) {
+                return [data isEqual:EVENT_DATA_VALUE];
+            }];
+            
+            stateMachine.states = @[a, b, c];
+            [stateMachine setUp:nil];
+            
+            waitUntil(^(DoneCallback done) {
+                [stateMachine scheduleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:EVENT_DATA_VALUE] withCompletion:^{
+                    done();
+                }];
+            });
+            
+            expect(executionSequence).to.equal(@"-enterB-completionB-enterC");
+            expect(stateMachine.currentState).to.equal(c);
+        });
+        
+        it(@"discards the completion event when no guard evaluates to YES.", ^{
+            
+            [a addCompletionHandlerWithTarget:b kind:TBSMTransitionExternal action:nil guard:^BOOL(id data) {
+                return NO;
+            }];
+            
+            stateMachine.states = @[a, b];
+            [stateMachine setUp:nil];
+            
+            expect(stateMachine.currentState).to.equal(a);
+        });
+        
+        it(@"performs completion transitions of sub states when their region has reached its final state.", ^{
+            
+            TBSMSubState *s = [TBSMSubState subStateWithName:@"s"];
+            TBSMFinalState *f = [TBSMFinalState finalStateWithName:@"f"];
+            [a addCompletionHandlerWithTarget:f];
+            s.states = @[a, f];
+            [s addCompletionHandlerWithTarget:b];
+            
+            stateMachine.states = @[s, b];
+            [stateMachine setUp:nil];
+            
+            expect(stateMachine.currentState).to.equal(b);
+        });
+    });
+    
+    describe(@"Internal events.", ^{
+        
+        it(@"handles internal events right after the current step and before the next scheduled event.", ^{
+            
+            NSMutableString *executionSequence = [NSMutableString stringWithString:@""];
+            
+            b.enterBlock = ^(id data) {
+                [executionSequence appendString:@"-enterB"];
+                [stateMachine raiseEventNamed:StateMachineEvents.EVENT_B data:nil];
+                [executionSequence appendString:@"-raisedB"];
+            };
+            c.enterBlock = ^(id data) {
+                [executionSequence appendString:@"-enterC"];
+            };
+            
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:b];
+            [b addHandlerForEvent:StateMachineEvents.EVENT_B target:c];
+            [c addHandlerForEvent:StateMachineEvents.EVENT_A target:c kind:TBSMTransitionInternal action:^(id data) {
+                [executionSequence appendString:@"-internalC"];
+            }];
+            
+            stateMachine.states = @[a, b, c];
+            stateMachine.scheduledEventsQueue = testQueue;
+            [stateMachine setUp:nil];
+            
+            waitUntil(^(DoneCallback done) {
+                testQueue.suspended = YES;
+                [stateMachine scheduleEventNamed:StateMachineEvents.EVENT_A data:nil];
+                [stateMachine scheduleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:nil] withCompletion:^{
+                    done();
+                }];
+                testQueue.suspended = NO;
+            });
+            
+            expect(executionSequence).to.equal(@"-enterB-raisedB-enterC-internalC");
+            expect(stateMachine.currentState).to.equal(c);
+        });
+        
+        it(@"handles internal events immediately outside of a run-to-completion step.", ^{
+            
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:b];
+            
+            stateMachine.states = @[a, b];
+            [stateMachine setUp:nil];
+            [stateMachine raiseEventNamed:StateMachineEvents.EVENT_A data:nil];
+            
+            expect(stateMachine.currentState).to.equal(b);
+        });
+    });
+
+    describe(@"Deferred events.", ^{
+        
+        it(@"keeps deferred events and handles them once after leaving the deferring state.", ^{
+            
+            NSMutableString *executionSequence = [NSMutableString stringWithString:@""];
+            
+            [a deferEvent:StateMachineEvents.EVENT_B];
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:b kind:TBSMTransitionExternal action:^(id data) {
+                [executionSequence appendString:@"-a_b"];
+            }];
+            [b addHandlerForEvent:StateMachineEvents.EVENT_B target:c kind:TBSMTransitionExternal action:^(id data) {
+                [executionSequence appendFormat:@"-b_c:%@", data];
+            }];
+            
+            stateMachine.states = @[a, b, c];
+            [stateMachine setUp:nil];
+            
+            expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_B data:@"1"]]).to.beFalsy();
+            expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_B data:@"2"]]).to.beFalsy();
+            expect(stateMachine.currentState).to.equal(a);
+            expect([stateMachine.deferredEvents valueForKey:@"data"]).to.equal(@[@"1", @"2"]);
+            
+            [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:nil]];
+            
+            expect(executionSequence).to.equal(@"-a_b-b_c:1");
+            expect(stateMachine.currentState).to.equal(c);
+            expect(stateMachine.deferredEvents).to.haveCountOf(0);
+        });
+        
+        it(@"prefers transitions over deferring an event.", ^{
+            
+            [a deferEvent:StateMachineEvents.EVENT_A];
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:b];
+            
+            stateMachine.states = @[a, b];
+            [stateMachine setUp:nil];
+            [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:nil]];
+            
+            expect(stateMachine.currentState).to.equal(b);
+            expect(stateMachine.deferredEvents).to.haveCountOf(0);
+        });
+        
+        it(@"discards deferred events on tear down.", ^{
+            
+            [a deferEvent:StateMachineEvents.EVENT_B];
+            
+            stateMachine.states = @[a, b];
+            [stateMachine setUp:nil];
+            [stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_B data:nil]];
+            expect(stateMachine.deferredEvents).to.haveCountOf(1);
+            
+            [stateMachine tearDown:nil];
+            expect(stateMachine.deferredEvents).to.haveCountOf(0);
+        });
+        
+        it(@"throws a TBSMException when a deferred event has no name.", ^{
+            
+            expect(^{
+                [a deferEvent:@""];
+            }).to.raise(TBSMException);
+        });
+    });
+    
+    describe(@"Asynchronous actions.", ^{
+
+        it(@"keeps events pending until the asynchronous action has completed.", ^{
+
+            NSMutableString *executionSequence = [NSMutableString stringWithString:@""];
+            __block TBSMActionCompletionBlock pendingCompletion = nil;
+
+            a.exitBlock = ^(id data) {
+                [executionSequence appendString:@"-exitA"];
+            };
+            b.enterBlock = ^(id data) {
+                [executionSequence appendString:@"-enterB"];
+            };
+            c.enterBlock = ^(id data) {
+                [executionSequence appendString:@"-enterC"];
+            };
+
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:b kind:TBSMTransitionExternal asyncAction:^(id data, TBSMActionCompletionBlock completion) {
+                [executionSequence appendString:@"-action"];
+                pendingCompletion = completion;
+            } guard:nil];
+            [b addHandlerForEvent:StateMachineEvents.EVENT_B target:c];
+
+            stateMachine.states = @[a, b, c];
+            stateMachine.scheduledEventsQueue = testQueue;
+            [stateMachine setUp:nil];
+
+            expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:nil]]).to.equal(YES);
+            expect(stateMachine.isTransitionInProgress).to.beTruthy();
+            expect(executionSequence).to.equal(@"-exitA-action");
+
+            waitUntil(^(DoneCallback done) {
+                [stateMachine scheduleEventNamed:StateMachineEvents.EVENT_B data:nil];
+                [testQueue addOperationWithBlock:^{
+                    done();
+                }];
+            });
+
+            expect(executionSequence).to.equal(@"-exitA-action");
+            expect(stateMachine.eventQueue.count).to.equal(1);
+
+            waitUntil(^(DoneCallback done) {
+                pendingCompletion();
+                [testQueue addOperationWithBlock:^{
+                    [testQueue addOperationWithBlock:^{
+                        done();
+                    }];
+                }];
+            });
+
+            expect(stateMachine.isTransitionInProgress).to.beFalsy();
+            expect(executionSequence).to.equal(@"-exitA-action-enterB-enterC");
+            expect(stateMachine.currentState).to.equal(c);
+        });
+
+        it(@"throws a TBSMException when an asynchronous action is registered for an internal transition.", ^{
+            expect(^{
+                [a addHandlerForEvent:StateMachineEvents.EVENT_A target:a kind:TBSMTransitionInternal asyncAction:^(id data, TBSMActionCompletionBlock completion) {
+                    completion();
+                } guard:nil];
+            }).to.raise(TBSMException);
+        });
+    });
+
+    describe(@"Function pointer handlers.", ^{
+
+        it(@"executes guard and action functions with their context.", ^{
+
+            NSMutableString *executionSequence = [NSMutableString stringWithString:@""];
+            void *context = (__bridge void *)executionSequence;
+
+            a.exitFunction = TBSMTestAppendFunction;
+            a.functionContext = context;
+            b.enterFunction = TBSMTestAppendFunction;
+            b.functionContext = context;
+
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:b kind:TBSMTransitionExternal actionFunction:TBSMTestAppendFunction guardFunction:TBSMTestGuardFunction context:context];
+
+            stateMachine.states = @[a, b];
+            [stateMachine setUp:nil];
+
+            expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:nil]]).to.equal(NO);
+            expect(stateMachine.currentState).to.equal(a);
+
+            expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:@"-"]]).to.equal(YES);
+            expect(stateMachine.currentState).to.equal(b);
+            expect(executionSequence).to.equal(@"---");
+        });
+
+        it(@"executes junction path functions.", ^{
+
+            NSMutableString *executionSequence = [NSMutableString stringWithString:@""];
+            void *context = (__bridge void *)executionSequence;
+
+            TBSMJunction *junction = [TBSMJunction junctionWithName:@"junction"];
+            [junction addOutgoingPathWithTarget:c actionFunction:TBSMTestAppendFunction guardFunction:TBSMTestGuardFunction context:context];
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:junction];
+
+            stateMachine.states = @[a, b, c];
+            [stateMachine setUp:nil];
+
+            expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:@"-junction"]]).to.equal(YES);
+            expect(stateMachine.currentState).to.equal(c);
+            expect(executionSequence).to.equal(@"-junction");
+        });
+    });
+
+    describe(@"Error reporting.", ^{
+
+        it(@"reports a missing outgoing junction path and stays in the source state.", ^{
+
+            __block NSError *reportedError = nil;
+            stateMachine.errorMode = TBSMErrorModeReport;
+            stateMachine.errorHandler = ^(NSError *error) {
+                reportedError = error;
+            };
+
+            TBSMJunction *junction = [TBSMJunction junctionWithName:@"junction"];
+            [junction addOutgoingPathWithTarget:b action:nil guard:^BOOL(id data) {
+                return NO;
+            }];
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:junction];
+
+            stateMachine.states = @[a, b];
+            [stateMachine setUp:nil];
+
+            expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:nil]]).to.equal(NO);
+            expect(stateMachine.currentState).to.equal(a);
+            expect(reportedError.domain).to.equal(TBSMErrorDomain);
+            expect(reportedError.code).to.equal(TBSMErrorCodeNoOutgoingJunctionPath);
+            expect(stateMachine.lastError).to.equal(reportedError);
+        });
+
+        it(@"reports a missing sub state machine and enters the containing state.", ^{
+
+            stateMachine.errorMode = TBSMErrorModeReport;
+
+            TBSMSubState *subState = [TBSMSubState subStateWithName:@"subState"];
+            [a addHandlerForEvent:StateMachineEvents.EVENT_A target:subState];
+
+            stateMachine.states = @[a, subState];
+            [stateMachine setUp:nil];
+
+            expect([stateMachine handleEvent:[TBSMEvent eventWithName:StateMachineEvents.EVENT_A data:nil]]).to.equal(YES);
+            expect(stateMachine.currentState).to.equal(subState);
+            expect(stateMachine.lastError.code).to.equal(TBSMErrorCodeMissingStateMachine);
+        });
+
+        it(@"reports invalid paths and missing initial states.", ^{
+
+            stateMachine.errorMode = TBSMErrorModeReport;
+
+            [stateMachine setUp:nil];
+            expect(stateMachine.currentState).to.beNil();
+            expect(stateMachine.lastError.code).to.equal(TBSMErrorCodeNoInitialState);
+
+            stateMachine.states = @[a, b];
+            [stateMachine setUp:nil];
+
+            expect([stateMachine isActiveAtPath:@"a/x"]).to.equal(NO);
+            expect(stateMachine.lastError.code).to.equal(TBSMErrorCodeInvalidPath);
+
+            NSError *error = nil;
+            expect([stateMachine stateWithPath:@"x" error:&error]).to.beNil();
+            expect(error.code).to.equal(TBSMErrorCodeInvalidPath);
+        });
+    });
+
     describe(@"NSNotificationCenter support.", ^{
         
         it(@"posts a notification when entering the specified state.", ^{
@@ -94,6 +94,41 @@ describe(@"TBSMState", ^{
         expect(eventHandlerB.target).to.equal(a);
     });
     
+    it(@"finds the same event handlers after compacting its handler table.", ^{
+        
+        NSMutableArray *names = [NSMutableArray new];
+        for (NSUInteger index = 0; index < 20; index++) {
+            NSString *name = [NSString stringWithFormat:@"event_%lu", (unsigned long)index];
+            [a addHandlerForEvent:name target:b];
+            [names addObject:name];
+        }
+        [a addHandlerForEvent:EVENT_NAME_A target:a kind:TBSMTransitionInternal];
+        [a addHandlerForEvent:EVENT_NAME_A target:b];
+        NSArray *handlersA = [a eventHandlersForEvent:[TBSMEvent eventWithName:EVENT_NAME_A data:nil]];
+        
+        [a compactEventHandlers];
+        
+        for (NSString *name in names) {
+            NSArray *eventHandlers = [a eventHandlersForEvent:[TBSMEvent eventWithName:name data:nil]];
+            expect(eventHandlers.count).to.equal(1);
+            expect([eventHandlers.firstObject name]).to.equal(name);
+        }
+        expect([a eventHandlersForEvent:[TBSMEvent eventWithName:EVENT_NAME_A data:nil]]).to.equal(handlersA);
+        expect([a hasHandlerForEvent:[TBSMEvent eventWithName:EVENT_NAME_B data:nil]]).to.equal(NO);
+        expect(a.eventHandlers.allKeys).to.haveCountOf(21);
+        
+        [a addHandlerForEvent:EVENT_NAME_B target:b];
+        expect([a hasHandlerForEvent:[TBSMEvent eventWithName:EVENT_NAME_B data:nil]]).to.equal(YES);
+        expect([a hasHandlerForEvent:[TBSMEvent eventWithName:@"event_7" data:nil]]).to.equal(YES);
+        
+        [a compactEventHandlers];
+        [a removeHandlersForEvent:EVENT_NAME_A passingTest:^BOOL(TBSMEventHandler *eventHandler) {
+            return (eventHandler.kind == TBSMTransitionInternal);
+        }];
+        expect([a eventHandlersForEvent:[TBSMEvent eventWithName:EVENT_NAME_A data:nil]]).to.haveCountOf(1);
+        expect(a.eventHandlers.allKeys).to.haveCountOf(22);
+    });
+    
     it(@"returns its path inside the state machine hierarchy containing all parent nodes in descending order", ^{
         
         TBSMSubState *s = [TBSMSubState subStateWithName:@"s"];
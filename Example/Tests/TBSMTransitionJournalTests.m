@@ -0,0 +1,111 @@
+//
+//  TBSMTransitionJournalTests.m
+//  TBStateMachineTests
+//
+
+#import <TBStateMachine/TBSMStateMachine.h>
+#import <TBStateMachine/TBSMTransitionJournal.h>
+
+SpecBegin(TBSMTransitionJournal)
+
+__block NSString *path;
+__block NSUInteger enterCount;
+
+TBSMStateMachine *(^buildStateMachine)(void) = ^TBSMStateMachine *{
+    TBSMState *a = [TBSMState stateWithName:@"a"];
+    TBSMSubState *b = [TBSMSubState subStateWithName:@"b"];
+    TBSMState *b1 = [TBSMState stateWithName:@"b1"];
+    TBSMState *b2 = [TBSMState stateWithName:@"b2"];
+    b.states = @[b1, b2];
+    b2.enterBlock = ^(id data) {
+        enterCount++;
+    };
+    [a addHandlerForEvent:@"a_b" target:b];
+    [b1 addHandlerForEvent:@"b1_b2" target:b2];
+    [b2 addHandlerForEvent:@"b2_a" target:a];
+    TBSMStateMachine *machine = [TBSMStateMachine stateMachineWithName:@"StateMachine"];
+    machine.states = @[a, b];
+    return machine;
+};
+
+describe(@"TBSMTransitionJournal", ^{
+    
+    beforeEach(^{
+        path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"journal.tbsj"];
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        enterCount = 0;
+    });
+    
+    it(@"restores the configurations of several state machines without executing actions.", ^{
+        
+        TBSMStateMachine *first = buildStateMachine();
+        TBSMStateMachine *second = buildStateMachine();
+        [first setUp:nil];
+        [second setUp:nil];
+        
+        NSError *error = nil;
+        TBSMTransitionJournal *journal = [[TBSMTransitionJournal alloc] initWithPath:path error:&error];
+        expect(error).to.beNil();
+        journal.maximumLatency = 1.0;
+        [journal attachStateMachine:first identifier:1];
+        [journal attachStateMachine:second identifier:2];
+        
+        [first handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        [first handleEvent:[TBSMEvent eventWithName:@"b1_b2" data:nil]];
+        [second handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        [journal synchronize];
+        
+        expect(journal.stepCount).to.equal(3);
+        expect(journal.syncCount).to.equal(1);
+        
+        NSDictionary *configurations = [TBSMTransitionJournal configurationsFromFile:path error:&error];
+        expect(configurations[@1]).to.equal(@[@"b/b2"]);
+        expect(configurations[@2]).to.equal(@[@"b/b1"]);
+        
+        enterCount = 0;
+        TBSMStateMachine *restored = buildStateMachine();
+        BOOL success = [TBSMTransitionJournal restoreStateMachines:@{@1 : restored} fromFile:path error:&error];
+        expect(success).to.beTruthy();
+        expect(enterCount).to.equal(0);
+        expect([restored isActiveAtPath:@"b/b2"]).to.beTruthy();
+        
+        [restored handleEvent:[TBSMEvent eventWithName:@"b2_a" data:nil]];
+        expect(restored.currentState.name).to.equal(@"a");
+        
+        [first tearDown:nil];
+        [second tearDown:nil];
+        [restored tearDown:nil];
+    });
+    
+    it(@"continues an existing log and compacts it into a snapshot.", ^{
+        
+        TBSMStateMachine *stateMachine = buildStateMachine();
+        [stateMachine setUp:nil];
+        TBSMTransitionJournal *journal = [[TBSMTransitionJournal alloc] initWithPath:path error:nil];
+        [journal attachStateMachine:stateMachine identifier:1];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"a_b" data:nil]];
+        [journal synchronize];
+        [journal detachStateMachine:stateMachine];
+        journal = nil;
+        
+        journal = [[TBSMTransitionJournal alloc] initWithPath:path error:nil];
+        [journal attachStateMachine:stateMachine identifier:1];
+        [stateMachine handleEvent:[TBSMEvent eventWithName:@"b1_b2" data:nil]];
+        [journal synchronize];
+        
+        unsigned long long size = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize];
+        NSError *error = nil;
+        expect([journal compact:&error]).to.beTruthy();
+        expect([[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize]).to.beLessThan(size);
+        
+        NSDictionary *configurations = [TBSMTransitionJournal configurationsFromFile:path error:&error];
+        expect(configurations[@1]).to.equal(@[@"b/b2"]);
+        
+        [stateMachine tearDown:nil];
+        [journal synchronize];
+        configurations = [TBSMTransitionJournal configurationsFromFile:path error:&error];
+        expect(configurations[@1]).to.equal(@[]);
+    });
+});
+
+SpecEnd
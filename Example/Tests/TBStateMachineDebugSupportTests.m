@@ -62,6 +62,58 @@ describe(@"DebugSupport", ^{
             expect(configuration).to.equal(expectedConfiguration);
         });
     });
+    
+    describe(@"-scheduleEvent:withCompletion:", ^{
+        
+        it(@"calls the completion of events which are not handled because the queue has discarded them.", ^{
+            
+            [[TBSMDebugger sharedInstance] debugStateMachine:stateMachine];
+            stateMachine.eventQueue.capacity = 1;
+            stateMachine.eventQueue.overflowPolicy = TBSMEventQueueOverflowDropOldest;
+            stateMachine.scheduledEventsQueue.suspended = YES;
+            
+            NSMutableArray *completedEvents = [NSMutableArray new];
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:@"dropped" data:nil] withCompletion:^{
+                [completedEvents addObject:@"dropped"];
+            }];
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:@"pending" data:nil] withCompletion:^{
+                [completedEvents addObject:@"pending"];
+            }];
+            expect(completedEvents).to.equal(@[@"dropped"]);
+            
+            stateMachine.eventQueue.overflowPolicy = TBSMEventQueueOverflowReject;
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:@"rejected" data:nil] withCompletion:^{
+                [completedEvents addObject:@"rejected"];
+            }];
+            expect(completedEvents).to.equal(@[@"dropped", @"rejected"]);
+            expect([stateMachine.eventDebugQueue valueForKeyPath:@"name"]).to.equal(@[@"pending"]);
+            
+            stateMachine.scheduledEventsQueue.suspended = NO;
+            [stateMachine.scheduledEventsQueue waitUntilAllOperationsAreFinished];
+            expect(completedEvents).to.equal(@[@"dropped", @"rejected", @"pending"]);
+        });
+        
+        it(@"calls the completion of events which have been coalesced into a pending event.", ^{
+            
+            [[TBSMDebugger sharedInstance] debugStateMachine:stateMachine];
+            [stateMachine.eventQueue setCoalescingPolicy:TBSMEventCoalescingKeepPosition forEventNamed:@"progress"];
+            stateMachine.scheduledEventsQueue.suspended = YES;
+            
+            NSMutableArray *completedEvents = [NSMutableArray new];
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:@"progress" data:@1] withCompletion:^{
+                [completedEvents addObject:@1];
+            }];
+            [stateMachine scheduleEvent:[TBSMEvent eventWithName:@"progress" data:@2] withCompletion:^{
+                [completedEvents addObject:@2];
+            }];
+            expect(completedEvents).to.equal(@[@2]);
+            expect(stateMachine.eventDebugQueue).to.haveCountOf(1);
+            
+            stateMachine.scheduledEventsQueue.suspended = NO;
+            [stateMachine.scheduledEventsQueue waitUntilAllOperationsAreFinished];
+            expect(completedEvents).to.equal(@[@2, @1]);
+        });
+    });
 });
 
 SpecEnd
@@ -0,0 +1,361 @@
+#!/usr/bin/env ruby
+#
+#  run_tests.rb
+#  TBStateMachine
+#
+#  Generates the C implementation of every scenario in Generator/Tests/Scenarios,
+#  compiles it together with a driver and compares the enter, exit and action
+#  trace of every step against the sequence recorded in the scenario.
+#
+#  The definition of every scenario is also generated with --population and
+#  stepped with random events and guard results next to the same number of
+#  independent machines. States, join masks, handled counts and the enter and
+#  exit sequence of every observed instance have to match.
+#
+#  A scenario names its definition and lists one step per line:
+#
+#    definition Example/Tests/Fixtures/nested.json
+#    setup => +a +a/a1
+#    a1_b => -a/a1 -a +b +b@0/b11 +b@1/b21
+#    guard can_leave false
+#    a_b => unhandled
+#
+#  '+path' and '-path' denote the entry and exit of a state, '!name' the call of an action.
+#  Guards return true unless they have been switched off by a 'guard' line.
+#
+#  Definitions the generator does not support list the expected error instead of steps:
+#
+#    rejects deferred events of state 'a' are not supported
+#
+#  Usage: run_tests.rb [--cc COMPILER] [--no-sanitize] [--seed N] [scenario ...]
+#
+
+require 'optparse'
+require 'tmpdir'
+require 'open3'
+require_relative '../tbsm_generate'
+
+module TBSMGeneratorTests
+
+  ROOT = File.expand_path('../..', __dir__)
+  SCENARIOS = File.join(__dir__, 'Scenarios')
+
+  Scenario = Struct.new(:name, :definition, :steps, :rejection)
+  Step = Struct.new(:command, :trace, :line)
+
+  def self.parse(file)
+    scenario = Scenario.new(File.basename(file, '.scenario'), nil, [])
+    File.readlines(file).each_with_index do |line, idx|
+      line = line.strip
+      next if line.empty? || line.start_with?('#')
+
+      if line.start_with?('definition ')
+        scenario.definition = File.join(ROOT, line.split(' ', 2).last)
+      elsif line.start_with?('rejects ')
+        scenario.rejection = line.split(' ', 2).last
+      elsif line.start_with?('guard ')
+        scenario.steps << Step.new(line, '', idx + 1)
+      else
+        command, trace = line.split('=>', 2).map(&:strip)
+        raise "#{file}:#{idx + 1}: missing '=>'" if trace.nil?
+        scenario.steps << Step.new(command, trace.split.join(' '), idx + 1)
+      end
+    end
+    raise "#{file}: missing definition" if scenario.definition.nil?
+    scenario
+  end
+
+  def self.generate(scenario, directory, population = false)
+    definition = JSON.parse(File.read(scenario.definition))
+    schema = JSON.parse(File.read(File.join(ROOT, 'Generator', 'schema.json')))
+    errors = TBSMGenerator::SchemaValidator.new(schema).validate(definition)
+    raise "#{scenario.definition} is not a valid definition:\n#{errors.join("\n")}" unless errors.empty?
+
+    generator = TBSMGenerator::Generator.new(definition, scenario.name, population)
+    File.write(File.join(directory, generator.header_name), generator.header)
+    File.write(File.join(directory, generator.source_name), generator.source)
+    generator
+  end
+
+  # Guards read their result from a table the driver updates, actions print themselves when traced.
+  def self.functions(generator, traced = true)
+    out = []
+    out << "static const char *const guard_names[] = { #{(generator.guards.map { |name| "\"#{name}\"" } + ['0']).join(', ')} };" if traced
+    out << "static bool guard_values[#{generator.guards.count + 1}];"
+    generator.guards.each_with_index do |name, idx|
+      out << "bool #{name}(void *context, void *data) { (void)context; (void)data; return guard_values[#{idx}]; }"
+    end
+    generator.actions.each do |name|
+      body = traced ? " printf(\" !#{name}\");" : ''
+      out << "void #{name}(void *context, void *data) { (void)context; (void)data;#{body} }"
+    end
+    out.join("\n")
+  end
+
+  def self.driver(generator)
+    p = generator.prefix
+    <<~C
+      #include "#{generator.header_name}"
+      #include <stdio.h>
+      #include <string.h>
+
+      #{functions(generator)}
+
+      static void trace_enter(void *context, #{p}_state state, void *data) { (void)context; (void)data; printf(" +%s", #{p}_state_name(state)); }
+      static void trace_exit(void *context, #{p}_state state, void *data) { (void)context; (void)data; printf(" -%s", #{p}_state_name(state)); }
+
+      static void set_guard(const char *arguments)
+      {
+          char name[128];
+          char value[8];
+          if (sscanf(arguments, "%127s %7s", name, value) != 2) return;
+          for (int i = 0; guard_names[i]; i++) {
+              if (strcmp(guard_names[i], name) == 0) guard_values[i] = (strcmp(value, "true") == 0);
+          }
+      }
+
+      int main(void)
+      {
+          #{p}_machine m;
+          char line[256];
+          for (size_t i = 0; i < sizeof(guard_values) / sizeof(guard_values[0]); i++) guard_values[i] = true;
+          #{p}_init(&m, NULL, trace_enter, trace_exit);
+          while (fgets(line, sizeof(line), stdin)) {
+              line[strcspn(line, "\\n")] = 0;
+              printf("%s =>", line);
+              if (strcmp(line, "setup") == 0) {
+                  #{p}_setup(&m, NULL);
+              } else if (strcmp(line, "teardown") == 0) {
+                  #{p}_teardown(&m, NULL);
+              } else if (strncmp(line, "guard ", 6) == 0) {
+                  set_guard(line + 6);
+              } else {
+                  int event = #{p}_event_from_name(line);
+                  if (event < 0) {
+                      printf(" unknown");
+                  } else if (!#{p}_dispatch(&m, (#{p}_event)event, NULL)) {
+                      printf(" unhandled");
+                  }
+              }
+              printf("\\n");
+          }
+          return 0;
+      }
+    C
+  end
+
+  # Steps a population and an array of independent machines with the same random events.
+  # Every third instance registers a context which hashes its enter and exit sequence.
+  def self.population_driver(generator)
+    p = generator.prefix
+    up = p.upcase
+    <<~C
+      #include "#{generator.header_name}"
+      #include <pthread.h>
+      #include <stdio.h>
+      #include <stdlib.h>
+
+      #{functions(generator, false)}
+
+      #define INSTANCES 2000
+      #define STEPS 200
+
+      typedef struct {
+          unsigned long hash;
+          size_t count;
+      } trace;
+
+      static void trace_enter(void *context, #{p}_state state, void *data)
+      {
+          (void)data;
+          trace *t = context;
+          t->hash = t->hash * 31 + (unsigned long)state;
+          t->count++;
+      }
+
+      static void trace_exit(void *context, #{p}_state state, void *data)
+      {
+          (void)data;
+          trace *t = context;
+          t->hash = t->hash * 37 + (unsigned long)state;
+          t->count++;
+      }
+
+      typedef struct {
+          size_t count;
+          size_t next;
+          void *context;
+          #{p}_work_function work;
+          pthread_mutex_t mutex;
+      } job;
+
+      static void *worker(void *argument)
+      {
+          job *j = argument;
+          for (;;) {
+              pthread_mutex_lock(&j->mutex);
+              size_t index = j->next++;
+              pthread_mutex_unlock(&j->mutex);
+              if (index >= j->count) return NULL;
+              j->work(j->context, index);
+          }
+      }
+
+      static void parallel(size_t count, void *context, #{p}_work_function work)
+      {
+          job j = { count, 0, context, work, PTHREAD_MUTEX_INITIALIZER };
+          pthread_t threads[4];
+          for (int k = 0; k < 4; k++) pthread_create(&threads[k], NULL, worker, &j);
+          for (int k = 0; k < 4; k++) pthread_join(threads[k], NULL);
+      }
+
+      static void randomize_guards(void)
+      {
+          for (size_t i = 0; i < sizeof(guard_values) / sizeof(guard_values[0]); i++) guard_values[i] = (rand() % 4) != 0;
+      }
+
+      int main(int argc, char **argv)
+      {
+          static #{p}_machine machines[INSTANCES];
+          static trace machine_traces[INSTANCES];
+          static trace population_traces[INSTANCES];
+          #{p}_population population;
+
+          srand(argc > 1 ? (unsigned)atoi(argv[1]) : 1);
+          randomize_guards();
+          if (!#{p}_population_init(&population, INSTANCES, NULL, trace_enter, trace_exit)) return 2;
+          for (size_t i = 0; i < INSTANCES; i++) {
+              bool observed = (i % 3 == 0);
+              if (observed) population.contexts[i] = &population_traces[i];
+              #{p}_init(&machines[i], observed ? &machine_traces[i] : NULL, observed ? trace_enter : NULL, observed ? trace_exit : NULL);
+              #{p}_setup(&machines[i], NULL);
+          }
+          if (!#{p}_population_setup(&population, NULL, parallel)) return 2;
+
+          for (int step = 0; step < STEPS; step++) {
+              randomize_guards();
+              for (int k = 0; k < 50; k++) {
+                  size_t i = (size_t)rand() % INSTANCES;
+                  #{p}_event event = (#{p}_event)(rand() % #{up}_EVENT_COUNT);
+                  if (#{p}_dispatch(&machines[i], event, NULL) != #{p}_population_dispatch_instance(&population, i, event, NULL)) {
+                      printf("step %d: instance %zu handled event %d differently\\n", step, i, (int)event);
+                      return 1;
+                  }
+              }
+              #{p}_event event = (#{p}_event)(rand() % #{up}_EVENT_COUNT);
+              size_t handled = 0;
+              for (size_t i = 0; i < INSTANCES; i++) handled += #{p}_dispatch(&machines[i], event, NULL);
+              size_t population_handled = #{p}_population_dispatch(&population, event, NULL, (step % 2) ? parallel : NULL);
+              if (handled != population_handled) {
+                  printf("step %d: event %d handled by %zu machines and %zu instances\\n", step, (int)event, handled, population_handled);
+                  return 1;
+              }
+          }
+          if (!#{p}_population_teardown(&population, NULL, parallel)) return 2;
+
+          for (size_t i = 0; i < INSTANCES; i++) {
+              #{p}_teardown(&machines[i], NULL);
+              for (size_t w = 0; w < #{up}_MACHINE_COUNT; w++) {
+                  if (machines[i].current[w] != population.current[w][i]) {
+                      printf("instance %zu: state machine %zu differs\\n", i, w);
+                      return 1;
+                  }
+              }
+              for (int w = 0; w < #{up}_JOIN_COUNT; w++) {
+                  if (machines[i].joins[w] != population.joins[w][i]) {
+                      printf("instance %zu: join %d differs\\n", i, w);
+                      return 1;
+                  }
+              }
+              if (machine_traces[i].hash != population_traces[i].hash || machine_traces[i].count != population_traces[i].count) {
+                  printf("instance %zu: enter and exit sequence differs\\n", i);
+                  return 1;
+              }
+          }
+          #{p}_population_destroy(&population);
+          return 0;
+      }
+    C
+  end
+
+  def self.compile(options, directory, sources, binary)
+    flags = %w[-std=c99 -Wall -Wextra -Werror -g -pthread]
+    flags += %w[-fsanitize=address,undefined -fno-sanitize-recover=all] if options[:sanitize]
+    output, status = Open3.capture2e(options[:cc], *flags, '-o', binary, *sources, chdir: directory)
+    raise "compilation failed:\n#{output}" unless status.success?
+  end
+
+  def self.run_scenario(scenario, options)
+    Dir.mktmpdir('tbsm_generate') do |directory|
+      generator = generate(scenario, directory)
+      File.write(File.join(directory, 'driver.c'), driver(generator))
+      compile(options, directory, ['driver.c', generator.source_name], 'driver')
+
+      input = scenario.steps.map { |step| step.command + "\n" }.join
+      output, status = Open3.capture2e(File.join(directory, 'driver'), stdin_data: input)
+      raise "driver failed:\n#{output}" unless status.success?
+
+      lines = output.lines.map(&:chomp)
+      failures = []
+      scenario.steps.each_with_index do |step, idx|
+        command, trace = (lines[idx] || '').split('=>', 2).map { |part| part.to_s.split.join(' ') }
+        next if command == step.command && trace == step.trace
+
+        failures << "line #{step.line}: #{step.command}\n  expected: #{step.trace}\n  actual:   #{trace}"
+      end
+      failures
+    end
+  end
+
+  def self.run_rejection(scenario)
+    Dir.mktmpdir('tbsm_generate') do |directory|
+      generate(scenario, directory)
+      ["#{scenario.definition} has been generated although it is not supported"]
+    rescue TBSMGenerator::GeneratorError => e
+      e.message == scenario.rejection ? [] : ["expected '#{scenario.rejection}' but got '#{e.message}'"]
+    end
+  end
+
+  def self.run_population(scenario, options)
+    Dir.mktmpdir('tbsm_generate') do |directory|
+      generator = generate(scenario, directory, true)
+      File.write(File.join(directory, 'driver.c'), population_driver(generator))
+      compile(options, directory, ['driver.c', generator.source_name], 'driver')
+
+      output, status = Open3.capture2e(File.join(directory, 'driver'), options[:seed].to_s)
+      status.success? ? [] : ["population with seed #{options[:seed]}: #{output.strip}"]
+    end
+  end
+
+  def self.run(argv)
+    options = { cc: ENV['CC'] || 'cc', sanitize: true, seed: 1 }
+    OptionParser.new do |opts|
+      opts.banner = 'Usage: run_tests.rb [--cc COMPILER] [--no-sanitize] [--seed N] [scenario ...]'
+      opts.on('--cc COMPILER', 'C compiler (defaults to $CC or cc)') { |v| options[:cc] = v }
+      opts.on('--[no-]sanitize', 'Build with address and undefined behavior sanitizers') { |v| options[:sanitize] = v }
+      opts.on('--seed N', Integer, 'Seed of the random population steps (defaults to 1)') { |v| options[:seed] = v }
+    end.parse!(argv)
+
+    files = argv.empty? ? Dir[File.join(SCENARIOS, '*.scenario')].sort : argv
+    failed = 0
+    files.each do |file|
+      scenario = parse(file)
+      begin
+        failures = if scenario.rejection
+                     run_rejection(scenario)
+                   else
+                     run_scenario(scenario, options) + run_population(scenario, options)
+                   end
+      rescue StandardError => e
+        failures = [e.message]
+      end
+      puts "#{failures.empty? ? 'passed' : 'FAILED'}: #{scenario.name}"
+      failures.each { |failure| puts failure.gsub(/^/, '  ') }
+      failed += 1 unless failures.empty?
+    end
+    puts "#{files.count - failed} of #{files.count} scenarios passed"
+    exit(failed.zero? ? 0 : 1)
+  end
+end
+
+TBSMGeneratorTests.run(ARGV) if $PROGRAM_NAME == __FILE__
@@ -0,0 +1,1129 @@
+#!/usr/bin/env ruby
+#
+#  tbsm_generate.rb
+#  TBStateMachine
+#
+#  Compiles a state machine definition in the TBSMStateMachineBuilder JSON format
+#  into a specialized C99 implementation. The generated dispatcher uses nested
+#  switch statements over the active state of every (sub) state machine and
+#  inlines all exit and entry sequences, which are resolved at generation time
+#  using the same rules as the runtime implementation.
+#
+#  Usage: tbsm_generate.rb [--prefix NAME] [--output DIR] [--population] definition.json
+#
+
+require 'json'
+require 'optparse'
+
+module TBSMGenerator
+
+  class GeneratorError < StandardError; end
+
+  # Minimal validator for the subset of JSON schema draft-07 used by Generator/schema.json.
+  class SchemaValidator
+
+    def initialize(schema)
+      @schema = schema
+    end
+
+    def validate(value)
+      errors = []
+      check(@schema, value, '#', errors)
+      errors
+    end
+
+    private
+
+    def resolve(ref)
+      ref.sub('#/', '').split('/').inject(@schema) { |node, key| node.fetch(key) }
+    end
+
+    def check(schema, value, location, errors)
+      return check(resolve(schema['$ref']), value, location, errors) if schema['$ref']
+
+      if schema['anyOf']
+        unless schema['anyOf'].any? { |option| check(option, value, location, []) }
+          errors << "#{location}: does not match any allowed definition"
+          return false
+        end
+      end
+
+      case schema['type']
+      when 'object'
+        return fail_type(location, 'object', errors) unless value.is_a?(Hash)
+        (schema['required'] || []).each do |key|
+          errors << "#{location}: missing required property '#{key}'" unless value.key?(key)
+        end
+        (schema['properties'] || {}).each do |key, property|
+          check(property, value[key], "#{location}/#{key}", errors) if value.key?(key)
+        end
+      when 'array'
+        return fail_type(location, 'array', errors) unless value.is_a?(Array)
+        value.each_with_index { |item, idx| check(schema['items'], item, "#{location}/#{idx}", errors) } if schema['items']
+      when 'string'
+        return fail_type(location, 'string', errors) unless value.is_a?(String)
+      when 'boolean'
+        return fail_type(location, 'boolean', errors) unless [true, false].include?(value)
+      when 'number'
+        return fail_type(location, 'number', errors) unless value.is_a?(Numeric)
+      end
+      errors.empty?
+    end
+
+    def fail_type(location, type, errors)
+      errors << "#{location}: expected #{type}"
+      false
+    end
+  end
+
+  class Machine
+    attr_reader :index, :parent_state, :states, :region_index
+    attr_accessor :level
+
+    def initialize(index, parent_state, region_index)
+      @index = index
+      @parent_state = parent_state
+      @region_index = region_index
+      @states = []
+    end
+
+    def initial_state
+      @states.first
+    end
+
+    def path
+      @parent_state ? @parent_state.path + [self] : [self]
+    end
+  end
+
+  class State
+    attr_reader :name, :type, :machine, :children, :handlers
+    attr_accessor :index, :identifier, :qualified_name
+
+    def initialize(name, type, machine)
+      @name = name
+      @type = type
+      @machine = machine
+      @children = []
+      @handlers = []
+    end
+
+    def sub?
+      @type == 'sub'
+    end
+
+    def parallel?
+      @type == 'parallel'
+    end
+
+    def path
+      @machine.path + [self]
+    end
+  end
+
+  Handler = Struct.new(:event, :kind, :target, :guard, :action, :fork, :join, :join_bit)
+  Fork = Struct.new(:targets, :region)
+  Join = Struct.new(:index, :sources, :region, :target)
+
+  class Generator
+    attr_reader :prefix, :guards, :actions
+
+    def initialize(definition, prefix, population = false)
+      @definition = definition
+      @population = population
+      @prefix = sanitize(prefix || definition['name'] || 'tbsm').downcase
+      @machines = []
+      @states = []
+      @events = []
+      @joins = []
+      @guards = []
+      @actions = []
+      @root = build_machine(definition['states'] || [], nil, nil, [])
+      raise GeneratorError, 'state machine has no states' if @root.states.empty?
+      (definition['transitions'] || []).each { |transition| build_transition(transition) }
+    end
+
+    def header_name
+      "#{@prefix}_machine.h"
+    end
+
+    def source_name
+      "#{@prefix}_machine.c"
+    end
+
+    # MARK: - model
+
+    def sanitize(string)
+      string.gsub(/[^A-Za-z0-9]+/, '_').gsub(/\A_+|_+\z/, '')
+    end
+
+    def build_machine(data, parent_state, region_index, components)
+      machine = Machine.new(@machines.count, parent_state, region_index)
+      machine.level = parent_state ? parent_state.machine.level + 1 : 1
+      @machines << machine
+      data.each do |entry|
+        raise GeneratorError, "deferred events of state '#{entry['name']}' are not supported" if entry.key?('deferred_events')
+        state = State.new(entry['name'], entry['type'], machine)
+        state.index = @states.count + 1
+        state.qualified_name = (components + [entry['name']]).join('/')
+        state.identifier = "#{@prefix.upcase}_STATE_#{sanitize(state.qualified_name).upcase}"
+        @states << state
+        machine.states << state
+        case entry['type']
+        when 'sub'
+          state.children << build_machine(entry['states'], state, nil, components + [entry['name']])
+        when 'parallel'
+          entry['regions'].each_with_index do |region, idx|
+            state.children << build_machine(region, state, idx, components + ["#{entry['name']}@#{idx}"])
+          end
+        when 'state'
+        else
+          raise GeneratorError, "unknown state type '#{entry['type']}' of state '#{entry['name']}'"
+        end
+      end
+      machine
+    end
+
+    # Resolves a path the same way -[TBSMStateMachine stateWithPath:] does.
+    def state_with_path(path)
+      machine = @root
+      state = nil
+      path.split('/').each do |component|
+        elements = component.split('@')
+        state = machine.states.find { |s| s.name == elements.first }
+        raise GeneratorError, "invalid path '#{path}'" if state.nil?
+        if state.sub?
+          machine = state.children.first
+        elsif state.parallel?
+          index = elements.last.to_i
+          raise GeneratorError, "invalid path '#{path}'" if index.negative? || index >= state.children.count
+          machine = state.children[index]
+        end
+      end
+      raise GeneratorError, "invalid path '#{path}'" if state.nil?
+      state
+    end
+
+    def register_event(name)
+      @events << name unless @events.include?(name)
+    end
+
+    def register_function(list, name)
+      return nil if name.nil?
+      raise GeneratorError, "invalid function name '#{name}'" unless name =~ /\A[A-Za-z_][A-Za-z0-9_]*\z/
+      list << name unless list.include?(name)
+      name
+    end
+
+    def build_transition(data)
+      case data['type']
+      when 'simple'
+        kind = data['kind'] || 'external'
+        raise GeneratorError, "unknown transition kind '#{kind}'" unless %w[external internal local].include?(kind)
+        source = state_with_path(data['source'])
+        target = state_with_path(data['target'])
+        raise GeneratorError, "internal transition '#{data['name']}' must not change state" if kind == 'internal' && source != target
+        add_handler(source, Handler.new(data['name'], kind, target,
+                                        register_function(@guards, data['guard']),
+                                        register_function(@actions, data['action'])))
+      when 'compound'
+        pseudo_state = data['pseudo_state']
+        region = state_with_path(pseudo_state['region'])
+        raise GeneratorError, "region of '#{pseudo_state['name']}' is not a parallel state" unless region.parallel?
+        incoming = data['vertices']['incoming']
+        outgoing = data['vertices']['outgoing']
+        case pseudo_state['type']
+        when 'fork'
+          entry = incoming.first
+          fork = Fork.new(outgoing.map { |vertex| state_with_path(vertex['target']) }, region)
+          fork.targets.each do |target|
+            raise GeneratorError, "fork target '#{target.qualified_name}' is not contained in its region" unless target.path.include?(region)
+          end
+          add_handler(state_with_path(entry['source']),
+                      Handler.new(entry['name'], 'external', region,
+                                  register_function(@guards, entry['guard']),
+                                  register_function(@actions, entry['action']), fork))
+        when 'join'
+          sources = incoming.map { |vertex| state_with_path(vertex['source']) }
+          raise GeneratorError, "join '#{pseudo_state['name']}' supports at most 32 sources" if sources.count > 32
+          join = Join.new(@joins.count, sources, region, state_with_path(outgoing.first['target']))
+          @joins << join
+          incoming.each_with_index do |vertex, idx|
+            add_handler(sources[idx],
+                        Handler.new(vertex['name'], 'external', join.target,
+                                    register_function(@guards, vertex['guard']), nil, nil, join, idx))
+          end
+        else
+          raise GeneratorError, "unsupported pseudo state type '#{pseudo_state['type']}'"
+        end
+      else
+        raise GeneratorError, "unknown transition type '#{data['type']}'"
+      end
+    end
+
+    def add_handler(source, handler)
+      register_event(handler.event)
+      source.handlers << handler
+    end
+
+    def machine_chain(vertex)
+      vertex.path.select { |v| v.is_a?(Machine) }
+    end
+
+    # Mirrors -[TBSMTransition leastCommonAncestor] including the local transition adjustment.
+    def least_common_ancestor(source, target, kind)
+      target_path = target.path
+      lca = source.path.reverse.find { |vertex| vertex.is_a?(Machine) && target_path.include?(vertex) }
+      raise GeneratorError, "no least common ancestor for '#{source.qualified_name}' and '#{target.qualified_name}'" if lca.nil?
+      if kind == 'local' && (source.path.include?(target) || target_path.include?(source))
+        active = source.path[source.path.index(lca) + 1]
+        raise GeneratorError, "local transition from '#{source.qualified_name}' requires a sub state" unless active.sub?
+        lca = active.children.first
+      end
+      lca
+    end
+
+    # MARK: - code emission
+
+    def enum_event(name)
+      "#{@prefix.upcase}_EVENT_#{sanitize(name).upcase}"
+    end
+
+    def state_none
+      "#{@prefix.upcase}_STATE_NONE"
+    end
+
+    def type(name)
+      "#{@prefix}_#{name}"
+    end
+
+    def fn(name)
+      "#{@prefix}_#{name}"
+    end
+
+    def callback(out, indent, hook, state)
+      out << "#{indent}if (m->#{hook}) m->#{hook}(m->context, #{state.identifier}, data);"
+    end
+
+    # Mirrors -[TBSMStateMachine enter:targetState:data:].
+    def emit_enter(out, indent, machine, target)
+      target_level = machine_chain(target).count
+      vertex = if target_level < machine.level
+                 machine.initial_state
+               elsif target_level == machine.level
+                 raise GeneratorError, "target '#{target.qualified_name}' is not reachable" unless target.machine == machine
+                 target
+               else
+                 machine_chain(target)[machine.level].parent_state
+               end
+      out << "#{indent}m->current[#{machine.index}] = #{vertex.identifier};"
+      emit_state_enter(out, indent, vertex, target)
+    end
+
+    # Mirrors -[TBSMState enter:targetState:data:] and its overrides.
+    def emit_state_enter(out, indent, state, target)
+      callback(out, indent, 'enter', state)
+      if state.sub?
+        emit_enter(out, indent, state.children.first, target)
+      elsif state.parallel?
+        state.children.each do |region|
+          if target.path.include?(region)
+            emit_enter(out, indent, region, target)
+          else
+            emit_enter(out, indent, region, region.initial_state)
+          end
+        end
+      end
+    end
+
+    # Mirrors -[TBSMStateMachine enter:targetStates:region:data:].
+    def emit_fork_enter(out, indent, machine, targets, region)
+      target_level = machine_chain(region).count
+      raise GeneratorError, "fork region '#{region.qualified_name}' is not reachable" if target_level < machine.level
+      vertex = target_level == machine.level ? region : machine_chain(region)[machine.level].parent_state
+      out << "#{indent}m->current[#{machine.index}] = #{vertex.identifier};"
+      callback(out, indent, 'enter', vertex)
+      if vertex.sub?
+        emit_fork_enter(out, indent, vertex.children.first, targets, region)
+      elsif vertex.parallel?
+        vertex.children.each do |child|
+          entered = false
+          targets.each do |target|
+            next unless target.path.include?(child)
+            emit_enter(out, indent, child, target)
+            entered = true
+          end
+          emit_enter(out, indent, child, child.initial_state) unless entered
+        end
+      else
+        raise GeneratorError, "fork region '#{region.qualified_name}' is not reachable"
+      end
+    end
+
+    def emit_action(out, indent, action)
+      out << "#{indent}#{action}(m->context, data);" if action
+    end
+
+    def emit_handler(out, indent, source, handler)
+      body = []
+      inner = handler.guard ? "#{indent}    " : indent
+      if handler.join
+        join = handler.join
+        mask = "(UINT32_C(1) << #{handler.join_bit})"
+        complete = join.sources.count == 32 ? 'UINT32_MAX' : "((UINT32_C(1) << #{join.sources.count}) - 1)"
+        lca = least_common_ancestor(source, join.target, 'external')
+        body << "#{inner}if ((m->joins[#{join.index}] & #{mask}) == 0) {"
+        body << "#{inner}    m->joins[#{join.index}] |= #{mask};"
+        body << "#{inner}    if (m->joins[#{join.index}] == #{complete}) {"
+        body << "#{inner}        m->joins[#{join.index}] = 0;"
+        body << "#{inner}        #{fn("exit_m#{lca.index}")}(m, data);"
+        emit_enter(body, "#{inner}        ", lca, join.target)
+        body << "#{inner}    }"
+        body << "#{inner}}"
+      elsif handler.fork
+        lca = least_common_ancestor(source, handler.fork.region, 'external')
+        body << "#{inner}#{fn("exit_m#{lca.index}")}(m, data);"
+        emit_action(body, inner, handler.action)
+        emit_fork_enter(body, inner, lca, handler.fork.targets, handler.fork.region)
+      elsif handler.kind == 'internal'
+        emit_action(body, inner, handler.action)
+      else
+        lca = least_common_ancestor(source, handler.target, handler.kind)
+        body << "#{inner}#{fn("exit_m#{lca.index}")}(m, data);"
+        emit_action(body, inner, handler.action)
+        emit_enter(body, inner, lca, handler.target)
+      end
+      body << "#{inner}return true;"
+
+      label = handler.join ? 'join' : (handler.fork ? 'fork' : handler.kind)
+      out << "#{indent}/* #{label} transition to #{handler.join ? handler.join.target.qualified_name : handler.target.qualified_name} */"
+      if handler.guard
+        out << "#{indent}if (#{handler.guard}(m->context, data)) {"
+        out.concat(body)
+        out << "#{indent}}"
+      else
+        out.concat(body)
+      end
+    end
+
+    def emit_exit_function(out, machine)
+      out << "static void #{fn("exit_m#{machine.index}")}(#{type('machine')} *m, void *data)"
+      out << '{'
+      out << "    switch (m->current[#{machine.index}]) {"
+      machine.states.each do |state|
+        out << "    case #{state.identifier}:"
+        state.children.each { |child| out << "        #{fn("teardown_m#{child.index}")}(m, data);" }
+        callback(out, '        ', 'exit', state)
+        out << '        break;'
+      end
+      out << '    default:'
+      out << '        break;'
+      out << '    }'
+      out << '}'
+      out << ''
+      out << "static void #{fn("teardown_m#{machine.index}")}(#{type('machine')} *m, void *data)"
+      out << '{'
+      out << "    #{fn("exit_m#{machine.index}")}(m, data);"
+      out << "    m->current[#{machine.index}] = #{state_none};"
+      out << '}'
+      out << ''
+    end
+
+    # Mirrors -[TBSMStateMachine _handleEvent:]: containers dispatch to their children first.
+    def emit_dispatch_function(out, machine)
+      out << "static bool #{fn("dispatch_m#{machine.index}")}(#{type('machine')} *m, #{type('event')} event, void *data)"
+      out << '{'
+      if machine.states.all? { |state| state.children.empty? && state.handlers.empty? }
+        out << '    (void)m;'
+        out << '    (void)event;'
+        out << '    (void)data;'
+        out << '    return false;'
+        out << '}'
+        out << ''
+        return
+      end
+      out << "    switch (m->current[#{machine.index}]) {"
+      machine.states.each do |state|
+        next if state.children.empty? && state.handlers.empty?
+        out << "    case #{state.identifier}:"
+        if state.sub?
+          out << "        if (#{fn("dispatch_m#{state.children.first.index}")}(m, event, data)) return true;"
+        elsif state.parallel?
+          out << '    {'
+          out << '        bool handled = false;'
+          state.children.each do |region|
+            out << "        if (#{fn("dispatch_m#{region.index}")}(m, event, data)) handled = true;"
+          end
+          out << '        if (handled) return true;'
+          out << '    }'
+        end
+        events = state.handlers.map(&:event).uniq
+        unless events.empty?
+          out << '        switch (event) {'
+          events.each do |event|
+            out << "        case #{enum_event(event)}:"
+            handlers = state.handlers.select { |handler| handler.event == event }
+            handlers.each { |handler| emit_handler(out, '            ', state, handler) }
+            out << '            break;' if handlers.last.guard
+          end
+          out << '        default:'
+          out << '            break;'
+          out << '        }'
+        end
+        out << '        break;'
+      end
+      out << '    default:'
+      out << '        break;'
+      out << '    }'
+      out << '    return false;'
+      out << '}'
+      out << ''
+    end
+
+    # MARK: - population
+
+    def indent(text, width)
+      text.gsub(/^(?=.)/, ' ' * width)
+    end
+
+    # Declares the structure of arrays container which steps many instances of the machine at once.
+    def population_header(out)
+      p = @prefix
+      up = @prefix.upcase
+      out.concat(<<~C.split("\n", -1))
+        #define #{up}_POPULATION_FAILED SIZE_MAX
+
+        typedef void (*#{p}_work_function)(void *context, size_t index);
+        typedef void (*#{p}_parallel_function)(size_t count, void *context, #{p}_work_function work);
+
+        typedef struct #{p}_population_plan #{p}_population_plan;
+
+        /*
+         * Instances of the machine in structure of arrays layout: current[n][i] is the active state of
+         * (sub) state machine n in instance i and joins[n][i] is the mask of join n in instance i.
+         * Guards and actions are evaluated once per group of instances sharing a configuration and
+         * receive the shared context. Enter and exit callbacks are only delivered to instances which
+         * have a context registered in contexts[i].
+         */
+        typedef struct {
+            size_t count;
+            uint16_t *current[#{up}_MACHINE_COUNT];
+            uint32_t *joins[#{[@joins.count, 1].max}];
+            void **contexts;
+            void *context;
+            #{p}_state_function enter;
+            #{p}_state_function exit;
+            #{p}_population_plan *plan;
+        } #{p}_population;
+
+        bool #{p}_population_init(#{p}_population *p, size_t count, void *context, #{p}_state_function enter, #{p}_state_function exit);
+        void #{p}_population_destroy(#{p}_population *p);
+        bool #{p}_population_setup(#{p}_population *p, void *data, #{p}_parallel_function parallel);
+        bool #{p}_population_teardown(#{p}_population *p, void *data, #{p}_parallel_function parallel);
+        size_t #{p}_population_dispatch(#{p}_population *p, #{p}_event event, void *data, #{p}_parallel_function parallel);
+        bool #{p}_population_dispatch_instance(#{p}_population *p, size_t instance, #{p}_event event, void *data);
+        bool #{p}_population_is_active(const #{p}_population *p, size_t instance, #{p}_state state);
+      C
+    end
+
+    # Each step classifies the instances by configuration in parallel chunks, runs the scalar
+    # machine once per distinct configuration while recording its enter and exit sequence and
+    # scatters the results back into the columns.
+    def population_source(out)
+      p = @prefix
+      up = @prefix.upcase
+      joins = @joins.count.positive?
+      trace_limit = 2 * @machines.count * @states.count
+      key_joins = joins ? indent(<<~C.chomp, 4) : ''
+
+            for (size_t w = 0; w < #{up}_JOIN_COUNT; w++) key[#{up}_MACHINE_COUNT + w] = p->joins[w][instance];
+      C
+      alloc_joins = joins ? indent(<<~C.chomp, 4) : ''
+
+            for (size_t w = 0; w < #{up}_JOIN_COUNT; w++) {
+                p->joins[w] = calloc(count, sizeof(uint32_t));
+                if (p->joins[w] == NULL) ok = false;
+            }
+      C
+      free_joins = joins ? indent(<<~C.chomp, 4) : ''
+
+            for (size_t w = 0; w < #{up}_JOIN_COUNT; w++) free(p->joins[w]);
+      C
+      load_joins = joins ? indent(<<~C.chomp, 4) : ''
+
+            for (size_t w = 0; w < #{up}_JOIN_COUNT; w++) m->joins[w] = key[#{up}_MACHINE_COUNT + w];
+      C
+      store_joins = joins ? indent(<<~C.chomp, 4) : ''
+
+            for (size_t w = 0; w < #{up}_JOIN_COUNT; w++) p->joins[w][instance] = m.joins[w];
+      C
+      scatter_joins = joins ? indent(<<~C.chomp, 4) : ''
+
+            for (size_t w = 0; w < #{up}_JOIN_COUNT; w++) {
+                const uint32_t *restrict next = plan->next + (#{up}_MACHINE_COUNT + w) * n;
+                uint32_t *restrict column = p->joins[w];
+                for (size_t i = begin; i < end; i++) column[i] = next[group[i]];
+            }
+      C
+      out.concat(<<~C.chomp.split("\n", -1))
+
+        /* MARK: - population */
+
+        #define #{up}_POPULATION_KEY_WORDS (#{up}_MACHINE_COUNT + #{up}_JOIN_COUNT)
+        #define #{up}_POPULATION_CHUNK_SIZE 4096
+        #define #{up}_POPULATION_CHUNK_GROUPS 32
+        #define #{up}_POPULATION_TRACE_LIMIT #{trace_limit}
+
+        #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+        #define #{up}_THREAD_LOCAL _Thread_local
+        #else
+        #define #{up}_THREAD_LOCAL __thread
+        #endif
+
+        typedef enum {
+            #{up}_POPULATION_SETUP,
+            #{up}_POPULATION_TEARDOWN,
+            #{up}_POPULATION_DISPATCH
+        } #{p}_population_operation;
+
+        typedef struct {
+            uint32_t count;
+            bool global;
+            size_t handled;
+            uint32_t slots[#{up}_POPULATION_CHUNK_GROUPS * 2];
+            uint32_t keys[#{up}_POPULATION_CHUNK_GROUPS][#{up}_POPULATION_KEY_WORDS];
+            uint32_t map[#{up}_POPULATION_CHUNK_GROUPS];
+        } #{p}_population_chunk;
+
+        struct #{p}_population_plan {
+            size_t chunk_count;
+            #{p}_population_chunk *chunks;
+            uint32_t *group;
+            uint32_t group_count;
+            uint32_t group_capacity;
+            uint32_t *slots;
+            uint32_t *keys;
+            uint32_t *next;
+            uint8_t *handled;
+            size_t *trace_offsets;
+            uint32_t *trace;
+            size_t trace_count;
+            size_t trace_capacity;
+            void *data;
+        };
+
+        /* The plan whose group is currently evaluated by the scalar machine. */
+        static #{up}_THREAD_LOCAL #{p}_population_plan *#{p}_recording_plan;
+
+        static void #{p}_population_record_enter(void *context, #{p}_state state, void *data)
+        {
+            (void)context;
+            (void)data;
+            #{p}_population_plan *plan = #{p}_recording_plan;
+            plan->trace[plan->trace_count++] = ((uint32_t)state << 1) | 1;
+        }
+
+        static void #{p}_population_record_exit(void *context, #{p}_state state, void *data)
+        {
+            (void)context;
+            (void)data;
+            #{p}_population_plan *plan = #{p}_recording_plan;
+            plan->trace[plan->trace_count++] = (uint32_t)state << 1;
+        }
+
+        static void #{p}_population_key(const #{p}_population *p, size_t instance, uint32_t *key)
+        {
+            for (size_t w = 0; w < #{up}_MACHINE_COUNT; w++) key[w] = p->current[w][instance];#{key_joins}
+        }
+
+        static void #{p}_population_load(#{p}_population *p, #{p}_machine *m, const uint32_t *key)
+        {
+            #{p}_init(m, p->context, #{p}_population_record_enter, #{p}_population_record_exit);
+            for (size_t w = 0; w < #{up}_MACHINE_COUNT; w++) m->current[w] = (uint16_t)key[w];#{load_joins}
+        }
+
+        static void #{p}_population_replay(#{p}_population *p, void *observer, size_t begin, size_t end, void *data)
+        {
+            #{p}_population_plan *plan = p->plan;
+            for (size_t t = begin; t < end; t++) {
+                uint32_t entry = plan->trace[t];
+                #{p}_state_function callback = (entry & 1) ? p->enter : p->exit;
+                if (callback) callback(observer, (#{p}_state)(entry >> 1), data);
+            }
+        }
+
+        static uint32_t #{p}_population_hash(const uint32_t *key)
+        {
+            uint32_t hash = UINT32_C(2166136261);
+            for (size_t w = 0; w < #{up}_POPULATION_KEY_WORDS; w++) {
+                hash ^= key[w];
+                hash *= UINT32_C(16777619);
+            }
+            return hash;
+        }
+
+        static void #{p}_population_insert_slot(#{p}_population_plan *plan, uint32_t group)
+        {
+            uint32_t mask = plan->group_capacity * 2 - 1;
+            uint32_t slot = #{p}_population_hash(&plan->keys[(size_t)group * #{up}_POPULATION_KEY_WORDS]) & mask;
+            while (plan->slots[slot]) slot = (slot + 1) & mask;
+            plan->slots[slot] = group + 1;
+        }
+
+        static bool #{p}_population_grow(#{p}_population_plan *plan)
+        {
+            uint32_t capacity = plan->group_capacity ? plan->group_capacity * 2 : 64;
+            uint32_t *keys = realloc(plan->keys, (size_t)capacity * #{up}_POPULATION_KEY_WORDS * sizeof(uint32_t));
+            if (keys == NULL) return false;
+            plan->keys = keys;
+            uint32_t *slots = calloc((size_t)capacity * 2, sizeof(uint32_t));
+            if (slots == NULL) return false;
+            free(plan->slots);
+            plan->slots = slots;
+            plan->group_capacity = capacity;
+            for (uint32_t group = 0; group < plan->group_count; group++) #{p}_population_insert_slot(plan, group);
+            return true;
+        }
+
+        static uint32_t #{p}_population_group(#{p}_population_plan *plan, const uint32_t *key)
+        {
+            uint32_t mask = plan->group_capacity * 2 - 1;
+            uint32_t slot = #{p}_population_hash(key) & mask;
+            uint32_t entry;
+            while ((entry = plan->slots[slot]) != 0) {
+                if (memcmp(&plan->keys[(size_t)(entry - 1) * #{up}_POPULATION_KEY_WORDS], key, sizeof(uint32_t) * #{up}_POPULATION_KEY_WORDS) == 0) return entry - 1;
+                slot = (slot + 1) & mask;
+            }
+            if (plan->group_count == plan->group_capacity && !#{p}_population_grow(plan)) return UINT32_MAX;
+            uint32_t group = plan->group_count++;
+            memcpy(&plan->keys[(size_t)group * #{up}_POPULATION_KEY_WORDS], key, sizeof(uint32_t) * #{up}_POPULATION_KEY_WORDS);
+            #{p}_population_insert_slot(plan, group);
+            return group;
+        }
+
+        /* Groups the instances of one chunk by configuration. Chunks with too many groups are left to the serial merge. */
+        static void #{p}_population_classify(void *context, size_t index)
+        {
+            #{p}_population *p = context;
+            #{p}_population_plan *plan = p->plan;
+            #{p}_population_chunk *chunk = &plan->chunks[index];
+            size_t begin = index * #{up}_POPULATION_CHUNK_SIZE;
+            size_t end = begin + #{up}_POPULATION_CHUNK_SIZE < p->count ? begin + #{up}_POPULATION_CHUNK_SIZE : p->count;
+            uint32_t mask = #{up}_POPULATION_CHUNK_GROUPS * 2 - 1;
+            uint32_t key[#{up}_POPULATION_KEY_WORDS];
+            chunk->count = 0;
+            chunk->global = false;
+            memset(chunk->slots, 0, sizeof(chunk->slots));
+            for (size_t i = begin; i < end; i++) {
+                #{p}_population_key(p, i, key);
+                uint32_t slot = #{p}_population_hash(key) & mask;
+                uint32_t entry;
+                while ((entry = chunk->slots[slot]) != 0 && memcmp(chunk->keys[entry - 1], key, sizeof(key)) != 0) slot = (slot + 1) & mask;
+                if (entry == 0) {
+                    if (chunk->count == #{up}_POPULATION_CHUNK_GROUPS) {
+                        chunk->global = true;
+                        return;
+                    }
+                    memcpy(chunk->keys[chunk->count], key, sizeof(key));
+                    entry = chunk->slots[slot] = ++chunk->count;
+                }
+                plan->group[i] = entry - 1;
+            }
+        }
+
+        /* Writes the resulting configuration of every instance and replays the recorded callbacks of observed instances. */
+        static void #{p}_population_apply(void *context, size_t index)
+        {
+            #{p}_population *p = context;
+            #{p}_population_plan *plan = p->plan;
+            #{p}_population_chunk *chunk = &plan->chunks[index];
+            size_t begin = index * #{up}_POPULATION_CHUNK_SIZE;
+            size_t end = begin + #{up}_POPULATION_CHUNK_SIZE < p->count ? begin + #{up}_POPULATION_CHUNK_SIZE : p->count;
+            size_t n = plan->group_count;
+            uint32_t *restrict group = plan->group;
+            if (!chunk->global) {
+                for (size_t i = begin; i < end; i++) group[i] = chunk->map[group[i]];
+            }
+            for (size_t w = 0; w < #{up}_MACHINE_COUNT; w++) {
+                const uint32_t *restrict next = plan->next + w * n;
+                uint16_t *restrict column = p->current[w];
+                for (size_t i = begin; i < end; i++) column[i] = (uint16_t)next[group[i]];
+            }#{scatter_joins}
+            size_t handled = 0;
+            for (size_t i = begin; i < end; i++) handled += plan->handled[group[i]];
+            chunk->handled = handled;
+            if (p->enter == NULL && p->exit == NULL) return;
+            for (size_t i = begin; i < end; i++) {
+                if (p->contexts[i] == NULL) continue;
+                #{p}_population_replay(p, p->contexts[i], plan->trace_offsets[group[i]], plan->trace_offsets[group[i] + 1], plan->data);
+            }
+        }
+
+        static void #{p}_population_run(#{p}_population *p, #{p}_parallel_function parallel, #{p}_work_function work)
+        {
+            if (parallel) {
+                parallel(p->plan->chunk_count, p, work);
+                return;
+            }
+            for (size_t index = 0; index < p->plan->chunk_count; index++) work(p, index);
+        }
+
+        static bool #{p}_population_merge(#{p}_population *p)
+        {
+            #{p}_population_plan *plan = p->plan;
+            uint32_t key[#{up}_POPULATION_KEY_WORDS];
+            for (size_t index = 0; index < plan->chunk_count; index++) {
+                #{p}_population_chunk *chunk = &plan->chunks[index];
+                if (chunk->global) {
+                    size_t begin = index * #{up}_POPULATION_CHUNK_SIZE;
+                    size_t end = begin + #{up}_POPULATION_CHUNK_SIZE < p->count ? begin + #{up}_POPULATION_CHUNK_SIZE : p->count;
+                    for (size_t i = begin; i < end; i++) {
+                        #{p}_population_key(p, i, key);
+                        plan->group[i] = #{p}_population_group(plan, key);
+                        if (plan->group[i] == UINT32_MAX) return false;
+                    }
+                    continue;
+                }
+                for (uint32_t local = 0; local < chunk->count; local++) {
+                    chunk->map[local] = #{p}_population_group(plan, chunk->keys[local]);
+                    if (chunk->map[local] == UINT32_MAX) return false;
+                }
+            }
+            size_t n = plan->group_count;
+            uint32_t *next = realloc(plan->next, n * #{up}_POPULATION_KEY_WORDS * sizeof(uint32_t));
+            if (next == NULL) return false;
+            plan->next = next;
+            uint8_t *handled = realloc(plan->handled, n);
+            if (handled == NULL) return false;
+            plan->handled = handled;
+            size_t *trace_offsets = realloc(plan->trace_offsets, (n + 1) * sizeof(size_t));
+            if (trace_offsets == NULL) return false;
+            plan->trace_offsets = trace_offsets;
+            return true;
+        }
+
+        /* Runs the scalar machine once for every group and records its result. */
+        static bool #{p}_population_evaluate(#{p}_population *p, #{p}_population_operation operation, #{p}_event event, void *data)
+        {
+            #{p}_population_plan *plan = p->plan;
+            #{p}_population_plan *recording = #{p}_recording_plan;
+            size_t n = plan->group_count;
+            for (uint32_t group = 0; group < n; group++) {
+                if (plan->trace_capacity - plan->trace_count < #{up}_POPULATION_TRACE_LIMIT) {
+                    size_t capacity = plan->trace_capacity * 2 + #{up}_POPULATION_TRACE_LIMIT;
+                    uint32_t *trace = realloc(plan->trace, capacity * sizeof(uint32_t));
+                    if (trace == NULL) return false;
+                    plan->trace = trace;
+                    plan->trace_capacity = capacity;
+                }
+                const uint32_t *key = &plan->keys[(size_t)group * #{up}_POPULATION_KEY_WORDS];
+                #{p}_machine m;
+                #{p}_population_load(p, &m, key);
+                plan->trace_offsets[group] = plan->trace_count;
+                #{p}_recording_plan = plan;
+                switch (operation) {
+                case #{up}_POPULATION_SETUP:
+                    #{p}_setup(&m, data);
+                    plan->handled[group] = 1;
+                    break;
+                case #{up}_POPULATION_TEARDOWN:
+                    #{p}_teardown(&m, data);
+                    plan->handled[group] = 1;
+                    break;
+                case #{up}_POPULATION_DISPATCH:
+                    plan->handled[group] = #{p}_dispatch(&m, event, data);
+                    break;
+                }
+                #{p}_recording_plan = recording;
+                for (size_t w = 0; w < #{up}_MACHINE_COUNT; w++) plan->next[w * n + group] = m.current[w];
+                for (size_t w = #{up}_MACHINE_COUNT; w < #{up}_POPULATION_KEY_WORDS; w++) plan->next[w * n + group] = m.joins[w - #{up}_MACHINE_COUNT];
+            }
+            plan->trace_offsets[n] = plan->trace_count;
+            return true;
+        }
+
+        static size_t #{p}_population_step(#{p}_population *p, #{p}_population_operation operation, #{p}_event event, void *data, #{p}_parallel_function parallel)
+        {
+            #{p}_population_plan *plan = p->plan;
+            memset(plan->slots, 0, (size_t)plan->group_capacity * 2 * sizeof(uint32_t));
+            plan->group_count = 0;
+            plan->trace_count = 0;
+            #{p}_population_run(p, parallel, #{p}_population_classify);
+            if (!#{p}_population_merge(p) || !#{p}_population_evaluate(p, operation, event, data)) return #{up}_POPULATION_FAILED;
+            plan->data = data;
+            #{p}_population_run(p, parallel, #{p}_population_apply);
+            plan->data = NULL;
+            size_t handled = 0;
+            for (size_t index = 0; index < plan->chunk_count; index++) handled += plan->chunks[index].handled;
+            return handled;
+        }
+
+        bool #{p}_population_init(#{p}_population *p, size_t count, void *context, #{p}_state_function enter, #{p}_state_function exit)
+        {
+            memset(p, 0, sizeof(*p));
+            if (count == 0) return false;
+            p->count = count;
+            p->context = context;
+            p->enter = enter;
+            p->exit = exit;
+            bool ok = true;
+            for (size_t w = 0; w < #{up}_MACHINE_COUNT; w++) {
+                p->current[w] = calloc(count, sizeof(uint16_t));
+                if (p->current[w] == NULL) ok = false;
+            }#{alloc_joins}
+            p->contexts = calloc(count, sizeof(void *));
+            p->plan = calloc(1, sizeof(#{p}_population_plan));
+            if (p->contexts == NULL || p->plan == NULL || !ok) {
+                #{p}_population_destroy(p);
+                return false;
+            }
+            p->plan->chunk_count = (count + #{up}_POPULATION_CHUNK_SIZE - 1) / #{up}_POPULATION_CHUNK_SIZE;
+            p->plan->chunks = calloc(p->plan->chunk_count, sizeof(#{p}_population_chunk));
+            p->plan->group = calloc(count, sizeof(uint32_t));
+            p->plan->trace = malloc(#{up}_POPULATION_TRACE_LIMIT * sizeof(uint32_t));
+            p->plan->trace_capacity = #{up}_POPULATION_TRACE_LIMIT;
+            if (p->plan->chunks == NULL || p->plan->group == NULL || p->plan->trace == NULL || !#{p}_population_grow(p->plan)) {
+                #{p}_population_destroy(p);
+                return false;
+            }
+            return true;
+        }
+
+        void #{p}_population_destroy(#{p}_population *p)
+        {
+            for (size_t w = 0; w < #{up}_MACHINE_COUNT; w++) free(p->current[w]);#{free_joins}
+            free(p->contexts);
+            if (p->plan) {
+                free(p->plan->chunks);
+                free(p->plan->group);
+                free(p->plan->slots);
+                free(p->plan->keys);
+                free(p->plan->next);
+                free(p->plan->handled);
+                free(p->plan->trace_offsets);
+                free(p->plan->trace);
+                free(p->plan);
+            }
+            memset(p, 0, sizeof(*p));
+        }
+
+        bool #{p}_population_setup(#{p}_population *p, void *data, #{p}_parallel_function parallel)
+        {
+            return #{p}_population_step(p, #{up}_POPULATION_SETUP, (#{p}_event)0, data, parallel) != #{up}_POPULATION_FAILED;
+        }
+
+        bool #{p}_population_teardown(#{p}_population *p, void *data, #{p}_parallel_function parallel)
+        {
+            return #{p}_population_step(p, #{up}_POPULATION_TEARDOWN, (#{p}_event)0, data, parallel) != #{up}_POPULATION_FAILED;
+        }
+
+        size_t #{p}_population_dispatch(#{p}_population *p, #{p}_event event, void *data, #{p}_parallel_function parallel)
+        {
+            return #{p}_population_step(p, #{up}_POPULATION_DISPATCH, event, data, parallel);
+        }
+
+        bool #{p}_population_dispatch_instance(#{p}_population *p, size_t instance, #{p}_event event, void *data)
+        {
+            #{p}_population_plan *plan = p->plan;
+            #{p}_population_plan *recording = #{p}_recording_plan;
+            if (instance >= p->count) return false;
+            uint32_t key[#{up}_POPULATION_KEY_WORDS];
+            #{p}_population_key(p, instance, key);
+            #{p}_machine m;
+            #{p}_population_load(p, &m, key);
+            plan->trace_count = 0;
+            #{p}_recording_plan = plan;
+            bool handled = #{p}_dispatch(&m, event, data);
+            #{p}_recording_plan = recording;
+            for (size_t w = 0; w < #{up}_MACHINE_COUNT; w++) p->current[w][instance] = m.current[w];#{store_joins}
+            if (p->contexts[instance]) #{p}_population_replay(p, p->contexts[instance], 0, plan->trace_count, data);
+            return handled;
+        }
+
+        bool #{p}_population_is_active(const #{p}_population *p, size_t instance, #{p}_state state)
+        {
+            if (state <= #{state_none} || state >= #{up}_STATE_COUNT || instance >= p->count) return false;
+            return p->current[#{fn('state_machines')}[state]][instance] == state;
+        }
+      C
+    end
+
+    def header
+      guard = "#{@prefix.upcase}_MACHINE_H"
+      out = []
+      out << '/*'
+      out << " * #{header_name}"
+      out << ' * Generated by tbsm_generate.rb. Do not edit.'
+      out << ' */'
+      out << ''
+      out << "#ifndef #{guard}"
+      out << "#define #{guard}"
+      out << ''
+      out << '#include <stdbool.h>'
+      out << '#include <stddef.h>' if @population
+      out << '#include <stdint.h>'
+      out << ''
+      out << '#ifdef __cplusplus'
+      out << 'extern "C" {'
+      out << '#endif'
+      out << ''
+      out << "#define #{@prefix.upcase}_MACHINE_COUNT #{@machines.count}"
+      out << "#define #{@prefix.upcase}_JOIN_COUNT #{@joins.count}"
+      out << ''
+      out << 'typedef enum {'
+      out << "    #{state_none} = 0,"
+      @states.each { |state| out << "    #{state.identifier} = #{state.index}," }
+      out << "    #{@prefix.upcase}_STATE_COUNT = #{@states.count + 1}"
+      out << "} #{type('state')};"
+      out << ''
+      out << 'typedef enum {'
+      @events.each_with_index { |event, idx| out << "    #{enum_event(event)} = #{idx}," }
+      out << "    #{@prefix.upcase}_EVENT_COUNT = #{@events.count}"
+      out << "} #{type('event')};"
+      out << ''
+      out << "typedef void (*#{type('state_function')})(void *context, #{type('state')} state, void *data);"
+      out << ''
+      out << 'typedef struct {'
+      out << "    uint16_t current[#{@prefix.upcase}_MACHINE_COUNT];"
+      out << "    uint32_t joins[#{[@joins.count, 1].max}];"
+      out << '    void *context;'
+      out << "    #{type('state_function')} enter;"
+      out << "    #{type('state_function')} exit;"
+      out << "} #{type('machine')};"
+      out << ''
+      unless @guards.empty? && @actions.empty?
+        out << '/* Guards and actions referenced by the definition. Provide these at link time. */'
+        @guards.each { |name| out << "extern bool #{name}(void *context, void *data);" }
+        @actions.each { |name| out << "extern void #{name}(void *context, void *data);" }
+        out << ''
+      end
+      out << "void #{fn('init')}(#{type('machine')} *m, void *context, #{type('state_function')} enter, #{type('state_function')} exit);"
+      out << "void #{fn('setup')}(#{type('machine')} *m, void *data);"
+      out << "void #{fn('teardown')}(#{type('machine')} *m, void *data);"
+      out << "bool #{fn('dispatch')}(#{type('machine')} *m, #{type('event')} event, void *data);"
+      out << "bool #{fn('is_active')}(const #{type('machine')} *m, #{type('state')} state);"
+      out << "const char *#{fn('state_name')}(#{type('state')} state);"
+      out << "int #{fn('event_from_name')}(const char *name);"
+      out << ''
+      population_header(out) if @population
+      out << '#ifdef __cplusplus'
+      out << '}'
+      out << '#endif'
+      out << ''
+      out << "#endif /* #{guard} */"
+      out.join("\n") + "\n"
+    end
+
+    def source
+      out = []
+      out << '/*'
+      out << " * #{source_name}"
+      out << ' * Generated by tbsm_generate.rb. Do not edit.'
+      out << ' */'
+      out << ''
+      out << "#include \"#{header_name}\""
+      out << ''
+      out << '#include <stdlib.h>' if @population
+      out << '#include <string.h>'
+      out << ''
+      out << "static const char *const #{fn('state_names')}[#{@prefix.upcase}_STATE_COUNT] = {"
+      out << '    0,'
+      @states.each { |state| out << "    \"#{state.qualified_name}\"," }
+      out << '};'
+      out << ''
+      out << "static const uint16_t #{fn('state_machines')}[#{@prefix.upcase}_STATE_COUNT] = {"
+      out << '    0,'
+      @states.each { |state| out << "    #{state.machine.index}," }
+      out << '};'
+      out << ''
+      unless @events.empty?
+        out << "static const char *const #{fn('event_names')}[#{@prefix.upcase}_EVENT_COUNT] = {"
+        @events.each { |event| out << "    \"#{event}\"," }
+        out << '};'
+        out << ''
+      end
+      @machines.each { |machine| out << "static void #{fn("teardown_m#{machine.index}")}(#{type('machine')} *m, void *data);" }
+      @machines.each { |machine| out << "static bool #{fn("dispatch_m#{machine.index}")}(#{type('machine')} *m, #{type('event')} event, void *data);" }
+      out << ''
+      @machines.each { |machine| emit_exit_function(out, machine) }
+      @machines.each { |machine| emit_dispatch_function(out, machine) }
+      out << "void #{fn('init')}(#{type('machine')} *m, void *context, #{type('state_function')} enter, #{type('state_function')} exit)"
+      out << '{'
+      out << '    memset(m, 0, sizeof(*m));'
+      out << '    m->context = context;'
+      out << '    m->enter = enter;'
+      out << '    m->exit = exit;'
+      out << '}'
+      out << ''
+      out << "void #{fn('setup')}(#{type('machine')} *m, void *data)"
+      out << '{'
+      emit_enter(out, '    ', @root, @root.initial_state)
+      out << '}'
+      out << ''
+      out << "void #{fn('teardown')}(#{type('machine')} *m, void *data)"
+      out << '{'
+      out << "    #{fn('teardown_m0')}(m, data);"
+      out << "    memset(m->joins, 0, sizeof(m->joins));"
+      out << '}'
+      out << ''
+      out << "bool #{fn('dispatch')}(#{type('machine')} *m, #{type('event')} event, void *data)"
+      out << '{'
+      out << "    return #{fn('dispatch_m0')}(m, event, data);"
+      out << '}'
+      out << ''
+      out << "bool #{fn('is_active')}(const #{type('machine')} *m, #{type('state')} state)"
+      out << '{'
+      out << "    if (state <= #{state_none} || state >= #{@prefix.upcase}_STATE_COUNT) return false;"
+      out << "    return m->current[#{fn('state_machines')}[state]] == state;"
+      out << '}'
+      out << ''
+      out << "const char *#{fn('state_name')}(#{type('state')} state)"
+      out << '{'
+      out << "    if (state <= #{state_none} || state >= #{@prefix.upcase}_STATE_COUNT) return 0;"
+      out << "    return #{fn('state_names')}[state];"
+      out << '}'
+      out << ''
+      out << "int #{fn('event_from_name')}(const char *name)"
+      out << '{'
+      unless @events.empty?
+        out << "    for (int i = 0; i < #{@prefix.upcase}_EVENT_COUNT; i++) {"
+        out << "        if (strcmp(#{fn('event_names')}[i], name) == 0) return i;"
+        out << '    }'
+      else
+        out << '    (void)name;'
+      end
+      out << '    return -1;'
+      out << '}'
+      population_source(out) if @population
+      out.join("\n") + "\n"
+    end
+  end
+
+  def self.run(argv)
+    options = { output: '.' }
+    parser = OptionParser.new do |opts|
+      opts.banner = 'Usage: tbsm_generate.rb [--prefix NAME] [--output DIR] [--population] definition.json'
+      opts.on('-p', '--prefix NAME', 'Prefix for generated identifiers (defaults to the machine name)') { |v| options[:prefix] = v }
+      opts.on('-o', '--output DIR', 'Output directory (defaults to the current directory)') { |v| options[:output] = v }
+      opts.on('-s', '--schema FILE', 'JSON schema to validate against') { |v| options[:schema] = v }
+      opts.on('-P', '--population', 'Also generate the batch stepping population API') { options[:population] = true }
+    end
+    parser.parse!(argv)
+    abort(parser.banner) if argv.count != 1
+
+    definition = JSON.parse(File.read(argv.first))
+    schema_path = options[:schema] || File.expand_path('schema.json', __dir__)
+    if File.exist?(schema_path)
+      errors = SchemaValidator.new(JSON.parse(File.read(schema_path))).validate(definition)
+      abort("#{argv.first} is not a valid definition:\n#{errors.join("\n")}") unless errors.empty?
+    end
+
+    generator = Generator.new(definition, options[:prefix], options[:population])
+    File.write(File.join(options[:output], generator.header_name), generator.header)
+    File.write(File.join(options[:output], generator.source_name), generator.source)
+  rescue GeneratorError, JSON::ParserError => e
+    abort("tbsm_generate.rb: #{e.message}")
+  end
+end
+
+TBSMGenerator.run(ARGV) if $PROGRAM_NAME == __FILE__
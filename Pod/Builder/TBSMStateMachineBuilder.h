@@ -7,8 +7,12 @@
 
 #import <Foundation/Foundation.h>
 
+#import "TBSMStateMachineDiff.h"
+
 @class TBSMStateMachine;
 @interface TBSMStateMachineBuilder : NSObject
 
 + (TBSMStateMachine *)buildFromFile:(NSString *)file;
++ (TBSMStateMachineDiff *)diffFromFile:(NSString *)file toFile:(NSString *)otherFile;
++ (BOOL)applyDiff:(TBSMStateMachineDiff *)diff toStateMachine:(TBSMStateMachine *)stateMachine fallbacks:(NSDictionary<NSString *, NSString *> *)fallbacks error:(NSError **)error;
 @end
@@ -7,18 +7,38 @@
 
 #import "TBSMStateMachineBuilder.h"
 #import "TBSMStateMachine.h"
+#import "TBSMStateMachine+Private.h"
+
+@interface TBSMBuilderContext : NSObject
+@property (nonatomic, strong) NSDictionary<NSString *, NSArray *> *transitions;
+@property (nonatomic, strong) NSSet<NSString *> *pinnedPaths;
+@end
+
+@implementation TBSMBuilderContext
+@end
 
 @implementation TBSMStateMachineBuilder
 
 + (TBSMStateMachine *)buildFromFile:(NSString *)file
 {
     NSDictionary *data = [self loadFile:file];
+    TBSMBuilderContext *context = [self contextForData:data];
     TBSMStateMachine *stateMachine = [TBSMStateMachine stateMachineWithName:data[@"name"]];
-    stateMachine.states = [self buildStates:data[@"states"]];
-    [self configureTransitions:data forStateMachine:stateMachine];
+    stateMachine.states = [self buildStates:data[@"states"] path:nil context:context];
+    [self configureTransitions:context.transitions[@""] forStateMachine:stateMachine];
     return stateMachine;
 }
 
++ (TBSMStateMachineDiff *)diffFromFile:(NSString *)file toFile:(NSString *)otherFile
+{
+    NSDictionary *data = [self loadFile:file];
+    NSDictionary *otherData = [self loadFile:otherFile];
+    if (data == nil || otherData == nil) {
+        return nil;
+    }
+    return [TBSMStateMachineDiff diffFromDefinition:data toDefinition:otherData];
+}
+
 + (NSDictionary *)loadFile:(NSString *)file
 {
     NSData *json = [NSData dataWithContentsOfFile:file];
@@ -33,54 +53,305 @@
     return data;
 }
 
-+ (NSArray *)buildStates:(NSArray *)data
++ (NSArray *)buildStates:(NSArray *)data path:(NSString *)path context:(TBSMBuilderContext *)context
 {
     NSMutableArray *states = [NSMutableArray new];
     [data enumerateObjectsUsingBlock:^(NSDictionary   * _Nonnull entry, NSUInteger index, BOOL * _Nonnull stop) {
-        TBSMState *state = [self buildState:entry];
+        NSString *statePath = path ? [path stringByAppendingFormat:@"/%@", entry[@"name"]] : entry[@"name"];
+        TBSMState *state = [self buildState:entry path:statePath context:context];
         [states addObject:state];
     }];
     return states;
 }
 
-+ (TBSMState *)buildState:(NSDictionary *)data
++ (TBSMState *)buildState:(NSDictionary *)data path:(NSString *)path context:(TBSMBuilderContext *)context
 {
     NSString *type = data[@"type"];
+    TBSMState *state = nil;
     if ([type isEqualToString:@"state"]) {
-        return [TBSMState stateWithName:data[@"name"]];
+        state = [TBSMState stateWithName:data[@"name"]];
+    } else if ([type isEqualToString:@"sub"]) {
+        state = [self buildSub:data path:path context:context];
+    } else if ([type isEqualToString:@"parallel"]) {
+        state = [self buildParallel:data path:path context:context];
     }
-    if ([type isEqualToString:@"sub"]) {
-        return [self buildSub:data];
+    for (NSString *event in data[@"deferred_events"]) {
+        [state deferEvent:event];
     }
-    if ([type isEqualToString:@"parallel"]) {
-        return [self buildParallel:data];
-    }
-    return nil;
+    return state;
 }
 
-+ (TBSMSubState *)buildSub:(NSDictionary *)data
++ (TBSMSubState *)buildSub:(NSDictionary *)data path:(NSString *)path context:(TBSMBuilderContext *)context
 {
     TBSMSubState *state = [TBSMSubState subStateWithName:data[@"name"]];
-    state.states = [self buildStates:data[@"states"]];
+    if ([data[@"deferred"] boolValue]) {
+        [state setStatesWithConfiguration:^(TBSMSubState *subState) {
+            subState.states = [self buildStates:data[@"states"] path:path context:context];
+            [self configureTransitions:context.transitions[path] forStateMachine:subState.path.firstObject];
+        } releaseInterval:[self releaseIntervalForData:data path:path context:context]];
+        return state;
+    }
+    state.states = [self buildStates:data[@"states"] path:path context:context];
     return state;
 }
 
-+ (TBSMParallelState *)buildParallel:(NSDictionary *)data
++ (TBSMParallelState *)buildParallel:(NSDictionary *)data path:(NSString *)path context:(TBSMBuilderContext *)context
 {
     TBSMParallelState *state = [TBSMParallelState parallelStateWithName:data[@"name"]];
-    NSArray *regionData = data[@"regions"];
+    if ([data[@"deferred"] boolValue]) {
+        [state setStatesWithConfiguration:^(TBSMParallelState *parallelState) {
+            [parallelState setStates:[self buildRegions:data[@"regions"] path:path context:context]];
+            [self configureTransitions:context.transitions[path] forStateMachine:parallelState.path.firstObject];
+        } releaseInterval:[self releaseIntervalForData:data path:path context:context]];
+        return state;
+    }
+    [state setStates:[self buildRegions:data[@"regions"] path:path context:context]];
+    return state;
+}
+
++ (NSArray *)buildRegions:(NSArray *)data path:(NSString *)path context:(TBSMBuilderContext *)context
+{
     NSMutableArray *regions = [NSMutableArray new];
-    [regionData enumerateObjectsUsingBlock:^(NSArray * _Nonnull entry, NSUInteger idx, BOOL * _Nonnull stop) {
-        NSArray *states = [self buildStates:entry];
+    [data enumerateObjectsUsingBlock:^(NSArray * _Nonnull entry, NSUInteger idx, BOOL * _Nonnull stop) {
+        NSString *regionPath = [path stringByAppendingFormat:@"@%lu", (unsigned long)idx];
+        NSArray *states = [self buildStates:entry path:regionPath context:context];
         [regions addObject:states];
     }];
-    [state setStates:regions];
-    return state;
+    return regions;
+}
+
++ (NSTimeInterval)releaseIntervalForData:(NSDictionary *)data path:(NSString *)path context:(TBSMBuilderContext *)context
+{
+    // States referenced by transitions outside of the deferred state must outlive it.
+    if ([context.pinnedPaths containsObject:path]) {
+        return 0;
+    }
+    return [data[@"release_interval"] doubleValue];
+}
+
+#pragma mark - Hot reload
+
++ (BOOL)applyDiff:(TBSMStateMachineDiff *)diff toStateMachine:(TBSMStateMachine *)stateMachine fallbacks:(NSDictionary<NSString *, NSString *> *)fallbacks error:(NSError **)error
+{
+    if (diff.incompatiblePath) {
+        return [self incompatiblePath:diff.incompatiblePath error:error];
+    }
+    
+    // Active states which will be removed need a fallback. Validate before changing anything.
+    NSMutableArray *remappedStates = [NSMutableArray new];
+    for (NSString *path in diff.removedStatePaths) {
+        TBSMState *state = [stateMachine stateWithPath:path error:nil];
+        if (state == nil || ![stateMachine isActive:state]) {
+            continue;
+        }
+        NSString *fallbackPath = fallbacks[path];
+        if (fallbackPath == nil || ![diff definesStateAtPath:fallbackPath]) {
+            return [self incompatiblePath:path error:error];
+        }
+        [remappedStates addObject:@[state, fallbackPath]];
+    }
+    
+    TBSMBuilderContext *context = [self contextForData:diff.definition];
+    NSMutableDictionary *containers = [NSMutableDictionary new];
+    NSMutableDictionary *containerStates = [NSMutableDictionary new];
+    NSMutableArray *removedStates = [NSMutableArray new];
+    for (NSString *containerPath in diff.changedContainerPaths) {
+        TBSMStateMachine *container = [self stateMachineAtContainerPath:containerPath inStateMachine:stateMachine];
+        NSMutableArray *states = [NSMutableArray new];
+        for (NSDictionary *entry in [diff stateDefinitionsInContainerAtPath:containerPath]) {
+            NSString *statePath = containerPath.length ? [containerPath stringByAppendingFormat:@"/%@", entry[@"name"]] : entry[@"name"];
+            if ([diff.addedStatePaths containsObject:statePath]) {
+                [states addObject:[self buildState:entry path:statePath context:context]];
+            } else {
+                [states addObject:[container stateWithPath:entry[@"name"]]];
+            }
+        }
+        NSMutableArray *obsoleteStates = [NSMutableArray new];
+        for (TBSMState *state in container.states) {
+            if (![states containsObject:state]) {
+                [obsoleteStates addObject:state];
+            }
+        }
+        // Removed states stay in place until active ones have been left.
+        container.states = [states arrayByAddingObjectsFromArray:obsoleteStates];
+        [removedStates addObjectsFromArray:obsoleteStates];
+        containers[containerPath] = container;
+        containerStates[containerPath] = states;
+    }
+    
+    for (NSDictionary *item in diff.removedTransitions) {
+        [self removeTransition:item fromStateMachine:stateMachine];
+    }
+    [self configureTransitions:diff.addedTransitions forStateMachine:stateMachine];
+    
+    for (NSArray *remappedState in remappedStates) {
+        TBSMState *state = remappedState.firstObject;
+        if (![stateMachine isActive:state]) {
+            continue;
+        }
+        TBSMState *fallback = [self stateWithPath:remappedState.lastObject inStateMachine:stateMachine];
+        TBSMTransition *transition = [[TBSMTransition alloc] initWithSourceState:state targetState:fallback kind:TBSMTransitionExternal action:nil guard:nil eventName:@"fallback"];
+        TBSMStateMachine *lca = [transition findLeastCommonAncestor];
+        [lca switchState:state targetState:fallback transition:transition data:nil];
+    }
+    
+    for (NSString *containerPath in containers) {
+        TBSMStateMachine *container = containers[containerPath];
+        container.states = containerStates[containerPath];
+    }
+    [removedStates makeObjectsPerformSelector:@selector(removeTransitionVertexes)];
+    [stateMachine invalidateStateIndex];
+    
+    // Fallback transitions and the new index change the active configuration.
+    [stateMachine _publishConfigurationSnapshot];
+    [stateMachine _journalStepWithEvent:nil];
+    return YES;
+}
+
++ (BOOL)incompatiblePath:(NSString *)path error:(NSError **)error
+{
+    if (error) {
+        *error = [NSError tbsm_incompatibleDefinitionError:path];
+    }
+    return NO;
+}
+
++ (TBSMStateMachine *)stateMachineAtContainerPath:(NSString *)path inStateMachine:(TBSMStateMachine *)stateMachine
+{
+    if (path.length == 0) {
+        return stateMachine;
+    }
+    NSRange slash = [path rangeOfString:@"/" options:NSBackwardsSearch];
+    NSRange region = [path rangeOfString:@"@" options:NSBackwardsSearch];
+    if (region.location != NSNotFound && (slash.location == NSNotFound || region.location > slash.location)) {
+        NSString *parallelStatePath = [path substringToIndex:region.location];
+        TBSMParallelState *parallelState = (TBSMParallelState *)[stateMachine stateWithPath:parallelStatePath];
+        return [self materializedStateMachinesOfState:parallelState path:parallelStatePath][[path substringFromIndex:region.location + 1].integerValue];
+    }
+    TBSMSubState *subState = (TBSMSubState *)[stateMachine stateWithPath:path];
+    return [self materializedStateMachinesOfState:subState path:path].firstObject;
+}
+
+/**
+ *  Diffs never change the contents of deferred states, so containers are only looked up in state machines which have been built.
+ */
++ (NSArray<TBSMStateMachine *> *)materializedStateMachinesOfState:(TBSMState *)state path:(NSString *)path
+{
+    if ([state isKindOfClass:[TBSMSubState class]] && ((TBSMSubState *)state).isMaterialized) {
+        return @[((TBSMSubState *)state).stateMachine];
+    }
+    if ([state isKindOfClass:[TBSMParallelState class]] && ((TBSMParallelState *)state).isMaterialized) {
+        return ((TBSMParallelState *)state).stateMachines;
+    }
+    @throw [NSException tbsm_unmaterializedPath:path];
+}
+
++ (void)removeTransition:(NSDictionary *)data fromStateMachine:(TBSMStateMachine *)stateMachine
+{
+    if ([data[@"type"] isEqualToString:@"simple"]) {
+        TBSMState *source = [stateMachine stateWithPath:data[@"source"] error:nil];
+        TBSMState *target = [stateMachine stateWithPath:data[@"target"] error:nil];
+        TBSMTransitionKind kind = [self kindForData:data];
+        [source removeHandlersForEvent:data[@"name"] passingTest:^BOOL(TBSMEventHandler *eventHandler) {
+            return (eventHandler.target == target && eventHandler.kind == kind);
+        }];
+        return;
+    }
+    NSString *pseudoStateName = data[@"pseudo_state"][@"name"];
+    for (NSDictionary *entry in data[@"vertices"][@"incoming"]) {
+        TBSMState *source = [stateMachine stateWithPath:entry[@"source"] error:nil];
+        [source removeHandlersForEvent:entry[@"name"] passingTest:^BOOL(TBSMEventHandler *eventHandler) {
+            return ([eventHandler.target isKindOfClass:[TBSMPseudoState class]] && [eventHandler.target.name isEqualToString:pseudoStateName]);
+        }];
+    }
+}
+
+#pragma mark - Deferred states
+
++ (TBSMBuilderContext *)contextForData:(NSDictionary *)data
+{
+    NSMutableArray *deferredPaths = [NSMutableArray new];
+    [self collectDeferredPaths:deferredPaths states:data[@"states"] path:nil];
+    
+    NSMutableDictionary *transitions = [NSMutableDictionary new];
+    NSMutableSet *pinnedPaths = [NSMutableSet new];
+    for (NSDictionary *item in data[@"transitions"]) {
+        NSArray *paths = [self pathsOfTransition:item];
+        NSString *owner = [self deferredPathContainingPath:paths.firstObject deferredPaths:deferredPaths] ?: @"";
+        NSMutableArray *group = transitions[owner] ?: [NSMutableArray new];
+        [group addObject:item];
+        transitions[owner] = group;
+        
+        for (NSString *path in paths) {
+            for (NSString *deferredPath in deferredPaths) {
+                if ([self path:path isInsideDeferredPath:deferredPath] && ![deferredPath isEqualToString:owner] && ![self path:owner isInsideDeferredPath:deferredPath]) {
+                    [pinnedPaths addObject:deferredPath];
+                }
+            }
+        }
+    }
+    TBSMBuilderContext *context = [TBSMBuilderContext new];
+    context.transitions = transitions;
+    context.pinnedPaths = pinnedPaths;
+    return context;
+}
+
++ (void)collectDeferredPaths:(NSMutableArray *)deferredPaths states:(NSArray *)data path:(NSString *)path
+{
+    for (NSDictionary *entry in data) {
+        NSString *statePath = path ? [path stringByAppendingFormat:@"/%@", entry[@"name"]] : entry[@"name"];
+        if ([entry[@"deferred"] boolValue]) {
+            [deferredPaths addObject:statePath];
+        }
+        if ([entry[@"type"] isEqualToString:@"sub"]) {
+            [self collectDeferredPaths:deferredPaths states:entry[@"states"] path:statePath];
+        }
+        if ([entry[@"type"] isEqualToString:@"parallel"]) {
+            [entry[@"regions"] enumerateObjectsUsingBlock:^(NSArray * _Nonnull region, NSUInteger idx, BOOL * _Nonnull stop) {
+                [self collectDeferredPaths:deferredPaths states:region path:[statePath stringByAppendingFormat:@"@%lu", (unsigned long)idx]];
+            }];
+        }
+    }
+}
+
+/**
+ *  Returns all state paths referenced by a transition. The first path determines which state configures the transition.
+ */
++ (NSArray<NSString *> *)pathsOfTransition:(NSDictionary *)data
+{
+    if ([data[@"type"] isEqualToString:@"simple"]) {
+        return @[data[@"source"], data[@"target"]];
+    }
+    NSMutableArray *paths = [NSMutableArray new];
+    NSDictionary *vertices = data[@"vertices"];
+    for (NSDictionary *entry in vertices[@"incoming"]) {
+        [paths addObject:entry[@"source"]];
+    }
+    for (NSDictionary *entry in vertices[@"outgoing"]) {
+        [paths addObject:entry[@"target"]];
+    }
+    [paths addObject:data[@"pseudo_state"][@"region"]];
+    return paths;
+}
+
++ (NSString *)deferredPathContainingPath:(NSString *)path deferredPaths:(NSArray *)deferredPaths
+{
+    NSString *result = nil;
+    for (NSString *deferredPath in deferredPaths) {
+        if ([self path:path isInsideDeferredPath:deferredPath] && deferredPath.length > result.length) {
+            result = deferredPath;
+        }
+    }
+    return result;
+}
+
++ (BOOL)path:(NSString *)path isInsideDeferredPath:(NSString *)deferredPath
+{
+    return [path hasPrefix:[deferredPath stringByAppendingString:@"/"]] || [path hasPrefix:[deferredPath stringByAppendingString:@"@"]];
 }
 
-+ (void)configureTransitions:(NSDictionary *)data forStateMachine:(TBSMStateMachine *)stateMachine
++ (void)configureTransitions:(NSArray *)transitionConfigurations forStateMachine:(TBSMStateMachine *)stateMachine
 {
-    NSArray *transitionConfigurations = data[@"transitions"];
     [transitionConfigurations enumerateObjectsUsingBlock:^(NSDictionary *  _Nonnull item, NSUInteger index, BOOL * _Nonnull stop) {
         if ([item[@"type"] isEqualToString:@"simple"]) {
             [self configureSimpleTransition:item forStateMachine:stateMachine];
@@ -92,6 +363,25 @@
 }
 
 + (void)configureSimpleTransition:(NSDictionary *)data forStateMachine:(TBSMStateMachine *)stateMachine
+{
+    TBSMState *source = [self stateWithPath:data[@"source"] inStateMachine:stateMachine];
+    TBSMState *target = [self stateWithPath:data[@"target"] inStateMachine:stateMachine];
+    [source addHandlerForEvent:data[@"name"] target:target kind:[self kindForData:data]];
+}
+
+/**
+ *  Transitions may target states inside deferred state machines which are built and kept alive for this purpose.
+ */
++ (TBSMState *)stateWithPath:(NSString *)path inStateMachine:(TBSMStateMachine *)stateMachine
+{
+    TBSMState *state = [stateMachine _stateWithPath:path materialize:YES error:nil];
+    if (state == nil) {
+        @throw [NSException tbsm_invalidPath:path];
+    }
+    return state;
+}
+
++ (TBSMTransitionKind)kindForData:(NSDictionary *)data
 {
     NSString *kindData = data[@"kind"];
     TBSMTransitionKind kind = TBSMTransitionExternal;
@@ -101,9 +391,7 @@
     if ([kindData isEqualToString:@"local"]) {
         kind = TBSMTransitionLocal;
     }
-    TBSMState *source = [stateMachine stateWithPath:data[@"source"]];
-    TBSMState *target = [stateMachine stateWithPath:data[@"target"]];
-    [source addHandlerForEvent:data[@"name"] target:target kind:kind];
+    return kind;
 }
 
 + (void)configureCompoundTransition:(NSDictionary *)data forStateMachine:(TBSMStateMachine *)stateMachine
@@ -115,6 +403,9 @@
     if ([pseudoState[@"type"] isEqualToString:@"join"]) {
         [self configureJoinTransition:data forStateMachine:stateMachine];
     }
+    if ([pseudoState[@"type"] isEqualToString:@"history"]) {
+        [self configureHistoryTransition:data forStateMachine:stateMachine];
+    }
 }
 
 + (void)configureForkTransition:(NSDictionary *)data forStateMachine:(TBSMStateMachine *)stateMachine
@@ -134,15 +425,15 @@
     NSMutableArray *targets = [NSMutableArray new];
     [outgoing enumerateObjectsUsingBlock:^(NSDictionary * _Nonnull entry, NSUInteger idx, BOOL * _Nonnull stop) {
         NSString *targetPath = entry[@"target"];
-        TBSMState *target = [stateMachine stateWithPath:targetPath];
+        TBSMState *target = [self stateWithPath:targetPath inStateMachine:stateMachine];
         [targets addObject:target];
     }];
     
     TBSMFork *fork = [TBSMFork forkWithName:forkName];
-    TBSMState *source = [stateMachine stateWithPath:sourcePath];
+    TBSMState *source = [self stateWithPath:sourcePath inStateMachine:stateMachine];
     [source addHandlerForEvent:sourceName target:fork];
     
-    TBSMParallelState *region = (TBSMParallelState *)[stateMachine stateWithPath:regionPath];
+    TBSMParallelState *region = (TBSMParallelState *)[self stateWithPath:regionPath inStateMachine:stateMachine];
     [fork setTargetStates:targets inRegion:region];
 }
 
@@ -160,14 +451,14 @@
     NSString *targetPath = outgoingFirst[@"target"];
     
     TBSMJoin *join = [TBSMJoin joinWithName:joinName];
-    TBSMState *target = [stateMachine stateWithPath:targetPath];
-    TBSMParallelState *region = (TBSMParallelState *)[stateMachine stateWithPath:regionPath];
+    TBSMState *target = [self stateWithPath:targetPath inStateMachine:stateMachine];
+    TBSMParallelState *region = (TBSMParallelState *)[self stateWithPath:regionPath inStateMachine:stateMachine];
     
     NSMutableArray *sources = [NSMutableArray new];
     [incoming enumerateObjectsUsingBlock:^(NSDictionary * _Nonnull entry, NSUInteger idx, BOOL * _Nonnull stop) {
         NSString *sourceName = entry[@"name"];
         NSString *sourcePath = entry[@"source"];
-        TBSMState *source = [stateMachine stateWithPath:sourcePath];
+        TBSMState *source = [self stateWithPath:sourcePath inStateMachine:stateMachine];
         [source addHandlerForEvent:sourceName target:join];
         [sources addObject:source];
     }];
@@ -175,4 +466,25 @@
     [join setSourceStates:sources inRegion:region target:target];
 }
 
++ (void)configureHistoryTransition:(NSDictionary *)data forStateMachine:(TBSMStateMachine *)stateMachine
+{
+    NSDictionary *pseudoState = data[@"pseudo_state"];
+    NSString *historyName = pseudoState[@"name"];
+    NSString *regionPath = pseudoState[@"region"];
+    TBSMHistoryKind kind = [pseudoState[@"deep"] boolValue] ? TBSMHistoryDeep : TBSMHistoryShallow;
+    
+    NSDictionary *vertices = data[@"vertices"];
+    NSArray *incoming = vertices[@"incoming"];
+    
+    TBSMHistory *history = [TBSMHistory historyWithName:historyName kind:kind];
+    [history setContainingState:[self stateWithPath:regionPath inStateMachine:stateMachine]];
+    
+    [incoming enumerateObjectsUsingBlock:^(NSDictionary * _Nonnull entry, NSUInteger idx, BOOL * _Nonnull stop) {
+        NSString *sourceName = entry[@"name"];
+        NSString *sourcePath = entry[@"source"];
+        TBSMState *source = [self stateWithPath:sourcePath inStateMachine:stateMachine];
+        [source addHandlerForEvent:sourceName target:history];
+    }];
+}
+
 @end
@@ -0,0 +1,90 @@
+//
+//  TBSMStateMachineDiff.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class describes the structural difference between two json definitions of a state machine.
+ *
+ *  A diff is computed once and can be applied to any number of running state machines
+ *  which have been built from the first definition via `TBSMStateMachineBuilder`.
+ */
+@interface TBSMStateMachineDiff : NSObject
+
+/**
+ *  The definition the diff leads to.
+ */
+@property (nonatomic, copy, readonly) NSDictionary *definition;
+
+/**
+ *  The paths of all added states. Contains only the top most state of an added branch.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *addedStatePaths;
+
+/**
+ *  The paths of all removed states. Contains only the top most state of a removed branch.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *removedStatePaths;
+
+/**
+ *  The paths of all state machines whose list of states has changed. The top state machine has the path `@""`.
+ *  Regions of parallel states are addressed via `parallel@index`.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *changedContainerPaths;
+
+/**
+ *  The transition definitions which only exist in the new definition.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSDictionary *> *addedTransitions;
+
+/**
+ *  The transition definitions which only exist in the old definition.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSDictionary *> *removedTransitions;
+
+/**
+ *  The path of the first state which prevents applying the diff to a running state machine.
+ *
+ *  Changing the type of a state, the number of regions, the deferred flag or the contents of a deferred state is not supported.
+ */
+@property (nonatomic, copy, readonly, nullable) NSString *incompatiblePath;
+
+/**
+ *  `YES` if both definitions are structurally equal.
+ */
+@property (nonatomic, assign, readonly, getter=isEmpty) BOOL empty;
+
+/**
+ *  Computes the difference between two definitions.
+ *
+ *  @param definition      The definition the running state machines have been built from.
+ *  @param otherDefinition The changed definition.
+ *
+ *  @return The diff instance.
+ */
++ (instancetype)diffFromDefinition:(NSDictionary *)definition toDefinition:(NSDictionary *)otherDefinition;
+
+/**
+ *  Returns `YES` if the new definition contains a state at the specified path.
+ *
+ *  @param path The path of the state.
+ *
+ *  @return `YES` if the state exists.
+ */
+- (BOOL)definesStateAtPath:(NSString *)path;
+
+/**
+ *  Returns the ordered state definitions of a state machine in the new definition.
+ *
+ *  @param path The path of the state machine as used in `changedContainerPaths`.
+ *
+ *  @return The array of state definitions.
+ */
+- (NSArray<NSDictionary *> *)stateDefinitionsInContainerAtPath:(NSString *)path;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,229 @@
+//
+//  TBSMStateMachineDiff.m
+//  TBStateMachine
+//
+
+#import "TBSMStateMachineDiff.h"
+
+@interface TBSMStateMachineDiff ()
+@property (nonatomic, copy, readwrite) NSDictionary *definition;
+@property (nonatomic, copy, readwrite) NSArray<NSString *> *addedStatePaths;
+@property (nonatomic, copy, readwrite) NSArray<NSString *> *removedStatePaths;
+@property (nonatomic, copy, readwrite) NSArray<NSString *> *changedContainerPaths;
+@property (nonatomic, copy, readwrite) NSArray<NSDictionary *> *addedTransitions;
+@property (nonatomic, copy, readwrite) NSArray<NSDictionary *> *removedTransitions;
+@property (nonatomic, copy, readwrite) NSString *incompatiblePath;
+@property (nonatomic, strong) NSDictionary<NSString *, NSDictionary *> *priv_states;
+@property (nonatomic, strong) NSDictionary<NSString *, NSArray *> *priv_containers;
+@end
+
+@implementation TBSMStateMachineDiff
+
++ (instancetype)diffFromDefinition:(NSDictionary *)definition toDefinition:(NSDictionary *)otherDefinition
+{
+    TBSMStateMachineDiff *diff = [TBSMStateMachineDiff new];
+    [diff _compareDefinition:definition withDefinition:otherDefinition];
+    return diff;
+}
+
+- (BOOL)isEmpty
+{
+    NSUInteger changes = self.addedStatePaths.count + self.removedStatePaths.count + self.changedContainerPaths.count + self.addedTransitions.count + self.removedTransitions.count;
+    return (changes == 0 && self.incompatiblePath == nil);
+}
+
+- (BOOL)definesStateAtPath:(NSString *)path
+{
+    return (self.priv_states[path] != nil);
+}
+
+- (NSArray<NSDictionary *> *)stateDefinitionsInContainerAtPath:(NSString *)path
+{
+    return self.priv_containers[path] ?: @[];
+}
+
+#pragma mark - Comparison
+
+- (void)_compareDefinition:(NSDictionary *)oldDefinition withDefinition:(NSDictionary *)newDefinition
+{
+    NSMutableDictionary *oldStates = [NSMutableDictionary new];
+    NSMutableDictionary *oldContainers = [NSMutableDictionary new];
+    NSMutableArray *oldDeferredPaths = [NSMutableArray new];
+    [self _collectStates:oldDefinition[@"states"] container:@"" states:oldStates containers:oldContainers deferredPaths:oldDeferredPaths];
+
+    NSMutableDictionary *newStates = [NSMutableDictionary new];
+    NSMutableDictionary *newContainers = [NSMutableDictionary new];
+    NSMutableArray *newDeferredPaths = [NSMutableArray new];
+    [self _collectStates:newDefinition[@"states"] container:@"" states:newStates containers:newContainers deferredPaths:newDeferredPaths];
+
+    self.definition = newDefinition;
+    self.priv_states = newStates;
+    self.priv_containers = newContainers;
+
+    self.addedStatePaths = [self _rootPathsOfStates:newStates missingIn:oldStates deferredPaths:newDeferredPaths];
+    self.removedStatePaths = [self _rootPathsOfStates:oldStates missingIn:newStates deferredPaths:oldDeferredPaths];
+
+    for (NSString *path in newStates) {
+        NSDictionary *oldState = oldStates[path];
+        if (oldState) {
+            [self _compareState:oldState withState:newStates[path] path:path];
+        }
+    }
+
+    NSMutableArray *changedContainerPaths = [NSMutableArray new];
+    for (NSString *container in newContainers) {
+        NSArray *oldEntries = oldContainers[container];
+        if (oldEntries == nil) {
+            continue;
+        }
+        if ([[oldEntries valueForKey:@"name"] isEqualToArray:[newContainers[container] valueForKey:@"name"]]) {
+            continue;
+        }
+        NSString *owner = [self _ownerOfContainer:container];
+        if (owner && ([newDeferredPaths containsObject:owner] || [self _deferredPathContainingPath:owner deferredPaths:newDeferredPaths])) {
+            [self _markIncompatiblePath:owner];
+        }
+        [changedContainerPaths addObject:container];
+    }
+    self.changedContainerPaths = [changedContainerPaths sortedArrayUsingSelector:@selector(compare:)];
+
+    NSArray *oldTransitions = oldDefinition[@"transitions"] ?: @[];
+    NSArray *newTransitions = newDefinition[@"transitions"] ?: @[];
+
+    NSMutableArray *addedTransitions = [NSMutableArray new];
+    for (NSDictionary *item in newTransitions) {
+        if ([oldTransitions containsObject:item]) {
+            continue;
+        }
+        NSString *deferredPath = [self _deferredPathContainingPath:[self _sourcePathOfTransition:item] deferredPaths:newDeferredPaths];
+        if (deferredPath == nil) {
+            [addedTransitions addObject:item];
+        } else if (oldStates[deferredPath]) {
+            [self _markIncompatiblePath:deferredPath];
+        }
+        // Transitions inside an added deferred state will be configured when it is built.
+    }
+    self.addedTransitions = addedTransitions;
+
+    NSMutableArray *removedTransitions = [NSMutableArray new];
+    for (NSDictionary *item in oldTransitions) {
+        if ([newTransitions containsObject:item]) {
+            continue;
+        }
+        NSString *deferredPath = [self _deferredPathContainingPath:[self _sourcePathOfTransition:item] deferredPaths:oldDeferredPaths];
+        if (deferredPath == nil) {
+            [removedTransitions addObject:item];
+        } else if (newStates[deferredPath]) {
+            [self _markIncompatiblePath:deferredPath];
+        }
+    }
+    self.removedTransitions = removedTransitions;
+}
+
+- (void)_collectStates:(NSArray *)entries container:(NSString *)container states:(NSMutableDictionary *)states containers:(NSMutableDictionary *)containers deferredPaths:(NSMutableArray *)deferredPaths
+{
+    for (NSDictionary *entry in entries) {
+        NSString *path = container.length ? [container stringByAppendingFormat:@"/%@", entry[@"name"]] : entry[@"name"];
+        states[path] = entry;
+        if ([entry[@"deferred"] boolValue]) {
+            [deferredPaths addObject:path];
+        }
+        if ([entry[@"type"] isEqualToString:@"sub"]) {
+            [self _collectStates:entry[@"states"] container:path states:states containers:containers deferredPaths:deferredPaths];
+        }
+        if ([entry[@"type"] isEqualToString:@"parallel"]) {
+            [entry[@"regions"] enumerateObjectsUsingBlock:^(NSArray * _Nonnull region, NSUInteger idx, BOOL * _Nonnull stop) {
+                NSString *regionPath = [path stringByAppendingFormat:@"@%lu", (unsigned long)idx];
+                [self _collectStates:region container:regionPath states:states containers:containers deferredPaths:deferredPaths];
+            }];
+        }
+    }
+    containers[container] = entries ?: @[];
+}
+
+- (NSArray<NSString *> *)_rootPathsOfStates:(NSDictionary *)states missingIn:(NSDictionary *)otherStates deferredPaths:(NSArray *)deferredPaths
+{
+    NSMutableArray *paths = [NSMutableArray new];
+    for (NSString *path in states) {
+        if (otherStates[path]) {
+            continue;
+        }
+        NSString *owner = [self _ownerOfContainer:[self _containerOfPath:path]];
+        if (owner && otherStates[owner] == nil) {
+            continue;
+        }
+        NSString *deferredPath = [self _deferredPathContainingPath:path deferredPaths:deferredPaths];
+        if (deferredPath) {
+            [self _markIncompatiblePath:deferredPath];
+        }
+        [paths addObject:path];
+    }
+    return [paths sortedArrayUsingSelector:@selector(compare:)];
+}
+
+- (void)_compareState:(NSDictionary *)oldState withState:(NSDictionary *)newState path:(NSString *)path
+{
+    if (![oldState[@"type"] isEqualToString:newState[@"type"]] ||
+        [oldState[@"deferred"] boolValue] != [newState[@"deferred"] boolValue] ||
+        ![[NSSet setWithArray:oldState[@"deferred_events"] ?: @[]] isEqualToSet:[NSSet setWithArray:newState[@"deferred_events"] ?: @[]]] ||
+        [oldState[@"regions"] count] != [newState[@"regions"] count]) {
+        [self _markIncompatiblePath:path];
+    }
+}
+
+- (void)_markIncompatiblePath:(NSString *)path
+{
+    if (self.incompatiblePath == nil) {
+        self.incompatiblePath = path;
+    }
+}
+
+#pragma mark - Paths
+
+- (NSString *)_sourcePathOfTransition:(NSDictionary *)item
+{
+    if ([item[@"type"] isEqualToString:@"simple"]) {
+        return item[@"source"];
+    }
+    NSDictionary *incoming = [item[@"vertices"][@"incoming"] firstObject];
+    return incoming[@"source"];
+}
+
+- (NSString *)_containerOfPath:(NSString *)path
+{
+    NSRange range = [path rangeOfString:@"/" options:NSBackwardsSearch];
+    if (range.location == NSNotFound) {
+        return @"";
+    }
+    return [path substringToIndex:range.location];
+}
+
+/**
+ *  Returns the path of the state owning a container or `nil` for the top state machine.
+ */
+- (NSString *)_ownerOfContainer:(NSString *)container
+{
+    if (container.length == 0) {
+        return nil;
+    }
+    NSRange slash = [container rangeOfString:@"/" options:NSBackwardsSearch];
+    NSRange region = [container rangeOfString:@"@" options:NSBackwardsSearch];
+    if (region.location != NSNotFound && (slash.location == NSNotFound || region.location > slash.location)) {
+        return [container substringToIndex:region.location];
+    }
+    return container;
+}
+
+- (NSString *)_deferredPathContainingPath:(NSString *)path deferredPaths:(NSArray *)deferredPaths
+{
+    NSString *result = nil;
+    for (NSString *deferredPath in deferredPaths) {
+        BOOL inside = [path hasPrefix:[deferredPath stringByAppendingString:@"/"]] || [path hasPrefix:[deferredPath stringByAppendingString:@"@"]];
+        if (inside && deferredPath.length > result.length) {
+            result = deferredPath;
+        }
+    }
+    return result;
+}
+
+@end
@@ -0,0 +1,135 @@
+//
+//  NSError+TBStateMachine.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+FOUNDATION_EXPORT NSString * const TBSMErrorDomain;
+
+/**
+ *  This enum defines the error codes inside the `TBSMErrorDomain`.
+ */
+typedef NS_ENUM(NSInteger, TBSMErrorCode) {
+    TBSMErrorCodeMissingStateMachine = 1,
+    TBSMErrorCodeNoInitialState,
+    TBSMErrorCodeNoLcaForTransition,
+    TBSMErrorCodeAmbiguousCompoundTransitionAttributes,
+    TBSMErrorCodeNoOutgoingJunctionPath,
+    TBSMErrorCodeInvalidPath,
+    TBSMErrorCodeInvalidEventLog,
+    TBSMErrorCodeIncompatibleDefinition,
+    TBSMErrorCodeIngressUnavailable,
+    TBSMErrorCodeUnmaterializedPath,
+    TBSMErrorCodeJournalCapacityExceeded
+};
+
+/**
+ *  This category adds class methods to create NSError instances reported by the TBStateMachine library
+ *  when a state machine is running in `TBSMErrorModeReport`.
+ */
+@interface NSError (TBStateMachine)
+
+/**
+ *  Reported when a `TBSMSubState` or `TBSMParallelState` was entered or exited without a sub-machine instance.
+ *
+ *  @param stateName The name of the containing state.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_missingStateMachineError:(NSString *)stateName;
+
+/**
+ *  Reported when a state machine without initial state has been set up.
+ *
+ *  @param stateMachineName The name of the state machine.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_noInitialStateError:(NSString *)stateMachineName;
+
+/**
+ *  Reported when no least common ancestor could be found for a given transition.
+ *
+ *  @param transitionName The name of the transition.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_noLcaForTransitionError:(NSString *)transitionName;
+
+/**
+ *  Reported when a compound transition is not well contructed.
+ *
+ *  @param pseudoStateName The name of the pseudo state.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_ambiguousCompoundTransitionAttributesError:(NSString *)pseudoStateName;
+
+/**
+ *  Reported when no outgoing path from a junction pseudo state could be determined.
+ *
+ *  @param junctionName The name of the junction pseudo state.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_noOutgoingJunctionPathError:(NSString *)junctionName;
+
+/**
+ *  Reported when a specified path could not be resolved to an existing state.
+ *
+ *  @param path The path that coud not be resolved.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_invalidPathError:(NSString *)path;
+
+/**
+ *  Reported when a recorded event log could not be read.
+ *
+ *  @param offset The byte offset at which reading failed.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_invalidEventLogError:(NSUInteger)offset;
+
+/**
+ *  Reported when a changed definition can not be applied to a running state machine.
+ *
+ *  @param path The path of the state which prevents the change.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_incompatibleDefinitionError:(NSString *)path;
+
+/**
+ *  Reported when the shared memory ring of an ingress could not be created or mapped.
+ *
+ *  @param name The name of the ring.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_ingressUnavailableError:(NSString *)name;
+
+/**
+ *  Reported when a specified path leads into the deferred contents of a state which have not been built yet.
+ *
+ *  @param path The path that could not be resolved.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_unmaterializedPathError:(NSString *)path;
+
+/**
+ *  Reported when a step can not be journaled because it exceeds the limits of the journal format.
+ *
+ *  @param name The state path or event name which could not be journaled.
+ *
+ *  @return The `NSError` instance.
+ */
++ (NSError *)tbsm_journalCapacityExceededError:(NSString *)name;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,84 @@
+//
+//  NSError+TBStateMachine.m
+//  TBStateMachine
+//
+
+#import "NSError+TBStateMachine.h"
+
+NSString * const TBSMErrorDomain = @"TBSMErrorDomain";
+
+static NSString * const TBSMMissingStateMachineErrorReason = @"Containing state '%@' needs to be set up with a valid TBSMStateMachine instance.";
+static NSString * const TBSMNoInitialStateErrorReason = @"Initial state needs to be set on state machine '%@'.";
+static NSString * const TBSMNoLcaForTransitionErrorReason = @"No transition possible for transition '%@'.";
+static NSString * const TBSMAmbiguousCompoundTransitionAttributesErrorReason = @"Ambiguous compound transition attributes for pseudo state '%@'.";
+static NSString * const TBSMNoOutgoingJunctionPathErrorReason = @"No outgoing path determined for junction '%@'.";
+static NSString * const TBSMInvalidPathErrorReason = @"Invalid path: '%@'.";
+static NSString * const TBSMInvalidEventLogErrorReason = @"Invalid event log at offset %lu.";
+static NSString * const TBSMIncompatibleDefinitionErrorReason = @"Definition change at '%@' can not be applied to a running state machine.";
+static NSString * const TBSMIngressUnavailableErrorReason = @"Shared memory ring '%@' could not be mapped.";
+static NSString * const TBSMUnmaterializedPathErrorReason = @"Path '%@' leads into deferred contents which have not been built yet.";
+static NSString * const TBSMJournalCapacityExceededErrorReason = @"'%@' exceeds the limits of the journal. Compact the journal to release unused identifiers.";
+
+@implementation NSError (TBStateMachine)
+
++ (NSError *)tbsm_missingStateMachineError:(NSString *)stateName
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeMissingStateMachine description:[NSString stringWithFormat:TBSMMissingStateMachineErrorReason, stateName]];
+}
+
++ (NSError *)tbsm_noInitialStateError:(NSString *)stateMachineName
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeNoInitialState description:[NSString stringWithFormat:TBSMNoInitialStateErrorReason, stateMachineName]];
+}
+
++ (NSError *)tbsm_noLcaForTransitionError:(NSString *)transitionName
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeNoLcaForTransition description:[NSString stringWithFormat:TBSMNoLcaForTransitionErrorReason, transitionName]];
+}
+
++ (NSError *)tbsm_ambiguousCompoundTransitionAttributesError:(NSString *)pseudoStateName
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeAmbiguousCompoundTransitionAttributes description:[NSString stringWithFormat:TBSMAmbiguousCompoundTransitionAttributesErrorReason, pseudoStateName]];
+}
+
++ (NSError *)tbsm_noOutgoingJunctionPathError:(NSString *)junctionName
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeNoOutgoingJunctionPath description:[NSString stringWithFormat:TBSMNoOutgoingJunctionPathErrorReason, junctionName]];
+}
+
++ (NSError *)tbsm_invalidPathError:(NSString *)path
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeInvalidPath description:[NSString stringWithFormat:TBSMInvalidPathErrorReason, path]];
+}
+
++ (NSError *)tbsm_invalidEventLogError:(NSUInteger)offset
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeInvalidEventLog description:[NSString stringWithFormat:TBSMInvalidEventLogErrorReason, (unsigned long)offset]];
+}
+
++ (NSError *)tbsm_incompatibleDefinitionError:(NSString *)path
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeIncompatibleDefinition description:[NSString stringWithFormat:TBSMIncompatibleDefinitionErrorReason, path]];
+}
+
++ (NSError *)tbsm_ingressUnavailableError:(NSString *)name
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeIngressUnavailable description:[NSString stringWithFormat:TBSMIngressUnavailableErrorReason, name]];
+}
+
++ (NSError *)tbsm_unmaterializedPathError:(NSString *)path
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeUnmaterializedPath description:[NSString stringWithFormat:TBSMUnmaterializedPathErrorReason, path]];
+}
+
++ (NSError *)tbsm_journalCapacityExceededError:(NSString *)name
+{
+    return [self _tbsm_errorWithCode:TBSMErrorCodeJournalCapacityExceeded description:[NSString stringWithFormat:TBSMJournalCapacityExceededErrorReason, name]];
+}
+
++ (NSError *)_tbsm_errorWithCode:(TBSMErrorCode)code description:(NSString *)description
+{
+    return [NSError errorWithDomain:TBSMErrorDomain code:code userInfo:@{NSLocalizedDescriptionKey : description}];
+}
+
+@end
@@ -147,5 +147,24 @@ FOUNDATION_EXPORT NSString * const TBSMException;
  */
 + (NSException *)tbsm_invalidPath:(NSString *)path;
 
+/**
+ *  Thrown when a specified path leads into the deferred contents of a state which have not been built yet.
+ *
+ *  @param path The path that could not be resolved.
+ *
+ *  @return The `NSException` instance.
+ */
++ (NSException *)tbsm_unmaterializedPath:(NSString *)path;
+
+/**
+ *  Thrown when a history is contained in a state which is neither a `TBSMSubState` nor a `TBSMParallelState`.
+ *
+ *  @param historyName The name of the history.
+ *  @param stateName   The name of the containing state.
+ *
+ *  @return The `NSException` instance.
+ */
++ (NSException *)tbsm_noCompositeContainingStateException:(NSString *)historyName stateName:(NSString *)stateName;
+
 @end
 NS_ASSUME_NONNULL_END
@@ -25,6 +25,8 @@ static NSString * const TBSMAmbiguousCompoundTransitionAttributesReason = @"Ambi
 static NSString * const TBSMNoOutgoingJunctionPathReason = @"No outgoing path determined for junction '%@'.";
 static NSString * const TBSMNoSerialQueueExceptionReason = @"The specified queue is not a serial queue '%@'.";
 static NSString * const TBSMInvalidPathExceptionReason = @"Invalid path: '%@'.";
+static NSString * const TBSMUnmaterializedPathExceptionReason = @"Path '%@' leads into deferred contents which have not been built yet.";
+static NSString * const TBSMNoCompositeContainingStateExceptionReason = @"History '%@' must be contained in a sub or parallel state but '%@' is neither.";
 
 @implementation NSException (TBStateMachine)
 
@@ -98,4 +100,14 @@ static NSString * const TBSMInvalidPathExceptionReason = @"Invalid path: '%@'.";
     return [NSException exceptionWithName:TBSMException reason:[NSString stringWithFormat:TBSMInvalidPathExceptionReason, path] userInfo:nil];
 }
 
++ (NSException *)tbsm_unmaterializedPath:(NSString *)path
+{
+    return [NSException exceptionWithName:TBSMException reason:[NSString stringWithFormat:TBSMUnmaterializedPathExceptionReason, path] userInfo:nil];
+}
+
++ (NSException *)tbsm_noCompositeContainingStateException:(NSString *)historyName stateName:(NSString *)stateName
+{
+    return [NSException exceptionWithName:TBSMException reason:[NSString stringWithFormat:TBSMNoCompositeContainingStateExceptionReason, historyName, stateName] userInfo:nil];
+}
+
 @end
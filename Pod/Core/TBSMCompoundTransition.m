@@ -12,9 +12,10 @@
 #import "TBSMFork.h"
 #import "TBSMJoin.h"
 #import "TBSMJunction.h"
+#import "TBSMHistory.h"
 
 @interface TBSMCompoundTransition ()
-
+@property (nonatomic, strong) TBSMJunctionPath *priv_outgoingPath;
 @end
 
 @implementation TBSMCompoundTransition
@@ -56,6 +57,10 @@
         source = self.sourceState.name;
         target = [NSString stringWithFormat:@"[%@]", [[junction.targetStates valueForKeyPath:@"name"] componentsJoinedByString:@","]];
     }
+    if ([self.targetPseudoState isKindOfClass:[TBSMHistory class]]) {
+        source = self.sourceState.name;
+        target = self.targetState.name;
+    }
     return [NSString stringWithFormat:@"%@ --> %@ --> %@", source, self.targetPseudoState.name, target];
 }
 
@@ -63,59 +68,117 @@
 {
     if ([self canPerformTransitionWithData:data]) {
         if ([self.targetPseudoState isKindOfClass:[TBSMFork class]]) {
-            [self _performForkTransitionWithData:data];
+            return [self _performForkTransitionWithData:data];
         } else if ([self.targetPseudoState isKindOfClass:[TBSMJoin class]]) {
-            [self _performJoinTransitionWithData:data];
+            return [self _performJoinTransitionWithData:data];
         } else if ([self.targetPseudoState isKindOfClass:[TBSMJunction class]]) {
-            [self _performJunctionTransitionWithData:data];
+            return [self _performJunctionTransitionWithData:data];
+        } else if ([self.targetPseudoState isKindOfClass:[TBSMHistory class]]) {
+            return [self _performHistoryTransitionWithData:data];
         }
         return YES;
     }
     return NO;
 }
 
-- (void)_performForkTransitionWithData:(id)data
+- (BOOL)_performForkTransitionWithData:(id)data
 {
     TBSMFork *fork = (TBSMFork *)self.targetPseudoState;
-    [self _validatePseudoState:fork states:fork.targetStates region:fork.region];
+    if (![self _validatePseudoState:fork states:fork.targetStates region:fork.region]) {
+        return NO;
+    }
     TBSMStateMachine *lca = [self findLeastCommonAncestor];
-    [lca switchState:self.sourceState targetStates:fork.targetStates region:(TBSMParallelState *)fork.targetState action:self.action data:data];
+    if (!lca) {
+        return NO;
+    }
+    [lca switchState:self.sourceState targetStates:fork.targetStates region:(TBSMParallelState *)fork.targetState transition:self data:data];
+    return YES;
 }
 
-- (void)_performJoinTransitionWithData:(id)data
+- (BOOL)_performJoinTransitionWithData:(id)data
 {
     TBSMJoin *join = (TBSMJoin *)self.targetPseudoState;
-    [self _validatePseudoState:join states:join.sourceStates region:join.region];
+    if (![self _validatePseudoState:join states:join.sourceStates region:join.region]) {
+        return NO;
+    }
     if ([join joinSourceState:self.sourceState]) {
         TBSMStateMachine *lca = [self findLeastCommonAncestor];
+        if (!lca) {
+            return NO;
+        }
         [lca switchState:self.sourceState targetState:self.targetState action:nil data:data];
     }
+    return YES;
 }
 
-- (void)_performJunctionTransitionWithData:(id)data
+- (BOOL)_performJunctionTransitionWithData:(id)data
 {
     TBSMJunction *junction = (TBSMJunction *)self.targetPseudoState;
     TBSMJunctionPath *outgoingPath = [junction outgoingPathForTransition:self.sourceState data:data];
+    if (!outgoingPath) {
+        return NO;
+    }
     self.targetState = outgoingPath.targetState;
     TBSMStateMachine *lca = [self findLeastCommonAncestor];
-    TBSMActionBlock compoundAction = ^(id data) {
-        if (self.action) {
-            self.action(data);
-        }
-        if (outgoingPath.action) {
-            outgoingPath.action(data);
-        }
-    };
-    [lca switchState:self.sourceState targetState:self.targetState action:compoundAction data:data];
+    if (!lca) {
+        return NO;
+    }
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    uint64_t start = [profiler beginCallback];
+    self.priv_outgoingPath = outgoingPath;
+    [lca switchState:self.sourceState targetState:self.targetState transition:self data:data];
+    self.priv_outgoingPath = nil;
+    [profiler endTransition:(__bridge const void *)outgoingPath start:start performed:YES name:^NSString *{
+        return [NSString stringWithFormat:@"%@ --> %@", self.targetPseudoState.name, outgoingPath.targetState.name];
+    }];
+    return YES;
+}
+
+- (BOOL)_performHistoryTransitionWithData:(id)data
+{
+    TBSMHistory *history = (TBSMHistory *)self.targetPseudoState;
+    TBSMStateMachine *lca = [self findLeastCommonAncestor];
+    if (!lca) {
+        return NO;
+    }
+    [history prepareRestore];
+    [lca switchState:self.sourceState targetState:self.targetState transition:self data:data];
+    return YES;
+}
+
+- (void)performActionWithData:(id)data
+{
+    [super performActionWithData:data];
+    
+    TBSMJunctionPath *outgoingPath = self.priv_outgoingPath;
+    if (outgoingPath.action == nil && outgoingPath.actionFunction == NULL) {
+        return;
+    }
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    uint64_t start = [profiler beginCallback];
+    if (outgoingPath.action) {
+        outgoingPath.action(data);
+    }
+    if (outgoingPath.actionFunction) {
+        outgoingPath.actionFunction(data, outgoingPath.context);
+    }
+    [profiler endCallback:TBSMProfileCategoryAction key:(__bridge const void *)outgoingPath start:start name:^NSString *{
+        return [NSString stringWithFormat:@"%@ --> %@", self.targetPseudoState.name, outgoingPath.targetState.name];
+    }];
 }
 
-- (void)_validatePseudoState:(TBSMPseudoState *)pseudoState states:(NSArray *)states region:(TBSMParallelState *)region
+- (BOOL)_validatePseudoState:(TBSMPseudoState *)pseudoState states:(NSArray *)states region:(TBSMParallelState *)region
 {
     for (TBSMState *state in states) {
-        if (![state.path containsObject:region]) {
-            @throw [NSException tbsm_ambiguousCompoundTransitionAttributes:pseudoState.name];
+        if (!TBSMHierarchyVertexIsContainedIn(state, region)) {
+            TBSMStateMachine *stateMachine = (TBSMStateMachine *)self.sourceState.parentVertex;
+            if (![stateMachine reportError:[NSError tbsm_ambiguousCompoundTransitionAttributesError:pseudoState.name]]) {
+                @throw [NSException tbsm_ambiguousCompoundTransitionAttributes:pseudoState.name];
+            }
+            return NO;
         }
     }
+    return YES;
 }
 
 @end
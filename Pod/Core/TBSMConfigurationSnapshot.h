@@ -0,0 +1,55 @@
+//
+//  TBSMConfigurationSnapshot.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class represents the immutable active state configuration of a state machine after a completed run-to-completion step.
+ *
+ *  Snapshots only contain paths, so they can be read from any thread.
+ */
+@interface TBSMConfigurationSnapshot : NSObject
+
+/**
+ *  The configuration version of the state machine. Increases with every change of the active state configuration.
+ */
+@property (nonatomic, assign, readonly) NSUInteger version;
+
+/**
+ *  The paths of all active states in depth first order.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *activeStatePaths;
+
+/**
+ *  The paths of all active states which do not contain other states.
+ */
+@property (nonatomic, copy, readonly) NSArray<NSString *> *activeLeafStatePaths;
+
+/**
+ *  Creates a snapshot.
+ *
+ *  @param version              The configuration version.
+ *  @param activeStatePaths     The paths of all active states.
+ *  @param activeLeafStatePaths The paths of all active leaf states.
+ *
+ *  @return The snapshot instance.
+ */
+- (instancetype)initWithVersion:(NSUInteger)version activeStatePaths:(NSArray<NSString *> *)activeStatePaths activeLeafStatePaths:(NSArray<NSString *> *)activeLeafStatePaths;
+
+/**
+ *  Returns `YES` if the state at the specified path was active when the snapshot was taken.
+ *
+ *  Unknown paths are reported as inactive.
+ *
+ *  @param path The specified path.
+ *
+ *  @return `YES` if the state is active.
+ */
+- (BOOL)isActiveAtPath:(NSString *)path;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,31 @@
+//
+//  TBSMConfigurationSnapshot.m
+//  TBStateMachine
+//
+
+#import "TBSMConfigurationSnapshot.h"
+
+@interface TBSMConfigurationSnapshot ()
+@property (nonatomic, strong) NSSet<NSString *> *priv_activeStatePaths;
+@end
+
+@implementation TBSMConfigurationSnapshot
+
+- (instancetype)initWithVersion:(NSUInteger)version activeStatePaths:(NSArray<NSString *> *)activeStatePaths activeLeafStatePaths:(NSArray<NSString *> *)activeLeafStatePaths
+{
+    self = [super init];
+    if (self) {
+        _version = version;
+        _activeStatePaths = activeStatePaths.copy;
+        _activeLeafStatePaths = activeLeafStatePaths.copy;
+        _priv_activeStatePaths = [NSSet setWithArray:activeStatePaths];
+    }
+    return self;
+}
+
+- (BOOL)isActiveAtPath:(NSString *)path
+{
+    return [self.priv_activeStatePaths containsObject:path];
+}
+
+@end
@@ -0,0 +1,111 @@
+//
+//  TBSMDeferredContent.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class TBSMState;
+@class TBSMStateMachine;
+
+/**
+ *  This type represents a block that configures the contents of a containing state on demand.
+ *
+ *  @param state The `TBSMSubState` or `TBSMParallelState` to configure.
+ */
+typedef void (^TBSMDeferredConfigurationBlock)(__kindof TBSMState *state);
+
+/**
+ *  This class manages the deferred construction and release of the state machines
+ *  contained in a `TBSMSubState` or `TBSMParallelState`.
+ *
+ *  Subscriptions to states inside the deferred state machines are recorded by path
+ *  and applied whenever the state machines are built.
+ */
+@interface TBSMDeferredContent : NSObject
+
+/**
+ *  The time in seconds after which the state machines will be released once the containing state has been exited.
+ *
+ *  Defaults to `0` which keeps the state machines once they have been built.
+ */
+@property (nonatomic, assign) NSTimeInterval releaseInterval;
+
+/**
+ *  `YES` while the configuration block is being executed.
+ */
+@property (nonatomic, assign, readonly, getter=isMaterializing) BOOL materializing;
+
+/**
+ *  Creates a `TBSMDeferredContent` instance with a specified configuration block.
+ *
+ *  @param configuration The block which configures the containing state.
+ *
+ *  @return A new `TBSMDeferredContent` instance.
+ */
+- (instancetype)initWithConfiguration:(TBSMDeferredConfigurationBlock)configuration;
+
+/**
+ *  Executes the configuration block on the specified containing state.
+ *
+ *  @param state The containing state.
+ */
+- (void)materializeState:(TBSMState *)state;
+
+/**
+ *  Applies all recorded subscriptions to the built state machines and rebuilds the index of the active state configuration.
+ *
+ *  @param stateMachines The state machines of the containing state.
+ *  @param state         The containing state.
+ */
+- (void)state:(TBSMState *)state didMaterializeStateMachines:(NSArray<TBSMStateMachine *> *)stateMachines;
+
+/**
+ *  Records a subscription to a notification of a state inside a deferred state machine.
+ *
+ *  @param observer      The observer.
+ *  @param selector      The selector to call on the observer.
+ *  @param name          The notification name.
+ *  @param path          The path of the state relative to the region.
+ *  @param region        The index of the region.
+ *  @param stateMachines The state machines of the containing state if they have been built.
+ */
+- (void)addObserver:(NSObject *)observer selector:(SEL)selector name:(NSString *)name path:(NSString *)path region:(NSUInteger)region stateMachines:(nullable NSArray<TBSMStateMachine *> *)stateMachines;
+
+/**
+ *  Removes a subscription recorded via `-addObserver:selector:name:path:region:stateMachines:`.
+ *
+ *  @param observer      The observer.
+ *  @param name          The notification name.
+ *  @param path          The path of the state relative to the region.
+ *  @param region        The index of the region.
+ *  @param stateMachines The state machines of the containing state if they have been built.
+ */
+- (void)removeObserver:(NSObject *)observer name:(NSString *)name path:(NSString *)path region:(NSUInteger)region stateMachines:(nullable NSArray<TBSMStateMachine *> *)stateMachines;
+
+/**
+ *  Cancels a pending release of the state machines.
+ */
+- (void)cancelRelease;
+
+/**
+ *  Schedules the release of the state machines after `releaseInterval` on the queue of the top state machine.
+ *
+ *  The release will be skipped when the containing state has been entered again in the meantime.
+ *
+ *  @param state        The containing state.
+ *  @param releaseBlock The block which releases the state machines.
+ */
+- (void)scheduleReleaseOfState:(TBSMState *)state releaseBlock:(void (^)(void))releaseBlock;
+
+/**
+ *  Removes all recorded subscriptions from the state machines before they will be released.
+ *
+ *  @param stateMachines The state machines of the containing state.
+ */
+- (void)removeSubscriptionsFromStateMachines:(NSArray<TBSMStateMachine *> *)stateMachines;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,137 @@
+//
+//  TBSMDeferredContent.m
+//  TBStateMachine
+//
+
+#import "TBSMDeferredContent.h"
+#import "TBSMStateMachine.h"
+
+@interface TBSMDeferredSubscription : NSObject
+@property (nonatomic, weak) NSObject *observer;
+@property (nonatomic, assign) SEL selector;
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, copy) NSString *path;
+@property (nonatomic, assign) NSUInteger region;
+@end
+
+@implementation TBSMDeferredSubscription
+@end
+
+@interface TBSMDeferredContent ()
+@property (nonatomic, copy) TBSMDeferredConfigurationBlock priv_configuration;
+@property (nonatomic, strong) NSMutableArray<TBSMDeferredSubscription *> *priv_subscriptions;
+@property (nonatomic, assign) NSUInteger priv_releaseGeneration;
+@property (nonatomic, assign, readwrite, getter=isMaterializing) BOOL materializing;
+@end
+
+@implementation TBSMDeferredContent
+
+- (instancetype)initWithConfiguration:(TBSMDeferredConfigurationBlock)configuration
+{
+    self = [super init];
+    if (self) {
+        _priv_configuration = [configuration copy];
+        _priv_subscriptions = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)materializeState:(TBSMState *)state
+{
+    self.materializing = YES;
+    self.priv_configuration(state);
+    self.materializing = NO;
+}
+
+- (void)state:(TBSMState *)state didMaterializeStateMachines:(NSArray<TBSMStateMachine *> *)stateMachines
+{
+    for (TBSMDeferredSubscription *subscription in self.priv_subscriptions.copy) {
+        [self _applySubscription:subscription toStateMachines:stateMachines];
+    }
+    [(TBSMStateMachine *)state.parentVertex invalidateStateIndex];
+}
+
+- (void)addObserver:(NSObject *)observer selector:(SEL)selector name:(NSString *)name path:(NSString *)path region:(NSUInteger)region stateMachines:(NSArray<TBSMStateMachine *> *)stateMachines
+{
+    TBSMDeferredSubscription *subscription = [TBSMDeferredSubscription new];
+    subscription.observer = observer;
+    subscription.selector = selector;
+    subscription.name = name;
+    subscription.path = path;
+    subscription.region = region;
+    [self.priv_subscriptions addObject:subscription];
+
+    if (stateMachines) {
+        [self _applySubscription:subscription toStateMachines:stateMachines];
+    }
+}
+
+- (void)removeObserver:(NSObject *)observer name:(NSString *)name path:(NSString *)path region:(NSUInteger)region stateMachines:(NSArray<TBSMStateMachine *> *)stateMachines
+{
+    NSIndexSet *indexes = [self.priv_subscriptions indexesOfObjectsPassingTest:^BOOL(TBSMDeferredSubscription *subscription, NSUInteger idx, BOOL *stop) {
+        return (subscription.observer == observer || subscription.observer == nil) &&
+        [subscription.name isEqualToString:name] &&
+        [subscription.path isEqualToString:path] &&
+        subscription.region == region;
+    }];
+    [self.priv_subscriptions removeObjectsAtIndexes:indexes];
+
+    if (region < stateMachines.count) {
+        [stateMachines[region] unsubscribeFromAction:name atPath:path forObserver:observer];
+    }
+}
+
+- (void)cancelRelease
+{
+    self.priv_releaseGeneration++;
+}
+
+- (void)scheduleReleaseOfState:(TBSMState *)state releaseBlock:(void (^)(void))releaseBlock
+{
+    if (self.releaseInterval <= 0) {
+        return;
+    }
+    NSUInteger generation = ++self.priv_releaseGeneration;
+    TBSMStateMachine *topStateMachine = state.path.firstObject;
+
+    __weak typeof(self) weakSelf = self;
+    __weak TBSMState *weakState = state;
+    __weak TBSMStateMachine *weakTopStateMachine = topStateMachine;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.releaseInterval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [weakTopStateMachine.scheduledEventsQueue addOperationWithBlock:^{
+            TBSMDeferredContent *strongSelf = weakSelf;
+            TBSMState *strongState = weakState;
+            if (strongSelf == nil || strongState == nil || strongSelf.priv_releaseGeneration != generation) {
+                return;
+            }
+            if ([weakTopStateMachine isActive:strongState]) {
+                return;
+            }
+            releaseBlock();
+        }];
+    });
+}
+
+- (void)removeSubscriptionsFromStateMachines:(NSArray<TBSMStateMachine *> *)stateMachines
+{
+    for (TBSMDeferredSubscription *subscription in self.priv_subscriptions) {
+        NSObject *observer = subscription.observer;
+        if (observer && subscription.region < stateMachines.count) {
+            [stateMachines[subscription.region] unsubscribeFromAction:subscription.name atPath:subscription.path forObserver:observer];
+        }
+    }
+}
+
+- (void)_applySubscription:(TBSMDeferredSubscription *)subscription toStateMachines:(NSArray<TBSMStateMachine *> *)stateMachines
+{
+    NSObject *observer = subscription.observer;
+    if (observer == nil) {
+        [self.priv_subscriptions removeObject:subscription];
+        return;
+    }
+    if (subscription.region < stateMachines.count) {
+        [stateMachines[subscription.region] subscribeToAction:subscription.name atPath:subscription.path forObserver:observer selector:subscription.selector];
+    }
+}
+
+@end
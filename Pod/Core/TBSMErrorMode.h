@@ -0,0 +1,25 @@
+//
+//  TBSMErrorMode.h
+//  TBStateMachine
+//
+
+#ifndef Pods_TBSMErrorMode_h
+#define Pods_TBSMErrorMode_h
+
+/**
+ *  This enum defines how a state machine reports failures which occur while handling events or entering states.
+ *
+ *  Failures during configuration are always reported by throwing a `TBSMException`.
+ */
+typedef NS_ENUM(NSUInteger, TBSMErrorMode) {
+    /**
+     *  Runtime failures throw a `TBSMException`.
+     */
+    TBSMErrorModeThrow,
+    /**
+     *  Runtime failures are reported as `NSError` to the error handler of the state machine.
+     */
+    TBSMErrorModeReport
+};
+
+#endif
@@ -8,6 +8,8 @@
 
 #import <Foundation/Foundation.h>
 
+#import "TBSMEventPriority.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 /**
@@ -25,6 +27,49 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, strong, nullable) id data;
 
+/**
+ *  The priority lane the event will be scheduled in. Defaults to `TBSMEventPriorityNormal`.
+ */
+@property (nonatomic, assign) TBSMEventPriority priority;
+
+/**
+ *  Optional point in time after which the event is discarded instead of being handled.
+ */
+@property (nonatomic, strong, nullable) NSDate *deadline;
+
+/**
+ *  A process-wide unique identifier assigned when the event is created.
+ */
+@property (nonatomic, assign, readonly) uint64_t identifier;
+
+/**
+ *  The system uptime in seconds at which the event has been scheduled or raised. `0` until then.
+ *
+ *  Set by the state machine. Events passed to `-handleEvent:` directly are stamped when they are handled for the first time.
+ */
+@property (nonatomic, assign) NSTimeInterval enqueueTime;
+
+/**
+ *  The identifier of the event whose run-to-completion step has scheduled or raised this event. `0` if there is none.
+ *
+ *  Set by the state machine.
+ */
+@property (nonatomic, assign) uint64_t parentIdentifier;
+
+/**
+ *  The identifier of the first event of the causal chain this event belongs to. Equals `identifier` for events without parent.
+ *
+ *  Set by the state machine.
+ */
+@property (nonatomic, assign) uint64_t rootIdentifier;
+
+/**
+ *  The `enqueueTime` of the first event of the causal chain this event belongs to.
+ *
+ *  Set by the state machine.
+ */
+@property (nonatomic, assign) NSTimeInterval rootEnqueueTime;
+
 /**
  *  Creates a `TBSMEvent` instance from a given name.
  *
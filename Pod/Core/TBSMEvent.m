@@ -9,6 +9,8 @@
 #import "TBSMEvent.h"
 #import "NSException+TBStateMachine.h"
 
+static uint64_t TBSMEventNextIdentifier = 0;
+
 @implementation TBSMEvent
 
 + (instancetype)eventWithName:(NSString *)name data:(id)data
@@ -25,6 +27,9 @@
     if (self) {
         _name = name.copy;
         _data = data;
+        _priority = TBSMEventPriorityNormal;
+        _identifier = __atomic_add_fetch(&TBSMEventNextIdentifier, 1, __ATOMIC_RELAXED);
+        _rootIdentifier = _identifier;
     }
     return self;
 }
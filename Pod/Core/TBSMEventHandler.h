@@ -43,6 +43,26 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, copy, nullable) TBSMGuardBlock guard;
 
+/**
+ *  The action function of the transition triggered by the event.
+ */
+@property (nonatomic, assign, nullable) TBSMActionFunction actionFunction;
+
+/**
+ *  The guard function of the transition triggered by the event.
+ */
+@property (nonatomic, assign, nullable) TBSMGuardFunction guardFunction;
+
+/**
+ *  The context pointer passed to action and guard function. Not retained.
+ */
+@property (nonatomic, assign, nullable) void *context;
+
+/**
+ *  The asynchronous action of the transition triggered by the event.
+ */
+@property (nonatomic, copy, nullable) TBSMAsyncActionBlock asyncAction;
+
 /**
  *  Initializes a `TBSMEventHandler` from a given event name, target, action and guard.
  *
@@ -58,5 +78,21 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (instancetype)initWithName:(NSString *)name target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind action:(nullable TBSMActionBlock)action guard:(nullable TBSMGuardBlock)guard;
 
+/**
+ *  Initializes a `TBSMEventHandler` from a given event name, target, action function, guard function and context.
+ *
+ *  Throws a `TBSMException` when name is nil or an empty string.
+ *
+ *  @param name           The name of this event. Must be unique.
+ *  @param target         The target vertex.
+ *  @param kind           The kind of transition.
+ *  @param actionFunction The action function.
+ *  @param guardFunction  The guard function.
+ *  @param context        The context pointer passed to both functions.
+ *
+ *  @return An initialized `TBSMEventHandler` instance.
+ */
+- (instancetype)initWithName:(NSString *)name target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind actionFunction:(nullable TBSMActionFunction)actionFunction guardFunction:(nullable TBSMGuardFunction)guardFunction context:(nullable void *)context;
+
 @end
 NS_ASSUME_NONNULL_END
@@ -28,4 +28,15 @@
     return self;
 }
 
+- (instancetype)initWithName:(NSString *)name target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind actionFunction:(TBSMActionFunction)actionFunction guardFunction:(TBSMGuardFunction)guardFunction context:(void *)context
+{
+    self = [self initWithName:name target:target kind:kind action:nil guard:nil];
+    if (self) {
+        self.actionFunction = actionFunction;
+        self.guardFunction = guardFunction;
+        self.context = context;
+    }
+    return self;
+}
+
 @end
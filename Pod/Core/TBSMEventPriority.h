@@ -0,0 +1,20 @@
+//
+//  TBSMEventPriority.h
+//  TBStateMachine
+//
+
+#ifndef Pods_TBSMEventPriority_h
+#define Pods_TBSMEventPriority_h
+
+/**
+ *  This enum defines the priority lanes an event can be scheduled in.
+ *
+ *  Higher lanes will be drained first. Events inside the same lane are handled in FIFO order.
+ */
+typedef NS_ENUM(NSUInteger, TBSMEventPriority) {
+    TBSMEventPriorityLow,
+    TBSMEventPriorityNormal,
+    TBSMEventPriorityHigh
+};
+
+#endif
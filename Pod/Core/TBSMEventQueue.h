@@ -0,0 +1,200 @@
+//
+//  TBSMEventQueue.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+#import "TBSMEvent.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This enum defines how a bounded `TBSMEventQueue` reacts when an event is added at full capacity.
+ */
+typedef NS_ENUM(NSUInteger, TBSMEventQueueOverflowPolicy) {
+    /**
+     *  The producer is blocked until the queue has room for the event.
+     *  Falls back to `TBSMEventQueueOverflowReject` when blocking is not allowed.
+     */
+    TBSMEventQueueOverflowBlock,
+    /**
+     *  The event is not added and `TBSMEventQueueStatusRejected` is returned.
+     */
+    TBSMEventQueueOverflowReject,
+    /**
+     *  The oldest event of the lowest non-empty lane is discarded to make room for the event.
+     */
+    TBSMEventQueueOverflowDropOldest,
+    /**
+     *  The event is discarded and `TBSMEventQueueStatusDropped` is returned.
+     */
+    TBSMEventQueueOverflowDropNewest
+};
+
+/**
+ *  This enum defines how a new event replaces a pending event of the same name.
+ */
+typedef NS_ENUM(NSUInteger, TBSMEventCoalescingPolicy) {
+    /**
+     *  Events are not coalesced.
+     */
+    TBSMEventCoalescingNone,
+    /**
+     *  The pending event keeps its position in the queue.
+     */
+    TBSMEventCoalescingKeepPosition,
+    /**
+     *  The pending event is moved to the tail of its lane.
+     */
+    TBSMEventCoalescingMoveToTail
+};
+
+/**
+ *  This enum describes the outcome of adding an event to a `TBSMEventQueue`.
+ */
+typedef NS_ENUM(NSUInteger, TBSMEventQueueStatus) {
+    TBSMEventQueueStatusEnqueued,
+    TBSMEventQueueStatusRejected,
+    TBSMEventQueueStatusDropped,
+    TBSMEventQueueStatusCoalesced
+};
+
+/**
+ *  This type represents the block which is notified about a pending event that has been discarded
+ *  because it was dropped to make room for a newer event or had expired on dequeue.
+ */
+typedef void(^TBSMEventQueueDiscardBlock)(TBSMEvent *event);
+
+/**
+ *  This class represents the buffer of pending events of a `TBSMStateMachine`.
+ *
+ *  Events are stored in one FIFO lane per `TBSMEventPriority`. Higher lanes are drained first.
+ *  All methods are thread safe.
+ */
+@interface TBSMEventQueue : NSObject
+
+/**
+ *  The number of times a non-empty lane may be passed over before it will be served regardless of its priority.
+ *  Defaults to `0` which disables the starvation guard.
+ */
+@property (nonatomic, assign) NSUInteger starvationLimit;
+
+/**
+ *  The maximum number of pending events. Defaults to `0` which means the queue is unbounded.
+ */
+@property (nonatomic, assign) NSUInteger capacity;
+
+/**
+ *  The policy to apply when an event is added at full capacity. Defaults to `TBSMEventQueueOverflowReject`.
+ */
+@property (nonatomic, assign) TBSMEventQueueOverflowPolicy overflowPolicy;
+
+/**
+ *  Optional block which is called for every pending event that is discarded by `TBSMEventQueueOverflowDropOldest`
+ *  or because its deadline had passed. Called on the thread which has discarded the event, outside of the queue's lock.
+ */
+@property (atomic, copy, nullable) TBSMEventQueueDiscardBlock discardBlock;
+
+/**
+ *  The number of events which have been added to the queue.
+ */
+@property (nonatomic, assign, readonly) NSUInteger enqueuedCount;
+
+/**
+ *  The number of events which have been rejected at full capacity.
+ */
+@property (nonatomic, assign, readonly) NSUInteger rejectedCount;
+
+/**
+ *  The number of pending events which have been discarded to make room for newer events.
+ */
+@property (nonatomic, assign, readonly) NSUInteger droppedOldestCount;
+
+/**
+ *  The number of new events which have been discarded at full capacity.
+ */
+@property (nonatomic, assign, readonly) NSUInteger droppedNewestCount;
+
+/**
+ *  The number of events which have been discarded on dequeue because their deadline had passed.
+ */
+@property (nonatomic, assign, readonly) NSUInteger expiredCount;
+
+/**
+ *  The number of times a producer had to wait for the queue to make room.
+ */
+@property (nonatomic, assign, readonly) NSUInteger blockedCount;
+
+/**
+ *  The number of events which have been merged into a pending event of the same name.
+ */
+@property (nonatomic, assign, readonly) NSUInteger coalescedCount;
+
+/**
+ *  Marks events of a given name as coalescable.
+ *
+ *  When an event of that name is added while another one of the same name is still pending in the same lane
+ *  the pending event takes over the new event's data and deadline instead of adding a new entry.
+ *
+ *  @param policy The coalescing policy. Pass `TBSMEventCoalescingNone` to stop coalescing.
+ *  @param name   The specified event name.
+ */
+- (void)setCoalescingPolicy:(TBSMEventCoalescingPolicy)policy forEventNamed:(NSString *)name;
+
+/**
+ *  Returns the coalescing policy for events of a given name.
+ *
+ *  @param name The specified event name.
+ *
+ *  @return The coalescing policy.
+ */
+- (TBSMEventCoalescingPolicy)coalescingPolicyForEventNamed:(NSString *)name;
+
+/**
+ *  Adds an event to the lane matching its priority. Blocks the caller when the policy says so.
+ *
+ *  @param event The given `TBSMEvent` instance.
+ *
+ *  @return The outcome of the operation.
+ */
+- (TBSMEventQueueStatus)enqueueEvent:(TBSMEvent *)event;
+
+/**
+ *  Adds an event to the lane matching its priority.
+ *
+ *  @param event         The given `TBSMEvent` instance.
+ *  @param allowBlocking `NO` if the caller must not be blocked at full capacity, e.g. because it runs on the queue's consumer.
+ *
+ *  @return The outcome of the operation.
+ */
+- (TBSMEventQueueStatus)enqueueEvent:(TBSMEvent *)event allowBlocking:(BOOL)allowBlocking;
+
+/**
+ *  Removes and returns the next event to handle. Discards all expired events on the way.
+ *
+ *  @return The next event or `nil` if the queue is empty.
+ */
+- (nullable TBSMEvent *)dequeueEvent;
+
+/**
+ *  Returns all pending events in the order they will be dequeued when no starvation guard kicks in.
+ *
+ *  @return An array containing the pending `TBSMEvent` instances.
+ */
+- (NSArray<TBSMEvent *> *)events;
+
+/**
+ *  The number of pending events.
+ *
+ *  @return The number of events.
+ */
+- (NSUInteger)count;
+
+/**
+ *  Removes all pending events and wakes up all blocked producers.
+ */
+- (void)removeAllEvents;
+
+@end
+NS_ASSUME_NONNULL_END
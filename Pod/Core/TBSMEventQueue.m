@@ -0,0 +1,343 @@
+//
+//  TBSMEventQueue.m
+//  TBStateMachine
+//
+
+#import "TBSMEventQueue.h"
+
+static const NSUInteger TBSMEventPriorityCount = TBSMEventPriorityHigh + 1;
+
+@interface TBSMEventQueue ()
+@property (nonatomic, strong) NSArray<NSMutableArray<TBSMEvent *> *> *priv_lanes;
+@property (nonatomic, strong) NSCondition *priv_condition;
+@property (nonatomic, assign) NSUInteger priv_count;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *priv_coalescingPolicies;
+@property (nonatomic, strong) NSArray<NSMutableDictionary<NSString *, TBSMEvent *> *> *priv_coalescableEvents;
+@end
+
+@implementation TBSMEventQueue
+{
+    NSUInteger _skipCounts[TBSMEventPriorityCount];
+    NSUInteger _enqueuedCount;
+    NSUInteger _rejectedCount;
+    NSUInteger _droppedOldestCount;
+    NSUInteger _droppedNewestCount;
+    NSUInteger _expiredCount;
+    NSUInteger _blockedCount;
+    NSUInteger _coalescedCount;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        NSMutableArray *lanes = [NSMutableArray new];
+        NSMutableArray *coalescableEvents = [NSMutableArray new];
+        for (NSUInteger i = 0; i < TBSMEventPriorityCount; i++) {
+            [lanes addObject:[NSMutableArray new]];
+            [coalescableEvents addObject:[NSMutableDictionary new]];
+        }
+        _priv_lanes = lanes.copy;
+        _priv_coalescableEvents = coalescableEvents.copy;
+        _priv_coalescingPolicies = [NSMutableDictionary new];
+        _priv_condition = [NSCondition new];
+        _overflowPolicy = TBSMEventQueueOverflowReject;
+    }
+    return self;
+}
+
+- (TBSMEventQueueStatus)enqueueEvent:(TBSMEvent *)event
+{
+    return [self enqueueEvent:event allowBlocking:YES];
+}
+
+- (TBSMEventQueueStatus)enqueueEvent:(TBSMEvent *)event allowBlocking:(BOOL)allowBlocking
+{
+    [self.priv_condition lock];
+    
+    TBSMEvent *droppedEvent = nil;
+    if ([self _coalesceEvent:event]) {
+        _coalescedCount++;
+        [self.priv_condition unlock];
+        return TBSMEventQueueStatusCoalesced;
+    }
+    if ([self _isFull]) {
+        TBSMEventQueueOverflowPolicy policy = self.overflowPolicy;
+        if (policy == TBSMEventQueueOverflowBlock && !allowBlocking) {
+            policy = TBSMEventQueueOverflowReject;
+        }
+        switch (policy) {
+            case TBSMEventQueueOverflowBlock:
+                _blockedCount++;
+                while ([self _isFull]) {
+                    [self.priv_condition wait];
+                }
+                break;
+            case TBSMEventQueueOverflowReject:
+                _rejectedCount++;
+                [self.priv_condition unlock];
+                return TBSMEventQueueStatusRejected;
+            case TBSMEventQueueOverflowDropOldest:
+                _droppedOldestCount++;
+                droppedEvent = [self _removeOldestEvent];
+                break;
+            case TBSMEventQueueOverflowDropNewest:
+                _droppedNewestCount++;
+                [self.priv_condition unlock];
+                return TBSMEventQueueStatusDropped;
+        }
+    }
+    NSUInteger lane = [self _laneForPriority:event.priority];
+    [self.priv_lanes[lane] addObject:event];
+    if (self.priv_coalescingPolicies[event.name]) {
+        self.priv_coalescableEvents[lane][event.name] = event;
+    }
+    self.priv_count++;
+    _enqueuedCount++;
+    
+    [self.priv_condition unlock];
+    
+    if (droppedEvent) {
+        [self _discardEvents:@[droppedEvent]];
+    }
+    return TBSMEventQueueStatusEnqueued;
+}
+
+- (TBSMEvent *)dequeueEvent
+{
+    [self.priv_condition lock];
+    
+    TBSMEvent *event = nil;
+    NSMutableArray *expiredEvents = nil;
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    while (event == nil) {
+        NSInteger lane = [self _nextLane];
+        if (lane == NSNotFound) {
+            break;
+        }
+        [self _updateSkipCountsForServedLane:lane];
+        
+        event = [self _removeFirstEventInLane:lane];
+        
+        if (event.deadline && event.deadline.timeIntervalSinceReferenceDate < now) {
+            _expiredCount++;
+            expiredEvents = expiredEvents ?: [NSMutableArray new];
+            [expiredEvents addObject:event];
+            event = nil;
+        }
+    }
+    [self.priv_condition broadcast];
+    [self.priv_condition unlock];
+    
+    if (expiredEvents) {
+        [self _discardEvents:expiredEvents];
+    }
+    return event;
+}
+
+- (NSUInteger)enqueuedCount
+{
+    return [self _valueOfCounter:&_enqueuedCount];
+}
+
+- (NSUInteger)rejectedCount
+{
+    return [self _valueOfCounter:&_rejectedCount];
+}
+
+- (NSUInteger)droppedOldestCount
+{
+    return [self _valueOfCounter:&_droppedOldestCount];
+}
+
+- (NSUInteger)droppedNewestCount
+{
+    return [self _valueOfCounter:&_droppedNewestCount];
+}
+
+- (NSUInteger)expiredCount
+{
+    return [self _valueOfCounter:&_expiredCount];
+}
+
+- (NSUInteger)blockedCount
+{
+    return [self _valueOfCounter:&_blockedCount];
+}
+
+- (NSUInteger)coalescedCount
+{
+    return [self _valueOfCounter:&_coalescedCount];
+}
+
+- (NSArray *)events
+{
+    [self.priv_condition lock];
+    NSMutableArray *events = [NSMutableArray new];
+    for (NSMutableArray *lane in self.priv_lanes.reverseObjectEnumerator) {
+        [events addObjectsFromArray:lane];
+    }
+    [self.priv_condition unlock];
+    return events;
+}
+
+- (NSUInteger)count
+{
+    [self.priv_condition lock];
+    NSUInteger count = self.priv_count;
+    [self.priv_condition unlock];
+    return count;
+}
+
+- (void)setCoalescingPolicy:(TBSMEventCoalescingPolicy)policy forEventNamed:(NSString *)name
+{
+    [self.priv_condition lock];
+    if (policy == TBSMEventCoalescingNone) {
+        [self.priv_coalescingPolicies removeObjectForKey:name];
+        for (NSMutableDictionary *coalescableEvents in self.priv_coalescableEvents) {
+            [coalescableEvents removeObjectForKey:name];
+        }
+    } else {
+        self.priv_coalescingPolicies[name] = @(policy);
+    }
+    [self.priv_condition unlock];
+}
+
+- (TBSMEventCoalescingPolicy)coalescingPolicyForEventNamed:(NSString *)name
+{
+    [self.priv_condition lock];
+    TBSMEventCoalescingPolicy policy = self.priv_coalescingPolicies[name].unsignedIntegerValue;
+    [self.priv_condition unlock];
+    return policy;
+}
+
+- (void)removeAllEvents
+{
+    [self.priv_condition lock];
+    for (NSUInteger i = 0; i < TBSMEventPriorityCount; i++) {
+        [self.priv_lanes[i] removeAllObjects];
+        [self.priv_coalescableEvents[i] removeAllObjects];
+        _skipCounts[i] = 0;
+    }
+    self.priv_count = 0;
+    [self.priv_condition broadcast];
+    [self.priv_condition unlock];
+}
+
+#pragma mark - private
+
+- (BOOL)_isFull
+{
+    return (self.capacity > 0 && self.priv_count >= self.capacity);
+}
+
+- (NSUInteger)_laneForPriority:(TBSMEventPriority)priority
+{
+    return MIN(priority, TBSMEventPriorityHigh);
+}
+
+/**
+ *  Reads a counter under the queue's lock. Counters are only written while the lock is held.
+ */
+- (NSUInteger)_valueOfCounter:(const NSUInteger *)counter
+{
+    [self.priv_condition lock];
+    NSUInteger value = *counter;
+    [self.priv_condition unlock];
+    return value;
+}
+
+- (void)_discardEvents:(NSArray<TBSMEvent *> *)events
+{
+    TBSMEventQueueDiscardBlock discardBlock = self.discardBlock;
+    if (discardBlock == nil) {
+        return;
+    }
+    for (TBSMEvent *event in events) {
+        discardBlock(event);
+    }
+}
+
+- (TBSMEvent *)_removeOldestEvent
+{
+    for (NSUInteger i = 0; i < TBSMEventPriorityCount; i++) {
+        if (self.priv_lanes[i].count > 0) {
+            return [self _removeFirstEventInLane:i];
+        }
+    }
+    return nil;
+}
+
+- (TBSMEvent *)_removeFirstEventInLane:(NSUInteger)lane
+{
+    NSMutableArray *events = self.priv_lanes[lane];
+    TBSMEvent *event = events.firstObject;
+    [events removeObjectAtIndex:0];
+    self.priv_count--;
+    
+    NSMutableDictionary *coalescableEvents = self.priv_coalescableEvents[lane];
+    if (coalescableEvents[event.name] == event) {
+        [coalescableEvents removeObjectForKey:event.name];
+    }
+    return event;
+}
+
+- (BOOL)_coalesceEvent:(TBSMEvent *)event
+{
+    TBSMEventCoalescingPolicy policy = self.priv_coalescingPolicies[event.name].unsignedIntegerValue;
+    if (policy == TBSMEventCoalescingNone) {
+        return NO;
+    }
+    NSUInteger lane = [self _laneForPriority:event.priority];
+    TBSMEvent *pendingEvent = self.priv_coalescableEvents[lane][event.name];
+    if (pendingEvent == nil) {
+        return NO;
+    }
+    pendingEvent.data = event.data;
+    pendingEvent.deadline = event.deadline;
+    
+    if (policy == TBSMEventCoalescingMoveToTail) {
+        NSMutableArray *events = self.priv_lanes[lane];
+        [events removeObjectIdenticalTo:pendingEvent];
+        [events addObject:pendingEvent];
+    }
+    return YES;
+}
+
+- (NSInteger)_nextLane
+{
+    NSInteger nextLane = NSNotFound;
+    for (NSInteger i = TBSMEventPriorityHigh; i >= 0; i--) {
+        if (self.priv_lanes[i].count > 0) {
+            nextLane = i;
+            break;
+        }
+    }
+    if (nextLane == NSNotFound || self.starvationLimit == 0) {
+        return nextLane;
+    }
+    
+    // Serve the lane which has been passed over the most once it reaches the limit.
+    NSInteger starvingLane = NSNotFound;
+    NSUInteger maxSkipCount = 0;
+    for (NSInteger i = nextLane - 1; i >= 0; i--) {
+        if (self.priv_lanes[i].count > 0 && _skipCounts[i] >= self.starvationLimit && _skipCounts[i] > maxSkipCount) {
+            starvingLane = i;
+            maxSkipCount = _skipCounts[i];
+        }
+    }
+    return (starvingLane != NSNotFound) ? starvingLane : nextLane;
+}
+
+- (void)_updateSkipCountsForServedLane:(NSInteger)servedLane
+{
+    for (NSInteger i = 0; i < TBSMEventPriorityCount; i++) {
+        if (i == servedLane || self.priv_lanes[i].count == 0) {
+            _skipCounts[i] = 0;
+        } else if (i < servedLane) {
+            _skipCounts[i]++;
+        }
+    }
+}
+
+@end
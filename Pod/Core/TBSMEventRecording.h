@@ -0,0 +1,31 @@
+//
+//  TBSMEventRecording.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMEventQueue.h"
+
+@class TBSMStateMachine;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This protocol describes an object which receives every event scheduled on a state machine.
+ */
+@protocol TBSMEventRecording <NSObject>
+
+/**
+ *  Called for every event scheduled on the state machine at the top of the hierarchy after the event queue has decided about it.
+ *
+ *  The event is already stamped, so `parentIdentifier` tells events scheduled from inside a run-to-completion step apart.
+ *  Can be called from any thread.
+ *
+ *  @param stateMachine The state machine the event has been scheduled on.
+ *  @param event        The scheduled event.
+ *  @param status       The status returned by the event queue.
+ */
+- (void)stateMachine:(TBSMStateMachine *)stateMachine didScheduleEvent:(TBSMEvent *)event status:(TBSMEventQueueStatus)status;
+
+@end
+NS_ASSUME_NONNULL_END
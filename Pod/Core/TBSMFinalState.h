@@ -0,0 +1,31 @@
+//
+//  TBSMFinalState.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMState.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class represents a final state in a state machine.
+ *
+ *  A region which has entered its final state is finished. A `TBSMSubState` is completed when its state machine is finished,
+ *  a `TBSMParallelState` is completed when all of its regions are finished.
+ */
+@interface TBSMFinalState : TBSMState
+
+/**
+ *  Creates a `TBSMFinalState` instance from a given name.
+ *
+ *  Throws a `TBSMException` when name is nil or an empty string.
+ *
+ *  @param name The specified state name.
+ *
+ *  @return The final state instance.
+ */
++ (instancetype)finalStateWithName:(NSString *)name;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,15 @@
+//
+//  TBSMFinalState.m
+//  TBStateMachine
+//
+
+#import "TBSMFinalState.h"
+
+@implementation TBSMFinalState
+
++ (instancetype)finalStateWithName:(NSString *)name
+{
+    return [[[self class] alloc] initWithName:name];
+}
+
+@end
@@ -77,4 +77,25 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)exit:(nullable TBSMState *)sourceState targetState:(nullable TBSMState *)targetState data:(nullable id)data;
 
 @end
+
+/**
+ *  Returns whether a vertex is the specified vertex or one of its parent vertexes.
+ *
+ *  Same as `[[vertex path] containsObject:ancestor]` for states but does not create the path.
+ *
+ *  @param vertex   The vertex to start from.
+ *  @param ancestor The vertex to search for.
+ *
+ *  @return `YES` if the ancestor has been found.
+ */
+NS_INLINE BOOL TBSMHierarchyVertexIsContainedIn(id<TBSMHierarchyVertex> _Nullable vertex, id<TBSMHierarchyVertex> _Nullable ancestor)
+{
+    while (vertex) {
+        if (vertex == ancestor) {
+            return YES;
+        }
+        vertex = vertex.parentVertex;
+    }
+    return NO;
+}
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,71 @@
+//
+//  TBSMHistogram.h
+//  TBStateMachine
+//
+
+#ifndef TBSMHistogram_h
+#define TBSMHistogram_h
+
+#include <math.h>
+#include <stdint.h>
+
+#define TBSM_HISTOGRAM_SUB_BITS 3
+#define TBSM_HISTOGRAM_BUCKETS ((64 - TBSM_HISTOGRAM_SUB_BITS + 1) << TBSM_HISTOGRAM_SUB_BITS)
+
+/**
+ *  Log-linear histogram of nanoseconds with eight buckets per power of two.
+ *  Percentiles are reported as the upper bound of their bucket and are exact to within 12.5%.
+ */
+typedef struct {
+    uint32_t counts[TBSM_HISTOGRAM_BUCKETS];
+    uint64_t total;
+} TBSMHistogram;
+
+static inline unsigned TBSMHistogramBucket(uint64_t nanoseconds)
+{
+    if (nanoseconds < (1u << TBSM_HISTOGRAM_SUB_BITS)) {
+        return (unsigned)nanoseconds;
+    }
+    unsigned exponent = 63 - __builtin_clzll(nanoseconds);
+    uint64_t mantissa = (nanoseconds >> (exponent - TBSM_HISTOGRAM_SUB_BITS)) & ((1u << TBSM_HISTOGRAM_SUB_BITS) - 1);
+    return ((exponent - TBSM_HISTOGRAM_SUB_BITS + 1) << TBSM_HISTOGRAM_SUB_BITS) | (unsigned)mantissa;
+}
+
+static inline uint64_t TBSMHistogramUpperBound(unsigned bucket)
+{
+    if (bucket < (1u << TBSM_HISTOGRAM_SUB_BITS)) {
+        return bucket;
+    }
+    unsigned exponent = (bucket >> TBSM_HISTOGRAM_SUB_BITS) + TBSM_HISTOGRAM_SUB_BITS - 1;
+    uint64_t mantissa = bucket & ((1u << TBSM_HISTOGRAM_SUB_BITS) - 1);
+    uint64_t lowerBound = ((1ull << TBSM_HISTOGRAM_SUB_BITS) | mantissa) << (exponent - TBSM_HISTOGRAM_SUB_BITS);
+    return lowerBound + (1ull << (exponent - TBSM_HISTOGRAM_SUB_BITS)) - 1;
+}
+
+static inline void TBSMHistogramAdd(TBSMHistogram *histogram, double seconds)
+{
+    uint32_t *count = &histogram->counts[TBSMHistogramBucket((uint64_t)(fmax(seconds, 0.0) * 1e9))];
+    if (*count < UINT32_MAX) {
+        (*count)++;
+        histogram->total++;
+    }
+}
+
+static inline double TBSMHistogramPercentile(const TBSMHistogram *histogram, double percentile)
+{
+    if (histogram->total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t)ceil(fmin(fmax(percentile, 0.0), 1.0) * histogram->total);
+    rank = rank ? rank : 1;
+    uint64_t count = 0;
+    for (unsigned bucket = 0; bucket < TBSM_HISTOGRAM_BUCKETS; bucket++) {
+        count += histogram->counts[bucket];
+        if (count >= rank) {
+            return (double)TBSMHistogramUpperBound(bucket) / 1e9;
+        }
+    }
+    return 0.0;
+}
+
+#endif /* TBSMHistogram_h */
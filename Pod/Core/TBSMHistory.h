@@ -0,0 +1,59 @@
+//
+//  TBSMHistory.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+#import "TBSMPseudoState.h"
+#import "TBSMHistoryKind.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class represents a 'history' pseudo state in a state machine.
+ *
+ *  A transition targeting a history pseudo state enters the containing state in the
+ *  configuration which was active when it was exited the last time.
+ *  Falls back to default entry when the containing state has not been exited yet.
+ */
+@interface TBSMHistory : TBSMPseudoState
+
+/**
+ *  The kind of the history.
+ */
+@property (nonatomic, assign, readonly) TBSMHistoryKind kind;
+
+/**
+ *  The `TBSMSubState` or `TBSMParallelState` whose configuration will be restored.
+ */
+@property (nonatomic, strong, readonly) TBSMState *containingState;
+
+/**
+ *  Creates a `TBSMHistory` instance from a given name and kind.
+ *
+ *  Throws a `TBSMException` when name is nil or an empty string.
+ *
+ *  @param name The specified history name.
+ *  @param kind The kind of the history.
+ *
+ *  @return The history instance.
+ */
++ (instancetype)historyWithName:(NSString *)name kind:(TBSMHistoryKind)kind;
+
+/**
+ *  Sets the state whose configuration will be restored.
+ *
+ *  Throws a `TBSMException` when the state is not a `TBSMSubState` or `TBSMParallelState`.
+ *
+ *  @param containingState The containing state.
+ */
+- (void)setContainingState:(TBSMState *)containingState;
+
+/**
+ *  Prepares the state machines of the containing state to restore their last active states on the next entry.
+ */
+- (void)prepareRestore;
+
+@end
+NS_ASSUME_NONNULL_END
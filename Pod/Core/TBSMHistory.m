@@ -0,0 +1,48 @@
+//
+//  TBSMHistory.m
+//  TBStateMachine
+//
+
+#import "TBSMHistory.h"
+#import "TBSMStateMachine.h"
+
+@implementation TBSMHistory
+
++ (instancetype)historyWithName:(NSString *)name kind:(TBSMHistoryKind)kind
+{
+    TBSMHistory *history = [[[self class] alloc] initWithName:name];
+    history->_kind = kind;
+    return history;
+}
+
+- (TBSMState *)targetState
+{
+    return self.containingState;
+}
+
+- (void)setContainingState:(TBSMState *)containingState
+{
+    if (![containingState isKindOfClass:[TBSMSubState class]] && ![containingState isKindOfClass:[TBSMParallelState class]]) {
+        @throw [NSException tbsm_noCompositeContainingStateException:self.name stateName:containingState.name];
+    }
+    _containingState = containingState;
+}
+
+- (void)prepareRestore
+{
+    if ([self.containingState isKindOfClass:[TBSMSubState class]]) {
+        TBSMSubState *subState = (TBSMSubState *)self.containingState;
+        if (subState.isMaterialized) {
+            [subState.stateMachine restoreHistory:self.kind];
+        }
+    } else if ([self.containingState isKindOfClass:[TBSMParallelState class]]) {
+        TBSMParallelState *parallelState = (TBSMParallelState *)self.containingState;
+        if (parallelState.isMaterialized) {
+            for (TBSMStateMachine *stateMachine in parallelState.stateMachines) {
+                [stateMachine restoreHistory:self.kind];
+            }
+        }
+    }
+}
+
+@end
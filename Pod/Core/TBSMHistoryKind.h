@@ -0,0 +1,23 @@
+//
+//  TBSMHistoryKind.h
+//  TBStateMachine
+//
+
+#ifndef Pods_TBSMHistoryKind_h
+#define Pods_TBSMHistoryKind_h
+
+/**
+ *  This enum defines how much of the last active state configuration a history pseudo state restores.
+ */
+typedef NS_ENUM(NSUInteger, TBSMHistoryKind) {
+    /**
+     *  Restores the last active state of the containing state. Nested states are entered by default entry.
+     */
+    TBSMHistoryShallow,
+    /**
+     *  Restores the last active states of the containing state and all nested states.
+     */
+    TBSMHistoryDeep
+};
+
+#endif
@@ -0,0 +1,30 @@
+//
+//  TBSMJournaling.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+@class TBSMEvent;
+@class TBSMStateMachine;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This protocol describes an object which persists the active state configuration of a state machine.
+ */
+@protocol TBSMJournaling <NSObject>
+
+/**
+ *  Called by the state machine at the top of the hierarchy after every completed run-to-completion step
+ *  as well as after `-setUp:` and `-tearDown:`.
+ *
+ *  Called on the thread the step has been executed on. Steps waiting for an asynchronous action are reported once the action has completed.
+ *
+ *  @param stateMachine The state machine at the top of the hierarchy.
+ *  @param event        The event which has been handled or `nil` for setup, teardown and steps without event.
+ */
+- (void)stateMachine:(TBSMStateMachine *)stateMachine didCompleteStepWithEvent:(nullable TBSMEvent *)event;
+
+@end
+NS_ASSUME_NONNULL_END
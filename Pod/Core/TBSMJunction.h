@@ -27,6 +27,13 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (instancetype)junctionWithName:(NSString *)name;
 
+/**
+ *  The junction's outgoing paths in the order of their evaluation.
+ *
+ *  @return An array containing the outgoing paths.
+ */
+- (NSArray<TBSMJunctionPath *> *)outgoingPaths;
+
 /**
  *  The junction's target states.
  *
@@ -43,17 +50,30 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)addOutgoingPathWithTarget:(TBSMState *)target action:(nullable TBSMActionBlock)action guard:(nullable TBSMGuardBlock)guard;
 
+/**
+ *  Adds an outgoing path to the junction which is implemented by plain C functions.
+ *
+ *  Throws a `TBSMException` when target or guard function is nil.
+ *
+ *  @param target         The target state.
+ *  @param actionFunction The action function to perform.
+ *  @param guardFunction  The guard function to evaluate for this path.
+ *  @param context        The context pointer passed to both functions.
+ */
+- (void)addOutgoingPathWithTarget:(TBSMState *)target actionFunction:(nullable TBSMActionFunction)actionFunction guardFunction:(nullable TBSMGuardFunction)guardFunction context:(nullable void *)context;
+
 /**
  *  Returns the outgoing path of the junction after evaluating all guards.
  *
- *  Throws a `TBSMException` when no target state could be found.
+ *  Throws a `TBSMException` when no target state could be found. Reports a `TBSMErrorCodeNoOutgoingJunctionPath` error
+ *  and returns `nil` instead when the state machine is running in `TBSMErrorModeReport`.
  *
  *  @param source The source state to transition from.
  *  @param data   The payload data.
  *
  *  @return The outgoing path.
  */
-- (TBSMJunctionPath *)outgoingPathForTransition:(TBSMState *)source data:(nullable id)data;
+- (nullable TBSMJunctionPath *)outgoingPathForTransition:(TBSMState *)source data:(nullable id)data;
 
 @end
 NS_ASSUME_NONNULL_END
@@ -7,9 +7,10 @@
 //
 
 #import "TBSMJunction.h"
+#import "TBSMStateMachine.h"
 
 @interface TBSMJunction ()
-@property (nonatomic, strong) NSMutableArray *outgoingPaths;
+@property (nonatomic, strong) NSMutableArray *priv_outgoingPaths;
 @end
 
 @implementation TBSMJunction
@@ -23,14 +24,19 @@
 {
     self = [super initWithName:name];
     if (self) {
-        _outgoingPaths = [NSMutableArray new];
+        _priv_outgoingPaths = [NSMutableArray new];
     }
     return self;
 }
 
+- (NSArray *)outgoingPaths
+{
+    return self.priv_outgoingPaths.copy;
+}
+
 - (NSArray *)targetStates
 {
-    return [self.outgoingPaths valueForKeyPath:@"targetState"];
+    return [self.priv_outgoingPaths valueForKeyPath:@"targetState"];
 }
 
 - (void)addOutgoingPathWithTarget:(TBSMState *)target action:(TBSMActionBlock)action guard:(TBSMGuardBlock)guard
@@ -42,17 +48,43 @@
     outgoingPath.targetState = target;
     outgoingPath.action = action;
     outgoingPath.guard = guard;
-    [self.outgoingPaths addObject:outgoingPath];
+    [self.priv_outgoingPaths addObject:outgoingPath];
+}
+
+- (void)addOutgoingPathWithTarget:(TBSMState *)target actionFunction:(TBSMActionFunction)actionFunction guardFunction:(TBSMGuardFunction)guardFunction context:(void *)context
+{
+    if (target == nil || guardFunction == NULL) {
+        @throw [NSException tbsm_ambiguousCompoundTransitionAttributes:self.name];
+    }
+    TBSMJunctionPath *outgoingPath = [TBSMJunctionPath new];
+    outgoingPath.targetState = target;
+    outgoingPath.actionFunction = actionFunction;
+    outgoingPath.guardFunction = guardFunction;
+    outgoingPath.context = context;
+    [self.priv_outgoingPaths addObject:outgoingPath];
 }
 
 - (TBSMJunctionPath *)outgoingPathForTransition:(TBSMState *)source data:(id)data
 {
-    for (TBSMJunctionPath *outgoingPath in self.outgoingPaths) {
-        if (outgoingPath.guard(data)) {
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    for (TBSMJunctionPath *outgoingPath in self.priv_outgoingPaths) {
+        uint64_t start = [profiler beginCallback];
+        BOOL canPerform = outgoingPath.guard ? outgoingPath.guard(data) : outgoingPath.guardFunction(data, outgoingPath.context);
+        [profiler endCallback:TBSMProfileCategoryGuard key:(__bridge const void *)outgoingPath start:start name:^NSString *{
+            return [NSString stringWithFormat:@"%@ --> %@", self.name, outgoingPath.targetState.name];
+        }];
+        if (canPerform) {
             return outgoingPath;
         }
+        [profiler endTransition:(__bridge const void *)outgoingPath start:start performed:NO name:^NSString *{
+            return [NSString stringWithFormat:@"%@ --> %@", self.name, outgoingPath.targetState.name];
+        }];
+    }
+    TBSMStateMachine *stateMachine = (TBSMStateMachine *)source.parentVertex;
+    if (![stateMachine reportError:[NSError tbsm_noOutgoingJunctionPathError:self.name]]) {
+        @throw [NSException tbsm_noOutgoingJunctionPathException:self.name];
     }
-    @throw [NSException tbsm_noOutgoingJunctionPathException:self.name];
+    return nil;
 }
 
 @end
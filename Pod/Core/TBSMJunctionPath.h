@@ -31,5 +31,20 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, copy, nullable) TBSMGuardBlock guard;
 
+/**
+ *  The action function associated with this path.
+ */
+@property (nonatomic, assign, nullable) TBSMActionFunction actionFunction;
+
+/**
+ *  The guard function associated with this path.
+ */
+@property (nonatomic, assign, nullable) TBSMGuardFunction guardFunction;
+
+/**
+ *  The context pointer passed to action and guard function. Not retained.
+ */
+@property (nonatomic, assign, nullable) void *context;
+
 @end
 NS_ASSUME_NONNULL_END
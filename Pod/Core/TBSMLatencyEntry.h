@@ -0,0 +1,68 @@
+//
+//  TBSMLatencyEntry.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class represents the distribution of one latency of a single event name inside a `TBSMLatencyTracer`.
+ *
+ *  Times are kept in a log-linear histogram with eight buckets per power of two, so percentiles are exact to within 12.5%.
+ */
+@interface TBSMLatencyEntry : NSObject <NSCopying>
+
+/**
+ *  The name of the event.
+ */
+@property (nonatomic, copy, readonly) NSString *name;
+
+/**
+ *  The number of measurements.
+ */
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/**
+ *  The mean of all measurements in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval meanTime;
+
+/**
+ *  The longest measurement in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval maximumTime;
+
+/**
+ *  The 99th percentile of all measurements in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval p99Time;
+
+/**
+ *  Creates an empty entry.
+ *
+ *  @param name The name of the event.
+ *
+ *  @return The entry instance.
+ */
+- (instancetype)initWithName:(NSString *)name;
+
+/**
+ *  Adds a measurement.
+ *
+ *  @param time The measured time in seconds.
+ */
+- (void)addTime:(NSTimeInterval)time;
+
+/**
+ *  Returns the upper bound of the histogram bucket containing the specified percentile, limited to `maximumTime`.
+ *
+ *  @param percentile The percentile between `0.0` and `1.0`.
+ *
+ *  @return The time in seconds or `0` if nothing has been measured yet.
+ */
+- (NSTimeInterval)timeAtPercentile:(double)percentile;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,62 @@
+//
+//  TBSMLatencyEntry.m
+//  TBStateMachine
+//
+
+#import "TBSMLatencyEntry.h"
+#import "TBSMHistogram.h"
+
+@interface TBSMLatencyEntry ()
+@property (nonatomic, assign) NSUInteger count;
+@property (nonatomic, assign) NSTimeInterval maximumTime;
+@end
+
+@implementation TBSMLatencyEntry
+{
+    TBSMHistogram _histogram;
+    NSTimeInterval _totalTime;
+}
+
+- (instancetype)initWithName:(NSString *)name
+{
+    self = [super init];
+    if (self) {
+        _name = name.copy;
+    }
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    TBSMLatencyEntry *entry = [[TBSMLatencyEntry allocWithZone:zone] initWithName:self.name];
+    entry->_count = _count;
+    entry->_maximumTime = _maximumTime;
+    entry->_histogram = _histogram;
+    entry->_totalTime = _totalTime;
+    return entry;
+}
+
+- (void)addTime:(NSTimeInterval)time
+{
+    self.count++;
+    self.maximumTime = MAX(self.maximumTime, time);
+    _totalTime += time;
+    TBSMHistogramAdd(&_histogram, time);
+}
+
+- (NSTimeInterval)meanTime
+{
+    return self.count ? _totalTime / self.count : 0.0;
+}
+
+- (NSTimeInterval)p99Time
+{
+    return [self timeAtPercentile:0.99];
+}
+
+- (NSTimeInterval)timeAtPercentile:(double)percentile
+{
+    return MIN(TBSMHistogramPercentile(&_histogram, percentile), self.maximumTime);
+}
+
+@end
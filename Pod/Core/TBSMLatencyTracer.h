@@ -0,0 +1,106 @@
+//
+//  TBSMLatencyTracer.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMEvent.h"
+#import "TBSMLatencyEntry.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class splits the latency of every event into the time it has waited in the queue and the time of its run-to-completion step.
+ *  It also measures the end-to-end latency of causal chains: the time from scheduling the first event until the last event
+ *  scheduled or raised by any step of the chain has been handled.
+ *
+ *  Set an instance as `latencyTracer` of the state machine at the top of the hierarchy to enable tracing.
+ *  Chains are followed inside a single tracer. Share one instance between state machines to follow chains across them.
+ *
+ *  The tracer is thread safe.
+ */
+@interface TBSMLatencyTracer : NSObject
+
+/**
+ *  The maximum number of unfinished chains. When exceeded the oldest chain is dropped and counted as abandoned. Defaults to `1024`.
+ */
+@property (nonatomic, assign) NSUInteger maximumPendingChains;
+
+/**
+ *  The number of handled events.
+ */
+@property (nonatomic, assign, readonly) NSUInteger eventCount;
+
+/**
+ *  The number of finished chains.
+ */
+@property (nonatomic, assign, readonly) NSUInteger chainCount;
+
+/**
+ *  The number of chains with events still waiting to be handled.
+ */
+@property (nonatomic, assign, readonly) NSUInteger pendingChainCount;
+
+/**
+ *  The number of chains dropped because `maximumPendingChains` has been exceeded.
+ */
+@property (nonatomic, assign, readonly) NSUInteger abandonedChainCount;
+
+/**
+ *  Returns the queue wait time per event name ordered by the 99th percentile.
+ *
+ *  @return A copy of the entries.
+ */
+- (NSArray<TBSMLatencyEntry *> *)queueWaitEntries;
+
+/**
+ *  Returns the run-to-completion time per event name ordered by the 99th percentile.
+ *
+ *  @return A copy of the entries.
+ */
+- (NSArray<TBSMLatencyEntry *> *)processingEntries;
+
+/**
+ *  Returns the end-to-end latency of finished chains per name of their first event ordered by the 99th percentile.
+ *
+ *  @return A copy of the entries.
+ */
+- (NSArray<TBSMLatencyEntry *> *)chainEntries;
+
+/**
+ *  Returns a human readable table of all entries.
+ *
+ *  @return The report.
+ */
+- (NSString *)report;
+
+/**
+ *  Discards all measurements and unfinished chains.
+ */
+- (void)reset;
+
+/**
+ *  Records an event which has been scheduled or raised by the step of another event.
+ *
+ *  @param event The stamped event.
+ */
+- (void)recordScheduledEvent:(TBSMEvent *)event;
+
+/**
+ *  Records a scheduled event which will not be handled because it has been rejected, dropped or coalesced by the event queue.
+ *
+ *  @param event The stamped event.
+ */
+- (void)recordDroppedEvent:(TBSMEvent *)event;
+
+/**
+ *  Records a handled event.
+ *
+ *  @param event      The stamped event.
+ *  @param startTime  The system uptime at which the step has started.
+ *  @param finishTime The system uptime at which the step has finished.
+ */
+- (void)recordEvent:(TBSMEvent *)event startTime:(NSTimeInterval)startTime finishTime:(NSTimeInterval)finishTime;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,216 @@
+//
+//  TBSMLatencyTracer.m
+//  TBStateMachine
+//
+
+#import "TBSMLatencyTracer.h"
+
+/**
+ *  An unfinished causal chain. Counts the events of the chain which have not been handled yet, including the first one.
+ */
+@interface TBSMLatencyChain : NSObject
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, assign) NSUInteger outstandingCount;
+@property (nonatomic, assign) NSTimeInterval enqueueTime;
+@end
+
+@implementation TBSMLatencyChain
+@end
+
+@interface TBSMLatencyTracer ()
+@property (nonatomic, assign) NSUInteger eventCount;
+@property (nonatomic, assign) NSUInteger chainCount;
+@property (nonatomic, assign) NSUInteger abandonedChainCount;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, TBSMLatencyEntry *> *priv_queueWaitEntries;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, TBSMLatencyEntry *> *priv_processingEntries;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, TBSMLatencyEntry *> *priv_chainEntries;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, TBSMLatencyChain *> *priv_chains;
+@property (nonatomic, strong) NSMutableOrderedSet<NSNumber *> *priv_chainOrder;
+@property (nonatomic, strong) NSLock *priv_lock;
+@end
+
+@implementation TBSMLatencyTracer
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _maximumPendingChains = 1024;
+        _priv_queueWaitEntries = [NSMutableDictionary new];
+        _priv_processingEntries = [NSMutableDictionary new];
+        _priv_chainEntries = [NSMutableDictionary new];
+        _priv_chains = [NSMutableDictionary new];
+        _priv_chainOrder = [NSMutableOrderedSet new];
+        _priv_lock = [NSLock new];
+    }
+    return self;
+}
+
+- (NSUInteger)pendingChainCount
+{
+    [self.priv_lock lock];
+    NSUInteger count = self.priv_chains.count;
+    [self.priv_lock unlock];
+    return count;
+}
+
+- (NSArray<TBSMLatencyEntry *> *)queueWaitEntries
+{
+    return [self _copyEntries:self.priv_queueWaitEntries];
+}
+
+- (NSArray<TBSMLatencyEntry *> *)processingEntries
+{
+    return [self _copyEntries:self.priv_processingEntries];
+}
+
+- (NSArray<TBSMLatencyEntry *> *)chainEntries
+{
+    return [self _copyEntries:self.priv_chainEntries];
+}
+
+- (NSArray<TBSMLatencyEntry *> *)_copyEntries:(NSDictionary<NSString *, TBSMLatencyEntry *> *)entries
+{
+    [self.priv_lock lock];
+    NSMutableArray *copies = [NSMutableArray arrayWithCapacity:entries.count];
+    for (TBSMLatencyEntry *entry in entries.allValues) {
+        [copies addObject:entry.copy];
+    }
+    [self.priv_lock unlock];
+    
+    [copies sortUsingComparator:^NSComparisonResult(TBSMLatencyEntry *entry, TBSMLatencyEntry *otherEntry) {
+        return [@(otherEntry.p99Time) compare:@(entry.p99Time)];
+    }];
+    return copies;
+}
+
+- (NSString *)report
+{
+    NSMutableString *report = [NSMutableString stringWithFormat:@"%lu events, %lu chains (%lu pending, %lu abandoned)\n",
+                               (unsigned long)self.eventCount, (unsigned long)self.chainCount, (unsigned long)self.pendingChainCount, (unsigned long)self.abandonedChainCount];
+    NSDictionary *sections = @{@"wait" : [self queueWaitEntries], @"process" : [self processingEntries], @"chain" : [self chainEntries]};
+    for (NSString *section in @[@"wait", @"process", @"chain"]) {
+        for (TBSMLatencyEntry *entry in sections[section]) {
+            [report appendFormat:@"%-10@ %-40@ %8lu x %10.3f ms (p99 %.3f ms, max %.3f ms)\n",
+             section, entry.name, (unsigned long)entry.count, entry.meanTime * 1000.0, entry.p99Time * 1000.0, entry.maximumTime * 1000.0];
+        }
+    }
+    return report;
+}
+
+- (void)reset
+{
+    [self.priv_lock lock];
+    [self.priv_queueWaitEntries removeAllObjects];
+    [self.priv_processingEntries removeAllObjects];
+    [self.priv_chainEntries removeAllObjects];
+    [self.priv_chains removeAllObjects];
+    [self.priv_chainOrder removeAllObjects];
+    self.eventCount = 0;
+    self.chainCount = 0;
+    self.abandonedChainCount = 0;
+    [self.priv_lock unlock];
+}
+
+- (void)recordScheduledEvent:(TBSMEvent *)event
+{
+    if (event.parentIdentifier == 0) {
+        return;
+    }
+    [self.priv_lock lock];
+    NSNumber *key = @(event.rootIdentifier);
+    TBSMLatencyChain *chain = self.priv_chains[key];
+    if (chain == nil) {
+        // Only the first event can open a chain. Otherwise the chain has been abandoned or is traced elsewhere.
+        if (event.parentIdentifier != event.rootIdentifier) {
+            [self.priv_lock unlock];
+            return;
+        }
+        chain = [TBSMLatencyChain new];
+        chain.outstandingCount = 1;
+        chain.enqueueTime = event.rootEnqueueTime;
+        self.priv_chains[key] = chain;
+        [self.priv_chainOrder addObject:key];
+        [self _dropAbandonedChains];
+    }
+    chain.outstandingCount++;
+    [self.priv_lock unlock];
+}
+
+- (void)recordDroppedEvent:(TBSMEvent *)event
+{
+    [self.priv_lock lock];
+    NSNumber *key = @(event.rootIdentifier);
+    TBSMLatencyChain *chain = self.priv_chains[key];
+    if (chain && event.identifier != event.rootIdentifier) {
+        [self _releaseChain:chain key:key finishTime:[NSProcessInfo processInfo].systemUptime];
+    }
+    [self.priv_lock unlock];
+}
+
+- (void)recordEvent:(TBSMEvent *)event startTime:(NSTimeInterval)startTime finishTime:(NSTimeInterval)finishTime
+{
+    [self.priv_lock lock];
+    self.eventCount++;
+    if (event.enqueueTime > 0) {
+        [[self _entryNamed:event.name in:self.priv_queueWaitEntries] addTime:startTime - event.enqueueTime];
+    }
+    [[self _entryNamed:event.name in:self.priv_processingEntries] addTime:finishTime - startTime];
+    
+    BOOL isRoot = (event.identifier == event.rootIdentifier);
+    NSNumber *key = @(event.rootIdentifier);
+    TBSMLatencyChain *chain = self.priv_chains[key];
+    if (chain == nil) {
+        if (isRoot) {
+            [self _finishChainNamed:event.name enqueueTime:event.rootEnqueueTime finishTime:finishTime];
+        }
+        [self.priv_lock unlock];
+        return;
+    }
+    if (isRoot) {
+        chain.name = event.name;
+    }
+    [self _releaseChain:chain key:key finishTime:finishTime];
+    [self.priv_lock unlock];
+}
+
+- (void)_releaseChain:(TBSMLatencyChain *)chain key:(NSNumber *)key finishTime:(NSTimeInterval)finishTime
+{
+    chain.outstandingCount--;
+    if (chain.outstandingCount > 0) {
+        return;
+    }
+    [self _finishChainNamed:chain.name enqueueTime:chain.enqueueTime finishTime:finishTime];
+    [self.priv_chains removeObjectForKey:key];
+    [self.priv_chainOrder removeObject:key];
+}
+
+- (void)_finishChainNamed:(NSString *)name enqueueTime:(NSTimeInterval)enqueueTime finishTime:(NSTimeInterval)finishTime
+{
+    self.chainCount++;
+    if (enqueueTime > 0) {
+        [[self _entryNamed:name in:self.priv_chainEntries] addTime:finishTime - enqueueTime];
+    }
+}
+
+- (void)_dropAbandonedChains
+{
+    while (self.priv_chains.count > self.maximumPendingChains) {
+        NSNumber *key = self.priv_chainOrder.firstObject;
+        [self.priv_chainOrder removeObjectAtIndex:0];
+        [self.priv_chains removeObjectForKey:key];
+        self.abandonedChainCount++;
+    }
+}
+
+- (TBSMLatencyEntry *)_entryNamed:(NSString *)name in:(NSMutableDictionary<NSString *, TBSMLatencyEntry *> *)entries
+{
+    TBSMLatencyEntry *entry = entries[name];
+    if (entry == nil) {
+        entry = [[TBSMLatencyEntry alloc] initWithName:name];
+        entries[name] = entry;
+    }
+    return entry;
+}
+
+@end
@@ -10,6 +10,7 @@
 
 #import "TBSMState.h"
 #import "TBSMContainingVertex.h"
+#import "TBSMDeferredContent.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -18,6 +19,16 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @interface TBSMParallelState : TBSMState <TBSMContainingVertex>
 
+/**
+ *  The deferred content of this parallel state or `nil` if the state machines have been set directly.
+ */
+@property (nonatomic, strong, readonly, nullable) TBSMDeferredContent *deferredContent;
+
+/**
+ *  `YES` if the state machines have been built.
+ */
+@property (nonatomic, assign, readonly, getter=isMaterialized) BOOL materialized;
+
 /**
  *  Creates a `TBSMParallelState` instance from a given name.
  *
@@ -42,6 +53,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 /**
  *  Returns the state machines the parallel wrapper manages.
+ *  Builds deferred state machines when they have not been built yet.
  *
  *  @return An NSArray containing all `TBSMStateMachine` instances.
  */
@@ -66,5 +78,18 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)setStates:(NSArray <NSArray<__kindof TBSMState *> *> *)states;
 
+/**
+ *  Defers the construction of the contained state machines until the parallel state is entered
+ *  or a state inside of it is looked up by path.
+ *
+ *  The configuration block receives the parallel state and should call `-setStates:` and add the
+ *  event handlers of the contained states.
+ *
+ *  @param configuration   The block which configures the parallel state.
+ *  @param releaseInterval The time in seconds after which the state machines will be released again
+ *                         once the parallel state has been exited. Pass `0` to keep them.
+ */
+- (void)setStatesWithConfiguration:(TBSMDeferredConfigurationBlock)configuration releaseInterval:(NSTimeInterval)releaseInterval;
+
 @end
 NS_ASSUME_NONNULL_END
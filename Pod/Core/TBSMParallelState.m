@@ -8,10 +8,12 @@
 
 #import "TBSMParallelState.h"
 #import "TBSMStateMachine.h"
+#import "TBSMState+Private.h"
 #import "NSException+TBStateMachine.h"
 
 @interface TBSMParallelState ()
 @property (nonatomic, strong) NSMutableArray *priv_parallelStateMachines;
+@property (nonatomic, strong, readwrite, nullable) TBSMDeferredContent *deferredContent;
 @end
 
 @implementation TBSMParallelState
@@ -34,9 +36,15 @@
 
 - (NSArray *)stateMachines
 {
+    [self _materializeIfNeeded];
     return [NSArray arrayWithArray:self.priv_parallelStateMachines];
 }
 
+- (BOOL)isMaterialized
+{
+    return (self.priv_parallelStateMachines.count > 0);
+}
+
 - (void)setStateMachines:(NSArray *)stateMachines
 {
     [self.priv_parallelStateMachines removeAllObjects];
@@ -62,6 +70,13 @@
     [self setStateMachines:stateMachines];
 }
 
+- (void)setStatesWithConfiguration:(TBSMDeferredConfigurationBlock)configuration releaseInterval:(NSTimeInterval)releaseInterval
+{
+    self.deferredContent = [[TBSMDeferredContent alloc] initWithConfiguration:configuration];
+    self.deferredContent.releaseInterval = releaseInterval;
+    [self.priv_parallelStateMachines removeAllObjects];
+}
+
 - (void)removeTransitionVertexes
 {
     [super removeTransitionVertexes];
@@ -70,13 +85,16 @@
 
 - (void)enter:(TBSMState *)sourceState targetState:(TBSMState *)targetState data:(id)data
 {
+    [self.deferredContent cancelRelease];
+    [self _materializeIfNeeded];
     [super enter:sourceState targetState:targetState data:data];
     
     if (self.priv_parallelStateMachines.count == 0) {
-        @throw [NSException tbsm_missingStateMachineException:self.name];
+        [self tbsm_reportMissingStateMachine];
+        return;
     }
     for (TBSMStateMachine *stateMachine in self.priv_parallelStateMachines) {
-        if ([targetState.path containsObject:stateMachine]) {
+        if (TBSMHierarchyVertexIsContainedIn(targetState, stateMachine)) {
             [stateMachine enter:sourceState targetState:targetState data:data];
         } else {
             [stateMachine setUp:data];
@@ -86,15 +104,18 @@
 
 - (void)enter:(TBSMState *)sourceState targetStates:(NSArray *)targetStates region:(TBSMParallelState *)region data:(id)data
 {
+    [self.deferredContent cancelRelease];
+    [self _materializeIfNeeded];
     [super enter:sourceState targetState:region data:data];
     
     if (self.priv_parallelStateMachines.count == 0) {
-        @throw [NSException tbsm_missingStateMachineException:self.name];
+        [self tbsm_reportMissingStateMachine];
+        return;
     }
     for (TBSMStateMachine *stateMachine in self.priv_parallelStateMachines) {
         BOOL isEntered = NO;
         for (TBSMState *targetState in targetStates) {
-            if ([targetState.path containsObject:stateMachine]) {
+            if (TBSMHierarchyVertexIsContainedIn(targetState, stateMachine)) {
                 [stateMachine enter:sourceState targetState:targetState data:data];
                 isEntered = YES;
             }
@@ -108,12 +129,19 @@
 - (void)exit:(TBSMState *)sourceState targetState:(TBSMState *)targetState data:(id)data
 {
     if (self.priv_parallelStateMachines.count == 0) {
-        @throw [NSException tbsm_missingStateMachineException:self.name];
+        [self tbsm_reportMissingStateMachine];
     }
     for (TBSMStateMachine *stateMachine in self.priv_parallelStateMachines) {
         [stateMachine tearDown:data];
     }
     [super exit:sourceState targetState:targetState data:data];
+    
+    if (self.deferredContent) {
+        __weak typeof(self) weakSelf = self;
+        [self.deferredContent scheduleReleaseOfState:self releaseBlock:^{
+            [weakSelf _releaseStateMachines];
+        }];
+    }
 }
 
 - (BOOL)handleEvent:(TBSMEvent *)event
@@ -127,4 +155,26 @@
     return didHandleEvent;
 }
 
+- (void)_materializeIfNeeded
+{
+    if (self.priv_parallelStateMachines.count > 0 || self.deferredContent == nil || self.deferredContent.isMaterializing) {
+        return;
+    }
+    [self.deferredContent materializeState:self];
+    if (self.priv_parallelStateMachines.count > 0) {
+        [self.deferredContent state:self didMaterializeStateMachines:self.priv_parallelStateMachines.copy];
+    }
+}
+
+- (void)_releaseStateMachines
+{
+    if (self.priv_parallelStateMachines.count == 0) {
+        return;
+    }
+    [self.deferredContent removeSubscriptionsFromStateMachines:self.priv_parallelStateMachines.copy];
+    [self.priv_parallelStateMachines makeObjectsPerformSelector:@selector(removeTransitionVertexes)];
+    [self.priv_parallelStateMachines removeAllObjects];
+    [(TBSMStateMachine *)self.parentVertex invalidateStateIndex];
+}
+
 @end
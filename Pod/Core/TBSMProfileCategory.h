@@ -0,0 +1,35 @@
+//
+//  TBSMProfileCategory.h
+//  TBStateMachine
+//
+
+#ifndef Pods_TBSMProfileCategory_h
+#define Pods_TBSMProfileCategory_h
+
+/**
+ *  This enum defines the buckets a `TBSMProfiler` attributes the time of a run-to-completion step to.
+ */
+typedef NS_ENUM(NSUInteger, TBSMProfileCategory) {
+    /**
+     *  Time spent inside the framework (dispatch, event filters, LCA search, path building and notifications) per event.
+     */
+    TBSMProfileCategoryFramework,
+    /**
+     *  Time spent in guard blocks and functions per transition.
+     */
+    TBSMProfileCategoryGuard,
+    /**
+     *  Time spent in action blocks, functions and asynchronous actions per transition.
+     */
+    TBSMProfileCategoryAction,
+    /**
+     *  Time spent in enter blocks and functions per state.
+     */
+    TBSMProfileCategoryEnter,
+    /**
+     *  Time spent in exit blocks and functions per state.
+     */
+    TBSMProfileCategoryExit
+};
+
+#endif
@@ -0,0 +1,59 @@
+//
+//  TBSMProfileEntry.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMProfileCategory.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class represents the aggregated time of a single bucket inside a `TBSMProfiler` report.
+ */
+@interface TBSMProfileEntry : NSObject
+
+/**
+ *  The category of the bucket.
+ */
+@property (nonatomic, assign, readonly) TBSMProfileCategory category;
+
+/**
+ *  The name of the event, transition or state the time is attributed to.
+ */
+@property (nonatomic, copy, readonly) NSString *name;
+
+/**
+ *  The number of measurements.
+ */
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/**
+ *  The sum of all measurements in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval totalTime;
+
+/**
+ *  The longest measurement in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval maximumTime;
+
+/**
+ *  Creates an empty entry.
+ *
+ *  @param category The category of the bucket.
+ *  @param name     The name of the bucket.
+ *
+ *  @return The entry instance.
+ */
+- (instancetype)initWithCategory:(TBSMProfileCategory)category name:(NSString *)name;
+
+/**
+ *  Adds a measurement.
+ *
+ *  @param time The measured time in seconds.
+ */
+- (void)addTime:(NSTimeInterval)time;
+
+@end
+NS_ASSUME_NONNULL_END
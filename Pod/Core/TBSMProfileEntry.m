@@ -0,0 +1,33 @@
+//
+//  TBSMProfileEntry.m
+//  TBStateMachine
+//
+
+#import "TBSMProfileEntry.h"
+
+@interface TBSMProfileEntry ()
+@property (nonatomic, assign) NSUInteger count;
+@property (nonatomic, assign) NSTimeInterval totalTime;
+@property (nonatomic, assign) NSTimeInterval maximumTime;
+@end
+
+@implementation TBSMProfileEntry
+
+- (instancetype)initWithCategory:(TBSMProfileCategory)category name:(NSString *)name
+{
+    self = [super init];
+    if (self) {
+        _category = category;
+        _name = name.copy;
+    }
+    return self;
+}
+
+- (void)addTime:(NSTimeInterval)time
+{
+    self.count++;
+    self.totalTime += time;
+    self.maximumTime = MAX(self.maximumTime, time);
+}
+
+@end
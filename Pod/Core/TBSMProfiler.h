@@ -0,0 +1,158 @@
+//
+//  TBSMProfiler.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMProfileCategory.h"
+#import "TBSMProfileEntry.h"
+#import "TBSMTransitionStatistics.h"
+#import "TBSMStateStatistics.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class splits the time of every run-to-completion step into time spent inside the framework
+ *  and time spent in guards, actions, enter and exit blocks.
+ *
+ *  Set an instance as `profiler` of the state machine at the top of the hierarchy to enable profiling.
+ *  Times are read from `mach_absolute_time()`. Guards and actions are identified by their event handler or junction path,
+ *  enter and exit blocks by their state.
+ *
+ *  The profiler also counts performed and rejected transitions with their times and the dwell time of every state.
+ *
+ *  The profiler is not thread safe. Read the results on the `scheduledEventsQueue` of the state machine or while it is idle.
+ */
+@interface TBSMProfiler : NSObject
+
+/**
+ *  The number of profiled steps.
+ */
+@property (nonatomic, assign, readonly) NSUInteger stepCount;
+
+/**
+ *  The total time of all steps in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval totalTime;
+
+/**
+ *  The time spent in guards, actions, enter and exit blocks in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval callbackTime;
+
+/**
+ *  The time spent inside the framework in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval frameworkTime;
+
+/**
+ *  Returns the current profiler of the calling thread. Only set while a profiled step is running.
+ *
+ *  @return The profiler or `nil`.
+ */
++ (nullable TBSMProfiler *)currentProfiler;
+
+/**
+ *  Returns all buckets ordered by their total time.
+ *
+ *  @return The array of entries.
+ */
+- (NSArray<TBSMProfileEntry *> *)entries;
+
+/**
+ *  Returns a human readable table of all buckets.
+ *
+ *  @return The report.
+ */
+- (NSString *)report;
+
+/**
+ *  Discards all measurements.
+ */
+- (void)reset;
+
+/**
+ *  Starts measuring a run-to-completion step and makes the profiler current on the calling thread.
+ *  Nested calls are counted as part of the outermost step.
+ */
+- (void)beginStep;
+
+/**
+ *  Finishes the measurement of a step started via `-beginStep`.
+ *
+ *  @param eventName The name of the handled event or `nil` for setup, teardown and steps without event.
+ */
+- (void)endStepWithEventName:(nullable NSString *)eventName;
+
+/**
+ *  Returns the timestamp to pass to `-endCallback:key:start:name:`.
+ *
+ *  @return The current value of `mach_absolute_time()`.
+ */
+- (uint64_t)beginCallback;
+
+/**
+ *  Attributes the time since `start` to a user callback.
+ *
+ *  @param category The category of the callback.
+ *  @param key      A pointer identifying the bucket, e.g. the event handler, the junction path or the state.
+ *  @param start    The timestamp returned by `-beginCallback`.
+ *  @param name     Returns the name of the bucket. Only called when the bucket is created.
+ */
+- (void)endCallback:(TBSMProfileCategory)category key:(const void *)key start:(uint64_t)start name:(NSString *(NS_NOESCAPE ^)(void))name;
+
+/**
+ *  Records an evaluated transition.
+ *
+ *  @param key       A pointer identifying the transition, e.g. the event handler or the junction path.
+ *  @param start     The timestamp returned by `-beginCallback` before the transition has been evaluated.
+ *  @param performed `YES` if the transition has been performed, `NO` if its guards have rejected it.
+ *  @param name      Returns the name of the transition. Only called when the statistics are created.
+ */
+- (void)endTransition:(const void *)key start:(uint64_t)start performed:(BOOL)performed name:(NSString *(NS_NOESCAPE ^)(void))name;
+
+/**
+ *  Records the entry of a state.
+ *
+ *  @param key  A pointer identifying the state.
+ *  @param name Returns the name of the state. Only called when the statistics are created.
+ */
+- (void)enterState:(const void *)key name:(NSString *(NS_NOESCAPE ^)(void))name;
+
+/**
+ *  Records the exit of a state.
+ *
+ *  @param key A pointer identifying the state.
+ */
+- (void)exitState:(const void *)key;
+
+/**
+ *  Returns the statistics of a transition.
+ *
+ *  @param key The pointer identifying the transition.
+ *
+ *  @return The statistics or `nil` if the transition has not been evaluated yet.
+ */
+- (nullable TBSMTransitionStatistics *)transitionStatisticsForKey:(const void *)key;
+
+/**
+ *  Returns a copy of the statistics of a state sampled at the current time.
+ *
+ *  @param key The pointer identifying the state.
+ *
+ *  @return The sampled copy or `nil` if the state has not been entered yet.
+ */
+- (nullable TBSMStateStatistics *)stateStatisticsForKey:(const void *)key;
+
+/**
+ *  Discards all measurements recorded for a key.
+ *
+ *  Keys are not retained. Call this method before the object identified by the key is released,
+ *  so that a new object at the same address does not inherit its measurements.
+ *
+ *  @param key The pointer identifying the bucket.
+ */
+- (void)removeStatisticsForKey:(const void *)key;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,222 @@
+//
+//  TBSMProfiler.m
+//  TBStateMachine
+//
+
+#import "TBSMProfiler.h"
+
+#include <mach/mach_time.h>
+
+static const NSUInteger TBSMProfileCategoryCount = TBSMProfileCategoryExit + 1;
+static __thread __unsafe_unretained TBSMProfiler *TBSMCurrentProfiler = nil;
+
+static NSTimeInterval TBSMSecondsForMachTime(uint64_t time)
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    return (NSTimeInterval)time * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
+@implementation TBSMProfiler
+{
+    CFMutableDictionaryRef _callbackEntries[TBSMProfileCategoryCount];
+    NSMutableDictionary<NSString *, TBSMProfileEntry *> *_frameworkEntries;
+    CFMutableDictionaryRef _transitionStatistics;
+    CFMutableDictionaryRef _stateStatistics;
+    __unsafe_unretained TBSMProfiler *_previousProfiler;
+    NSUInteger _depth;
+    uint64_t _stepStart;
+    uint64_t _stepCallbackTime;
+    uint64_t _totalTime;
+    uint64_t _callbackTime;
+}
+
++ (TBSMProfiler *)currentProfiler
+{
+    return TBSMCurrentProfiler;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        for (NSUInteger category = 0; category < TBSMProfileCategoryCount; category++) {
+            _callbackEntries[category] = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+        }
+        _frameworkEntries = [NSMutableDictionary new];
+        _transitionStatistics = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+        _stateStatistics = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger category = 0; category < TBSMProfileCategoryCount; category++) {
+        CFRelease(_callbackEntries[category]);
+    }
+    CFRelease(_transitionStatistics);
+    CFRelease(_stateStatistics);
+}
+
+- (NSTimeInterval)totalTime
+{
+    return TBSMSecondsForMachTime(_totalTime);
+}
+
+- (NSTimeInterval)callbackTime
+{
+    return TBSMSecondsForMachTime(_callbackTime);
+}
+
+- (NSTimeInterval)frameworkTime
+{
+    return TBSMSecondsForMachTime(_totalTime - _callbackTime);
+}
+
+- (NSArray<TBSMProfileEntry *> *)entries
+{
+    NSMutableArray *entries = [NSMutableArray arrayWithArray:_frameworkEntries.allValues];
+    for (NSUInteger category = 0; category < TBSMProfileCategoryCount; category++) {
+        [entries addObjectsFromArray:[(__bridge NSDictionary *)_callbackEntries[category] allValues]];
+    }
+    [entries sortUsingComparator:^NSComparisonResult(TBSMProfileEntry *entry, TBSMProfileEntry *otherEntry) {
+        return [@(otherEntry.totalTime) compare:@(entry.totalTime)];
+    }];
+    return entries;
+}
+
+- (NSString *)report
+{
+    NSArray *categories = @[@"framework", @"guard", @"action", @"enter", @"exit"];
+    NSMutableString *report = [NSMutableString stringWithFormat:@"%lu steps: %.3f ms total, %.3f ms framework, %.3f ms callbacks\n",
+                               (unsigned long)self.stepCount, self.totalTime * 1000.0, self.frameworkTime * 1000.0, self.callbackTime * 1000.0];
+    for (TBSMProfileEntry *entry in [self entries]) {
+        [report appendFormat:@"%-10@ %-40@ %8lu x %10.3f ms (max %.3f ms)\n",
+         categories[entry.category], entry.name, (unsigned long)entry.count, entry.totalTime * 1000.0, entry.maximumTime * 1000.0];
+    }
+    return report;
+}
+
+- (void)reset
+{
+    for (NSUInteger category = 0; category < TBSMProfileCategoryCount; category++) {
+        CFDictionaryRemoveAllValues(_callbackEntries[category]);
+    }
+    [_frameworkEntries removeAllObjects];
+    CFDictionaryRemoveAllValues(_transitionStatistics);
+    CFDictionaryRemoveAllValues(_stateStatistics);
+    _stepCount = 0;
+    _totalTime = 0;
+    _callbackTime = 0;
+}
+
+- (void)beginStep
+{
+    if (_depth++ > 0) {
+        return;
+    }
+    _previousProfiler = TBSMCurrentProfiler;
+    TBSMCurrentProfiler = self;
+    _stepCallbackTime = 0;
+    _stepStart = mach_absolute_time();
+}
+
+- (void)endStepWithEventName:(NSString *)eventName
+{
+    if (_depth == 0 || --_depth > 0) {
+        return;
+    }
+    uint64_t time = mach_absolute_time() - _stepStart;
+    TBSMCurrentProfiler = _previousProfiler;
+    _previousProfiler = nil;
+    
+    _stepCount++;
+    _totalTime += time;
+    _callbackTime += _stepCallbackTime;
+    
+    NSString *name = eventName ?: @"-";
+    TBSMProfileEntry *entry = _frameworkEntries[name];
+    if (entry == nil) {
+        entry = [[TBSMProfileEntry alloc] initWithCategory:TBSMProfileCategoryFramework name:name];
+        _frameworkEntries[name] = entry;
+    }
+    [entry addTime:TBSMSecondsForMachTime(time - MIN(time, _stepCallbackTime))];
+}
+
+- (uint64_t)beginCallback
+{
+    return mach_absolute_time();
+}
+
+- (void)endCallback:(TBSMProfileCategory)category key:(const void *)key start:(uint64_t)start name:(NSString *(NS_NOESCAPE ^)(void))name
+{
+    uint64_t time = mach_absolute_time() - start;
+    _stepCallbackTime += time;
+    
+    CFMutableDictionaryRef entries = _callbackEntries[category];
+    TBSMProfileEntry *entry = (__bridge TBSMProfileEntry *)CFDictionaryGetValue(entries, key);
+    if (entry == nil) {
+        entry = [[TBSMProfileEntry alloc] initWithCategory:category name:name()];
+        CFDictionarySetValue(entries, key, (__bridge const void *)entry);
+    }
+    [entry addTime:TBSMSecondsForMachTime(time)];
+}
+
+#pragma mark - Transitions and states
+
+- (void)endTransition:(const void *)key start:(uint64_t)start performed:(BOOL)performed name:(NSString *(NS_NOESCAPE ^)(void))name
+{
+    uint64_t time = mach_absolute_time() - start;
+    TBSMTransitionStatistics *statistics = (__bridge TBSMTransitionStatistics *)CFDictionaryGetValue(_transitionStatistics, key);
+    if (statistics == nil) {
+        statistics = [[TBSMTransitionStatistics alloc] initWithName:name()];
+        CFDictionarySetValue(_transitionStatistics, key, (__bridge const void *)statistics);
+    }
+    if (performed) {
+        [statistics addTime:TBSMSecondsForMachTime(time)];
+    } else {
+        [statistics addRejection];
+    }
+}
+
+- (void)enterState:(const void *)key name:(NSString *(NS_NOESCAPE ^)(void))name
+{
+    TBSMStateStatistics *statistics = (__bridge TBSMStateStatistics *)CFDictionaryGetValue(_stateStatistics, key);
+    if (statistics == nil) {
+        statistics = [[TBSMStateStatistics alloc] initWithName:name()];
+        CFDictionarySetValue(_stateStatistics, key, (__bridge const void *)statistics);
+    }
+    [statistics enterAtTime:TBSMSecondsForMachTime(mach_absolute_time())];
+}
+
+- (void)exitState:(const void *)key
+{
+    TBSMStateStatistics *statistics = (__bridge TBSMStateStatistics *)CFDictionaryGetValue(_stateStatistics, key);
+    [statistics exitAtTime:TBSMSecondsForMachTime(mach_absolute_time())];
+}
+
+- (TBSMTransitionStatistics *)transitionStatisticsForKey:(const void *)key
+{
+    return (__bridge TBSMTransitionStatistics *)CFDictionaryGetValue(_transitionStatistics, key);
+}
+
+- (TBSMStateStatistics *)stateStatisticsForKey:(const void *)key
+{
+    TBSMStateStatistics *statistics = (__bridge TBSMStateStatistics *)CFDictionaryGetValue(_stateStatistics, key);
+    return [statistics statisticsSampledAtTime:TBSMSecondsForMachTime(mach_absolute_time())];
+}
+
+- (void)removeStatisticsForKey:(const void *)key
+{
+    for (NSUInteger category = 0; category < TBSMProfileCategoryCount; category++) {
+        CFDictionaryRemoveValue(_callbackEntries[category], key);
+    }
+    CFDictionaryRemoveValue(_transitionStatistics, key);
+    CFDictionaryRemoveValue(_stateStatistics, key);
+}
+
+@end
@@ -0,0 +1,85 @@
+//
+//  TBSMScratchArena.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class provides scratch memory which is valid until the end of the current run-to-completion step.
+ *
+ *  The state machine at the top of the hierarchy owns an arena and makes it current on the calling thread while a step is running.
+ *  Allocations are served from blocks which are kept across steps, so once the arena has grown to its working size a step does not call `malloc` anymore.
+ *  All allocations are released in bulk when the outermost step ends. Do not keep pointers into the arena beyond the step.
+ *
+ *  The arena is not thread safe.
+ */
+@interface TBSMScratchArena : NSObject
+
+/**
+ *  The minimum size of a block in bytes.
+ */
+@property (nonatomic, assign, readonly) size_t blockSize;
+
+/**
+ *  The number of bytes allocated since the last reset.
+ */
+@property (nonatomic, assign, readonly) size_t allocatedBytes;
+
+/**
+ *  The number of bytes held by all blocks.
+ */
+@property (nonatomic, assign, readonly) size_t capacity;
+
+/**
+ *  Returns the arena of the step running on the calling thread.
+ *
+ *  @return The arena or `nil` if no step is running.
+ */
++ (nullable TBSMScratchArena *)currentArena;
+
+/**
+ *  Initializes an arena with a block size of 16 KB.
+ *
+ *  @return The arena.
+ */
+- (instancetype)init;
+
+/**
+ *  Initializes an arena with a given block size.
+ *
+ *  @param blockSize The minimum size of a block in bytes.
+ *
+ *  @return The arena.
+ */
+- (instancetype)initWithBlockSize:(size_t)blockSize NS_DESIGNATED_INITIALIZER;
+
+/**
+ *  Allocates memory which stays valid until the arena is reset.
+ *
+ *  @param size The number of bytes.
+ *
+ *  @return A pointer aligned to 16 bytes or `NULL` if the memory could not be allocated.
+ */
+- (nullable void *)allocate:(size_t)size NS_RETURNS_INNER_POINTER;
+
+/**
+ *  Releases all allocations in bulk. The blocks are kept for reuse.
+ */
+- (void)reset;
+
+/**
+ *  Makes the arena current on the calling thread. Nested calls are counted as part of the outermost step.
+ */
+- (void)beginStep;
+
+/**
+ *  Finishes a step started via `-beginStep`. The outermost call resets the arena.
+ */
+- (void)endStep;
+
+@end
+
+NS_ASSUME_NONNULL_END
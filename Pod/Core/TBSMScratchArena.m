@@ -0,0 +1,123 @@
+//
+//  TBSMScratchArena.m
+//  TBStateMachine
+//
+
+#import "TBSMScratchArena.h"
+
+static const size_t TBSMScratchArenaAlignment = 16;
+static const size_t TBSMScratchArenaDefaultBlockSize = 16384;
+static __thread __unsafe_unretained TBSMScratchArena *TBSMCurrentScratchArena = nil;
+
+@implementation TBSMScratchArena
+{
+    void **_blocks;
+    size_t *_blockSizes;
+    NSUInteger _blockCount;
+    NSUInteger _blockIndex;
+    size_t _offset;
+    __unsafe_unretained TBSMScratchArena *_previousArena;
+    NSUInteger _depth;
+}
+
++ (TBSMScratchArena *)currentArena
+{
+    return TBSMCurrentScratchArena;
+}
+
+- (instancetype)init
+{
+    return [self initWithBlockSize:TBSMScratchArenaDefaultBlockSize];
+}
+
+- (instancetype)initWithBlockSize:(size_t)blockSize
+{
+    self = [super init];
+    if (self) {
+        _blockSize = MAX(blockSize, TBSMScratchArenaAlignment);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger index = 0; index < _blockCount; index++) {
+        free(_blocks[index]);
+    }
+    free(_blocks);
+    free(_blockSizes);
+}
+
+- (void *)allocate:(size_t)size
+{
+    if (size > SIZE_MAX - TBSMScratchArenaAlignment) {
+        return NULL;
+    }
+    size = (MAX(size, 1) + TBSMScratchArenaAlignment - 1) & ~(TBSMScratchArenaAlignment - 1);
+    while (_blockIndex < _blockCount) {
+        if (_blockSizes[_blockIndex] - _offset >= size) {
+            void *memory = (uint8_t *)_blocks[_blockIndex] + _offset;
+            _offset += size;
+            _allocatedBytes += size;
+            return memory;
+        }
+        _blockIndex++;
+        _offset = 0;
+    }
+    return [self _allocateBlockWithSize:size];
+}
+
+- (void *)_allocateBlockWithSize:(size_t)size
+{
+    size_t blockSize = MAX(_blockSize, size);
+    void **blocks = realloc(_blocks, (_blockCount + 1) * sizeof(void *));
+    if (blocks == NULL) {
+        return NULL;
+    }
+    _blocks = blocks;
+    size_t *blockSizes = realloc(_blockSizes, (_blockCount + 1) * sizeof(size_t));
+    if (blockSizes == NULL) {
+        return NULL;
+    }
+    _blockSizes = blockSizes;
+    void *block = NULL;
+    if (posix_memalign(&block, TBSMScratchArenaAlignment, blockSize) != 0) {
+        return NULL;
+    }
+    _blocks[_blockCount] = block;
+    _blockSizes[_blockCount] = blockSize;
+    _blockIndex = _blockCount;
+    _blockCount++;
+    _capacity += blockSize;
+    _offset = size;
+    _allocatedBytes += size;
+    return block;
+}
+
+- (void)reset
+{
+    _blockIndex = 0;
+    _offset = 0;
+    _allocatedBytes = 0;
+}
+
+- (void)beginStep
+{
+    if (_depth++ > 0) {
+        return;
+    }
+    _previousArena = TBSMCurrentScratchArena;
+    TBSMCurrentScratchArena = self;
+}
+
+- (void)endStep
+{
+    if (_depth == 0 || --_depth > 0) {
+        return;
+    }
+    TBSMCurrentScratchArena = _previousArena;
+    _previousArena = nil;
+    [self reset];
+}
+
+@end
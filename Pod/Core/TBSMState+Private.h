@@ -0,0 +1,27 @@
+//
+//  TBSMState+Private.h
+//  TBStateMachine
+//
+
+#import "TBSMState.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Declarations shared between `TBSMState`, its subclasses and `TBSMStateMachine` which are not part of the public interface.
+ */
+@interface TBSMState ()
+
+/**
+ *  The dense index of the state inside the hierarchy of the top state machine. Only written by the top state machine.
+ */
+@property (nonatomic, assign, readwrite) NSUInteger stateIndex;
+
+/**
+ *  Reports a missing sub-statemachine through the parent statemachine and throws a `TBSMException` when the error is not handled.
+ *  Used by composite states which are entered, exited or sent events without a statemachine.
+ */
+- (void)tbsm_reportMissingStateMachine;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -17,6 +17,7 @@ NS_ASSUME_NONNULL_BEGIN
 FOUNDATION_EXPORT NSString * const TBSMStateDidEnterNotification;
 FOUNDATION_EXPORT NSString * const TBSMStateDidExitNotification;
 FOUNDATION_EXPORT NSString * const TBSMDataUserInfo;
+FOUNDATION_EXPORT NSString * const TBSMCompletionEvent;
 
 /**
  *  This type represents a block that is executed on entry and exit of a `TBSMState`.
@@ -25,6 +26,14 @@ FOUNDATION_EXPORT NSString * const TBSMDataUserInfo;
  */
 typedef void (^TBSMStateBlock)(id _Nullable data);
 
+/**
+ *  This type represents a plain C function that is executed on entry and exit of a `TBSMState`.
+ *
+ *  @param data    The payload data.
+ *  @param context The `functionContext` of the state.
+ */
+typedef void (*TBSMStateFunction)(id _Nullable data, void * _Nullable context);
+
 @class TBSMEventHandler;
 
 /**
@@ -37,6 +46,12 @@ typedef void (^TBSMStateBlock)(id _Nullable data);
  */
 @property (nonatomic, weak) id<TBSMHierarchyVertex> parentVertex;
 
+/**
+ *  The dense index of the state inside the hierarchy of the top state machine.
+ *  Assigned by the top state machine on `-setUp:`.
+ */
+@property (nonatomic, assign, readonly) NSUInteger stateIndex;
+
 /**
  *  Block that is executed when the state is entered.
  */
@@ -47,11 +62,38 @@ typedef void (^TBSMStateBlock)(id _Nullable data);
  */
 @property (nonatomic, copy, nullable) TBSMStateBlock exitBlock;
 
+/**
+ *  Function that is executed when the state is entered. Executed after the `enterBlock`.
+ */
+@property (nonatomic, assign, nullable) TBSMStateFunction enterFunction;
+
+/**
+ *  Function that is executed when the state is exited. Executed after the `exitBlock`.
+ */
+@property (nonatomic, assign, nullable) TBSMStateFunction exitFunction;
+
+/**
+ *  The context pointer passed to `enterFunction` and `exitFunction`. Not retained.
+ */
+@property (nonatomic, assign, nullable) void *functionContext;
+
 /**
  *  All `TBSMEventHandler` instances registered to this state instance.
+ *
+ *  Returns a copy. Use `-enumerateEventHandlersUsingBlock:` to iterate the handlers without copying them.
  */
 @property (nonatomic, strong, readonly) NSDictionary<NSString *, NSMutableArray<TBSMEventHandler *> *> *eventHandlers;
 
+/**
+ *  All `TBSMEventHandler` instances registered as completion transitions on this state instance.
+ */
+@property (nonatomic, strong, readonly) NSArray<TBSMEventHandler *> *completionHandlers;
+
+/**
+ *  The names of the events which are deferred while the state is active.
+ */
+@property (nonatomic, strong, readonly) NSSet<NSString *> *deferredEvents;
+
 /**
  *  Creates a `TBSMState` instance from a given name.
  *
@@ -119,6 +161,95 @@ typedef void (^TBSMStateBlock)(id _Nullable data);
  */
 - (void)addHandlerForEvent:(NSString *)event target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind action:(nullable TBSMActionBlock)action guard:(nullable TBSMGuardBlock)guard;
 
+/**
+ *  Registers an event of a given name for transition to a specified target state
+ *  with action and guard implemented as plain C functions.
+ *
+ *  Throws a `TBSMException` if the parameters are ambiguous.
+ *
+ *  @param event          The given event name.
+ *  @param target         The target vertex.
+ *  @param kind           The kind of transition.
+ *  @param actionFunction The action function associated with this event.
+ *  @param guardFunction  The guard function associated with this event.
+ *  @param context        The context pointer passed to both functions. Not retained.
+ */
+- (void)addHandlerForEvent:(NSString *)event target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind actionFunction:(nullable TBSMActionFunction)actionFunction guardFunction:(nullable TBSMGuardFunction)guardFunction context:(nullable void *)context;
+
+/**
+ *  Registers an event of a given name for transition to a specified target state with an asynchronous action.
+ *
+ *  The state machine will not handle further events until the action has called its completion block.
+ *  Throws a `TBSMException` if the parameters are ambiguous or the transition is internal.
+ *
+ *  @param event       The given event name.
+ *  @param target      The target vertex.
+ *  @param kind        The kind of transition.
+ *  @param asyncAction The asynchronous action block associated with this event.
+ *  @param guard       The guard block associated with this event.
+ */
+- (void)addHandlerForEvent:(NSString *)event target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind asyncAction:(TBSMAsyncActionBlock)asyncAction guard:(nullable TBSMGuardBlock)guard;
+
+/**
+ *  Registers a completion transition to a specified target state. Defaults to external transition.
+ *
+ *  Completion transitions have no trigger. They are evaluated inside the same run-to-completion step
+ *  right after the state has been entered. `TBSMSubState` and `TBSMParallelState` instances are evaluated
+ *  once all of their regions have reached a `TBSMFinalState`.
+ *
+ *  @param target The target vertex.
+ */
+- (void)addCompletionHandlerWithTarget:(id <TBSMTransitionVertex>)target;
+
+/**
+ *  Registers a completion transition to a specified target state.
+ *
+ *  Throws a `TBSMException` if the parameters are ambiguous.
+ *
+ *  @param target The target vertex.
+ *  @param kind   The kind of transition.
+ *  @param action The action block associated with this transition.
+ *  @param guard  The guard block associated with this transition.
+ */
+- (void)addCompletionHandlerWithTarget:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind action:(nullable TBSMActionBlock)action guard:(nullable TBSMGuardBlock)guard;
+
+/**
+ *  Registers a completion transition to a specified target state
+ *  with action and guard implemented as plain C functions.
+ *
+ *  Throws a `TBSMException` if the parameters are ambiguous.
+ *
+ *  @param target         The target vertex.
+ *  @param kind           The kind of transition.
+ *  @param actionFunction The action function associated with this transition.
+ *  @param guardFunction  The guard function associated with this transition.
+ *  @param context        The context pointer passed to both functions. Not retained.
+ */
+- (void)addCompletionHandlerWithTarget:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind actionFunction:(nullable TBSMActionFunction)actionFunction guardFunction:(nullable TBSMGuardFunction)guardFunction context:(nullable void *)context;
+
+/**
+ *  Removes the event handlers for a given event which pass a test.
+ *
+ *  @param event     The name of the event.
+ *  @param predicate The block to apply to each event handler. Returns `YES` to remove the handler.
+ */
+- (void)removeHandlersForEvent:(NSString *)event passingTest:(BOOL (^)(TBSMEventHandler *eventHandler))predicate;
+
+/**
+ *  Enumerates the event handlers grouped by event name.
+ *
+ *  @param block The block to apply to the handlers of each event.
+ */
+- (void)enumerateEventHandlersUsingBlock:(void (^)(NSString *event, NSArray<TBSMEventHandler *> *eventHandlers, BOOL *stop))block;
+
+/**
+ *  Moves the event handlers into a compact table of records sorted by the hash of the event name.
+ *
+ *  Called by the state machine once its configuration is complete. Adding or removing handlers afterwards
+ *  expands the table again until the state machine compacts it on the next event.
+ */
+- (void)compactEventHandlers;
+
 /**
  *  Returns `YES` if a given event can be consumed by the state.
  *
@@ -137,5 +268,32 @@ typedef void (^TBSMStateBlock)(id _Nullable data);
  */
 - (nullable NSArray<TBSMEventHandler *> *)eventHandlersForEvent:(TBSMEvent *)event;
 
+/**
+ *  Defers events of a given name while the state is active.
+ *
+ *  An event which is not consumed by any transition while a deferring state is active will be kept by the state machine
+ *  and handled again once after a state change has made it undeferred.
+ *  Throws a `TBSMException` if the name is empty.
+ *
+ *  @param event The given event name.
+ */
+- (void)deferEvent:(NSString *)event;
+
+/**
+ *  Stops deferring events of a given name.
+ *
+ *  @param event The given event name.
+ */
+- (void)removeDeferredEvent:(NSString *)event;
+
+/**
+ *  Returns `YES` if a given event is deferred by this state.
+ *
+ *  @param event The given `TBSMEvent` instance.
+ *
+ *  @return `YES` if the event is deferred.
+ */
+- (BOOL)defersEvent:(TBSMEvent *)event;
+
 @end
 NS_ASSUME_NONNULL_END
@@ -7,19 +7,70 @@
 //
 
 #import "TBSMState.h"
+#import "TBSMState+Private.h"
 #import "NSException+TBStateMachine.h"
 #import "TBSMEventHandler.h"
+#import "TBSMStateMachine.h"
+#import "TBSMJunction.h"
 
 NSString * const TBSMStateDidEnterNotification = @"TBSMStateDidEnterNotification";
 NSString * const TBSMStateDidExitNotification = @"TBSMStateDidExitNotification";
 NSString * const TBSMDataUserInfo = @"data";
+NSString * const TBSMCompletionEvent = @"TBSMCompletionEvent";
+
+/**
+ *  The handlers of one event inside the compact handler table. Name and handlers are retained manually.
+ */
+typedef struct {
+    NSUInteger hash;
+    __unsafe_unretained NSString *name;
+    __unsafe_unretained NSArray<TBSMEventHandler *> *eventHandlers;
+} TBSMEventHandlerRecord;
+
+/**
+ *  Tables up to this size are scanned linearly, larger ones are searched by bisection.
+ */
+static const NSUInteger TBSMEventHandlerLinearSearchLimit = 8;
+
+static NSArray<TBSMEventHandler *> *TBSMEventHandlersInRecords(const TBSMEventHandlerRecord *records, NSUInteger count, NSString *name)
+{
+    if (count == 0 || name == nil) {
+        return nil;
+    }
+    NSUInteger hash = name.hash;
+    NSUInteger index = 0;
+    if (count > TBSMEventHandlerLinearSearchLimit) {
+        NSUInteger upper = count;
+        while (index < upper) {
+            NSUInteger middle = index + (upper - index) / 2;
+            if (records[middle].hash < hash) {
+                index = middle + 1;
+            } else {
+                upper = middle;
+            }
+        }
+    }
+    for (; index < count && records[index].hash <= hash; index++) {
+        const TBSMEventHandlerRecord *record = &records[index];
+        if (record->hash == hash && (record->name == name || [record->name isEqualToString:name])) {
+            return record->eventHandlers;
+        }
+    }
+    return nil;
+}
 
 @interface TBSMState ()
 @property (nonatomic, copy) NSString *name;
 @property (nonatomic, strong) NSMutableDictionary *priv_eventHandlers;
+@property (nonatomic, strong) NSMutableArray *priv_completionHandlers;
+@property (nonatomic, strong) NSMutableSet *priv_deferredEvents;
 @end
 
 @implementation TBSMState
+{
+    TBSMEventHandlerRecord *_eventHandlerRecords;
+    NSUInteger _eventHandlerRecordCount;
+}
 
 + (instancetype)stateWithName:(NSString *)name
 {
@@ -34,20 +85,52 @@ NSString * const TBSMDataUserInfo = @"data";
     self = [super init];
     if (self) {
         _name = name.copy;
-        _priv_eventHandlers = [NSMutableDictionary new];
+        _stateIndex = NSNotFound;
     }
     return self;
 }
 
+- (void)dealloc
+{
+    [self _releaseEventHandlerRecords];
+}
+
 - (void)removeTransitionVertexes
 {
+    TBSMProfiler *profiler = [self _profiler];
+    if (profiler) {
+        [self enumerateEventHandlersUsingBlock:^(NSString *event, NSArray *eventHandlers, BOOL *stop) {
+            [self _removeStatisticsOfEventHandlers:eventHandlers profiler:profiler];
+        }];
+        [self _removeStatisticsOfEventHandlers:self.priv_completionHandlers profiler:profiler];
+    }
     [self.priv_eventHandlers removeAllObjects];
     self.priv_eventHandlers = nil;
+    [self _releaseEventHandlerRecords];
+    [self.priv_completionHandlers removeAllObjects];
+    self.priv_completionHandlers = nil;
 }
 
 - (NSDictionary *)eventHandlers
 {
-    return self.priv_eventHandlers.copy;
+    if (self.priv_eventHandlers) {
+        return self.priv_eventHandlers.copy;
+    }
+    NSMutableDictionary *eventHandlers = [NSMutableDictionary dictionaryWithCapacity:_eventHandlerRecordCount];
+    [self enumerateEventHandlersUsingBlock:^(NSString *event, NSArray *handlers, BOOL *stop) {
+        eventHandlers[event] = handlers.mutableCopy;
+    }];
+    return eventHandlers.copy;
+}
+
+- (NSArray *)completionHandlers
+{
+    return self.priv_completionHandlers.copy ?: @[];
+}
+
+- (NSSet *)deferredEvents
+{
+    return self.priv_deferredEvents.copy ?: [NSSet set];
 }
 
 - (void)addHandlerForEvent:(NSString *)event target:(id <TBSMTransitionVertex>)target
@@ -66,6 +149,58 @@ NSString * const TBSMDataUserInfo = @"data";
 }
 
 - (void)addHandlerForEvent:(NSString *)event target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind action:(TBSMActionBlock)action guard:(TBSMGuardBlock)guard
+{
+    [self _validateTransitionForEvent:event target:target kind:kind];
+    TBSMEventHandler *eventHandler = [[TBSMEventHandler alloc] initWithName:event target:target kind:kind action:action guard:guard];
+    [self _addEventHandler:eventHandler];
+}
+
+- (void)addHandlerForEvent:(NSString *)event target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind actionFunction:(TBSMActionFunction)actionFunction guardFunction:(TBSMGuardFunction)guardFunction context:(void *)context
+{
+    [self _validateTransitionForEvent:event target:target kind:kind];
+    TBSMEventHandler *eventHandler = [[TBSMEventHandler alloc] initWithName:event target:target kind:kind actionFunction:actionFunction guardFunction:guardFunction context:context];
+    [self _addEventHandler:eventHandler];
+}
+
+- (void)addHandlerForEvent:(NSString *)event target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind asyncAction:(TBSMAsyncActionBlock)asyncAction guard:(TBSMGuardBlock)guard
+{
+    [self _validateTransitionForEvent:event target:target kind:kind];
+    if (kind == TBSMTransitionInternal) {
+        @throw [NSException tbsm_ambiguousTransitionAttributes:event source:self.name target:target.name];
+    }
+    TBSMEventHandler *eventHandler = [[TBSMEventHandler alloc] initWithName:event target:target kind:kind action:nil guard:guard];
+    eventHandler.asyncAction = asyncAction;
+    [self _addEventHandler:eventHandler];
+}
+
+- (void)addCompletionHandlerWithTarget:(id <TBSMTransitionVertex>)target
+{
+    [self addCompletionHandlerWithTarget:target kind:TBSMTransitionExternal action:nil guard:nil];
+}
+
+- (void)addCompletionHandlerWithTarget:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind action:(TBSMActionBlock)action guard:(TBSMGuardBlock)guard
+{
+    [self _validateTransitionForEvent:TBSMCompletionEvent target:target kind:kind];
+    TBSMEventHandler *eventHandler = [[TBSMEventHandler alloc] initWithName:TBSMCompletionEvent target:target kind:kind action:action guard:guard];
+    [self _addCompletionHandler:eventHandler];
+}
+
+- (void)addCompletionHandlerWithTarget:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind actionFunction:(TBSMActionFunction)actionFunction guardFunction:(TBSMGuardFunction)guardFunction context:(void *)context
+{
+    [self _validateTransitionForEvent:TBSMCompletionEvent target:target kind:kind];
+    TBSMEventHandler *eventHandler = [[TBSMEventHandler alloc] initWithName:TBSMCompletionEvent target:target kind:kind actionFunction:actionFunction guardFunction:guardFunction context:context];
+    [self _addCompletionHandler:eventHandler];
+}
+
+- (void)_addCompletionHandler:(TBSMEventHandler *)eventHandler
+{
+    if (self.priv_completionHandlers == nil) {
+        self.priv_completionHandlers = [NSMutableArray new];
+    }
+    [self.priv_completionHandlers addObject:eventHandler];
+}
+
+- (void)_validateTransitionForEvent:(NSString *)event target:(id <TBSMTransitionVertex>)target kind:(TBSMTransitionKind)kind
 {
     if (target == nil) {
         @throw [NSException tbsm_ambiguousTransitionAttributes:event source:self.name target:target.name];
@@ -73,53 +208,244 @@ NSString * const TBSMDataUserInfo = @"data";
     if (kind == TBSMTransitionInternal && target != self) {
         @throw [NSException tbsm_ambiguousTransitionAttributes:event source:self.name target:target.name];
     }
-    TBSMEventHandler *eventHandler = [[TBSMEventHandler alloc] initWithName:event target:target kind:kind action:action guard:guard];
-    if (!self.priv_eventHandlers[event]) {
-        self.priv_eventHandlers[event] = NSMutableArray.new;
+}
+
+- (void)_addEventHandler:(TBSMEventHandler *)eventHandler
+{
+    NSMutableDictionary *eventHandlers = [self _expandEventHandlers];
+    NSString *event = eventHandler.name;
+    if (!eventHandlers[event]) {
+        eventHandlers[event] = NSMutableArray.new;
+    }
+    [eventHandlers[event] addObject:eventHandler];
+    [self _invalidateEventFilters];
+}
+
+- (void)removeHandlersForEvent:(NSString *)event passingTest:(BOOL (^)(TBSMEventHandler *eventHandler))predicate
+{
+    NSArray *eventHandlers = [self _eventHandlersForName:event];
+    if (eventHandlers == nil) {
+        return;
+    }
+    NSIndexSet *indexes = [eventHandlers indexesOfObjectsPassingTest:^BOOL(TBSMEventHandler *eventHandler, NSUInteger idx, BOOL *stop) {
+        return predicate(eventHandler);
+    }];
+    if (indexes.count == 0) {
+        return;
+    }
+    [self _removeStatisticsOfEventHandlers:[eventHandlers objectsAtIndexes:indexes] profiler:[self _profiler]];
+    NSMutableDictionary *mutableEventHandlers = [self _expandEventHandlers];
+    [mutableEventHandlers[event] removeObjectsAtIndexes:indexes];
+    if ([mutableEventHandlers[event] count] == 0) {
+        [mutableEventHandlers removeObjectForKey:event];
     }
-    [self.priv_eventHandlers[event] addObject:eventHandler];
+    [self _invalidateEventFilters];
 }
 
 - (BOOL)hasHandlerForEvent:(TBSMEvent *)event
 {
-    return (self.priv_eventHandlers[event.name] != nil);
+    return ([self _eventHandlersForName:event.name] != nil);
 }
 
 - (NSArray *)eventHandlersForEvent:(TBSMEvent *)event
 {
     if ([self hasHandlerForEvent:event]) {
-        return self.priv_eventHandlers[event.name];
+        return [self _eventHandlersForName:event.name];
     }
     return nil;
 }
 
+- (void)enumerateEventHandlersUsingBlock:(void (^)(NSString *event, NSArray<TBSMEventHandler *> *eventHandlers, BOOL *stop))block
+{
+    if (self.priv_eventHandlers) {
+        [self.priv_eventHandlers enumerateKeysAndObjectsUsingBlock:^(NSString *event, NSArray *eventHandlers, BOOL *stop) {
+            block(event, eventHandlers, stop);
+        }];
+        return;
+    }
+    BOOL stop = NO;
+    for (NSUInteger index = 0; index < _eventHandlerRecordCount && !stop; index++) {
+        block(_eventHandlerRecords[index].name, _eventHandlerRecords[index].eventHandlers, &stop);
+    }
+}
+
+#pragma mark - Compact handler table
+
+- (void)compactEventHandlers
+{
+    NSDictionary *eventHandlers = self.priv_eventHandlers;
+    if (eventHandlers == nil) {
+        return;
+    }
+    NSArray *names = [eventHandlers.allKeys sortedArrayUsingComparator:^NSComparisonResult(NSString *name, NSString *otherName) {
+        if (name.hash != otherName.hash) {
+            return (name.hash < otherName.hash) ? NSOrderedAscending : NSOrderedDescending;
+        }
+        return [name compare:otherName];
+    }];
+    TBSMEventHandlerRecord *records = names.count ? calloc(names.count, sizeof(TBSMEventHandlerRecord)) : NULL;
+    for (NSUInteger index = 0; index < names.count; index++) {
+        NSString *name = names[index];
+        records[index].hash = name.hash;
+        records[index].name = (__bridge NSString *)CFBridgingRetain(name);
+        records[index].eventHandlers = (__bridge NSArray *)CFBridgingRetain([NSArray arrayWithArray:eventHandlers[name]]);
+    }
+    _eventHandlerRecords = records;
+    _eventHandlerRecordCount = names.count;
+    self.priv_eventHandlers = nil;
+}
+
+/**
+ *  Moves the compact handler table back into a mutable dictionary before handlers are added or removed.
+ */
+- (NSMutableDictionary *)_expandEventHandlers
+{
+    if (self.priv_eventHandlers == nil) {
+        NSMutableDictionary *eventHandlers = [NSMutableDictionary dictionaryWithCapacity:_eventHandlerRecordCount];
+        for (NSUInteger index = 0; index < _eventHandlerRecordCount; index++) {
+            eventHandlers[_eventHandlerRecords[index].name] = _eventHandlerRecords[index].eventHandlers.mutableCopy;
+        }
+        [self _releaseEventHandlerRecords];
+        self.priv_eventHandlers = eventHandlers;
+    }
+    return self.priv_eventHandlers;
+}
+
+- (NSArray *)_eventHandlersForName:(NSString *)name
+{
+    if (self.priv_eventHandlers) {
+        return self.priv_eventHandlers[name];
+    }
+    return TBSMEventHandlersInRecords(_eventHandlerRecords, _eventHandlerRecordCount, name);
+}
+
+- (void)_releaseEventHandlerRecords
+{
+    for (NSUInteger index = 0; index < _eventHandlerRecordCount; index++) {
+        CFRelease((__bridge CFTypeRef)_eventHandlerRecords[index].name);
+        CFRelease((__bridge CFTypeRef)_eventHandlerRecords[index].eventHandlers);
+    }
+    free(_eventHandlerRecords);
+    _eventHandlerRecords = NULL;
+    _eventHandlerRecordCount = 0;
+}
+
+- (void)deferEvent:(NSString *)event
+{
+    if (event == nil || [event isEqualToString:@""]) {
+        @throw [NSException tbsm_noNameForEventException];
+    }
+    if (self.priv_deferredEvents == nil) {
+        self.priv_deferredEvents = [NSMutableSet new];
+    }
+    [self.priv_deferredEvents addObject:event];
+    [self _invalidateEventFilters];
+}
+
+- (void)removeDeferredEvent:(NSString *)event
+{
+    if (![self.priv_deferredEvents containsObject:event]) {
+        return;
+    }
+    [self.priv_deferredEvents removeObject:event];
+    [self _invalidateEventFilters];
+}
+
+- (BOOL)defersEvent:(TBSMEvent *)event
+{
+    return [self.priv_deferredEvents containsObject:event.name];
+}
+
+- (void)_invalidateEventFilters
+{
+    if ([self.parentVertex isKindOfClass:[TBSMStateMachine class]]) {
+        [(TBSMStateMachine *)self.parentVertex invalidateEventFilters];
+    }
+}
+
 - (void)enter:(TBSMState *)sourceState targetState:(TBSMState *)targetState data:(id)data
 {
     [self tbsm_postNotificationWithName:TBSMStateDidEnterNotification data:data];
     
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    [profiler enterState:(__bridge const void *)self name:^NSString *{
+        return self.name;
+    }];
+    if (_enterBlock == nil && _enterFunction == NULL) {
+        return;
+    }
+    uint64_t start = [profiler beginCallback];
     if (_enterBlock) {
         _enterBlock(data);
     }
+    if (_enterFunction) {
+        _enterFunction(data, _functionContext);
+    }
+    [profiler endCallback:TBSMProfileCategoryEnter key:(__bridge const void *)self start:start name:^NSString *{
+        return self.name;
+    }];
 }
 
 - (void)exit:(TBSMState *)sourceState targetState:(TBSMState *)targetState data:(id)data
 {
     [self tbsm_postNotificationWithName:TBSMStateDidExitNotification data:data];
     
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    [profiler exitState:(__bridge const void *)self];
+    if (_exitBlock == nil && _exitFunction == NULL) {
+        return;
+    }
+    uint64_t start = [profiler beginCallback];
     if (_exitBlock) {
         _exitBlock(data);
     }
+    if (_exitFunction) {
+        _exitFunction(data, _functionContext);
+    }
+    [profiler endCallback:TBSMProfileCategoryExit key:(__bridge const void *)self start:start name:^NSString *{
+        return self.name;
+    }];
 }
 
 - (void)tbsm_postNotificationWithName:(NSString *)name data:(id)data
 {
-    NSMutableDictionary *userInfo = NSMutableDictionary.new;
-    if (data) {
-        userInfo[TBSMDataUserInfo] = data;
-    }
+    NSDictionary *userInfo = data ? @{TBSMDataUserInfo : data} : @{};
     [[NSNotificationCenter defaultCenter] postNotificationName:name object:self userInfo:userInfo];
 }
 
+- (TBSMProfiler *)_profiler
+{
+    id<TBSMHierarchyVertex> topVertex = self.path.firstObject;
+    if (![topVertex isKindOfClass:[TBSMStateMachine class]]) {
+        return nil;
+    }
+    return ((TBSMStateMachine *)topVertex).profiler;
+}
+
+/**
+ *  The profiler does not retain its keys. Drops the statistics of handlers which will be released
+ *  so that new handlers at the same address start with empty statistics.
+ */
+- (void)_removeStatisticsOfEventHandlers:(NSArray<TBSMEventHandler *> *)eventHandlers profiler:(TBSMProfiler *)profiler
+{
+    for (TBSMEventHandler *eventHandler in eventHandlers) {
+        [profiler removeStatisticsForKey:(__bridge const void *)eventHandler];
+        if ([eventHandler.target isKindOfClass:[TBSMJunction class]]) {
+            for (TBSMJunctionPath *outgoingPath in [(TBSMJunction *)eventHandler.target outgoingPaths]) {
+                [profiler removeStatisticsForKey:(__bridge const void *)outgoingPath];
+            }
+        }
+    }
+}
+
+- (void)tbsm_reportMissingStateMachine
+{
+    TBSMStateMachine *stateMachine = (TBSMStateMachine *)self.parentVertex;
+    if (![stateMachine reportError:[NSError tbsm_missingStateMachineError:self.name]]) {
+        @throw [NSException tbsm_missingStateMachineException:self.name];
+    }
+}
+
 #pragma mark - TBSMHierarchyVertex
 
 - (NSArray *)path
@@ -0,0 +1,39 @@
+//
+//  TBSMStateMachine+Private.h
+//  TBStateMachine
+//
+
+#import "TBSMStateMachine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Declarations shared between `TBSMStateMachine` and the builder which are not part of the public interface.
+ */
+@interface TBSMStateMachine ()
+
+/**
+ *  Returns the state at the specified path.
+ *
+ *  @param path        The path of the state.
+ *  @param materialize `YES` to build deferred contents on the path, `NO` to report them as `TBSMErrorCodeUnmaterializedPath`.
+ *  @param error       Set to an error if the state could not be found.
+ *
+ *  @return The state or `nil` if it could not be found.
+ */
+- (nullable TBSMState *)_stateWithPath:(NSString *)path materialize:(BOOL)materialize error:(NSError **)error;
+
+/**
+ *  Publishes a new configuration snapshot when the active state configuration has changed.
+ */
+- (void)_publishConfigurationSnapshot;
+
+/**
+ *  Reports a completed step to the journal.
+ *
+ *  @param event The event which has been handled or `nil` if the configuration has been changed otherwise.
+ */
+- (void)_journalStepWithEvent:(nullable TBSMEvent *)event;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -12,17 +12,36 @@
 #import "TBSMTransition.h"
 #import "TBSMCompoundTransition.h"
 #import "TBSMEvent.h"
+#import "TBSMEventQueue.h"
+#import "TBSMEventRecording.h"
+#import "TBSMJournaling.h"
+#import "TBSMProfiler.h"
+#import "TBSMLatencyTracer.h"
+#import "TBSMScratchArena.h"
+#import "TBSMConfigurationSnapshot.h"
 #import "TBSMEventHandler.h"
 #import "TBSMParallelState.h"
 #import "TBSMSubState.h"
+#import "TBSMFinalState.h"
 #import "TBSMFork.h"
 #import "TBSMJoin.h"
 #import "TBSMJunction.h"
+#import "TBSMHistory.h"
 #import "TBSMMacros.h"
 #import "NSException+TBStateMachine.h"
+#import "NSError+TBStateMachine.h"
+#import "TBSMErrorMode.h"
+#import "TBSMHistoryKind.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ *  This type represents a block that is executed when a state machine reports a runtime failure.
+ *
+ *  @param error The reported error.
+ */
+typedef void (^TBSMErrorHandlerBlock)(NSError *error);
+
 /**
  *  This class represents a hierarchical state machine.
  */
@@ -36,6 +55,67 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, strong) NSOperationQueue *scheduledEventsQueue;
 
+/**
+ *  The number of times pending events of a lower priority may be passed over
+ *  before they will be handled regardless of their priority.
+ *
+ *  Defaults to `0` which disables the starvation guard.
+ */
+@property (nonatomic, assign) NSUInteger starvationLimit;
+
+/**
+ *  The buffer containing all pending events. Can be configured with a capacity and an overflow policy
+ *  and provides counters for every outcome of scheduling an event.
+ */
+@property (nonatomic, strong, readonly) TBSMEventQueue *eventQueue;
+
+/**
+ *  Optional recorder which receives every event scheduled on the state machine at the top of the hierarchy.
+ */
+@property (nonatomic, weak, nullable) id<TBSMEventRecording> eventRecorder;
+
+/**
+ *  Optional journal which is notified after every run-to-completion step of the state machine at the top of the hierarchy.
+ */
+@property (nonatomic, weak, nullable) id<TBSMJournaling> journal;
+
+/**
+ *  Optional profiler which splits the time of every run-to-completion step into framework and callback time.
+ *  Only the setting of the state machine at the top of the hierarchy is taken into account.
+ */
+@property (nonatomic, strong, nullable) TBSMProfiler *profiler;
+
+/**
+ *  Optional tracer which measures queue wait, run-to-completion time and the end-to-end latency of causal event chains.
+ *  Only the setting of the state machine at the top of the hierarchy is taken into account.
+ */
+@property (nonatomic, strong, nullable) TBSMLatencyTracer *latencyTracer;
+
+/**
+ *  Scratch memory which is current on the calling thread while a run-to-completion step of this state machine is running.
+ *  Every step is also wrapped in its own autorelease pool. Only used on the state machine at the top of the hierarchy.
+ */
+@property (nonatomic, strong, readonly) TBSMScratchArena *scratchArena;
+
+/**
+ *  Defines how failures while handling events or entering states are reported.
+ *
+ *  Defaults to `TBSMErrorModeThrow`. With `TBSMErrorModeReport` the failing transition is not performed
+ *  and an `NSError` of the `TBSMErrorDomain` is passed to the `errorHandler`.
+ *  Only the setting of the state machine at the top of the hierarchy is taken into account.
+ */
+@property (nonatomic, assign) TBSMErrorMode errorMode;
+
+/**
+ *  Block that is executed when a runtime failure is reported in `TBSMErrorModeReport`.
+ */
+@property (nonatomic, copy, nullable) TBSMErrorHandlerBlock errorHandler;
+
+/**
+ *  The last error which has been reported in `TBSMErrorModeReport`.
+ */
+@property (nonatomic, strong, readonly, nullable) NSError *lastError;
+
 /**
  *  The state the state machine wil enter on setup (by default the first state in the provided array will be set).
  *
@@ -48,6 +128,27 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, strong, readonly, nullable) TBSMState *currentState;
 
+/**
+ *  The state which was active when the state machine has been torn down the last time.
+ */
+@property (nonatomic, weak, readonly, nullable) TBSMState *lastActiveState;
+
+/**
+ *  `YES` while a transition waits for its asynchronous action to complete.
+ *
+ *  The source states have been left and the target states have not been entered yet.
+ *  Scheduled events stay in the event queue and events passed to `-handleEvent:` will be deferred until the transition has finished.
+ */
+@property (nonatomic, assign, readonly, getter=isTransitionInProgress) BOOL transitionInProgress;
+
+/**
+ *  The events which have not been consumed while an active state defers them, in the order they arrived.
+ *
+ *  After every state change the events which are no longer deferred are removed from this list and handled once,
+ *  in order, inside the same run-to-completion step before any further scheduled event.
+ */
+@property (nonatomic, copy, readonly) NSArray<TBSMEvent *> *deferredEvents;
+
 /**
  *  Creates a `TBSMStateMachine` instance from a given name.
  *
@@ -73,7 +174,8 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  *  Starts up the state machine. Will enter the initial state.
  *
- *  Throws `TBSMException` if initial state has not been set beforehand.
+ *  Throws `TBSMException` if initial state has not been set beforehand. Reports a `TBSMErrorCodeNoInitialState` error instead
+ *  when running in `TBSMErrorModeReport`.
  */
 - (void)setUp:(nullable id)data;
 
@@ -82,6 +184,29 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)tearDown:(nullable id)data;
 
+/**
+ *  Starts up the state machine in the specified active state configuration without executing any enter blocks.
+ *
+ *  Intended to restore a configuration persisted before. The state machine must not be set up.
+ *  Regions and containing states without a specified leaf state will reside in their initial states.
+ *
+ *  @param paths The paths of the active leaf states as returned by `-pathOfState:`.
+ *  @param error Set to a `TBSMErrorCodeInvalidPath` error if a path could not be resolved.
+ *
+ *  @return `YES` if the configuration has been restored.
+ */
+- (BOOL)setUpWithActiveStatesAtPaths:(NSArray<NSString *> *)paths error:(NSError **)error;
+
+/**
+ *  Lets the state machine enter its last active state instead of the initial state on its next default entry.
+ *
+ *  With `TBSMHistoryDeep` the last active states of all nested state machines will be restored as well.
+ *  Falls back to the initial state when the state machine has not been torn down yet.
+ *
+ *  @param kind The kind of history to restore.
+ */
+- (void)restoreHistory:(TBSMHistoryKind)kind;
+
 /**
  *  Returns all states inside the state machine.
  *
@@ -101,17 +226,57 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  *  Adds an event to the event queue.
  *
+ *  Events are handled in the order of their priority lane. Inside a lane events are handled in FIFO order.
+ *  Sub-statemachines forward the event to the state machine at the top of the hierarchy.
+ *
+ *  When the event queue is bounded and full the configured `TBSMEventQueueOverflowPolicy` applies.
+ *  A producer running on the `scheduledEventsQueue` will never be blocked and gets the event rejected instead.
+ *
  *  @param event The given `TBSMEvent` instance.
+ *
+ *  @return The outcome of adding the event to the event queue.
  */
-- (void)scheduleEvent:(TBSMEvent *)event;
+- (TBSMEventQueueStatus)scheduleEvent:(TBSMEvent *)event;
 
 /**
  *  Adds an event to the event queue. Convenience method which receives the event name and payload.
  *
  *  @param name The specified event name.
  *  @param data Optional payload data.
+ *
+ *  @return The outcome of adding the event to the event queue.
+ */
+- (TBSMEventQueueStatus)scheduleEventNamed:(NSString *)name data:(nullable id)data;
+
+/**
+ *  Adds an event to the event queue. Convenience method which receives the event name, payload and priority.
+ *
+ *  @param name     The specified event name.
+ *  @param data     Optional payload data.
+ *  @param priority The priority lane to schedule the event in.
+ *
+ *  @return The outcome of adding the event to the event queue.
+ */
+- (TBSMEventQueueStatus)scheduleEventNamed:(NSString *)name data:(nullable id)data priority:(TBSMEventPriority)priority;
+
+/**
+ *  Raises an internal event. Must be called on the `scheduledEventsQueue`, e.g. from inside an action, guard, enter or exit block.
+ *
+ *  While a run-to-completion step is being performed the event is appended to a local FIFO which is drained
+ *  right after the current step and before the next scheduled event. Otherwise the event is handled immediately.
+ *  Sub-statemachines forward the event to the state machine at the top of the hierarchy.
+ *
+ *  @param event The given `TBSMEvent` instance.
+ */
+- (void)raiseEvent:(TBSMEvent *)event;
+
+/**
+ *  Raises an internal event. Convenience method which receives the event name and payload.
+ *
+ *  @param name The specified event name.
+ *  @param data Optional payload data.
  */
-- (void)scheduleEventNamed:(NSString *)name data:(nullable id)data;
+- (void)raiseEventNamed:(NSString *)name data:(nullable id)data;
 
 /**
  *  Switches between states defined in a specified transition.
@@ -134,10 +299,32 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)switchState:(nullable TBSMState *)sourceState targetStates:(NSArray<__kindof TBSMState *> *)targetStates region:(TBSMParallelState *)region action:(nullable TBSMActionBlock)action data:(nullable id)data;
 
+/**
+ *  Switches between states executing the actions of the specified transition.
+ *
+ *  @param sourceState The source state.
+ *  @param targetState The target state.
+ *  @param transition  The transition whose actions will be executed.
+ *  @param data        The payload data.
+ */
+- (void)switchState:(nullable TBSMState *)sourceState targetState:(nullable TBSMState *)targetState transition:(TBSMTransition *)transition data:(nullable id)data;
+
+/**
+ *  Switches between states executing the actions of the specified transition.
+ *
+ *  @param sourceState  The source state.
+ *  @param targetStates The target states inside the specified region.
+ *  @param region       The target region.
+ *  @param transition   The transition whose actions will be executed.
+ *  @param data         The payload data.
+ */
+- (void)switchState:(nullable TBSMState *)sourceState targetStates:(NSArray<__kindof TBSMState *> *)targetStates region:(TBSMParallelState *)region transition:(TBSMTransition *)transition data:(nullable id)data;
+
 /**
  * Returns the state at the specified path.
  *
- * Throws `TBSMException` if state could not be found.
+ * Throws `TBSMException` if state could not be found or the path leads into deferred contents which have not been built yet.
+ * Deferred contents are never built by a lookup.
  *
  * @param path The specified path
  *
@@ -145,8 +332,110 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (TBSMState *)stateWithPath:(NSString *)path;
 
+/**
+ * Returns the state at the specified path without throwing an exception.
+ *
+ * @param path  The specified path
+ * @param error Set to a `TBSMErrorCodeInvalidPath` error if the state could not be found or to a `TBSMErrorCodeUnmaterializedPath`
+ *              error if the path leads into deferred contents which have not been built yet.
+ *
+ * @return The specified state or `nil`.
+ */
+- (nullable TBSMState *)stateWithPath:(NSString *)path error:(NSError **)error;
+
+/**
+ * Returns the path of a state relative to the state machine at the top of the hierarchy.
+ *
+ * Regions of parallel states are addressed via `parallel@index`.
+ *
+ * @param state The specified state.
+ *
+ * @return The path which resolves to the state via `-stateWithPath:`.
+ */
+- (NSString *)pathOfState:(TBSMState *)state;
+
+/**
+ *  Reports a runtime failure according to the `errorMode` of the state machine at the top of the hierarchy.
+ *
+ *  @param error The error to report.
+ *
+ *  @return `YES` if the error has been reported, `NO` if the caller needs to throw the corresponding `TBSMException`.
+ */
+- (BOOL)reportError:(NSError *)error;
+
+/**
+ *  Returns `YES` if the specified state is part of the active state configuration.
+ *
+ *  Each state receives a dense index on `-setUp:` of the state machine at the top of the hierarchy.
+ *  The state machine keeps a bitset of all active states which makes this query O(1).
+ *
+ *  @param state The specified state.
+ *
+ *  @return `YES` if the state is active.
+ */
+- (BOOL)isActive:(TBSMState *)state;
+
+/**
+ *  Returns `YES` if the state at the specified path is part of the active state configuration.
+ *
+ *  Throws `TBSMException` if state could not be found. Resolved paths are cached.
+ *
+ *  @param path The specified path.
+ *
+ *  @return `YES` if the state is active.
+ */
+- (BOOL)isActiveAtPath:(NSString *)path;
+
+/**
+ *  Enumerates all active states which do not contain other states without allocating intermediate collections.
+ *
+ *  @param block The block to execute for every active leaf state. Set `stop` to `YES` to stop the enumeration.
+ */
+- (void)enumerateActiveLeafStatesUsingBlock:(void (^)(TBSMState *state, BOOL *stop))block;
+
+/**
+ *  Returns the active state configuration of the last completed run-to-completion step.
+ *
+ *  Unlike `currentState` and `-isActive:` this method can be called from any thread while the state machine is handling events.
+ *  The state machine at the top of the hierarchy publishes a new snapshot through an atomic pointer swap whenever a step has changed the configuration.
+ *  Reading a snapshot is wait-free. Snapshots replaced while a reader may still be loading them are released after the following step.
+ *
+ *  @return The last published snapshot or `nil` if the state machine has not been set up yet.
+ */
+- (nullable TBSMConfigurationSnapshot *)configurationSnapshot;
+
+/**
+ *  Returns `YES` if any state of the active state configuration or one of its descendants has a handler for the specified event.
+ *
+ *  Each state carries a bitmask over event identifiers which are handled by the state itself or by any of its descendants.
+ *  The masks are computed on `-setUp:` of the state machine at the top of the hierarchy.
+ *  Events which are not accepted are rejected without descending into sub states or regions.
+ *
+ *  @param event The specified event.
+ *
+ *  @return `YES` if the event can be handled in the current state configuration.
+ */
+- (BOOL)acceptsEvent:(TBSMEvent *)event;
+
+/**
+ *  Marks the event acceptance masks of the hierarchy as stale.
+ *
+ *  The masks will be recomputed before the next event is handled.
+ *  States call this method automatically when event handlers are added or removed.
+ */
+- (void)invalidateEventFilters;
+
+/**
+ *  Rebuilds the index of the active state configuration after states have been added to or removed from the hierarchy.
+ *  Also drops all cached path lookups.
+ *
+ *  Deferred sub and parallel states call this method automatically when their state machines are built or released.
+ */
+- (void)invalidateStateIndex;
+
 /**
  * Subscribe to a `TBSMStateDidEnterNotification` of the state at the specified path.
+ * Subscriptions to states inside deferred state machines will be applied once these have been built.
  *
  * Throws `TBSMException` if state could not be found.
  *
@@ -7,14 +7,80 @@
 //
 
 #import "TBSMStateMachine.h"
+#import "TBSMStateMachine+Private.h"
+#import "TBSMState+Private.h"
 
 @interface TBSMStateMachine ()
 @property (nonatomic, copy, readonly) NSString *name;
 @property (nonatomic, weak) id<TBSMHierarchyVertex> parentVertex;
 @property (nonatomic, strong) NSMutableArray *priv_states;
+@property (nonatomic, assign) BOOL priv_completionPending;
+@property (nonatomic, assign) BOOL priv_runningToCompletion;
+@property (nonatomic, assign) BOOL priv_restoresHistory;
+@property (nonatomic, assign) BOOL priv_restoresDeepHistory;
+@property (nonatomic, assign, readwrite, getter=isTransitionInProgress) BOOL transitionInProgress;
+@property (nonatomic, copy) void (^priv_pendingContinuation)(void);
+@property (nonatomic, strong) id priv_pendingData;
+@property (nonatomic, strong) TBSMEvent *priv_pendingEvent;
+@property (nonatomic, weak) TBSMStateMachine *priv_pendingStateMachine;
+@property (nonatomic, assign) NSUInteger priv_transitionGeneration;
+@property (nonatomic, assign) NSUInteger priv_deferredEventCount;
+@property (nonatomic, weak) TBSMState *lastActiveState;
+@property (nonatomic, strong) NSMutableArray *priv_internalEvents;
+@property (nonatomic, strong) NSMutableArray<TBSMEvent *> *priv_deferredEvents;
+@property (nonatomic, strong) NSDictionary<NSString *, NSArray<TBSMState *> *> *priv_deferringStates;
+@property (nonatomic, strong) NSArray<TBSMState *> *priv_indexedStates;
+@property (nonatomic, strong) NSArray<NSString *> *priv_indexedStatePaths;
+@property (nonatomic, strong) NSMutableArray<TBSMConfigurationSnapshot *> *priv_retiredSnapshots;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, TBSMState *> *priv_statesByPath;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *priv_eventIdentifiers;
+@property (nonatomic, strong) NSMutableArray *priv_acceptedEvents;
+@property (nonatomic, assign) BOOL priv_eventFiltersValid;
+@property (nonatomic, strong) NSString *priv_lastEventName;
+@property (nonatomic, strong) NSError *lastError;
+@property (nonatomic, strong) TBSMScratchArena *priv_scratchArena;
 @end
 
+/**
+ *  The event whose run-to-completion step is running on the calling thread. Becomes the parent of every event scheduled or raised by it.
+ */
+static __thread __unsafe_unretained TBSMEvent *TBSMCurrentEvent = nil;
+
+/**
+ *  Returns the number of state machines on the path of a state machine without creating the path.
+ */
+static NSUInteger TBSMStateMachineLevel(TBSMStateMachine *stateMachine)
+{
+    NSUInteger level = 0;
+    while (stateMachine) {
+        level++;
+        stateMachine = (TBSMStateMachine *)stateMachine.parentVertex.parentVertex;
+    }
+    return level;
+}
+
+/**
+ *  Returns the state machine the specified number of levels above a state machine.
+ */
+static TBSMStateMachine *TBSMStateMachineAncestor(TBSMStateMachine *stateMachine, NSUInteger distance)
+{
+    for (NSUInteger index = 0; index < distance; index++) {
+        stateMachine = (TBSMStateMachine *)stateMachine.parentVertex.parentVertex;
+    }
+    return stateMachine;
+}
+
 @implementation TBSMStateMachine
+{
+    CFMutableBitVectorRef _activeStates;
+    CFMutableBitVectorRef _leafStates;
+    NSUInteger _lastEventIdentifier;
+    NSUInteger _configurationVersion;
+    NSUInteger _deferredEventsVersion;
+    NSUInteger _publishedConfigurationVersion;
+    void *_configurationSnapshot;
+    NSUInteger _snapshotReaders;
+}
 
 + (instancetype)stateMachineWithName:(NSString *)name
 {
@@ -30,6 +96,11 @@
     if (self) {
         _name = name.copy;
         _priv_states = [NSMutableArray new];
+        _eventQueue = [TBSMEventQueue new];
+        _priv_internalEvents = [NSMutableArray new];
+        _priv_deferredEvents = [NSMutableArray new];
+        _priv_statesByPath = [NSMutableDictionary new];
+        _priv_retiredSnapshots = [NSMutableArray new];
         _scheduledEventsQueue = [NSOperationQueue mainQueue];
     }
     return self;
@@ -39,11 +110,22 @@
 {
     [self.priv_states makeObjectsPerformSelector:@selector(removeTransitionVertexes)];
     [self.priv_states removeAllObjects];
+    [self.priv_statesByPath removeAllObjects];
 }
 
 - (void)dealloc
 {
     [self removeTransitionVertexes];
+    
+    if (_activeStates) {
+        CFRelease(_activeStates);
+    }
+    if (_leafStates) {
+        CFRelease(_leafStates);
+    }
+    if (_configurationSnapshot) {
+        CFRelease(_configurationSnapshot);
+    }
 }
 
 - (NSArray *)states
@@ -54,6 +136,7 @@
 - (void)setStates:(NSArray *)states
 {
     [self.priv_states removeAllObjects];
+    [self.priv_statesByPath removeAllObjects];
     
     for (id object in states) {
         if (![object isKindOfClass:[TBSMState class]])  {
@@ -84,46 +167,361 @@
     _scheduledEventsQueue = scheduledEventsQueue;
 }
 
+- (NSUInteger)starvationLimit
+{
+    return self.eventQueue.starvationLimit;
+}
+
+- (void)setStarvationLimit:(NSUInteger)starvationLimit
+{
+    self.eventQueue.starvationLimit = starvationLimit;
+}
+
+- (TBSMScratchArena *)scratchArena
+{
+    if (self.priv_scratchArena == nil) {
+        self.priv_scratchArena = [TBSMScratchArena new];
+    }
+    return self.priv_scratchArena;
+}
+
 - (void)setUp:(id)data
 {
     if (!self.initialState) {
-        @throw [NSException tbsm_noInitialStateException:self.name];
+        if (![self reportError:[NSError tbsm_noInitialStateError:self.name]]) {
+            @throw [NSException tbsm_noInitialStateException:self.name];
+        }
+        return;
+    }
+    if (self.parentVertex) {
+        [self enter:nil targetState:[self _defaultEntryState] data:data];
+        return;
+    }
+    @autoreleasepool {
+        TBSMProfiler *profiler = self.profiler;
+        TBSMScratchArena *scratchArena = self.scratchArena;
+        [profiler beginStep];
+        [scratchArena beginStep];
+        [self _indexStates];
+        [self _buildEventFilters];
+        self.priv_runningToCompletion = YES;
+        [self enter:nil targetState:self.initialState data:data];
+        [self _handleCompletionEventsWithData:data];
+        [self _handleInternalEvents];
+        self.priv_runningToCompletion = NO;
+        [scratchArena endStep];
+        [profiler endStepWithEventName:nil];
+        [self _publishConfigurationSnapshot];
+        [self _journalStepWithEvent:nil];
+    }
+}
+
+- (BOOL)setUpWithActiveStatesAtPaths:(NSArray<NSString *> *)paths error:(NSError **)error
+{
+    NSMutableArray *states = [NSMutableArray arrayWithCapacity:paths.count];
+    for (NSString *path in paths) {
+        TBSMState *state = [self _stateWithPath:path materialize:YES error:error];
+        if (state == nil) {
+            return NO;
+        }
+        [states addObject:state];
+    }
+    [self _indexStates];
+    [self _buildEventFilters];
+    for (TBSMState *state in states) {
+        [self _restoreState:state];
     }
-    [self enter:nil targetState:self.initialState data:data];
+    [self _restoreInitialStates];
+    [self _publishConfigurationSnapshot];
+    return YES;
 }
 
 - (void)tearDown:(id)data
 {
-    [self.scheduledEventsQueue cancelAllOperations];
+    if (self.parentVertex) {
+        // Sub state machines are torn down inside the step of the top state machine and share its queue.
+        [self _exitCurrentStateWithData:data];
+        return;
+    }
+    @autoreleasepool {
+        TBSMProfiler *profiler = self.profiler;
+        TBSMScratchArena *scratchArena = self.scratchArena;
+        [profiler beginStep];
+        [scratchArena beginStep];
+        [self.scheduledEventsQueue cancelAllOperations];
+        [self.eventQueue removeAllEvents];
+        [self.priv_internalEvents removeAllObjects];
+        [self.priv_deferredEvents removeAllObjects];
+        if (self.transitionInProgress) {
+            // The states below the pending transition have already been left.
+            [self.priv_pendingStateMachine _setCurrentState:nil];
+            [self _cancelPendingTransition];
+        }
+        self.priv_deferredEventCount = 0;
+        [self _exitCurrentStateWithData:data];
+        [scratchArena endStep];
+        [profiler endStepWithEventName:nil];
+        [self _publishConfigurationSnapshot];
+        [self.journal stateMachine:self didCompleteStepWithEvent:nil];
+    }
+}
+
+- (void)_exitCurrentStateWithData:(id)data
+{
+    if (self.currentState) {
+        self.lastActiveState = self.currentState;
+    }
     [self exit:self.currentState targetState:nil data:data];
-    _currentState = nil;
+    [self _setCurrentState:nil];
+    self.priv_completionPending = NO;
+}
+
+- (void)restoreHistory:(TBSMHistoryKind)kind
+{
+    self.priv_restoresHistory = YES;
+    self.priv_restoresDeepHistory = (kind == TBSMHistoryDeep);
+}
+
+- (TBSMState *)_defaultEntryState
+{
+    if (!self.priv_restoresHistory) {
+        return self.initialState;
+    }
+    self.priv_restoresHistory = NO;
+    
+    TBSMState *state = self.lastActiveState;
+    if (state == nil || state.parentVertex != self) {
+        return self.initialState;
+    }
+    if (self.priv_restoresDeepHistory) {
+        for (TBSMStateMachine *stateMachine in [self _materializedStateMachinesOfState:state]) {
+            [stateMachine restoreHistory:TBSMHistoryDeep];
+        }
+    }
+    return state;
 }
 
 #pragma mark - handling events
 
-- (void)scheduleEvent:(TBSMEvent *)event
+- (TBSMEventQueueStatus)scheduleEvent:(TBSMEvent *)event
 {
     if (self.parentVertex) {
         TBSMStateMachine *topStateMachine = (TBSMStateMachine *)[self.parentVertex parentVertex];
-        [topStateMachine scheduleEvent:event];
-        return;
+        return [topStateMachine scheduleEvent:event];
     }
     
-    [self.scheduledEventsQueue addOperationWithBlock:^{
+    [self _stampEvent:event];
+    
+    BOOL allowBlocking = ([NSOperationQueue currentQueue] != self.scheduledEventsQueue);
+    TBSMEventQueueStatus status = [self.eventQueue enqueueEvent:event allowBlocking:allowBlocking];
+    [self.eventRecorder stateMachine:self didScheduleEvent:event status:status];
+    if (status == TBSMEventQueueStatusEnqueued) {
+        [self.scheduledEventsQueue addOperationWithBlock:^{
+            [self _handleNextEvent];
+        }];
+    } else {
+        [self.latencyTracer recordDroppedEvent:event];
+    }
+    return status;
+}
+
+- (TBSMEventQueueStatus)scheduleEventNamed:(NSString *)name data:(id)data
+{
+    return [self scheduleEvent:[TBSMEvent eventWithName:name data:data]];
+}
+
+- (TBSMEventQueueStatus)scheduleEventNamed:(NSString *)name data:(id)data priority:(TBSMEventPriority)priority
+{
+    TBSMEvent *event = [TBSMEvent eventWithName:name data:data];
+    event.priority = priority;
+    return [self scheduleEvent:event];
+}
+
+- (void)_handleNextEvent
+{
+    if (self.transitionInProgress) {
+        self.priv_deferredEventCount++;
+        return;
+    }
+    // Drains the queue so events whose operation has been cancelled are not left behind.
+    TBSMEvent *event = nil;
+    while (!self.transitionInProgress && (event = [self.eventQueue dequeueEvent])) {
         [self handleEvent:event];
-    }];
+    }
 }
 
-- (void)scheduleEventNamed:(NSString *)name data:(id)data
+- (void)raiseEvent:(TBSMEvent *)event
 {
-    [self scheduleEvent:[TBSMEvent eventWithName:name data:data]];
+    if (self.parentVertex) {
+        TBSMStateMachine *topStateMachine = (TBSMStateMachine *)[self.parentVertex parentVertex];
+        [topStateMachine raiseEvent:event];
+        return;
+    }
+    [self _stampEvent:event];
+    if (self.priv_runningToCompletion) {
+        [self.priv_internalEvents addObject:event];
+        return;
+    }
+    [self handleEvent:event];
+}
+
+- (void)raiseEventNamed:(NSString *)name data:(id)data
+{
+    [self raiseEvent:[TBSMEvent eventWithName:name data:data]];
 }
 
 - (BOOL)handleEvent:(TBSMEvent *)event
+{
+    if (self.parentVertex) {
+        return [self _handleEvent:event];
+    }
+    if (event.enqueueTime == 0) {
+        [self _stampEvent:event];
+    }
+    if (self.transitionInProgress) {
+        [self.priv_internalEvents addObject:event];
+        return NO;
+    }
+    TBSMProfiler *profiler = self.profiler;
+    [profiler beginStep];
+    if (![self acceptsEvent:event] && ![self _isDeferredEvent:event]) {
+        [profiler endStepWithEventName:event.name];
+        if (self.latencyTracer) {
+            NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+            [self.latencyTracer recordEvent:event startTime:now finishTime:now];
+        }
+        return NO;
+    }
+    BOOL didHandleEvent = NO;
+    @autoreleasepool {
+        TBSMScratchArena *scratchArena = self.scratchArena;
+        [scratchArena beginStep];
+        self.priv_runningToCompletion = YES;
+        didHandleEvent = [self _processEvent:event];
+        [self _handleInternalEvents];
+        self.priv_runningToCompletion = NO;
+        [scratchArena endStep];
+        [profiler endStepWithEventName:event.name];
+        [self _publishConfigurationSnapshot];
+        [self _journalStepWithEvent:event];
+    }
+    return didHandleEvent;
+}
+
+- (void)_handleInternalEvents
+{
+    [self _releaseDeferredEvents];
+    while (self.priv_internalEvents.count > 0 && !self.transitionInProgress) {
+        TBSMEvent *event = self.priv_internalEvents.firstObject;
+        [self.priv_internalEvents removeObjectAtIndex:0];
+        [self _processEvent:event];
+        [self _releaseDeferredEvents];
+    }
+}
+
+/**
+ *  Handles an event and the resulting completion events while it is the current event of the calling thread.
+ *  Reports the step to the latency tracer unless the event has been deferred.
+ */
+- (BOOL)_processEvent:(TBSMEvent *)event
+{
+    TBSMLatencyTracer *latencyTracer = self.latencyTracer;
+    NSTimeInterval startTime = latencyTracer ? [NSProcessInfo processInfo].systemUptime : 0.0;
+    TBSMEvent *previousEvent = TBSMCurrentEvent;
+    TBSMCurrentEvent = event;
+    BOOL didHandleEvent = [self _handleDeferrableEvent:event];
+    [self _handleCompletionEventsWithData:event.data];
+    TBSMCurrentEvent = previousEvent;
+    
+    if (latencyTracer && self.priv_deferredEvents.lastObject != event) {
+        [latencyTracer recordEvent:event startTime:startTime finishTime:[NSProcessInfo processInfo].systemUptime];
+    }
+    return didHandleEvent;
+}
+
+/**
+ *  Stamps the enqueue time of an event and links it to the event whose step is running on the calling thread.
+ */
+- (void)_stampEvent:(TBSMEvent *)event
+{
+    TBSMEvent *cause = TBSMCurrentEvent;
+    event.enqueueTime = [NSProcessInfo processInfo].systemUptime;
+    if (cause == nil || cause == event) {
+        event.parentIdentifier = 0;
+        event.rootIdentifier = event.identifier;
+        event.rootEnqueueTime = event.enqueueTime;
+        return;
+    }
+    event.parentIdentifier = cause.identifier;
+    event.rootIdentifier = cause.rootIdentifier;
+    event.rootEnqueueTime = cause.rootEnqueueTime;
+    [self.latencyTracer recordScheduledEvent:event];
+}
+
+#pragma mark - Deferred events
+
+- (NSArray<TBSMEvent *> *)deferredEvents
+{
+    return [self _topStateMachine].priv_deferredEvents.copy;
+}
+
+/**
+ *  Handles an event and keeps it if no transition has consumed it while an active state defers it.
+ */
+- (BOOL)_handleDeferrableEvent:(TBSMEvent *)event
+{
+    if ([self _handleEvent:event]) {
+        return YES;
+    }
+    if ([self _isDeferredEvent:event]) {
+        [self.priv_deferredEvents addObject:event];
+        _deferredEventsVersion = _configurationVersion;
+    }
+    return NO;
+}
+
+- (BOOL)_isDeferredEvent:(TBSMEvent *)event
+{
+    if (!self.priv_eventFiltersValid && self.priv_indexedStates) {
+        [self _buildEventFilters];
+    }
+    for (TBSMState *state in self.priv_deferringStates[event.name]) {
+        if (CFBitVectorGetBitAtIndex(_activeStates, state.stateIndex)) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+/**
+ *  Moves all kept events which are no longer deferred to the internal events in their original order.
+ *  Only runs after the active configuration has changed.
+ */
+- (void)_releaseDeferredEvents
+{
+    if (self.priv_deferredEvents.count == 0 || _deferredEventsVersion == _configurationVersion) {
+        return;
+    }
+    _deferredEventsVersion = _configurationVersion;
+    NSIndexSet *indexes = [self.priv_deferredEvents indexesOfObjectsPassingTest:^BOOL(TBSMEvent *event, NSUInteger idx, BOOL *stop) {
+        return ![self _isDeferredEvent:event];
+    }];
+    if (indexes.count == 0) {
+        return;
+    }
+    NSArray *events = [self.priv_deferredEvents objectsAtIndexes:indexes];
+    [self.priv_deferredEvents removeObjectsAtIndexes:indexes];
+    [self.priv_internalEvents insertObjects:events atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, events.count)]];
+}
+
+- (BOOL)_handleEvent:(TBSMEvent *)event
 {
     if (self.currentState == nil) {
         return NO;
     }
+    if (![[self _topStateMachine] _state:self.currentState acceptsEvent:event]) {
+        return NO;
+    }
     
     if ([self.currentState respondsToSelector:@selector(handleEvent:)]) {
         if ([self.currentState performSelector:@selector(handleEvent:) withObject:event]) {
@@ -131,6 +529,12 @@
         }
     }
     NSArray *eventHandlers = [self.currentState eventHandlersForEvent:event];
+    return [self _performEventHandlers:eventHandlers eventName:event.name data:event.data];
+}
+
+- (BOOL)_performEventHandlers:(NSArray *)eventHandlers eventName:(NSString *)eventName data:(id)data
+{
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
     for (TBSMEventHandler *eventHandler in eventHandlers) {
         
         TBSMTransition *transition = nil;
@@ -140,70 +544,251 @@
                                                                 kind:eventHandler.kind
                                                               action:eventHandler.action
                                                                guard:eventHandler.guard
-                                                           eventName:event.name];
+                                                           eventName:eventName];
         } else {
             transition = [[TBSMCompoundTransition alloc] initWithSourceState:self.currentState
                                                            targetPseudoState:(TBSMPseudoState *)eventHandler.target
                                                                       action:eventHandler.action
                                                                        guard:eventHandler.guard
-                                                                   eventName:event.name];
+                                                                   eventName:eventName];
         }
-        if ([transition performTransitionWithData:event.data]) {
+        transition.actionFunction = eventHandler.actionFunction;
+        transition.guardFunction = eventHandler.guardFunction;
+        transition.context = eventHandler.context;
+        transition.asyncAction = eventHandler.asyncAction;
+        transition.eventHandler = eventHandler;
+        uint64_t start = [profiler beginCallback];
+        BOOL performed = [transition performTransitionWithData:data];
+        [profiler endTransition:(__bridge const void *)eventHandler start:start performed:performed name:^NSString *{
+            return transition.name;
+        }];
+        if (performed) {
             return YES;
         }
     }
     return NO;
 }
 
+#pragma mark - Completion transitions
+
+- (void)_handleCompletionEventsWithData:(id)data
+{
+    while (!self.transitionInProgress && [self _handleCompletionEventWithData:data]) {
+        // Every fired completion transition may complete further states.
+    }
+}
+
+- (BOOL)_handleCompletionEventWithData:(id)data
+{
+    TBSMState *state = self.currentState;
+    if (state == nil) {
+        return NO;
+    }
+    if ([state isKindOfClass:[TBSMSubState class]]) {
+        TBSMSubState *subState = (TBSMSubState *)state;
+        if ([subState.stateMachine _handleCompletionEventWithData:data]) {
+            return YES;
+        }
+    } else if ([state isKindOfClass:[TBSMParallelState class]]) {
+        TBSMParallelState *parallelState = (TBSMParallelState *)state;
+        for (TBSMStateMachine *stateMachine in parallelState.stateMachines) {
+            if ([stateMachine _handleCompletionEventWithData:data]) {
+                return YES;
+            }
+        }
+    }
+    if (self.priv_completionPending == NO || [self _isCompletedState:state] == NO) {
+        return NO;
+    }
+    self.priv_completionPending = NO;
+    return [self _performEventHandlers:state.completionHandlers eventName:TBSMCompletionEvent data:data];
+}
+
+- (BOOL)_isCompletedState:(TBSMState *)state
+{
+    if ([state isKindOfClass:[TBSMSubState class]]) {
+        TBSMSubState *subState = (TBSMSubState *)state;
+        return [subState.stateMachine.currentState isKindOfClass:[TBSMFinalState class]];
+    }
+    if ([state isKindOfClass:[TBSMParallelState class]]) {
+        TBSMParallelState *parallelState = (TBSMParallelState *)state;
+        for (TBSMStateMachine *stateMachine in parallelState.stateMachines) {
+            if ([stateMachine.currentState isKindOfClass:[TBSMFinalState class]] == NO) {
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
 #pragma mark - State switching
 
 - (void)switchState:(TBSMState *)sourceState targetState:(TBSMState *)targetState action:(TBSMActionBlock)action data:(id)data
 {
     [self.currentState exit:sourceState targetState:targetState data:data];
-    if (action) {
-        action(data);
-    }
+    [self _performAction:action data:data];
     [self enter:sourceState targetState:targetState data:data];
 }
 
 - (void)switchState:(TBSMState *)sourceState targetStates:(NSArray *)targetStates region:(TBSMParallelState *)region action:(TBSMActionBlock)action data:(id)data
 {
     [self.currentState exit:sourceState targetState:region data:data];
-    if (action) {
-        action(data);
+    [self _performAction:action data:data];
+    [self enter:sourceState targetStates:targetStates region:region data:data];
+}
+
+- (void)switchState:(TBSMState *)sourceState targetState:(TBSMState *)targetState transition:(TBSMTransition *)transition data:(id)data
+{
+    [self.currentState exit:sourceState targetState:targetState data:data];
+    [transition performActionWithData:data];
+    if (transition.asyncAction) {
+        [self _performAsyncActionOfTransition:transition data:data continuation:^{
+            [self enter:sourceState targetState:targetState data:data];
+        }];
+        return;
+    }
+    [self enter:sourceState targetState:targetState data:data];
+}
+
+- (void)switchState:(TBSMState *)sourceState targetStates:(NSArray *)targetStates region:(TBSMParallelState *)region transition:(TBSMTransition *)transition data:(id)data
+{
+    [self.currentState exit:sourceState targetState:region data:data];
+    [transition performActionWithData:data];
+    if (transition.asyncAction) {
+        [self _performAsyncActionOfTransition:transition data:data continuation:^{
+            [self enter:sourceState targetStates:targetStates region:region data:data];
+        }];
+        return;
     }
     [self enter:sourceState targetStates:targetStates region:region data:data];
 }
 
+- (void)_performAction:(TBSMActionBlock)action data:(id)data
+{
+    if (action == nil) {
+        return;
+    }
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    uint64_t start = [profiler beginCallback];
+    action(data);
+    // Actions passed without event handler are attributed to the state machine which performs them.
+    [profiler endCallback:TBSMProfileCategoryAction key:(__bridge const void *)self start:start name:^NSString *{
+        return self.name;
+    }];
+}
+
+- (void)_performAsyncActionOfTransition:(TBSMTransition *)transition data:(id)data continuation:(void (^)(void))continuation
+{
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    NSUInteger generation = ++topStateMachine.priv_transitionGeneration;
+    topStateMachine.transitionInProgress = YES;
+    topStateMachine.priv_pendingContinuation = continuation;
+    topStateMachine.priv_pendingData = data;
+    topStateMachine.priv_pendingStateMachine = self;
+    
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    uint64_t start = [profiler beginCallback];
+    __weak TBSMStateMachine *weakTopStateMachine = topStateMachine;
+    transition.asyncAction(data, ^{
+        [weakTopStateMachine.scheduledEventsQueue addOperationWithBlock:^{
+            [weakTopStateMachine _finishPendingTransition:generation];
+        }];
+    });
+    [profiler endCallback:TBSMProfileCategoryAction key:transition.profilerKey start:start name:^NSString *{
+        return transition.name;
+    }];
+}
+
+- (void)_finishPendingTransition:(NSUInteger)generation
+{
+    if (!self.transitionInProgress || generation != self.priv_transitionGeneration) {
+        return;
+    }
+    void (^continuation)(void) = self.priv_pendingContinuation;
+    id data = self.priv_pendingData;
+    TBSMEvent *event = self.priv_pendingEvent;
+    [self _cancelPendingTransition];
+    
+    @autoreleasepool {
+        TBSMProfiler *profiler = self.profiler;
+        TBSMScratchArena *scratchArena = self.scratchArena;
+        [profiler beginStep];
+        [scratchArena beginStep];
+        self.priv_runningToCompletion = YES;
+        continuation();
+        [self _handleCompletionEventsWithData:data];
+        [self _handleInternalEvents];
+        self.priv_runningToCompletion = NO;
+        [scratchArena endStep];
+        [profiler endStepWithEventName:event.name];
+        [self _publishConfigurationSnapshot];
+        [self _journalStepWithEvent:event];
+    }
+    
+    if (self.transitionInProgress) {
+        return;
+    }
+    NSUInteger count = self.priv_deferredEventCount;
+    self.priv_deferredEventCount = 0;
+    for (NSUInteger index = 0; index < count; index++) {
+        [self.scheduledEventsQueue addOperationWithBlock:^{
+            [self _handleNextEvent];
+        }];
+    }
+}
+
+- (void)_cancelPendingTransition
+{
+    self.transitionInProgress = NO;
+    self.priv_pendingContinuation = nil;
+    self.priv_pendingData = nil;
+    self.priv_pendingEvent = nil;
+    self.priv_pendingStateMachine = nil;
+}
+
+/**
+ *  Reports a completed step to the journal. Steps waiting for an asynchronous action are reported when it has finished.
+ */
+- (void)_journalStepWithEvent:(TBSMEvent *)event
+{
+    if (self.transitionInProgress) {
+        self.priv_pendingEvent = event;
+        return;
+    }
+    [self.journal stateMachine:self didCompleteStepWithEvent:event];
+}
+
 - (void)enter:(TBSMState *)sourceState targetState:(TBSMState *)targetState data:(id)data
 {
-    NSUInteger targetLevel = targetState.parentVertex.path.count;
-    NSUInteger thisLevel = self.path.count;
+    TBSMStateMachine *targetStateMachine = (TBSMStateMachine *)targetState.parentVertex;
+    NSUInteger targetLevel = TBSMStateMachineLevel(targetStateMachine);
+    NSUInteger thisLevel = TBSMStateMachineLevel(self);
     
     if (targetLevel < thisLevel) {
-        _currentState = self.initialState;
+        [self _setCurrentState:[self _defaultEntryState]];
     } else if (targetLevel == thisLevel) {
-        _currentState = targetState;
+        [self _setCurrentState:targetState];
     } else {
-        NSArray *targetPath = [targetState.parentVertex path];
-        id<TBSMHierarchyVertex> vertex = targetPath[thisLevel];
-        _currentState = (TBSMState *)vertex.parentVertex;
+        TBSMStateMachine *stateMachine = TBSMStateMachineAncestor(targetStateMachine, targetLevel - thisLevel - 1);
+        [self _setCurrentState:(TBSMState *)stateMachine.parentVertex];
     }
+    self.priv_completionPending = YES;
     [self.currentState enter:sourceState targetState:targetState data:data];
 }
 
 - (void)enter:(TBSMState *)sourceState targetStates:(NSArray *)targetStates region:(TBSMParallelState *)region data:(id)data
 {
-    NSUInteger targetLevel = [[region.parentVertex path] count];
-    NSUInteger thisLevel = self.path.count;
+    TBSMStateMachine *targetStateMachine = (TBSMStateMachine *)region.parentVertex;
+    NSUInteger targetLevel = TBSMStateMachineLevel(targetStateMachine);
+    NSUInteger thisLevel = TBSMStateMachineLevel(self);
     
     if (targetLevel == thisLevel) {
-        _currentState = region;
+        [self _setCurrentState:region];
     } else if (targetLevel > thisLevel) {
-        NSArray *targetPath = [region.parentVertex path];
-        id<TBSMHierarchyVertex> vertex = targetPath[thisLevel];
-        _currentState = (TBSMState *)vertex.parentVertex;
+        TBSMStateMachine *stateMachine = TBSMStateMachineAncestor(targetStateMachine, targetLevel - thisLevel - 1);
+        [self _setCurrentState:(TBSMState *)stateMachine.parentVertex];
     }
+    self.priv_completionPending = YES;
     id<TBSMContainingVertex> vertex = (id <TBSMContainingVertex>)_currentState;
     [vertex enter:sourceState targetStates:targetStates region:region data:data];
 }
@@ -215,43 +800,121 @@
 
 - (void)subscribeToEntryAtPath:(NSString *)path forObserver:(NSObject *)observer selector:(nonnull SEL)selector
 {
-    TBSMState *state = [self stateWithPath:path];
-    [[NSNotificationCenter defaultCenter] addObserver:observer selector:selector name:TBSMStateDidEnterNotification object:state];
+    [self _addObserver:observer selector:selector name:TBSMStateDidEnterNotification path:path];
 }
 
 - (void)subscribeToExitAtPath:(NSString *)path forObserver:(NSObject *)observer selector:(nonnull SEL)selector
 {
-    TBSMState *state = [self stateWithPath:path];
-    [[NSNotificationCenter defaultCenter] addObserver:observer selector:selector name:TBSMStateDidExitNotification object:state];
+    [self _addObserver:observer selector:selector name:TBSMStateDidExitNotification path:path];
 }
 
 - (void)subscribeToAction:(NSString *)action atPath:(NSString *)path forObserver:(NSObject *)observer selector:(nonnull SEL)selector
 {
-    TBSMState *state = [self stateWithPath:path];
-    [[NSNotificationCenter defaultCenter] addObserver:observer selector:selector name:action object:state];
+    [self _addObserver:observer selector:selector name:action path:path];
 }
 
 - (void)unsubscribeFromEntryAtPath:(NSString *)path forObserver:(NSObject *)observer
 {
-    TBSMState *state = [self stateWithPath:path];
-    [[NSNotificationCenter defaultCenter] removeObserver:observer name:TBSMStateDidEnterNotification object:state];
+    [self _removeObserver:observer name:TBSMStateDidEnterNotification path:path];
 }
 
 - (void)unsubscribeFromExitAtPath:(NSString *)path forObserver:(NSObject *)observer
 {
-    TBSMState *state = [self stateWithPath:path];
-    [[NSNotificationCenter defaultCenter] removeObserver:observer name:TBSMStateDidExitNotification object:state];
+    [self _removeObserver:observer name:TBSMStateDidExitNotification path:path];
 }
 
 - (void)unsubscribeFromAction:(NSString *)action atPath:(NSString *)path forObserver:(NSObject *)observer
 {
+    [self _removeObserver:observer name:action path:path];
+}
+
+- (void)_addObserver:(NSObject *)observer selector:(SEL)selector name:(NSString *)name path:(NSString *)path
+{
+    NSUInteger region = 0;
+    NSString *remainingPath = nil;
+    TBSMState *deferredState = [self _deferredStateOnPath:path region:&region remainingPath:&remainingPath];
+    if (deferredState) {
+        TBSMDeferredContent *content = [self _deferredContentOfState:deferredState];
+        [content addObserver:observer selector:selector name:name path:remainingPath region:region stateMachines:[self _materializedStateMachinesOfState:deferredState]];
+        return;
+    }
     TBSMState *state = [self stateWithPath:path];
-    [[NSNotificationCenter defaultCenter] removeObserver:observer name:action object:state];
+    [[NSNotificationCenter defaultCenter] addObserver:observer selector:selector name:name object:state];
+}
+
+- (void)_removeObserver:(NSObject *)observer name:(NSString *)name path:(NSString *)path
+{
+    NSUInteger region = 0;
+    NSString *remainingPath = nil;
+    TBSMState *deferredState = [self _deferredStateOnPath:path region:&region remainingPath:&remainingPath];
+    if (deferredState) {
+        TBSMDeferredContent *content = [self _deferredContentOfState:deferredState];
+        [content removeObserver:observer name:name path:remainingPath region:region stateMachines:[self _materializedStateMachinesOfState:deferredState]];
+        return;
+    }
+    TBSMState *state = [self stateWithPath:path];
+    [[NSNotificationCenter defaultCenter] removeObserver:observer name:name object:state];
+}
+
+/**
+ *  Returns the outermost deferred state on the specified path without building it.
+ *  Returns `nil` if the path does not lead through a deferred state.
+ */
+- (TBSMState *)_deferredStateOnPath:(NSString *)path region:(NSUInteger *)region remainingPath:(NSString **)remainingPath
+{
+    TBSMStateMachine *statemachine = self;
+    NSArray *components = [path componentsSeparatedByString:@"/"];
+    for (NSUInteger index = 0; index < components.count - 1; index++) {
+        NSArray *elements = [components[index] componentsSeparatedByString:@"@"];
+        TBSMState *state = [statemachine _stateWithName:elements.firstObject];
+        NSInteger regionIndex = 0;
+        
+        if ([state isKindOfClass:TBSMParallelState.class]) {
+            regionIndex = [elements.lastObject integerValue];
+        } else if (![state isKindOfClass:TBSMSubState.class]) {
+            return nil;
+        }
+        if ([self _deferredContentOfState:state]) {
+            *region = regionIndex;
+            *remainingPath = [[components subarrayWithRange:NSMakeRange(index + 1, components.count - index - 1)] componentsJoinedByString:@"/"];
+            return state;
+        }
+        NSArray *stateMachines = [self _materializedStateMachinesOfState:state];
+        if (regionIndex < 0 || regionIndex >= stateMachines.count) {
+            return nil;
+        }
+        statemachine = stateMachines[regionIndex];
+    }
+    return nil;
+}
+
+- (TBSMDeferredContent *)_deferredContentOfState:(TBSMState *)state
+{
+    if ([state isKindOfClass:TBSMSubState.class]) {
+        return [(TBSMSubState *)state deferredContent];
+    }
+    if ([state isKindOfClass:TBSMParallelState.class]) {
+        return [(TBSMParallelState *)state deferredContent];
+    }
+    return nil;
+}
+
+- (NSArray<TBSMStateMachine *> *)_materializedStateMachinesOfState:(TBSMState *)state
+{
+    if ([state isKindOfClass:TBSMSubState.class]) {
+        TBSMSubState *subState = (TBSMSubState *)state;
+        return subState.isMaterialized ? @[subState.stateMachine] : nil;
+    }
+    if ([state isKindOfClass:TBSMParallelState.class]) {
+        TBSMParallelState *parallelState = (TBSMParallelState *)state;
+        return parallelState.isMaterialized ? parallelState.stateMachines : nil;
+    }
+    return nil;
 }
 
 - (TBSMState *)_stateWithName:(NSString *)name
 {
-    for (TBSMState *state in self.states) {
+    for (TBSMState *state in self.priv_states) {
         if ([state.name isEqualToString:name]) {
             return state;
         }
@@ -260,40 +923,454 @@
 }
 
 - (TBSMState *)stateWithPath:(NSString *)path
+{
+    NSError *error = nil;
+    TBSMState *state = [self stateWithPath:path error:&error];
+    if (state == nil) {
+        if (error.code == TBSMErrorCodeUnmaterializedPath) {
+            @throw [NSException tbsm_unmaterializedPath:path];
+        }
+        @throw [NSException tbsm_invalidPath:path];
+    }
+    return state;
+}
+
+- (TBSMState *)stateWithPath:(NSString *)path error:(NSError **)error
+{
+    return [self _stateWithPath:path materialize:NO error:error];
+}
+
+- (TBSMState *)_stateWithPath:(NSString *)path materialize:(BOOL)materialize error:(NSError **)error
 {
     TBSMStateMachine *statemachine = self;
     TBSMState *state;
     
     NSArray *components = [path componentsSeparatedByString:@"/"];
-    for (NSString *component in components) {
-        NSArray *elements = [component componentsSeparatedByString:@"@"];
+    for (NSUInteger index = 0; index < components.count; index++) {
+        NSArray *elements = [components[index] componentsSeparatedByString:@"@"];
         NSString *name = elements.firstObject;
         NSString *region = elements.lastObject;
         
         state = [statemachine _stateWithName:name];
         
-        if ([state isKindOfClass:TBSMSubState.class]) {
-            TBSMSubState *sub = (TBSMSubState *)state;
-            statemachine = sub.stateMachine;
+        if (![state isKindOfClass:TBSMSubState.class] && ![state isKindOfClass:TBSMParallelState.class]) {
+            continue;
         }
-        if ([state isKindOfClass:TBSMParallelState.class]) {
-            if (region == nil) {
-                @throw [NSException tbsm_invalidPath:path];
+        BOOL lastComponent = (index == components.count - 1);
+        NSArray<TBSMStateMachine *> *stateMachines = [self _materializedStateMachinesOfState:state];
+        if (stateMachines == nil && [self _deferredContentOfState:state]) {
+            if (lastComponent) {
+                break;
             }
-            TBSMParallelState *par = (TBSMParallelState *)state;
-            NSInteger index = region.integerValue;
-            if (index < 0 || index >= par.stateMachines.count) {
-                @throw [NSException tbsm_invalidPath:path];
+            if (!materialize) {
+                if (error) {
+                    *error = [NSError tbsm_unmaterializedPathError:path];
+                }
+                return nil;
+            }
+            if ([state isKindOfClass:TBSMSubState.class]) {
+                [(TBSMSubState *)state stateMachine];
+            } else {
+                [(TBSMParallelState *)state stateMachines];
             }
-            statemachine = par.stateMachines[index];
+            stateMachines = [self _materializedStateMachinesOfState:state];
         }
+        NSInteger regionIndex = [state isKindOfClass:TBSMParallelState.class] ? region.integerValue : 0;
+        if (regionIndex < 0 || regionIndex >= (NSInteger)stateMachines.count) {
+            if (lastComponent && stateMachines.count == 0) {
+                break;
+            }
+            return [self _invalidPath:path error:error];
+        }
+        statemachine = stateMachines[regionIndex];
     }
     if (state == nil) {
-        @throw [NSException tbsm_invalidPath:path];
+        return [self _invalidPath:path error:error];
     }
     return state;
 }
 
+- (NSString *)pathOfState:(TBSMState *)state
+{
+    NSMutableArray *components = [NSMutableArray arrayWithObject:state.name];
+    TBSMStateMachine *stateMachine = (TBSMStateMachine *)state.parentVertex;
+    while (stateMachine.parentVertex) {
+        TBSMState *containingState = (TBSMState *)stateMachine.parentVertex;
+        NSString *component = containingState.name;
+        if ([containingState isKindOfClass:[TBSMParallelState class]]) {
+            NSArray *regions = [self _materializedStateMachinesOfState:containingState];
+            NSUInteger region = regions ? [regions indexOfObject:stateMachine] : NSNotFound;
+            if (region != NSNotFound) {
+                component = [NSString stringWithFormat:@"%@@%lu", component, (unsigned long)region];
+            }
+        }
+        [components insertObject:component atIndex:0];
+        stateMachine = (TBSMStateMachine *)containingState.parentVertex;
+    }
+    return [components componentsJoinedByString:@"/"];
+}
+
+- (TBSMState *)_invalidPath:(NSString *)path error:(NSError **)error
+{
+    if (error) {
+        *error = [NSError tbsm_invalidPathError:path];
+    }
+    return nil;
+}
+
+#pragma mark - Error handling
+
+- (BOOL)reportError:(NSError *)error
+{
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    if (topStateMachine.errorMode == TBSMErrorModeThrow) {
+        return NO;
+    }
+    topStateMachine.lastError = error;
+    if (topStateMachine.errorHandler) {
+        topStateMachine.errorHandler(error);
+    }
+    return YES;
+}
+
+#pragma mark - Active state configuration
+
+- (BOOL)isActive:(TBSMState *)state
+{
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    if (![topStateMachine _isIndexedState:state]) {
+        return NO;
+    }
+    return CFBitVectorGetBitAtIndex(topStateMachine->_activeStates, state.stateIndex);
+}
+
+- (BOOL)isActiveAtPath:(NSString *)path
+{
+    TBSMState *state = self.priv_statesByPath[path];
+    if (state == nil) {
+        NSUInteger region = 0;
+        NSString *remainingPath = nil;
+        TBSMState *deferredState = [self _deferredStateOnPath:path region:&region remainingPath:&remainingPath];
+        if (deferredState) {
+            NSArray *stateMachines = [self _materializedStateMachinesOfState:deferredState];
+            if (region >= stateMachines.count) {
+                return NO;
+            }
+            return [stateMachines[region] isActiveAtPath:remainingPath];
+        }
+        NSError *error = nil;
+        state = [self stateWithPath:path error:&error];
+        if (state == nil) {
+            if (![self reportError:error]) {
+                @throw [NSException tbsm_invalidPath:path];
+            }
+            return NO;
+        }
+        self.priv_statesByPath[path] = state;
+    }
+    return [self isActive:state];
+}
+
+- (void)enumerateActiveLeafStatesUsingBlock:(void (^)(TBSMState *state, BOOL *stop))block
+{
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    if (topStateMachine->_activeStates == NULL) {
+        return;
+    }
+    CFIndex count = CFBitVectorGetCount(topStateMachine->_activeStates);
+    CFIndex index = CFBitVectorGetFirstIndexOfBit(topStateMachine->_activeStates, CFRangeMake(0, count), 1);
+    BOOL stop = NO;
+    while (index != kCFNotFound && !stop) {
+        if (CFBitVectorGetBitAtIndex(topStateMachine->_leafStates, index)) {
+            block(topStateMachine.priv_indexedStates[index], &stop);
+        }
+        index = CFBitVectorGetFirstIndexOfBit(topStateMachine->_activeStates, CFRangeMake(index + 1, count - index - 1), 1);
+    }
+}
+
+- (TBSMConfigurationSnapshot *)configurationSnapshot
+{
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    
+    // Announce the reader before loading the pointer so the publishing thread keeps replaced snapshots alive.
+    __atomic_fetch_add(&topStateMachine->_snapshotReaders, 1, __ATOMIC_SEQ_CST);
+    CFTypeRef snapshot = __atomic_load_n(&topStateMachine->_configurationSnapshot, __ATOMIC_SEQ_CST);
+    if (snapshot) {
+        CFRetain(snapshot);
+    }
+    __atomic_fetch_sub(&topStateMachine->_snapshotReaders, 1, __ATOMIC_SEQ_CST);
+    return snapshot ? CFBridgingRelease(snapshot) : nil;
+}
+
+/**
+ *  Publishes the active state configuration after a completed step if it has changed.
+ *  Steps waiting for an asynchronous action are published when it has finished.
+ */
+- (void)_publishConfigurationSnapshot
+{
+    if (self.parentVertex || self.transitionInProgress) {
+        return;
+    }
+    if (_configurationSnapshot && _publishedConfigurationVersion == _configurationVersion) {
+        return;
+    }
+    _publishedConfigurationVersion = _configurationVersion;
+    
+    NSMutableArray *paths = [NSMutableArray new];
+    NSMutableArray *leafPaths = [NSMutableArray new];
+    if (_activeStates) {
+        CFIndex count = CFBitVectorGetCount(_activeStates);
+        CFIndex index = CFBitVectorGetFirstIndexOfBit(_activeStates, CFRangeMake(0, count), 1);
+        while (index != kCFNotFound) {
+            NSString *path = self.priv_indexedStatePaths[index];
+            [paths addObject:path];
+            if (CFBitVectorGetBitAtIndex(_leafStates, index)) {
+                [leafPaths addObject:path];
+            }
+            index = CFBitVectorGetFirstIndexOfBit(_activeStates, CFRangeMake(index + 1, count - index - 1), 1);
+        }
+    }
+    TBSMConfigurationSnapshot *snapshot = [[TBSMConfigurationSnapshot alloc] initWithVersion:_configurationVersion activeStatePaths:paths activeLeafStatePaths:leafPaths];
+    void *retiredSnapshot = __atomic_exchange_n(&_configurationSnapshot, (void *)CFBridgingRetain(snapshot), __ATOMIC_SEQ_CST);
+    if (retiredSnapshot) {
+        [self.priv_retiredSnapshots addObject:CFBridgingRelease(retiredSnapshot)];
+    }
+    
+    // A reader which has loaded a retired pointer is still counted until it has retained it.
+    // Without any reader all retired snapshots are either released or owned by their readers.
+    if (__atomic_load_n(&_snapshotReaders, __ATOMIC_SEQ_CST) == 0) {
+        [self.priv_retiredSnapshots removeAllObjects];
+    }
+}
+
+- (BOOL)acceptsEvent:(TBSMEvent *)event
+{
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    TBSMState *state = topStateMachine.currentState;
+    if (state == nil) {
+        return NO;
+    }
+    return [topStateMachine _state:state acceptsEvent:event];
+}
+
+- (void)invalidateEventFilters
+{
+    [self _topStateMachine].priv_eventFiltersValid = NO;
+}
+
+- (void)invalidateStateIndex
+{
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    [topStateMachine.priv_statesByPath removeAllObjects];
+    if (topStateMachine.priv_indexedStates == nil) {
+        return;
+    }
+    [topStateMachine _indexStates];
+    [topStateMachine _markActiveStates];
+    topStateMachine.priv_eventFiltersValid = NO;
+    topStateMachine->_configurationVersion++;
+}
+
+- (BOOL)_state:(TBSMState *)state acceptsEvent:(TBSMEvent *)event
+{
+    if (!self.priv_eventFiltersValid && self.priv_indexedStates) {
+        [self _buildEventFilters];
+    }
+    if (![self _isIndexedState:state]) {
+        return YES;
+    }
+    NSUInteger identifier = [self _identifierForEventName:event.name];
+    if (identifier == NSNotFound) {
+        return NO;
+    }
+    CFBitVectorRef acceptedEvents = (__bridge CFBitVectorRef)self.priv_acceptedEvents[state.stateIndex];
+    return CFBitVectorGetBitAtIndex(acceptedEvents, identifier);
+}
+
+- (NSUInteger)_identifierForEventName:(NSString *)name
+{
+    if (name != self.priv_lastEventName) {
+        NSNumber *identifier = self.priv_eventIdentifiers[name];
+        _lastEventIdentifier = identifier ? identifier.unsignedIntegerValue : NSNotFound;
+        self.priv_lastEventName = name;
+    }
+    return _lastEventIdentifier;
+}
+
+- (void)_buildEventFilters
+{
+    NSArray *states = self.priv_indexedStates;
+    NSMutableDictionary *identifiers = [NSMutableDictionary new];
+    for (TBSMState *state in states) {
+        [state compactEventHandlers];
+        [state enumerateEventHandlersUsingBlock:^(NSString *name, NSArray *eventHandlers, BOOL *stop) {
+            if (identifiers[name] == nil) {
+                identifiers[name] = @(identifiers.count);
+            }
+        }];
+    }
+    
+    NSMutableArray *acceptedEvents = [NSMutableArray arrayWithCapacity:states.count];
+    for (TBSMState *state in states) {
+        CFMutableBitVectorRef bits = CFBitVectorCreateMutable(kCFAllocatorDefault, identifiers.count);
+        CFBitVectorSetCount(bits, identifiers.count);
+        [state enumerateEventHandlersUsingBlock:^(NSString *name, NSArray *eventHandlers, BOOL *stop) {
+            CFBitVectorSetBitAtIndex(bits, [identifiers[name] unsignedIntegerValue], 1);
+        }];
+        [acceptedEvents addObject:CFBridgingRelease(bits)];
+    }
+    
+    // States are indexed depth first, so descendants always have a higher index than their ancestors.
+    for (NSInteger index = states.count - 1; index >= 0; index--) {
+        TBSMState *state = states[index];
+        TBSMState *parentState = (TBSMState *)[state.parentVertex parentVertex];
+        if (![self _isIndexedState:parentState]) {
+            continue;
+        }
+        CFMutableBitVectorRef parentBits = (__bridge CFMutableBitVectorRef)acceptedEvents[parentState.stateIndex];
+        CFBitVectorRef bits = (__bridge CFBitVectorRef)acceptedEvents[index];
+        CFIndex bit = CFBitVectorGetFirstIndexOfBit(bits, CFRangeMake(0, identifiers.count), 1);
+        while (bit != kCFNotFound) {
+            CFBitVectorSetBitAtIndex(parentBits, bit, 1);
+            bit = CFBitVectorGetFirstIndexOfBit(bits, CFRangeMake(bit + 1, identifiers.count - bit - 1), 1);
+        }
+    }
+    
+    NSMutableDictionary *deferringStates = [NSMutableDictionary new];
+    for (TBSMState *state in states) {
+        for (NSString *name in state.deferredEvents) {
+            deferringStates[name] = [deferringStates[name] ?: @[] arrayByAddingObject:state];
+        }
+    }
+    self.priv_eventIdentifiers = identifiers;
+    self.priv_acceptedEvents = acceptedEvents;
+    self.priv_deferringStates = deferringStates;
+    self.priv_lastEventName = nil;
+    self.priv_eventFiltersValid = YES;
+}
+
+- (TBSMStateMachine *)_topStateMachine
+{
+    TBSMStateMachine *stateMachine = self;
+    while (stateMachine.parentVertex) {
+        stateMachine = (TBSMStateMachine *)stateMachine.parentVertex.parentVertex;
+    }
+    return stateMachine;
+}
+
+- (void)_setCurrentState:(TBSMState *)state
+{
+    if (_currentState == state) {
+        return;
+    }
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    if ([topStateMachine _isIndexedState:_currentState]) {
+        CFBitVectorSetBitAtIndex(topStateMachine->_activeStates, _currentState.stateIndex, 0);
+    }
+    _currentState = state;
+    if ([topStateMachine _isIndexedState:state]) {
+        CFBitVectorSetBitAtIndex(topStateMachine->_activeStates, state.stateIndex, 1);
+    }
+    topStateMachine->_configurationVersion++;
+}
+
+- (BOOL)_isIndexedState:(TBSMState *)state
+{
+    if (state == nil || _activeStates == NULL) {
+        return NO;
+    }
+    NSUInteger index = state.stateIndex;
+    return (index < self.priv_indexedStates.count && self.priv_indexedStates[index] == state);
+}
+
+- (void)_indexStates
+{
+    NSMutableArray *states = [NSMutableArray new];
+    [self _collectStates:states];
+    
+    if (_activeStates) {
+        CFRelease(_activeStates);
+    }
+    if (_leafStates) {
+        CFRelease(_leafStates);
+    }
+    _activeStates = CFBitVectorCreateMutable(kCFAllocatorDefault, states.count);
+    _leafStates = CFBitVectorCreateMutable(kCFAllocatorDefault, states.count);
+    CFBitVectorSetCount(_activeStates, states.count);
+    CFBitVectorSetCount(_leafStates, states.count);
+    
+    NSMutableArray *paths = [NSMutableArray arrayWithCapacity:states.count];
+    [states enumerateObjectsUsingBlock:^(TBSMState *state, NSUInteger index, BOOL *stop) {
+        state.stateIndex = index;
+        [paths addObject:[self pathOfState:state]];
+        if (![state isKindOfClass:[TBSMSubState class]] && ![state isKindOfClass:[TBSMParallelState class]]) {
+            CFBitVectorSetBitAtIndex(self->_leafStates, index, 1);
+        }
+    }];
+    self.priv_indexedStates = states;
+    self.priv_indexedStatePaths = paths;
+}
+
+- (void)_collectStates:(NSMutableArray *)states
+{
+    for (TBSMState *state in self.priv_states) {
+        [states addObject:state];
+        for (TBSMStateMachine *stateMachine in [self _materializedStateMachinesOfState:state]) {
+            [stateMachine _collectStates:states];
+        }
+    }
+}
+
+/**
+ *  Makes the specified state and all its ancestors current without entering them.
+ */
+- (void)_restoreState:(TBSMState *)state
+{
+    TBSMState *currentState = state;
+    TBSMStateMachine *stateMachine = (TBSMStateMachine *)state.parentVertex;
+    while (stateMachine) {
+        [stateMachine _setCurrentState:currentState];
+        currentState = (TBSMState *)stateMachine.parentVertex;
+        stateMachine = (TBSMStateMachine *)currentState.parentVertex;
+    }
+}
+
+/**
+ *  Makes the initial state current in every active state machine which has no current state yet.
+ */
+- (void)_restoreInitialStates
+{
+    if (self.currentState == nil) {
+        [self _setCurrentState:self.initialState];
+    }
+    TBSMState *state = self.currentState;
+    NSArray *stateMachines = nil;
+    if ([state isKindOfClass:TBSMSubState.class]) {
+        TBSMStateMachine *stateMachine = [(TBSMSubState *)state stateMachine];
+        stateMachines = stateMachine ? @[stateMachine] : nil;
+    } else if ([state isKindOfClass:TBSMParallelState.class]) {
+        stateMachines = [(TBSMParallelState *)state stateMachines];
+    }
+    for (TBSMStateMachine *stateMachine in stateMachines) {
+        [stateMachine _restoreInitialStates];
+    }
+}
+
+- (void)_markActiveStates
+{
+    TBSMState *state = self.currentState;
+    if (state == nil) {
+        return;
+    }
+    TBSMStateMachine *topStateMachine = [self _topStateMachine];
+    if ([topStateMachine _isIndexedState:state]) {
+        CFBitVectorSetBitAtIndex(topStateMachine->_activeStates, state.stateIndex, 1);
+    }
+    for (TBSMStateMachine *stateMachine in [self _materializedStateMachinesOfState:state]) {
+        [stateMachine _markActiveStates];
+    }
+}
+
 #pragma mark - TBSMHierarchyVertex
 
 - (NSArray *)path
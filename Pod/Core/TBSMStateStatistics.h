@@ -0,0 +1,73 @@
+//
+//  TBSMStateStatistics.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class represents the dwell time of a single state inside a `TBSMProfiler`.
+ */
+@interface TBSMStateStatistics : NSObject
+
+/**
+ *  The name of the state.
+ */
+@property (nonatomic, copy, readonly) NSString *name;
+
+/**
+ *  The number of times the state has been entered.
+ */
+@property (nonatomic, assign, readonly) NSUInteger entryCount;
+
+/**
+ *  `YES` if the state was active when the statistics have been sampled.
+ */
+@property (nonatomic, assign, readonly, getter=isActive) BOOL active;
+
+/**
+ *  The time spent inside the state in seconds including the running visit up to the last sample.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval totalDwellTime;
+
+/**
+ *  The mean time of all finished visits in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval meanDwellTime;
+
+/**
+ *  Creates empty statistics.
+ *
+ *  @param name The name of the state.
+ *
+ *  @return The statistics instance.
+ */
+- (instancetype)initWithName:(NSString *)name;
+
+/**
+ *  Starts a visit.
+ *
+ *  @param time The monotonic time of the entry in seconds.
+ */
+- (void)enterAtTime:(NSTimeInterval)time;
+
+/**
+ *  Finishes the running visit.
+ *
+ *  @param time The monotonic time of the exit in seconds.
+ */
+- (void)exitAtTime:(NSTimeInterval)time;
+
+/**
+ *  Returns a copy whose `totalDwellTime` includes the running visit. The receiver is not modified.
+ *
+ *  @param time The current monotonic time in seconds.
+ *
+ *  @return The sampled copy.
+ */
+- (TBSMStateStatistics *)statisticsSampledAtTime:(NSTimeInterval)time;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,65 @@
+//
+//  TBSMStateStatistics.m
+//  TBStateMachine
+//
+
+#import "TBSMStateStatistics.h"
+
+@interface TBSMStateStatistics ()
+@property (nonatomic, assign) NSUInteger entryCount;
+@property (nonatomic, assign) BOOL active;
+@property (nonatomic, assign) NSTimeInterval totalDwellTime;
+@end
+
+@implementation TBSMStateStatistics
+{
+    NSTimeInterval _entryTime;
+    NSTimeInterval _finishedDwellTime;
+    NSUInteger _finishedVisits;
+}
+
+- (instancetype)initWithName:(NSString *)name
+{
+    self = [super init];
+    if (self) {
+        _name = name.copy;
+    }
+    return self;
+}
+
+- (NSTimeInterval)meanDwellTime
+{
+    return _finishedVisits ? _finishedDwellTime / _finishedVisits : 0.0;
+}
+
+- (void)enterAtTime:(NSTimeInterval)time
+{
+    self.entryCount++;
+    self.active = YES;
+    _entryTime = time;
+}
+
+- (void)exitAtTime:(NSTimeInterval)time
+{
+    if (!self.active) {
+        return;
+    }
+    self.active = NO;
+    _finishedDwellTime += MAX(time - _entryTime, 0.0);
+    _finishedVisits++;
+    self.totalDwellTime = _finishedDwellTime;
+}
+
+- (TBSMStateStatistics *)statisticsSampledAtTime:(NSTimeInterval)time
+{
+    TBSMStateStatistics *statistics = [[TBSMStateStatistics alloc] initWithName:self.name];
+    statistics.entryCount = self.entryCount;
+    statistics.active = self.active;
+    statistics.totalDwellTime = _finishedDwellTime + (self.active ? MAX(time - _entryTime, 0.0) : 0.0);
+    statistics->_entryTime = _entryTime;
+    statistics->_finishedDwellTime = _finishedDwellTime;
+    statistics->_finishedVisits = _finishedVisits;
+    return statistics;
+}
+
+@end
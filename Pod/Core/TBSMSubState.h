@@ -9,6 +9,7 @@
 #import <Foundation/Foundation.h>
 #import "TBSMState.h"
 #import "TBSMContainingVertex.h"
+#import "TBSMDeferredContent.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -21,9 +22,21 @@ NS_ASSUME_NONNULL_BEGIN
 
 /**
  *  The `TBSMStateMachine` instance contained in this sub state.
+ *
+ *  Builds a deferred state machine when it has not been built yet.
  */
 @property (nonatomic, strong) TBSMStateMachine *stateMachine;
 
+/**
+ *  The deferred content of this sub state or `nil` if the state machine has been set directly.
+ */
+@property (nonatomic, strong, readonly, nullable) TBSMDeferredContent *deferredContent;
+
+/**
+ *  `YES` if the state machine has been built.
+ */
+@property (nonatomic, assign, readonly, getter=isMaterialized) BOOL materialized;
+
 /**
  *  Creates a `TBSMSUBState` with a specified name.
  *
@@ -45,5 +58,18 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)setStates:(NSArray<__kindof TBSMState *> *)states;
 
+/**
+ *  Defers the construction of the contained state machine until the sub state is entered
+ *  or a state inside of it is looked up by path.
+ *
+ *  The configuration block receives the sub state and should call `-setStates:` and add the
+ *  event handlers of the contained states.
+ *
+ *  @param configuration   The block which configures the sub state.
+ *  @param releaseInterval The time in seconds after which the state machine will be released again
+ *                         once the sub state has been exited. Pass `0` to keep it.
+ */
+- (void)setStatesWithConfiguration:(TBSMDeferredConfigurationBlock)configuration releaseInterval:(NSTimeInterval)releaseInterval;
+
 @end
 NS_ASSUME_NONNULL_END
@@ -8,11 +8,17 @@
 
 #import "TBSMSubState.h"
 #import "TBSMStateMachine.h"
+#import "TBSMState+Private.h"
 #import "NSException+TBStateMachine.h"
 
+@interface TBSMSubState ()
+@property (nonatomic, strong, readwrite, nullable) TBSMDeferredContent *deferredContent;
+@end
 
 @implementation TBSMSubState
 
+@synthesize stateMachine = _stateMachine;
+
 + (instancetype)subStateWithName:(NSString *)name
 {
     return [[[self class] alloc] initWithName:name];
@@ -27,6 +33,26 @@
     [_stateMachine setParentVertex:self];
 }
 
+- (TBSMStateMachine *)stateMachine
+{
+    if (_stateMachine == nil && self.deferredContent && !self.deferredContent.isMaterializing) {
+        [self _materialize];
+    }
+    return _stateMachine;
+}
+
+- (BOOL)isMaterialized
+{
+    return (_stateMachine != nil);
+}
+
+- (void)setStatesWithConfiguration:(TBSMDeferredConfigurationBlock)configuration releaseInterval:(NSTimeInterval)releaseInterval
+{
+    self.deferredContent = [[TBSMDeferredContent alloc] initWithConfiguration:configuration];
+    self.deferredContent.releaseInterval = releaseInterval;
+    _stateMachine = nil;
+}
+
 - (void)setStates:(NSArray<__kindof TBSMState *> *)states
 {
     NSString *name = [self.name stringByAppendingString:@"SubMachine"];
@@ -38,13 +64,16 @@
 - (void)removeTransitionVertexes
 {
     [super removeTransitionVertexes];
-    [self.stateMachine removeTransitionVertexes];
+    [_stateMachine removeTransitionVertexes];
 }
 
 - (void)enter:(TBSMState *)sourceState targetState:(TBSMState *)targetState data:(id)data
 {
+    [self.deferredContent cancelRelease];
     if (self.stateMachine == nil) {
-        @throw [NSException tbsm_missingStateMachineException:self.name];
+        [self tbsm_reportMissingStateMachine];
+        [super enter:sourceState targetState:targetState data:data];
+        return;
     }
     [super enter:sourceState targetState:targetState data:data];
     [_stateMachine enter:sourceState targetState:targetState data:data];
@@ -52,8 +81,11 @@
 
 - (void)enter:(TBSMState *)sourceState targetStates:(NSArray *)targetStates region:(TBSMParallelState *)region data:(id)data
 {
+    [self.deferredContent cancelRelease];
     if (self.stateMachine == nil) {
-        @throw [NSException tbsm_missingStateMachineException:self.name];
+        [self tbsm_reportMissingStateMachine];
+        [super enter:sourceState targetState:region data:data];
+        return;
     }
     [super enter:sourceState targetState:region data:data];
     [_stateMachine enter:sourceState targetStates:targetStates region:region data:data];
@@ -61,11 +93,18 @@
 
 - (void)exit:(TBSMState *)sourceState targetState:(TBSMState *)targetState data:(id)data
 {
-    if (self.stateMachine == nil) {
-        @throw [NSException tbsm_missingStateMachineException:self.name];
+    if (_stateMachine == nil) {
+        [self tbsm_reportMissingStateMachine];
     }
     [_stateMachine tearDown:data];
     [super exit:sourceState targetState:targetState data:data];
+    
+    if (self.deferredContent) {
+        __weak typeof(self) weakSelf = self;
+        [self.deferredContent scheduleReleaseOfState:self releaseBlock:^{
+            [weakSelf _releaseStateMachine];
+        }];
+    }
 }
 
 - (BOOL)handleEvent:(TBSMEvent *)event
@@ -73,4 +112,23 @@
     return [_stateMachine handleEvent:event];
 }
 
+- (void)_materialize
+{
+    [self.deferredContent materializeState:self];
+    if (_stateMachine) {
+        [self.deferredContent state:self didMaterializeStateMachines:@[_stateMachine]];
+    }
+}
+
+- (void)_releaseStateMachine
+{
+    if (_stateMachine == nil) {
+        return;
+    }
+    [self.deferredContent removeSubscriptionsFromStateMachines:@[_stateMachine]];
+    [_stateMachine removeTransitionVertexes];
+    _stateMachine = nil;
+    [(TBSMStateMachine *)self.parentVertex invalidateStateIndex];
+}
+
 @end
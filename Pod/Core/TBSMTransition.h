@@ -14,6 +14,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 @class TBSMState;
 @class TBSMStateMachine;
+@class TBSMEventHandler;
 
 /**
  *  This type represents an action of a `TBSMTransition`.
@@ -29,6 +30,37 @@ typedef void(^TBSMActionBlock)(id _Nullable data);
  */
 typedef BOOL(^TBSMGuardBlock)(id _Nullable data);
 
+/**
+ *  This type represents an action of a `TBSMTransition` implemented as plain C function.
+ *
+ *  @param data    The payload data.
+ *  @param context The context pointer which has been registered together with the function.
+ */
+typedef void(*TBSMActionFunction)(id _Nullable data, void * _Nullable context);
+
+/**
+ *  This type represents a guard function of a `TBSMTransition` implemented as plain C function.
+ *
+ *  @param data    The payload data.
+ *  @param context The context pointer which has been registered together with the function.
+ */
+typedef BOOL(*TBSMGuardFunction)(id _Nullable data, void * _Nullable context);
+
+/**
+ *  This type represents the block which finishes a pending asynchronous action.
+ */
+typedef void(^TBSMActionCompletionBlock)(void);
+
+/**
+ *  This type represents an asynchronous action of a `TBSMTransition`.
+ *
+ *  The transition will be finished once the completion block has been called from any thread.
+ *
+ *  @param data       The payload data.
+ *  @param completion The block to call when the action has finished.
+ */
+typedef void(^TBSMAsyncActionBlock)(id _Nullable data, TBSMActionCompletionBlock completion);
+
 
 /**
  *  This class represents a transition between two states.
@@ -60,12 +92,43 @@ typedef BOOL(^TBSMGuardBlock)(id _Nullable data);
  */
 @property (nonatomic, copy, nullable) TBSMGuardBlock guard;
 
+/**
+ *  The action function associated with the transition. Executed after the action block.
+ */
+@property (nonatomic, assign, nullable) TBSMActionFunction actionFunction;
+
+/**
+ *  The guard function associated with the transition. Evaluated after the guard block.
+ */
+@property (nonatomic, assign, nullable) TBSMGuardFunction guardFunction;
+
+/**
+ *  The context pointer passed to the action and guard functions. Not retained.
+ */
+@property (nonatomic, assign, nullable) void *context;
+
+/**
+ *  The asynchronous action associated with the transition. Executed after the action block and function.
+ */
+@property (nonatomic, copy, nullable) TBSMAsyncActionBlock asyncAction;
+
 /**
  *  The name of the event being handled.
  *
  */
 @property (nonatomic, strong) NSString *eventName;
 
+/**
+ *  The event handler which has created the transition. Identifies guards and actions in the `TBSMProfiler`.
+ *  Transitions without event handler are identified by their source state.
+ */
+@property (nonatomic, weak, nullable) TBSMEventHandler *eventHandler;
+
+/**
+ *  The pointer identifying the guards and actions of the transition in the `TBSMProfiler`.
+ */
+@property (nonatomic, assign, readonly) const void *profilerKey;
+
 /**
  *  Initializes a `TBSMTransition` instance from a given source and target state, action and guard.
  *
@@ -85,8 +148,22 @@ typedef BOOL(^TBSMGuardBlock)(id _Nullable data);
                               guard:(nullable TBSMGuardBlock)guard
                           eventName:(NSString *)eventName;
 
+/**
+ *  Returns the least common ancestor of source and target state.
+ *
+ *  Throws a `TBSMException` if none could be found. Reports a `TBSMErrorCodeNoLcaForTransition` error
+ *  and returns `nil` instead when running in `TBSMErrorModeReport`.
+ *
+ *  @return The least common ancestor.
+ */
+- (nullable TBSMStateMachine *)findLeastCommonAncestor;
 
-- (TBSMStateMachine *)findLeastCommonAncestor;
+/**
+ *  Returns the least common ancestor of source and target state without reporting a failure.
+ *
+ *  @return The least common ancestor or `nil`.
+ */
+- (nullable TBSMStateMachine *)leastCommonAncestor;
 
 /**
  *  Checks wether the transition can be performed by evaluating its guards.
@@ -97,6 +174,13 @@ typedef BOOL(^TBSMGuardBlock)(id _Nullable data);
  */
 - (BOOL)canPerformTransitionWithData:(id)data;
 
+/**
+ *  Executes the action block and the action function of the transition.
+ *
+ *  @param data The payload data.
+ */
+- (void)performActionWithData:(nullable id)data;
+
 /**
  *  Performs the transition between source and target state.
  *  Evaluates guard and action blocks.
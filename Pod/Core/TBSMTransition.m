@@ -10,6 +10,16 @@
 #import "TBSMState.h"
 #import "TBSMStateMachine.h"
 
+static NSUInteger TBSMHierarchyVertexDepth(id<TBSMHierarchyVertex> vertex)
+{
+    NSUInteger depth = 0;
+    while (vertex) {
+        depth++;
+        vertex = vertex.parentVertex;
+    }
+    return depth;
+}
+
 @implementation TBSMTransition
 
 - (instancetype)initWithSourceState:(TBSMState *)sourceState
@@ -31,6 +41,11 @@
     return self;
 }
 
+- (const void *)profilerKey
+{
+    return (__bridge const void *)(self.eventHandler ?: self.sourceState);
+}
+
 - (NSString *)name
 {
     if (self.targetState == nil) {
@@ -41,34 +56,81 @@
 
 - (TBSMStateMachine *)findLeastCommonAncestor
 {
-    NSArray *sourcePath = [self.sourceState path];
-    NSArray *targetPath = [self.targetState path];
-    
-    __block TBSMStateMachine *lca = nil;
-    [sourcePath enumerateObjectsWithOptions:NSEnumerationReverse usingBlock:^(id obj, NSUInteger idx, BOOL *stop) {
-        if ([obj isKindOfClass:[TBSMStateMachine class]]) {
-            if ([targetPath containsObject:obj]) {
-                lca = (TBSMStateMachine *)obj;
-                *stop = YES;
-            }
+    TBSMStateMachine *lca = [self leastCommonAncestor];
+    if (!lca) {
+        TBSMStateMachine *stateMachine = (TBSMStateMachine *)self.sourceState.parentVertex;
+        if (![stateMachine reportError:[NSError tbsm_noLcaForTransitionError:self.name]]) {
+            @throw [NSException tbsm_noLcaForTransition:self.name];
         }
-    }];
+    }
+    return lca;
+}
+
+- (TBSMStateMachine *)leastCommonAncestor
+{
+    id<TBSMHierarchyVertex> source = self.sourceState;
+    id<TBSMHierarchyVertex> target = self.targetState;
+    NSUInteger sourceDepth = TBSMHierarchyVertexDepth(source);
+    NSUInteger targetDepth = TBSMHierarchyVertexDepth(target);
+    for (; sourceDepth > targetDepth; sourceDepth--) {
+        source = source.parentVertex;
+    }
+    for (; targetDepth > sourceDepth; targetDepth--) {
+        target = target.parentVertex;
+    }
+    while (source != target) {
+        source = source.parentVertex;
+        target = target.parentVertex;
+    }
+    while (source && ![source isKindOfClass:[TBSMStateMachine class]]) {
+        source = source.parentVertex;
+    }
+    TBSMStateMachine *lca = (TBSMStateMachine *)source;
     
     if (self.kind == TBSMTransitionLocal) {
-        if ([self.sourceState.path containsObject:self.targetState] || [self.targetState.path containsObject:self.sourceState]) {
+        if (TBSMHierarchyVertexIsContainedIn(self.sourceState, self.targetState) || TBSMHierarchyVertexIsContainedIn(self.targetState, self.sourceState)) {
             TBSMSubState *containingSubState = (TBSMSubState *)lca.currentState;
             lca = containingSubState.stateMachine;
         }
     }
-    if (!lca) {
-        @throw [NSException tbsm_noLcaForTransition:self.name];
-    }
     return lca;
 }
 
 - (BOOL)canPerformTransitionWithData:(id)data
 {
-    return (self.guard == nil || self.guard(data));
+    if (self.guard == nil && self.guardFunction == NULL) {
+        return YES;
+    }
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    uint64_t start = [profiler beginCallback];
+    BOOL canPerform = YES;
+    if (self.guard && !self.guard(data)) {
+        canPerform = NO;
+    } else if (self.guardFunction && !self.guardFunction(data, self.context)) {
+        canPerform = NO;
+    }
+    [profiler endCallback:TBSMProfileCategoryGuard key:self.profilerKey start:start name:^NSString *{
+        return self.name;
+    }];
+    return canPerform;
+}
+
+- (void)performActionWithData:(id)data
+{
+    if (self.action == nil && self.actionFunction == NULL) {
+        return;
+    }
+    TBSMProfiler *profiler = [TBSMProfiler currentProfiler];
+    uint64_t start = [profiler beginCallback];
+    if (self.action) {
+        self.action(data);
+    }
+    if (self.actionFunction) {
+        self.actionFunction(data, self.context);
+    }
+    [profiler endCallback:TBSMProfileCategoryAction key:self.profilerKey start:start name:^NSString *{
+        return self.name;
+    }];
 }
 
 - (BOOL)performTransitionWithData:(id)data
@@ -77,13 +139,14 @@
         return NO;
     }
     if (self.kind == TBSMTransitionInternal) {
-        if (self.action) {
-            self.action(data);
-        }
+        [self performActionWithData:data];
         [self _postInternalTransitionActionNotificationWithData:data];
     } else {
         TBSMStateMachine *lca = [self findLeastCommonAncestor];
-        [lca switchState:self.sourceState targetState:self.targetState action:self.action data:data];
+        if (!lca) {
+            return NO;
+        }
+        [lca switchState:self.sourceState targetState:self.targetState transition:self data:data];
     }
     return YES;
 }
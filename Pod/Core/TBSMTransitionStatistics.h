@@ -0,0 +1,78 @@
+//
+//  TBSMTransitionStatistics.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class represents the runtime statistics of a single transition or junction path inside a `TBSMProfiler`.
+ *
+ *  Times are kept in a log-linear histogram with eight buckets per power of two, so percentiles are exact to within 12.5%.
+ */
+@interface TBSMTransitionStatistics : NSObject
+
+/**
+ *  The name of the transition.
+ */
+@property (nonatomic, copy, readonly) NSString *name;
+
+/**
+ *  The number of times the transition has been performed.
+ */
+@property (nonatomic, assign, readonly) NSUInteger fireCount;
+
+/**
+ *  The number of times the transition has been rejected by its guards.
+ */
+@property (nonatomic, assign, readonly) NSUInteger rejectionCount;
+
+/**
+ *  The share of evaluations rejected by the guards between `0.0` and `1.0`.
+ */
+@property (nonatomic, assign, readonly) double rejectionRate;
+
+/**
+ *  The mean time of the transition including exit, enter blocks and actions in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval meanTime;
+
+/**
+ *  The 99th percentile of the time of the transition in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval p99Time;
+
+/**
+ *  Creates empty statistics.
+ *
+ *  @param name The name of the transition.
+ *
+ *  @return The statistics instance.
+ */
+- (instancetype)initWithName:(NSString *)name;
+
+/**
+ *  Adds a performed transition.
+ *
+ *  @param time The measured time in seconds.
+ */
+- (void)addTime:(NSTimeInterval)time;
+
+/**
+ *  Adds a rejection by the guards.
+ */
+- (void)addRejection;
+
+/**
+ *  Returns the upper bound of the histogram bucket containing the specified percentile.
+ *
+ *  @param percentile The percentile between `0.0` and `1.0`.
+ *
+ *  @return The time in seconds or `0` if the transition has not been performed yet.
+ */
+- (NSTimeInterval)timeAtPercentile:(double)percentile;
+
+@end
+NS_ASSUME_NONNULL_END
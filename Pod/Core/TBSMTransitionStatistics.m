@@ -0,0 +1,62 @@
+//
+//  TBSMTransitionStatistics.m
+//  TBStateMachine
+//
+
+#import "TBSMTransitionStatistics.h"
+#import "TBSMHistogram.h"
+
+@interface TBSMTransitionStatistics ()
+@property (nonatomic, assign) NSUInteger fireCount;
+@property (nonatomic, assign) NSUInteger rejectionCount;
+@end
+
+@implementation TBSMTransitionStatistics
+{
+    TBSMHistogram _histogram;
+    NSTimeInterval _totalTime;
+}
+
+- (instancetype)initWithName:(NSString *)name
+{
+    self = [super init];
+    if (self) {
+        _name = name.copy;
+    }
+    return self;
+}
+
+- (void)addTime:(NSTimeInterval)time
+{
+    self.fireCount++;
+    _totalTime += time;
+    TBSMHistogramAdd(&_histogram, time);
+}
+
+- (void)addRejection
+{
+    self.rejectionCount++;
+}
+
+- (double)rejectionRate
+{
+    NSUInteger evaluations = self.fireCount + self.rejectionCount;
+    return evaluations ? (double)self.rejectionCount / evaluations : 0.0;
+}
+
+- (NSTimeInterval)meanTime
+{
+    return self.fireCount ? _totalTime / self.fireCount : 0.0;
+}
+
+- (NSTimeInterval)p99Time
+{
+    return [self timeAtPercentile:0.99];
+}
+
+- (NSTimeInterval)timeAtPercentile:(double)percentile
+{
+    return TBSMHistogramPercentile(&_histogram, percentile);
+}
+
+@end
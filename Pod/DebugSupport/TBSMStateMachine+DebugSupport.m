@@ -73,10 +73,22 @@
     [self tbsm_tearDown:data];
 }
 
-- (void)tbsm_scheduleEvent:(TBSMEvent *)event
+- (TBSMEventQueueStatus)tbsm_scheduleEvent:(TBSMEvent *)event
 {
+    if (self.eventQueue.discardBlock == nil) {
+        __weak TBSMStateMachine *weakSelf = self;
+        self.eventQueue.discardBlock = ^(TBSMEvent *discardedEvent) {
+            [[TBSMDebugLogger sharedInstance] log:@"[%@]: event '%@' discarded from queue", weakSelf.name, discardedEvent.name];
+            [weakSelf tbsm_finishDebugEvent:discardedEvent];
+        };
+    }
     [self.eventDebugQueue addObject:event];
-    [self tbsm_scheduleEvent:event];
+    TBSMEventQueueStatus status = [self tbsm_scheduleEvent:event];
+    if (status != TBSMEventQueueStatusEnqueued) {
+        [[TBSMDebugLogger sharedInstance] log:@"[%@]: event '%@' not scheduled status: %lu", self.name, event.name, (unsigned long)status];
+        [self tbsm_finishDebugEvent:event];
+    }
+    return status;
 }
 
 - (void)scheduleEvent:(TBSMEvent *)event withCompletion:(TBSMDebugCompletionBlock)completion
@@ -88,6 +100,10 @@
 - (BOOL)tbsm_handleEvent:(TBSMEvent *)event
 {
     [[TBSMDebugLogger sharedInstance] log:@"[%@]: attempt to handle event '%@' data: %@", self.name, event.name, event.data];
+    if (event.enqueueTime > 0) {
+        NSTimeInterval waitTime = ([NSProcessInfo processInfo].systemUptime - event.enqueueTime) * 1000.0;
+        [[TBSMDebugLogger sharedInstance] log:@"[%@]: event '%@' waited %f milliseconds in queue", self.name, event.name, waitTime];
+    }
     
     uint64_t startTime = mach_absolute_time();
     BOOL hasHandledEvent = [self tbsm_handleEvent:event];
@@ -101,11 +117,23 @@
     [[TBSMDebugLogger sharedInstance] log:@"[%@]: remaining events in queue: %i", self.name, self.eventDebugQueue.count];
     [[TBSMDebugLogger sharedInstance] log:@"[%@]: %@\n\n", self.name, [self.eventDebugQueue valueForKeyPath:@"name"]];
     
+    [self tbsm_finishDebugEvent:event];
+    return hasHandledEvent;
+}
+
+/**
+ *  Removes an event from the debug queue and calls its completion block once it has been handled,
+ *  rejected, coalesced or discarded by the event queue.
+ */
+- (void)tbsm_finishDebugEvent:(TBSMEvent *)event
+{
+    [self.eventDebugQueue removeObject:event];
+    
     TBSMDebugCompletionBlock completionBlock = event.completionBlock;
+    event.completionBlock = nil;
     if (completionBlock) {
         completionBlock();
     }
-    return hasHandledEvent;
 }
 
 @end
@@ -24,14 +24,8 @@
 
 - (BOOL)tbsm_canPerformTransitionWithData:(id)data
 {
-    TBSMStateMachine *lca = nil;
-    
-    @try {
-        lca = [self findLeastCommonAncestor];
-    }
-    @catch (NSException *exception) {
-        // swallow exception in case lca could not be found since we do not want to interfere with the running application.
-    }
+    // do not report a missing lca since we do not want to interfere with the running application.
+    TBSMStateMachine *lca = [self leastCommonAncestor];
     
     BOOL canPerform = [self tbsm_canPerformTransitionWithData:data];
     
@@ -0,0 +1,71 @@
+//
+//  TBSMGraphExporter.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMStateMachine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class exports the hierarchy of a state machine as Graphviz DOT or json, annotated with the runtime data of a `TBSMProfiler`.
+ *
+ *  The export contains sub state machines, regions, forks, joins, junctions with their outgoing paths and history pseudo states.
+ *  Transitions carry their fire count, guard rejection rate and the mean and 99th percentile of their time.
+ *  States carry their entry count and dwell time. Both are colored by their share of the hottest transition or state.
+ *
+ *  Deferred state machines are exported without their content unless they have been built. The export runs on the
+ *  `scheduledEventsQueue` of the state machine because the profiler is not thread safe. Calls from other queues block until
+ *  the export has finished there, so do not call it from a queue the `scheduledEventsQueue` is waiting for.
+ */
+@interface TBSMGraphExporter : NSObject
+
+/**
+ *  The exported state machine.
+ */
+@property (nonatomic, strong, readonly) TBSMStateMachine *stateMachine;
+
+/**
+ *  The profiler providing the runtime data. Defaults to the profiler of the state machine.
+ */
+@property (nonatomic, strong, nullable) TBSMProfiler *profiler;
+
+/**
+ *  Creates an exporter.
+ *
+ *  @param stateMachine The state machine at the top of the hierarchy.
+ *
+ *  @return The exporter instance.
+ */
++ (instancetype)exporterWithStateMachine:(TBSMStateMachine *)stateMachine;
+
+/**
+ *  Initializes an exporter.
+ *
+ *  @param stateMachine The state machine at the top of the hierarchy.
+ *
+ *  @return The exporter instance.
+ */
+- (instancetype)initWithStateMachine:(TBSMStateMachine *)stateMachine;
+
+/**
+ *  Returns the hierarchy as Graphviz DOT graph. Composite states and regions are rendered as clusters.
+ *  Runs on the `scheduledEventsQueue` of the state machine.
+ *
+ *  @return The DOT source.
+ */
+- (NSString *)dotRepresentation;
+
+/**
+ *  Returns the hierarchy as json object which can be serialized via `NSJSONSerialization`.
+ *
+ *  States are nested like in json definitions via `states` and `regions`. Transitions and pseudo states are listed separately
+ *  and reference states by path. Times are given in seconds. Runs on the `scheduledEventsQueue` of the state machine.
+ *
+ *  @return The json object.
+ */
+- (NSDictionary<NSString *, id> *)jsonRepresentation;
+
+@end
+NS_ASSUME_NONNULL_END
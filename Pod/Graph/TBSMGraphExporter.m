@@ -0,0 +1,360 @@
+//
+//  TBSMGraphExporter.m
+//  TBStateMachine
+//
+
+#import "TBSMGraphExporter.h"
+
+static NSString *TBSMGraphQuote(NSString *string)
+{
+    NSString *escaped = [string stringByReplacingOccurrencesOfString:@"\\" withString:@"\\\\"];
+    escaped = [escaped stringByReplacingOccurrencesOfString:@"\"" withString:@"\\\""];
+    escaped = [escaped stringByReplacingOccurrencesOfString:@"\n" withString:@"\\n"];
+    return [NSString stringWithFormat:@"\"%@\"", escaped];
+}
+
+@interface TBSMGraphExporter ()
+@property (nonatomic, strong, readwrite) TBSMStateMachine *stateMachine;
+@property (nonatomic, strong) NSMutableArray<NSMutableDictionary *> *priv_states;
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *priv_pseudoStates;
+@property (nonatomic, strong) NSMutableArray<NSMutableDictionary *> *priv_transitions;
+@property (nonatomic, strong) NSMapTable<TBSMPseudoState *, NSString *> *priv_pseudoStateIdentifiers;
+@end
+
+@implementation TBSMGraphExporter
+
++ (instancetype)exporterWithStateMachine:(TBSMStateMachine *)stateMachine
+{
+    return [[[self class] alloc] initWithStateMachine:stateMachine];
+}
+
+- (instancetype)initWithStateMachine:(TBSMStateMachine *)stateMachine
+{
+    self = [super init];
+    if (self) {
+        _stateMachine = stateMachine;
+        _profiler = stateMachine.profiler;
+    }
+    return self;
+}
+
+- (id)_performOnScheduledEventsQueue:(id (^)(void))block
+{
+    NSOperationQueue *queue = self.stateMachine.scheduledEventsQueue;
+    if (queue == nil || [NSOperationQueue currentQueue] == queue) {
+        return block();
+    }
+    __block id result = nil;
+    NSOperation *operation = [NSBlockOperation blockOperationWithBlock:^{
+        result = block();
+    }];
+    [queue addOperations:@[operation] waitUntilFinished:YES];
+    return result;
+}
+
+#pragma mark - json
+
+- (NSDictionary<NSString *, id> *)jsonRepresentation
+{
+    return [self _performOnScheduledEventsQueue:^id{
+        return [self _graph];
+    }];
+}
+
+- (NSDictionary<NSString *, id> *)_graph
+{
+    self.priv_states = [NSMutableArray new];
+    self.priv_pseudoStates = [NSMutableArray new];
+    self.priv_transitions = [NSMutableArray new];
+    self.priv_pseudoStateIdentifiers = [NSMapTable strongToStrongObjectsMapTable];
+    
+    NSArray *states = [self _statesOfStateMachine:self.stateMachine];
+    [self _applyHeatToNodes:self.priv_states value:@"dwell_time"];
+    [self _applyHeatToNodes:self.priv_transitions value:@"fires"];
+    
+    NSDictionary *graph = @{@"name" : self.stateMachine.name,
+                            @"steps" : @(self.profiler.stepCount),
+                            @"states" : states,
+                            @"pseudo_states" : self.priv_pseudoStates,
+                            @"transitions" : self.priv_transitions};
+    self.priv_states = nil;
+    self.priv_pseudoStates = nil;
+    self.priv_transitions = nil;
+    self.priv_pseudoStateIdentifiers = nil;
+    return graph;
+}
+
+- (NSArray *)_statesOfStateMachine:(TBSMStateMachine *)stateMachine
+{
+    NSMutableArray *states = [NSMutableArray new];
+    for (TBSMState *state in stateMachine.states) {
+        [states addObject:[self _nodeOfState:state]];
+    }
+    return states;
+}
+
+- (NSDictionary *)_nodeOfState:(TBSMState *)state
+{
+    NSString *path = [self.stateMachine pathOfState:state];
+    NSMutableDictionary *node = [NSMutableDictionary new];
+    node[@"name"] = state.name;
+    node[@"path"] = path;
+    node[@"active"] = @([self.stateMachine isActive:state]);
+    node[@"type"] = @"state";
+    
+    if ([state isKindOfClass:[TBSMFinalState class]]) {
+        node[@"type"] = @"final";
+    } else if ([state isKindOfClass:[TBSMSubState class]]) {
+        TBSMSubState *subState = (TBSMSubState *)state;
+        node[@"type"] = @"sub";
+        if (subState.isMaterialized) {
+            node[@"states"] = [self _statesOfStateMachine:subState.stateMachine];
+        } else {
+            node[@"deferred"] = @YES;
+        }
+    } else if ([state isKindOfClass:[TBSMParallelState class]]) {
+        TBSMParallelState *parallelState = (TBSMParallelState *)state;
+        node[@"type"] = @"parallel";
+        if (parallelState.isMaterialized) {
+            NSMutableArray *regions = [NSMutableArray new];
+            for (TBSMStateMachine *stateMachine in parallelState.stateMachines) {
+                [regions addObject:[self _statesOfStateMachine:stateMachine]];
+            }
+            node[@"regions"] = regions;
+        } else {
+            node[@"deferred"] = @YES;
+        }
+    }
+    
+    TBSMStateStatistics *statistics = [self.profiler stateStatisticsForKey:(__bridge const void *)state];
+    node[@"entries"] = @(statistics.entryCount);
+    node[@"dwell_time"] = @(statistics.totalDwellTime);
+    node[@"mean_dwell_time"] = @(statistics.meanDwellTime);
+    [self.priv_states addObject:node];
+    
+    NSDictionary *eventHandlers = state.eventHandlers;
+    for (NSString *event in [eventHandlers.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        for (TBSMEventHandler *eventHandler in eventHandlers[event]) {
+            [self _addTransitionOfState:state path:path eventHandler:eventHandler];
+        }
+    }
+    for (TBSMEventHandler *eventHandler in state.completionHandlers) {
+        [self _addTransitionOfState:state path:path eventHandler:eventHandler];
+    }
+    return node;
+}
+
+- (void)_addTransitionOfState:(TBSMState *)state path:(NSString *)path eventHandler:(TBSMEventHandler *)eventHandler
+{
+    TBSMTransition *transition = nil;
+    NSString *target = nil;
+    if ([eventHandler.target isKindOfClass:[TBSMState class]]) {
+        transition = [[TBSMTransition alloc] initWithSourceState:state
+                                                     targetState:(TBSMState *)eventHandler.target
+                                                            kind:eventHandler.kind
+                                                          action:nil
+                                                           guard:nil
+                                                       eventName:eventHandler.name];
+        target = [self.stateMachine pathOfState:(TBSMState *)eventHandler.target];
+    } else {
+        TBSMPseudoState *pseudoState = (TBSMPseudoState *)eventHandler.target;
+        transition = [[TBSMCompoundTransition alloc] initWithSourceState:state
+                                                       targetPseudoState:pseudoState
+                                                                  action:nil
+                                                                   guard:nil
+                                                               eventName:eventHandler.name];
+        target = [self _identifierOfPseudoState:pseudoState];
+    }
+    NSArray *kinds = @[@"external", @"local", @"internal"];
+    NSMutableDictionary *edge = [self _edgeFromSource:path target:target name:transition.name key:(__bridge const void *)eventHandler];
+    edge[@"event"] = eventHandler.name;
+    edge[@"kind"] = kinds[eventHandler.kind];
+    edge[@"guarded"] = @(eventHandler.guard != nil || eventHandler.guardFunction != NULL);
+}
+
+- (NSString *)_identifierOfPseudoState:(TBSMPseudoState *)pseudoState
+{
+    NSString *identifier = [self.priv_pseudoStateIdentifiers objectForKey:pseudoState];
+    if (identifier) {
+        return identifier;
+    }
+    NSString *type = @"pseudo";
+    if ([pseudoState isKindOfClass:[TBSMFork class]]) {
+        type = @"fork";
+    } else if ([pseudoState isKindOfClass:[TBSMJoin class]]) {
+        type = @"join";
+    } else if ([pseudoState isKindOfClass:[TBSMJunction class]]) {
+        type = @"junction";
+    } else if ([pseudoState isKindOfClass:[TBSMHistory class]]) {
+        type = ([(TBSMHistory *)pseudoState kind] == TBSMHistoryDeep) ? @"deep_history" : @"shallow_history";
+    }
+    identifier = [NSString stringWithFormat:@"%@:%@", type, pseudoState.name];
+    [self.priv_pseudoStateIdentifiers setObject:identifier forKey:pseudoState];
+    [self.priv_pseudoStates addObject:@{@"id" : identifier, @"name" : pseudoState.name, @"type" : type}];
+    
+    if ([pseudoState isKindOfClass:[TBSMJunction class]]) {
+        for (TBSMJunctionPath *outgoingPath in [(TBSMJunction *)pseudoState outgoingPaths]) {
+            NSString *name = [NSString stringWithFormat:@"%@ --> %@", pseudoState.name, outgoingPath.targetState.name];
+            NSMutableDictionary *edge = [self _edgeFromSource:identifier target:[self.stateMachine pathOfState:outgoingPath.targetState] name:name key:(__bridge const void *)outgoingPath];
+            edge[@"guarded"] = @YES;
+        }
+        return identifier;
+    }
+    NSArray *targetStates = nil;
+    if ([pseudoState isKindOfClass:[TBSMFork class]]) {
+        targetStates = [(TBSMFork *)pseudoState targetStates];
+    } else if (pseudoState.targetState) {
+        targetStates = @[pseudoState.targetState];
+    }
+    for (TBSMState *targetState in targetStates) {
+        NSString *name = [NSString stringWithFormat:@"%@ --> %@", pseudoState.name, targetState.name];
+        [self _edgeFromSource:identifier target:[self.stateMachine pathOfState:targetState] name:name key:NULL];
+    }
+    return identifier;
+}
+
+- (NSMutableDictionary *)_edgeFromSource:(NSString *)source target:(NSString *)target name:(NSString *)name key:(const void *)key
+{
+    NSMutableDictionary *edge = [NSMutableDictionary new];
+    edge[@"source"] = source;
+    edge[@"target"] = target;
+    edge[@"name"] = name;
+    TBSMTransitionStatistics *statistics = key ? [self.profiler transitionStatisticsForKey:key] : nil;
+    edge[@"fires"] = @(statistics.fireCount);
+    edge[@"rejections"] = @(statistics.rejectionCount);
+    edge[@"rejection_rate"] = @(statistics.rejectionRate);
+    edge[@"mean_time"] = @(statistics.meanTime);
+    edge[@"p99_time"] = @(statistics.p99Time);
+    [self.priv_transitions addObject:edge];
+    return edge;
+}
+
+- (void)_applyHeatToNodes:(NSArray<NSMutableDictionary *> *)nodes value:(NSString *)key
+{
+    double maximum = 0.0;
+    for (NSDictionary *node in nodes) {
+        maximum = MAX(maximum, [node[key] doubleValue]);
+    }
+    for (NSMutableDictionary *node in nodes) {
+        node[@"heat"] = @(maximum > 0.0 ? [node[key] doubleValue] / maximum : 0.0);
+    }
+}
+
+#pragma mark - DOT
+
+- (NSString *)dotRepresentation
+{
+    NSDictionary *graph = [self jsonRepresentation];
+    NSMutableSet *clusters = [NSMutableSet new];
+    NSMutableString *dot = [NSMutableString new];
+    [dot appendFormat:@"digraph %@ {\n", TBSMGraphQuote(graph[@"name"])];
+    [dot appendString:@"    compound=true;\n"];
+    [dot appendString:@"    node [shape=box, style=\"rounded,filled\", fillcolor=\"white\", fontname=\"Helvetica\"];\n"];
+    [dot appendString:@"    edge [fontname=\"Helvetica\", fontsize=10];\n"];
+    [dot appendFormat:@"    label=%@;\n", TBSMGraphQuote([NSString stringWithFormat:@"%@ (%@ steps)", graph[@"name"], graph[@"steps"]])];
+    [self _appendStates:graph[@"states"] toDot:dot indent:@"    " clusters:clusters];
+    
+    for (NSDictionary *pseudoState in graph[@"pseudo_states"]) {
+        NSString *type = pseudoState[@"type"];
+        NSString *attributes = @"shape=circle, width=0.15, style=filled, fillcolor=\"black\", label=\"\"";
+        if ([type isEqualToString:@"fork"] || [type isEqualToString:@"join"]) {
+            attributes = @"shape=box, height=0.05, width=0.6, style=filled, fillcolor=\"black\", label=\"\"";
+        } else if ([type hasSuffix:@"history"]) {
+            attributes = [type hasPrefix:@"deep"] ? @"shape=circle, width=0.3, style=solid, label=\"H*\"" : @"shape=circle, width=0.3, style=solid, label=\"H\"";
+        }
+        [dot appendFormat:@"    %@ [%@, xlabel=%@];\n", TBSMGraphQuote(pseudoState[@"id"]), attributes, TBSMGraphQuote(pseudoState[@"name"])];
+    }
+    
+    for (NSDictionary *transition in graph[@"transitions"]) {
+        NSString *source = transition[@"source"];
+        NSString *target = transition[@"target"];
+        NSMutableArray *attributes = [NSMutableArray new];
+        [attributes addObject:[NSString stringWithFormat:@"label=%@", TBSMGraphQuote([self _labelOfTransition:transition])]];
+        if ([transition[@"fires"] unsignedIntegerValue] > 0) {
+            double heat = [transition[@"heat"] doubleValue];
+            [attributes addObject:[NSString stringWithFormat:@"color=\"%.3f 1.000 0.850\", fontcolor=\"%.3f 1.000 0.850\", penwidth=%.1f", 0.667 * (1.0 - heat), 0.667 * (1.0 - heat), 1.0 + 3.0 * heat]];
+        } else {
+            [attributes addObject:@"color=\"gray60\", fontcolor=\"gray40\""];
+        }
+        if ([transition[@"kind"] isEqualToString:@"internal"]) {
+            [attributes addObject:@"style=dashed"];
+        }
+        if ([clusters containsObject:source] && ![target hasPrefix:[source stringByAppendingString:@"/"]]) {
+            [attributes addObject:[NSString stringWithFormat:@"ltail=%@", TBSMGraphQuote([@"cluster_" stringByAppendingString:source])]];
+        }
+        if ([clusters containsObject:target] && ![source hasPrefix:[target stringByAppendingString:@"/"]]) {
+            [attributes addObject:[NSString stringWithFormat:@"lhead=%@", TBSMGraphQuote([@"cluster_" stringByAppendingString:target])]];
+        }
+        [dot appendFormat:@"    %@ -> %@ [%@];\n", TBSMGraphQuote(source), TBSMGraphQuote(target), [attributes componentsJoinedByString:@", "]];
+    }
+    [dot appendString:@"}\n"];
+    return dot;
+}
+
+- (void)_appendStates:(NSArray *)states toDot:(NSMutableString *)dot indent:(NSString *)indent clusters:(NSMutableSet *)clusters
+{
+    for (NSDictionary *state in states) {
+        NSString *path = state[@"path"];
+        NSString *label = [self _labelOfState:state];
+        NSString *fillColor = [NSString stringWithFormat:@"0.000 %.3f 1.000", 0.7 * [state[@"heat"] doubleValue]];
+        NSString *style = [state[@"active"] boolValue] ? @"rounded,filled,bold" : @"rounded,filled";
+    
+        if (![state[@"type"] isEqualToString:@"sub"] && ![state[@"type"] isEqualToString:@"parallel"]) {
+            NSString *shape = [state[@"type"] isEqualToString:@"final"] ? @", shape=doublecircle" : @"";
+            [dot appendFormat:@"%@%@ [label=%@, style=\"%@\", fillcolor=\"%@\"%@];\n", indent, TBSMGraphQuote(path), TBSMGraphQuote(label), style, fillColor, shape];
+            continue;
+        }
+        [clusters addObject:path];
+        NSString *innerIndent = [indent stringByAppendingString:@"    "];
+        [dot appendFormat:@"%@subgraph %@ {\n", indent, TBSMGraphQuote([@"cluster_" stringByAppendingString:path])];
+        [dot appendFormat:@"%@label=%@;\n", innerIndent, TBSMGraphQuote(label)];
+        [dot appendFormat:@"%@style=\"%@\";\n", innerIndent, style];
+        [dot appendFormat:@"%@fillcolor=\"%@\";\n", innerIndent, fillColor];
+        [dot appendFormat:@"%@%@ [shape=point, style=invis];\n", innerIndent, TBSMGraphQuote(path)];
+        [self _appendStates:state[@"states"] toDot:dot indent:innerIndent clusters:clusters];
+        [state[@"regions"] enumerateObjectsUsingBlock:^(NSArray *region, NSUInteger index, BOOL *stop) {
+            NSString *regionIndent = [innerIndent stringByAppendingString:@"    "];
+            NSString *regionPath = [NSString stringWithFormat:@"%@@%lu", path, (unsigned long)index];
+            [dot appendFormat:@"%@subgraph %@ {\n", innerIndent, TBSMGraphQuote([@"cluster_" stringByAppendingString:regionPath])];
+            [dot appendFormat:@"%@label=\"\";\n", regionIndent];
+            [dot appendFormat:@"%@style=\"dashed\";\n", regionIndent];
+            [self _appendStates:region toDot:dot indent:regionIndent clusters:clusters];
+            [dot appendFormat:@"%@}\n", innerIndent];
+        }];
+        [dot appendFormat:@"%@}\n", indent];
+    }
+}
+
+- (NSString *)_labelOfState:(NSDictionary *)state
+{
+    NSMutableString *label = [NSMutableString stringWithString:state[@"name"]];
+    if ([state[@"deferred"] boolValue]) {
+        [label appendString:@" (deferred)"];
+    }
+    NSUInteger entries = [state[@"entries"] unsignedIntegerValue];
+    if (entries > 0) {
+        [label appendFormat:@"\n%lu x, %.3f ms", (unsigned long)entries, [state[@"dwell_time"] doubleValue] * 1000.0];
+    }
+    return label;
+}
+
+- (NSString *)_labelOfTransition:(NSDictionary *)transition
+{
+    NSString *event = transition[@"event"];
+    NSMutableString *label = [NSMutableString stringWithString:([event isEqualToString:TBSMCompletionEvent] ? @"completion" : event ?: @"")];
+    NSUInteger fires = [transition[@"fires"] unsignedIntegerValue];
+    NSUInteger rejections = [transition[@"rejections"] unsignedIntegerValue];
+    if (fires + rejections == 0) {
+        return label;
+    }
+    [label appendFormat:@"\n%lu x", (unsigned long)fires];
+    if (rejections > 0) {
+        [label appendFormat:@", %.0f%% rejected", [transition[@"rejection_rate"] doubleValue] * 100.0];
+    }
+    if (fires > 0) {
+        [label appendFormat:@"\nmean %.3f ms, p99 %.3f ms", [transition[@"mean_time"] doubleValue] * 1000.0, [transition[@"p99_time"] doubleValue] * 1000.0];
+    }
+    return label;
+}
+
+@end
@@ -0,0 +1,280 @@
+//
+//  TBSMIngressRing.c
+//  TBStateMachine
+//
+
+#include "TBSMIngressRing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct tbsm_ingress_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t record_size;
+    uint64_t head;
+    uint64_t tail;
+    uint32_t waiting;
+    uint8_t reserved[28];
+} tbsm_ingress_header;
+
+struct tbsm_ingress {
+    tbsm_ingress_header *header;
+    tbsm_ingress_record *records;
+    size_t size;
+    uint64_t mask;
+    sem_t *semaphore;
+};
+
+typedef char tbsm_ingress_header_size_check[sizeof(tbsm_ingress_header) == 64 ? 1 : -1];
+typedef char tbsm_ingress_record_size_check[sizeof(tbsm_ingress_record) == TBSM_INGRESS_RECORD_SIZE ? 1 : -1];
+
+static void tbsm_ingress_object_names(const char *name, char *memory, char *semaphore, size_t length)
+{
+    snprintf(memory, length, "/tbsm.%s", name);
+    snprintf(semaphore, length, "/tbsm.%s.s", name);
+}
+
+static uint32_t tbsm_ingress_capacity(uint32_t capacity)
+{
+    uint32_t result = 2;
+    while (result < capacity && result < (1u << 30)) {
+        result <<= 1;
+    }
+    return result;
+}
+
+static int tbsm_ingress_initialize(int fd, uint32_t capacity)
+{
+    size_t size = sizeof(tbsm_ingress_header) + (size_t)capacity * sizeof(tbsm_ingress_record);
+    if (ftruncate(fd, (off_t)size) != 0) {
+        return -1;
+    }
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        return -1;
+    }
+    tbsm_ingress_header *header = memory;
+    tbsm_ingress_record *records = (tbsm_ingress_record *)(header + 1);
+    for (uint32_t index = 0; index < capacity; index++) {
+        records[index].sequence = index;
+    }
+    header->version = TBSM_INGRESS_VERSION;
+    header->capacity = capacity;
+    header->record_size = TBSM_INGRESS_RECORD_SIZE;
+    header->head = 0;
+    header->tail = 0;
+    header->waiting = 0;
+    __atomic_store_n(&header->magic, TBSM_INGRESS_MAGIC, __ATOMIC_RELEASE);
+    munmap(memory, size);
+    return 0;
+}
+
+tbsm_ingress *tbsm_ingress_open(const char *name, uint32_t capacity, int create)
+{
+    char memoryName[NAME_MAX];
+    char semaphoreName[NAME_MAX];
+    tbsm_ingress_object_names(name, memoryName, semaphoreName, sizeof(memoryName));
+
+    int fd = -1;
+    if (create) {
+        fd = shm_open(memoryName, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0 && tbsm_ingress_initialize(fd, tbsm_ingress_capacity(capacity)) != 0) {
+            int error = errno;
+            close(fd);
+            shm_unlink(memoryName);
+            errno = error;
+            return NULL;
+        }
+        if (fd < 0 && errno != EEXIST) {
+            return NULL;
+        }
+    }
+    if (fd < 0) {
+        fd = shm_open(memoryName, O_RDWR, 0600);
+        if (fd < 0) {
+            return NULL;
+        }
+    }
+
+    // Touching pages beyond the end of the object raises SIGBUS. The creator may not have sized it yet.
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+    if ((size_t)status.st_size < sizeof(tbsm_ingress_header)) {
+        close(fd);
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    tbsm_ingress_header *header = mmap(NULL, sizeof(tbsm_ingress_header), PROT_READ, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    // The creator sizes the object before it publishes the magic.
+    uint32_t magic = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE);
+    int valid = (magic == TBSM_INGRESS_MAGIC &&
+                 header->version == TBSM_INGRESS_VERSION &&
+                 header->record_size == TBSM_INGRESS_RECORD_SIZE);
+    uint32_t ringCapacity = header->capacity;
+    munmap(header, sizeof(tbsm_ingress_header));
+    if (magic == 0) {
+        close(fd);
+        errno = EAGAIN;
+        return NULL;
+    }
+    if (!valid) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size_t size = sizeof(tbsm_ingress_header) + (size_t)ringCapacity * sizeof(tbsm_ingress_record);
+    if ((size_t)status.st_size < size) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+    sem_t *semaphore = sem_open(semaphoreName, O_CREAT, 0600, 0);
+    if (semaphore == SEM_FAILED) {
+        int error = errno;
+        munmap(memory, size);
+        errno = error;
+        return NULL;
+    }
+
+    tbsm_ingress *ingress = calloc(1, sizeof(tbsm_ingress));
+    if (ingress == NULL) {
+        munmap(memory, size);
+        sem_close(semaphore);
+        errno = ENOMEM;
+        return NULL;
+    }
+    ingress->header = memory;
+    ingress->records = (tbsm_ingress_record *)(ingress->header + 1);
+    ingress->size = size;
+    ingress->mask = ringCapacity - 1;
+    ingress->semaphore = semaphore;
+    return ingress;
+}
+
+void tbsm_ingress_close(tbsm_ingress *ingress)
+{
+    if (ingress == NULL) {
+        return;
+    }
+    munmap(ingress->header, ingress->size);
+    sem_close(ingress->semaphore);
+    free(ingress);
+}
+
+void tbsm_ingress_unlink(const char *name)
+{
+    char memoryName[NAME_MAX];
+    char semaphoreName[NAME_MAX];
+    tbsm_ingress_object_names(name, memoryName, semaphoreName, sizeof(memoryName));
+    shm_unlink(memoryName);
+    sem_unlink(semaphoreName);
+}
+
+int tbsm_ingress_send(tbsm_ingress *ingress, uint16_t machine, uint16_t event, const void *payload, uint16_t length)
+{
+    if (length > TBSM_INGRESS_PAYLOAD_SIZE) {
+        return -1;
+    }
+    tbsm_ingress_header *header = ingress->header;
+    uint64_t position = __atomic_load_n(&header->head, __ATOMIC_RELAXED);
+    tbsm_ingress_record *record;
+    for (;;) {
+        record = &ingress->records[position & ingress->mask];
+        uint32_t sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        int32_t difference = (int32_t)(sequence - (uint32_t)position);
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(&header->head, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return -1;
+        } else {
+            position = __atomic_load_n(&header->head, __ATOMIC_RELAXED);
+        }
+    }
+    record->machine = machine;
+    record->event = event;
+    record->length = length;
+    record->reserved = 0;
+    if (length > 0) {
+        memcpy(record->payload, payload, length);
+    }
+    __atomic_store_n(&record->sequence, (uint32_t)(position + 1), __ATOMIC_RELEASE);
+
+    // Pairs with the fence in tbsm_ingress_wait: either the consumer sees the record or we see the flag.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->waiting, __ATOMIC_RELAXED) && __atomic_exchange_n(&header->waiting, 0, __ATOMIC_ACQ_REL)) {
+        sem_post(ingress->semaphore);
+    }
+    return 0;
+}
+
+static tbsm_ingress_record *tbsm_ingress_next_record(tbsm_ingress *ingress, uint64_t *position)
+{
+    *position = __atomic_load_n(&ingress->header->tail, __ATOMIC_RELAXED);
+    tbsm_ingress_record *record = &ingress->records[*position & ingress->mask];
+    uint32_t sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+    if ((int32_t)(sequence - (uint32_t)(*position + 1)) < 0) {
+        return NULL;
+    }
+    return record;
+}
+
+int tbsm_ingress_receive(tbsm_ingress *ingress, tbsm_ingress_record *record)
+{
+    uint64_t position;
+    tbsm_ingress_record *next = tbsm_ingress_next_record(ingress, &position);
+    if (next == NULL) {
+        return 0;
+    }
+    memcpy(record, next, sizeof(tbsm_ingress_record));
+    __atomic_store_n(&next->sequence, (uint32_t)(position + ingress->mask + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&ingress->header->tail, position + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void tbsm_ingress_wait(tbsm_ingress *ingress)
+{
+    uint64_t position;
+    __atomic_store_n(&ingress->header->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (tbsm_ingress_next_record(ingress, &position) != NULL) {
+        __atomic_store_n(&ingress->header->waiting, 0, __ATOMIC_RELAXED);
+        return;
+    }
+    while (sem_wait(ingress->semaphore) != 0 && errno == EINTR) {
+        // Retry when interrupted by a signal.
+    }
+    __atomic_store_n(&ingress->header->waiting, 0, __ATOMIC_RELAXED);
+}
+
+void tbsm_ingress_wake(tbsm_ingress *ingress)
+{
+    sem_post(ingress->semaphore);
+}
@@ -0,0 +1,101 @@
+//
+//  TBSMIngressRing.h
+//  TBStateMachine
+//
+
+#ifndef Pods_TBSMIngressRing_h
+#define Pods_TBSMIngressRing_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Shared memory ring buffer which carries events from producer processes into `TBSMSharedMemoryIngress`.
+ *
+ *  The ring lives in the POSIX shared memory object `/tbsm.<name>`. All integers use host byte order
+ *  since producers and consumer run on the same host.
+ *
+ *  header (64 bytes):  uint32 magic 'TBSI' | uint32 version | uint32 capacity (power of two) | uint32 record size
+ *                      | uint64 head | uint64 tail | uint32 consumer waiting | 28 bytes reserved
+ *  record (128 bytes): uint32 sequence | uint16 machine identifier | uint16 event identifier
+ *                      | uint16 payload length | uint16 reserved | 116 bytes inline payload
+ *
+ *  Any number of producers reserve slots by advancing `head`, a single consumer advances `tail`.
+ *  The `sequence` of a slot tells whether it has been published. The consumer parks on the named
+ *  semaphore `/tbsm.<name>.s` after setting `consumer waiting`. Producers only post the semaphore
+ *  when that flag is set, so the fast path never enters the kernel.
+ */
+
+#define TBSM_INGRESS_MAGIC 0x49534254u
+#define TBSM_INGRESS_VERSION 1u
+#define TBSM_INGRESS_RECORD_SIZE 128u
+#define TBSM_INGRESS_PAYLOAD_SIZE 116u
+
+typedef struct tbsm_ingress_record {
+    uint32_t sequence;
+    uint16_t machine;
+    uint16_t event;
+    uint16_t length;
+    uint16_t reserved;
+    uint8_t payload[TBSM_INGRESS_PAYLOAD_SIZE];
+} tbsm_ingress_record;
+
+typedef struct tbsm_ingress tbsm_ingress;
+
+/**
+ *  Maps the ring with the specified name.
+ *
+ *  @param name     The name of the ring. Keep it short: Darwin limits shared memory names to 31 characters.
+ *  @param capacity The number of records. Rounded up to a power of two. Ignored when opening an existing ring.
+ *  @param create   Non zero to create the ring if it does not exist yet.
+ *
+ *  @return The ring handle or `NULL` with `errno` set. `EAGAIN` means the ring is still being created by another process,
+ *          i.e. the object is not sized or its magic has not been published yet. `EINVAL` means the shared memory object
+ *          is not a compatible ring.
+ */
+tbsm_ingress *tbsm_ingress_open(const char *name, uint32_t capacity, int create);
+
+/**
+ *  Unmaps the ring and releases the handle.
+ */
+void tbsm_ingress_close(tbsm_ingress *ingress);
+
+/**
+ *  Removes the shared memory object and the semaphore of the ring with the specified name.
+ */
+void tbsm_ingress_unlink(const char *name);
+
+/**
+ *  Publishes an event. Safe to call from any number of threads and processes.
+ *
+ *  @return `0` on success, `-1` if the ring is full or the payload exceeds `TBSM_INGRESS_PAYLOAD_SIZE`.
+ */
+int tbsm_ingress_send(tbsm_ingress *ingress, uint16_t machine, uint16_t event, const void *payload, uint16_t length);
+
+/**
+ *  Takes the next published record without blocking. Must only be called by the consumer.
+ *
+ *  @return `1` if a record has been copied into `record`, `0` if the ring is empty.
+ */
+int tbsm_ingress_receive(tbsm_ingress *ingress, tbsm_ingress_record *record);
+
+/**
+ *  Parks the consumer until a producer publishes a record or `tbsm_ingress_wake` is called.
+ *  Returns immediately if the ring is not empty.
+ */
+void tbsm_ingress_wait(tbsm_ingress *ingress);
+
+/**
+ *  Wakes a parked consumer.
+ */
+void tbsm_ingress_wake(tbsm_ingress *ingress);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
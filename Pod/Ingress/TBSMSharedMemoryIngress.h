@@ -0,0 +1,86 @@
+//
+//  TBSMSharedMemoryIngress.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMStateMachine.h"
+#import "TBSMIngressRing.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class receives events from other processes through a shared memory ring and schedules them on registered state machines.
+ *
+ *  Producers link against the plain C functions in `TBSMIngressRing.h` and address state machines and events
+ *  by the numeric identifiers registered here. A single drain thread copies each record out of the ring
+ *  and calls `-scheduleEvent:` on the target state machine, so the run-to-completion model stays untouched.
+ */
+@interface TBSMSharedMemoryIngress : NSObject
+
+/**
+ *  The name of the ring.
+ */
+@property (nonatomic, copy, readonly) NSString *name;
+
+/**
+ *  `YES` between `-start` and `-stop`.
+ */
+@property (nonatomic, assign, readonly, getter=isRunning) BOOL running;
+
+/**
+ *  The number of records taken from the ring.
+ */
+@property (nonatomic, assign, readonly) NSUInteger receivedCount;
+
+/**
+ *  The number of records which could not be scheduled because of an unknown identifier or a full event queue.
+ */
+@property (nonatomic, assign, readonly) NSUInteger droppedCount;
+
+/**
+ *  Creates the ring if necessary and maps it into the current process.
+ *
+ *  @param name     The name of the ring. Darwin limits shared memory names to 31 characters including the `/tbsm.` prefix.
+ *  @param capacity The number of records the ring can hold. Rounded up to a power of two.
+ *  @param error    Set to a `TBSMErrorCodeIngressUnavailable` error if the ring could not be mapped.
+ *
+ *  @return The ingress instance or `nil`.
+ */
+- (nullable instancetype)initWithName:(NSString *)name capacity:(NSUInteger)capacity error:(NSError **)error;
+
+/**
+ *  Routes records carrying the specified identifier to a state machine.
+ *
+ *  @param stateMachine The state machine at the top of the hierarchy.
+ *  @param identifier   The machine identifier used by producers.
+ */
+- (void)registerStateMachine:(TBSMStateMachine *)stateMachine identifier:(uint16_t)identifier;
+
+/**
+ *  Maps the specified identifier to an event name.
+ *
+ *  @param name       The name of the event.
+ *  @param identifier The event identifier used by producers.
+ */
+- (void)registerEventName:(NSString *)name identifier:(uint16_t)identifier;
+
+/**
+ *  Starts the drain thread.
+ */
+- (void)start;
+
+/**
+ *  Stops the drain thread and waits until it has finished. Records still in the ring stay there until the next `-start`.
+ */
+- (void)stop;
+
+/**
+ *  Removes the shared memory objects of the ring with the specified name.
+ *
+ *  @param name The name of the ring.
+ */
++ (void)unlinkRingWithName:(NSString *)name;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,128 @@
+//
+//  TBSMSharedMemoryIngress.m
+//  TBStateMachine
+//
+
+#import "TBSMSharedMemoryIngress.h"
+#import "NSError+TBStateMachine.h"
+
+@interface TBSMSharedMemoryIngress ()
+@property (nonatomic, copy) NSString *name;
+@property (atomic, assign, getter=isRunning) BOOL running;
+@property (atomic, assign) NSUInteger receivedCount;
+@property (atomic, assign) NSUInteger droppedCount;
+@property (nonatomic, assign) tbsm_ingress *priv_ring;
+@property (nonatomic, strong) NSMapTable<NSNumber *, TBSMStateMachine *> *priv_stateMachines;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSString *> *priv_eventNames;
+@property (nonatomic, strong) NSLock *priv_lock;
+@property (nonatomic, strong) dispatch_group_t priv_drainGroup;
+@end
+
+@implementation TBSMSharedMemoryIngress
+
+- (nullable instancetype)initWithName:(NSString *)name capacity:(NSUInteger)capacity error:(NSError **)error
+{
+    self = [super init];
+    if (self) {
+        _priv_ring = tbsm_ingress_open(name.UTF8String, (uint32_t)MIN(capacity, (NSUInteger)UINT32_MAX), 1);
+        if (_priv_ring == NULL) {
+            if (error) {
+                *error = [NSError tbsm_ingressUnavailableError:name];
+            }
+            return nil;
+        }
+        _name = name.copy;
+        _priv_stateMachines = [NSMapTable strongToWeakObjectsMapTable];
+        _priv_eventNames = [NSMutableDictionary new];
+        _priv_lock = [NSLock new];
+        _priv_drainGroup = dispatch_group_create();
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_priv_ring) {
+        tbsm_ingress_close(_priv_ring);
+    }
+}
+
++ (void)unlinkRingWithName:(NSString *)name
+{
+    tbsm_ingress_unlink(name.UTF8String);
+}
+
+- (void)registerStateMachine:(TBSMStateMachine *)stateMachine identifier:(uint16_t)identifier
+{
+    [self.priv_lock lock];
+    [self.priv_stateMachines setObject:stateMachine forKey:@(identifier)];
+    [self.priv_lock unlock];
+}
+
+- (void)registerEventName:(NSString *)name identifier:(uint16_t)identifier
+{
+    [self.priv_lock lock];
+    self.priv_eventNames[@(identifier)] = name.copy;
+    [self.priv_lock unlock];
+}
+
+- (void)start
+{
+    if (self.running) {
+        return;
+    }
+    self.running = YES;
+    dispatch_group_enter(self.priv_drainGroup);
+    NSThread *thread = [[NSThread alloc] initWithTarget:self selector:@selector(_drain) object:nil];
+    thread.name = [NSString stringWithFormat:@"TBSMSharedMemoryIngress.%@", self.name];
+    thread.qualityOfService = NSQualityOfServiceUserInitiated;
+    [thread start];
+}
+
+- (void)stop
+{
+    if (!self.running) {
+        return;
+    }
+    self.running = NO;
+    tbsm_ingress_wake(self.priv_ring);
+    dispatch_group_wait(self.priv_drainGroup, DISPATCH_TIME_FOREVER);
+}
+
+#pragma mark - Draining
+
+- (void)_drain
+{
+    tbsm_ingress_record record;
+    while (self.running) {
+        @autoreleasepool {
+            if (tbsm_ingress_receive(self.priv_ring, &record)) {
+                self.receivedCount++;
+                [self _dispatchRecord:&record];
+            } else {
+                tbsm_ingress_wait(self.priv_ring);
+            }
+        }
+    }
+    dispatch_group_leave(self.priv_drainGroup);
+}
+
+- (void)_dispatchRecord:(const tbsm_ingress_record *)record
+{
+    [self.priv_lock lock];
+    TBSMStateMachine *stateMachine = [self.priv_stateMachines objectForKey:@(record->machine)];
+    NSString *eventName = self.priv_eventNames[@(record->event)];
+    [self.priv_lock unlock];
+
+    if (stateMachine == nil || eventName == nil) {
+        self.droppedCount++;
+        return;
+    }
+    NSData *data = (record->length > 0) ? [NSData dataWithBytes:record->payload length:record->length] : nil;
+    TBSMEventQueueStatus status = [stateMachine scheduleEvent:[TBSMEvent eventWithName:eventName data:data]];
+    if (status == TBSMEventQueueStatusRejected || status == TBSMEventQueueStatusDropped) {
+        self.droppedCount++;
+    }
+}
+
+@end
@@ -0,0 +1,38 @@
+//
+//  TBSMJournalLog.h
+//  TBStateMachine
+//
+
+#ifndef Pods_TBSMJournalLog_h
+#define Pods_TBSMJournalLog_h
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Binary transition journal format. All integers are stored little endian.
+ *
+ *  header:     'T' 'B' 'S' 'J' | uint8 version | 3 bytes reserved
+ *  state path: uint8 0x01 | uint16 identifier | uint16 length | UTF-8 path
+ *  event name: uint8 0x02 | uint16 identifier | uint16 length | UTF-8 name
+ *  step:       uint8 0x03 | uint16 machine | uint16 event identifier | uint16 exited count | uint16 entered count | uint16 state path identifiers
+ *  snapshot:   uint8 0x04 | uint16 machine | uint16 count | uint16 state path identifiers
+ *
+ *  A step carries the leaf states which have been left and entered. A snapshot replaces the whole configuration of a machine.
+ *  Steps without event use the event identifier 0xFFFF, so identifiers range from 0 to 0xFFFE. Counts and name lengths are limited to 0xFFFF.
+ *  An incomplete record at the end of the file is ignored.
+ */
+static const char TBSMJournalLogMagic[4] = {'T', 'B', 'S', 'J'};
+static const uint8_t TBSMJournalLogVersion = 1;
+static const NSUInteger TBSMJournalLogHeaderLength = 8;
+static const uint16_t TBSMJournalLogNoEvent = 0xFFFF;
+static const NSUInteger TBSMJournalLogMaximumIdentifierCount = TBSMJournalLogNoEvent;
+static const NSUInteger TBSMJournalLogMaximumCount = UINT16_MAX;
+
+typedef NS_ENUM(uint8_t, TBSMJournalLogRecord) {
+    TBSMJournalLogRecordStatePath = 0x01,
+    TBSMJournalLogRecordEventName = 0x02,
+    TBSMJournalLogRecordStep = 0x03,
+    TBSMJournalLogRecordSnapshot = 0x04
+};
+
+#endif
@@ -0,0 +1,116 @@
+//
+//  TBSMTransitionJournal.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMStateMachine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class appends the configuration changes of any number of state machines to a write-ahead log on disk.
+ *
+ *  After every run-to-completion step the leaf states which have been left and entered are encoded into a
+ *  memory buffer. The buffer is written and synced to disk on a background queue at most `maximumLatency`
+ *  after the first pending step, so a single sync covers all steps of all machines within that window.
+ *  After a crash the configurations can be restored from the log without executing any actions.
+ */
+@interface TBSMTransitionJournal : NSObject <TBSMJournaling>
+
+/**
+ *  The path of the log file.
+ */
+@property (nonatomic, copy, readonly) NSString *path;
+
+/**
+ *  The maximum time in seconds a completed step may stay in memory before it is synced to disk.
+ *
+ *  Defaults to `0.005`. Higher values batch more steps into a single sync.
+ */
+@property (nonatomic, assign) NSTimeInterval maximumLatency;
+
+/**
+ *  The number of steps which have been appended to the log.
+ */
+@property (nonatomic, assign, readonly) NSUInteger stepCount;
+
+/**
+ *  The number of syncs to disk.
+ */
+@property (nonatomic, assign, readonly) NSUInteger syncCount;
+
+/**
+ *  The last error which occurred while writing to disk or journaling a step.
+ *
+ *  Data which could not be written is kept and written together with fresh snapshots of all attached state machines on the next sync.
+ *  A `TBSMErrorCodeJournalCapacityExceeded` error means that all identifiers are in use. Call `-compact:` to release unused ones.
+ */
+@property (nonatomic, strong, readonly, nullable) NSError *lastError;
+
+/**
+ *  Opens the log at the specified path. An existing log will be continued.
+ *
+ *  @param path  The path of the log file.
+ *  @param error Set if the file could not be opened or to a `TBSMErrorCodeInvalidEventLog` error if an existing log could not be read.
+ *
+ *  @return The journal instance or `nil`.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path error:(NSError **)error;
+
+/**
+ *  Sets the journal as `journal` of the specified state machine and appends a snapshot of its current configuration.
+ *
+ *  @param stateMachine The state machine at the top of the hierarchy.
+ *  @param identifier   The identifier of the state machine inside the log.
+ */
+- (void)attachStateMachine:(TBSMStateMachine *)stateMachine identifier:(uint16_t)identifier;
+
+/**
+ *  Stops journaling the specified state machine.
+ *
+ *  @param stateMachine The state machine at the top of the hierarchy.
+ */
+- (void)detachStateMachine:(TBSMStateMachine *)stateMachine;
+
+/**
+ *  Writes and syncs all pending steps. Returns when they are on disk.
+ */
+- (void)synchronize;
+
+/**
+ *  Replaces the log by a snapshot of the configurations of all attached state machines.
+ *
+ *  The new log is written to a temporary file first and moved into place atomically.
+ *
+ *  @param error Set if the snapshot could not be written.
+ *
+ *  @return `YES` if the log has been compacted.
+ */
+- (BOOL)compact:(NSError **)error;
+
+/**
+ *  Reads the configurations from a log.
+ *
+ *  @param path  The path of the log file.
+ *  @param error Set if the file could not be read or to a `TBSMErrorCodeInvalidEventLog` error if the log is corrupt.
+ *
+ *  @return The paths of the active leaf states keyed by machine identifier or `nil`.
+ */
++ (nullable NSDictionary<NSNumber *, NSArray<NSString *> *> *)configurationsFromFile:(NSString *)path error:(NSError **)error;
+
+/**
+ *  Sets up the specified state machines in the configurations read from a log without executing any actions.
+ *
+ *  State machines without configuration in the log or with an empty configuration will not be set up.
+ *
+ *  @param stateMachines The state machines keyed by machine identifier.
+ *  @param path          The path of the log file.
+ *  @param error         Set if the log could not be read or a configuration could not be restored.
+ *
+ *  @return `YES` if all configurations have been restored.
+ */
++ (BOOL)restoreStateMachines:(NSDictionary<NSNumber *, TBSMStateMachine *> *)stateMachines fromFile:(NSString *)path error:(NSError **)error;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,584 @@
+//
+//  TBSMTransitionJournal.m
+//  TBStateMachine
+//
+
+#import "TBSMTransitionJournal.h"
+#import "TBSMJournalLog.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+@interface TBSMJournalEntry : NSObject
+@property (nonatomic, assign) uint16_t identifier;
+@property (nonatomic, strong) NSSet<NSNumber *> *configuration;
+@end
+
+@implementation TBSMJournalEntry
+@end
+
+@interface TBSMJournalContents : NSObject
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSString *> *statePaths;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSString *> *eventNames;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSMutableSet<NSNumber *> *> *configurations;
+@property (nonatomic, assign) NSUInteger length;
+@end
+
+@implementation TBSMJournalContents
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _statePaths = [NSMutableDictionary new];
+        _eventNames = [NSMutableDictionary new];
+        _configurations = [NSMutableDictionary new];
+    }
+    return self;
+}
+
+- (NSMutableSet<NSNumber *> *)configurationOfMachine:(uint16_t)machine
+{
+    NSMutableSet *configuration = self.configurations[@(machine)];
+    if (configuration == nil) {
+        configuration = [NSMutableSet new];
+        self.configurations[@(machine)] = configuration;
+    }
+    return configuration;
+}
+
+@end
+
+static inline uint16_t TBSMReadUInt16(const uint8_t *bytes)
+{
+    uint16_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return CFSwapInt16LittleToHost(value);
+}
+
+static NSError *TBSMPOSIXError(void)
+{
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+}
+
+static BOOL TBSMWriteAndSync(int fileDescriptor, NSData *data)
+{
+    const uint8_t *bytes = data.bytes;
+    NSUInteger remaining = data.length;
+    while (remaining > 0) {
+        ssize_t written = write(fileDescriptor, bytes, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NO;
+        }
+        bytes += written;
+        remaining -= (NSUInteger)written;
+    }
+#ifdef F_FULLFSYNC
+    // fsync on Darwin does not flush the write cache of the drive.
+    if (fcntl(fileDescriptor, F_FULLFSYNC) == 0) {
+        return YES;
+    }
+#endif
+    return (fsync(fileDescriptor) == 0);
+}
+
+@interface TBSMTransitionJournal ()
+@property (nonatomic, copy) NSString *path;
+@property (atomic, assign) NSUInteger stepCount;
+@property (atomic, assign) NSUInteger syncCount;
+@property (atomic, strong) NSError *lastError;
+@property (nonatomic, assign) int priv_fileDescriptor;
+@property (nonatomic, strong) NSMutableData *priv_buffer;
+@property (nonatomic, assign) BOOL priv_syncScheduled;
+@property (nonatomic, assign) off_t priv_syncedLength;
+@property (nonatomic, assign) BOOL priv_syncFailed;
+@property (nonatomic, strong) NSMapTable<TBSMStateMachine *, TBSMJournalEntry *> *priv_entries;
+@property (nonatomic, strong) NSMapTable<TBSMState *, NSNumber *> *priv_stateIdentifiers;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *priv_pathIdentifiers;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *priv_eventIdentifiers;
+@property (nonatomic, strong) NSLock *priv_lock;
+@property (nonatomic, strong) dispatch_queue_t priv_syncQueue;
+@end
+
+@implementation TBSMTransitionJournal
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error
+{
+    self = [super init];
+    if (self) {
+        _path = path.copy;
+        _maximumLatency = 0.005;
+        _priv_fileDescriptor = -1;
+        _priv_buffer = [NSMutableData new];
+        _priv_entries = [NSMapTable weakToStrongObjectsMapTable];
+        _priv_stateIdentifiers = [NSMapTable weakToStrongObjectsMapTable];
+        _priv_pathIdentifiers = [NSMutableDictionary new];
+        _priv_eventIdentifiers = [NSMutableDictionary new];
+        _priv_lock = [NSLock new];
+        _priv_syncQueue = dispatch_queue_create("TBSMTransitionJournal", DISPATCH_QUEUE_SERIAL);
+        
+        TBSMJournalContents *contents = [TBSMJournalContents new];
+        NSData *data = [NSData dataWithContentsOfFile:path];
+        if (data.length > 0) {
+            contents = [[self class] _contentsOfData:data error:error];
+            if (contents == nil) {
+                return nil;
+            }
+        }
+        [contents.statePaths enumerateKeysAndObjectsUsingBlock:^(NSNumber *identifier, NSString *statePath, BOOL *stop) {
+            self->_priv_pathIdentifiers[statePath] = identifier;
+        }];
+        [contents.eventNames enumerateKeysAndObjectsUsingBlock:^(NSNumber *identifier, NSString *name, BOOL *stop) {
+            self->_priv_eventIdentifiers[name] = identifier;
+        }];
+        
+        _priv_fileDescriptor = open(path.fileSystemRepresentation, O_WRONLY | O_CREAT, 0644);
+        if (_priv_fileDescriptor < 0 || ftruncate(_priv_fileDescriptor, (off_t)contents.length) != 0 || lseek(_priv_fileDescriptor, 0, SEEK_END) < 0) {
+            if (error) {
+                *error = TBSMPOSIXError();
+            }
+            return nil;
+        }
+        if (contents.length == 0) {
+            [_priv_buffer appendData:[self _headerData]];
+        }
+        _priv_syncedLength = (off_t)contents.length;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_priv_fileDescriptor >= 0) {
+        [self _sync];
+        close(_priv_fileDescriptor);
+    }
+}
+
+- (void)attachStateMachine:(TBSMStateMachine *)stateMachine identifier:(uint16_t)identifier
+{
+    [self.priv_lock lock];
+    TBSMJournalEntry *entry = [TBSMJournalEntry new];
+    entry.identifier = identifier;
+    entry.configuration = [self _configurationOfStateMachine:stateMachine] ?: [NSSet set];
+    [self.priv_entries setObject:entry forKey:stateMachine];
+    [self _appendSnapshotOfEntry:entry];
+    [self _scheduleSync];
+    [self.priv_lock unlock];
+    stateMachine.journal = self;
+}
+
+- (void)detachStateMachine:(TBSMStateMachine *)stateMachine
+{
+    [self.priv_lock lock];
+    [self.priv_entries removeObjectForKey:stateMachine];
+    [self.priv_lock unlock];
+    if (stateMachine.journal == self) {
+        stateMachine.journal = nil;
+    }
+}
+
+- (void)synchronize
+{
+    dispatch_sync(self.priv_syncQueue, ^{
+        [self _sync];
+    });
+}
+
+- (BOOL)compact:(NSError **)error
+{
+    __block NSError *compactError = nil;
+    dispatch_sync(self.priv_syncQueue, ^{
+        [self.priv_lock lock];
+        NSMutableDictionary *statePaths = [NSMutableDictionary new];
+        [self.priv_pathIdentifiers enumerateKeysAndObjectsUsingBlock:^(NSString *statePath, NSNumber *identifier, BOOL *stop) {
+            statePaths[identifier] = statePath;
+        }];
+        NSMutableDictionary *pathIdentifiers = self.priv_pathIdentifiers;
+        NSMutableDictionary *eventIdentifiers = self.priv_eventIdentifiers;
+        NSMapTable *stateIdentifiers = self.priv_stateIdentifiers;
+        NSMutableData *buffer = self.priv_buffer;
+        NSMapTable *configurations = [NSMapTable strongToStrongObjectsMapTable];
+        
+        // The configurations of all entries already include the pending steps, so the buffer can be discarded.
+        self.priv_pathIdentifiers = [NSMutableDictionary new];
+        self.priv_eventIdentifiers = [NSMutableDictionary new];
+        self.priv_stateIdentifiers = [NSMapTable weakToStrongObjectsMapTable];
+        self.priv_buffer = [[self _headerData] mutableCopy];
+        for (TBSMJournalEntry *entry in self.priv_entries.objectEnumerator) {
+            NSMutableSet *configuration = [NSMutableSet setWithCapacity:entry.configuration.count];
+            for (NSNumber *identifier in entry.configuration) {
+                // Compaction only keeps identifiers in use, so these always fit.
+                [configuration addObject:@([self _identifierForName:statePaths[identifier] identifiers:self.priv_pathIdentifiers record:TBSMJournalLogRecordStatePath])];
+            }
+            [configurations setObject:entry.configuration forKey:entry];
+            entry.configuration = configuration;
+            [self _appendSnapshotOfEntry:entry];
+        }
+        NSData *data = self.priv_buffer;
+        self.priv_buffer = [NSMutableData new];
+        
+        if ([self _replaceFileWithData:data error:&compactError]) {
+            self.priv_syncedLength = (off_t)data.length;
+            self.priv_syncFailed = NO;
+        } else {
+            self.priv_pathIdentifiers = pathIdentifiers;
+            self.priv_eventIdentifiers = eventIdentifiers;
+            self.priv_stateIdentifiers = stateIdentifiers;
+            self.priv_buffer = buffer;
+            for (TBSMJournalEntry *entry in configurations) {
+                entry.configuration = [configurations objectForKey:entry];
+            }
+        }
+        [self.priv_lock unlock];
+    });
+    if (compactError && error) {
+        *error = compactError;
+    }
+    return (compactError == nil);
+}
+
++ (NSDictionary<NSNumber *, NSArray<NSString *> *> *)configurationsFromFile:(NSString *)path error:(NSError **)error
+{
+    NSData *data = [NSData dataWithContentsOfFile:path options:0 error:error];
+    if (data == nil) {
+        return nil;
+    }
+    TBSMJournalContents *contents = [self _contentsOfData:data error:error];
+    if (contents == nil) {
+        return nil;
+    }
+    NSMutableDictionary *configurations = [NSMutableDictionary new];
+    for (NSNumber *machine in contents.configurations) {
+        NSMutableArray *paths = [NSMutableArray new];
+        for (NSNumber *identifier in contents.configurations[machine]) {
+            NSString *statePath = contents.statePaths[identifier];
+            if (statePath == nil) {
+                if (error) {
+                    *error = [NSError tbsm_invalidEventLogError:contents.length];
+                }
+                return nil;
+            }
+            [paths addObject:statePath];
+        }
+        configurations[machine] = [paths sortedArrayUsingSelector:@selector(compare:)];
+    }
+    return configurations;
+}
+
++ (BOOL)restoreStateMachines:(NSDictionary<NSNumber *, TBSMStateMachine *> *)stateMachines fromFile:(NSString *)path error:(NSError **)error
+{
+    NSDictionary *configurations = [self configurationsFromFile:path error:error];
+    if (configurations == nil) {
+        return NO;
+    }
+    for (NSNumber *machine in stateMachines) {
+        NSArray *paths = configurations[machine];
+        if (paths.count == 0) {
+            continue;
+        }
+        if (![stateMachines[machine] setUpWithActiveStatesAtPaths:paths error:error]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+#pragma mark - TBSMJournaling
+
+- (void)stateMachine:(TBSMStateMachine *)stateMachine didCompleteStepWithEvent:(TBSMEvent *)event
+{
+    [self.priv_lock lock];
+    TBSMJournalEntry *entry = [self.priv_entries objectForKey:stateMachine];
+    NSSet *configuration = entry ? [self _configurationOfStateMachine:stateMachine] : nil;
+    if (configuration) {
+        NSMutableSet *exited = entry.configuration.mutableCopy;
+        [exited minusSet:configuration];
+        NSMutableSet *entered = configuration.mutableCopy;
+        [entered minusSet:entry.configuration];
+        
+        NSUInteger eventIdentifier = TBSMJournalLogNoEvent;
+        if ((exited.count > 0 || entered.count > 0) && event) {
+            eventIdentifier = [self _identifierForName:event.name identifiers:self.priv_eventIdentifiers record:TBSMJournalLogRecordEventName];
+        }
+        // Skipped steps are contained in the next one since the entry keeps the last journaled configuration.
+        if ((exited.count > 0 || entered.count > 0) && eventIdentifier != NSNotFound) {
+            [self _appendUInt8:TBSMJournalLogRecordStep];
+            [self _appendUInt16:entry.identifier];
+            [self _appendUInt16:(uint16_t)eventIdentifier];
+            [self _appendUInt16:(uint16_t)exited.count];
+            [self _appendUInt16:(uint16_t)entered.count];
+            for (NSNumber *identifier in exited) {
+                [self _appendUInt16:identifier.unsignedShortValue];
+            }
+            for (NSNumber *identifier in entered) {
+                [self _appendUInt16:identifier.unsignedShortValue];
+            }
+            entry.configuration = configuration;
+            self.stepCount++;
+            [self _scheduleSync];
+        }
+    }
+    [self.priv_lock unlock];
+}
+
+#pragma mark - private
+
+/**
+ *  Returns `nil` and sets `lastError` if the configuration exceeds the limits of the journal format.
+ */
+- (NSSet<NSNumber *> *)_configurationOfStateMachine:(TBSMStateMachine *)stateMachine
+{
+    __block NSMutableSet *configuration = [NSMutableSet new];
+    [stateMachine enumerateActiveLeafStatesUsingBlock:^(TBSMState *state, BOOL *stop) {
+        NSNumber *identifier = [self.priv_stateIdentifiers objectForKey:state];
+        if (identifier == nil) {
+            NSUInteger newIdentifier = [self _identifierForName:[stateMachine pathOfState:state] identifiers:self.priv_pathIdentifiers record:TBSMJournalLogRecordStatePath];
+            if (newIdentifier == NSNotFound) {
+                configuration = nil;
+                *stop = YES;
+                return;
+            }
+            identifier = @(newIdentifier);
+            [self.priv_stateIdentifiers setObject:identifier forKey:state];
+        }
+        [configuration addObject:identifier];
+    }];
+    if (configuration.count > TBSMJournalLogMaximumCount) {
+        self.lastError = [NSError tbsm_journalCapacityExceededError:stateMachine.name];
+        return nil;
+    }
+    return configuration;
+}
+
+/**
+ *  Returns `NSNotFound` and sets `lastError` if no identifier is left or the name is too long.
+ */
+- (NSUInteger)_identifierForName:(NSString *)name identifiers:(NSMutableDictionary<NSString *, NSNumber *> *)identifiers record:(TBSMJournalLogRecord)record
+{
+    NSNumber *identifier = identifiers[name];
+    if (identifier) {
+        return identifier.unsignedShortValue;
+    }
+    NSData *bytes = [name dataUsingEncoding:NSUTF8StringEncoding];
+    if (identifiers.count >= TBSMJournalLogMaximumIdentifierCount || bytes.length > TBSMJournalLogMaximumCount) {
+        self.lastError = [NSError tbsm_journalCapacityExceededError:name];
+        return NSNotFound;
+    }
+    uint16_t newIdentifier = (uint16_t)identifiers.count;
+    identifiers[name] = @(newIdentifier);
+    
+    [self _appendUInt8:record];
+    [self _appendUInt16:newIdentifier];
+    [self _appendUInt16:(uint16_t)bytes.length];
+    [self.priv_buffer appendData:bytes];
+    return newIdentifier;
+}
+
+- (void)_appendSnapshotOfEntry:(TBSMJournalEntry *)entry
+{
+    [self _appendUInt8:TBSMJournalLogRecordSnapshot];
+    [self _appendUInt16:entry.identifier];
+    [self _appendUInt16:(uint16_t)entry.configuration.count];
+    for (NSNumber *identifier in entry.configuration) {
+        [self _appendUInt16:identifier.unsignedShortValue];
+    }
+}
+
+- (void)_scheduleSync
+{
+    if (self.priv_syncScheduled) {
+        return;
+    }
+    self.priv_syncScheduled = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.maximumLatency * NSEC_PER_SEC)), self.priv_syncQueue, ^{
+        [self _sync];
+    });
+}
+
+- (void)_sync
+{
+    [self.priv_lock lock];
+    NSMutableData *data = self.priv_buffer;
+    self.priv_buffer = [NSMutableData new];
+    self.priv_syncScheduled = NO;
+    [self.priv_lock unlock];
+    
+    if (data.length == 0) {
+        return;
+    }
+    // A failed write may have left a partial record behind which would hide everything appended after it.
+    if (self.priv_syncFailed && (ftruncate(self.priv_fileDescriptor, self.priv_syncedLength) != 0 || lseek(self.priv_fileDescriptor, self.priv_syncedLength, SEEK_SET) < 0)) {
+        [self _requeueData:data];
+        return;
+    }
+    if (!TBSMWriteAndSync(self.priv_fileDescriptor, data)) {
+        [self _requeueData:data];
+        return;
+    }
+    self.priv_syncedLength += (off_t)data.length;
+    self.priv_syncFailed = NO;
+    self.syncCount++;
+}
+
+/**
+ *  Puts unwritten data back in front of the buffer and appends snapshots of all entries once per failure,
+ *  so the log is consistent again after the next successful write.
+ */
+- (void)_requeueData:(NSMutableData *)data
+{
+    self.lastError = TBSMPOSIXError();
+    
+    [self.priv_lock lock];
+    [data appendData:self.priv_buffer];
+    self.priv_buffer = data;
+    if (!self.priv_syncFailed) {
+        self.priv_syncFailed = YES;
+        for (TBSMJournalEntry *entry in self.priv_entries.objectEnumerator) {
+            [self _appendSnapshotOfEntry:entry];
+        }
+    }
+    [self.priv_lock unlock];
+}
+
+- (BOOL)_replaceFileWithData:(NSData *)data error:(NSError **)error
+{
+    NSString *temporaryPath = [self.path stringByAppendingString:@".tmp"];
+    int fileDescriptor = open(temporaryPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0 || !TBSMWriteAndSync(fileDescriptor, data) || rename(temporaryPath.fileSystemRepresentation, self.path.fileSystemRepresentation) != 0) {
+        if (error) {
+            *error = TBSMPOSIXError();
+        }
+        if (fileDescriptor >= 0) {
+            close(fileDescriptor);
+        }
+        unlink(temporaryPath.fileSystemRepresentation);
+        return NO;
+    }
+    int directory = open(self.path.stringByDeletingLastPathComponent.fileSystemRepresentation, O_RDONLY);
+    if (directory >= 0) {
+        fsync(directory);
+        close(directory);
+    }
+    close(self.priv_fileDescriptor);
+    self.priv_fileDescriptor = fileDescriptor;
+    return YES;
+}
+
+- (NSData *)_headerData
+{
+    NSMutableData *header = [NSMutableData dataWithBytes:TBSMJournalLogMagic length:sizeof(TBSMJournalLogMagic)];
+    uint8_t version[4] = {TBSMJournalLogVersion, 0, 0, 0};
+    [header appendBytes:version length:sizeof(version)];
+    return header;
+}
+
+/**
+ *  Reads all complete records. Returns `nil` if the log is corrupt.
+ */
++ (TBSMJournalContents *)_contentsOfData:(NSData *)data error:(NSError **)error
+{
+    TBSMJournalContents *contents = [TBSMJournalContents new];
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    if (length < TBSMJournalLogHeaderLength) {
+        return contents;
+    }
+    if (memcmp(bytes, TBSMJournalLogMagic, sizeof(TBSMJournalLogMagic)) != 0 || bytes[4] != TBSMJournalLogVersion) {
+        if (error) {
+            *error = [NSError tbsm_invalidEventLogError:0];
+        }
+        return nil;
+    }
+    
+    NSUInteger offset = TBSMJournalLogHeaderLength;
+    contents.length = offset;
+    while (offset < length) {
+        const uint8_t *record = bytes + offset;
+        NSUInteger available = length - offset;
+        NSUInteger recordLength = 0;
+        
+        switch (record[0]) {
+            case TBSMJournalLogRecordStatePath:
+            case TBSMJournalLogRecordEventName: {
+                if (available < 5 || available < 5 + (NSUInteger)TBSMReadUInt16(record + 3)) {
+                    break;
+                }
+                recordLength = 5 + TBSMReadUInt16(record + 3);
+                NSString *name = [[NSString alloc] initWithBytes:record + 5 length:recordLength - 5 encoding:NSUTF8StringEncoding];
+                if (name == nil) {
+                    if (error) {
+                        *error = [NSError tbsm_invalidEventLogError:offset];
+                    }
+                    return nil;
+                }
+                NSMutableDictionary *names = (record[0] == TBSMJournalLogRecordStatePath) ? contents.statePaths : contents.eventNames;
+                names[@(TBSMReadUInt16(record + 1))] = name;
+                break;
+            }
+            case TBSMJournalLogRecordStep: {
+                if (available < 9) {
+                    break;
+                }
+                NSUInteger exited = TBSMReadUInt16(record + 5);
+                NSUInteger entered = TBSMReadUInt16(record + 7);
+                if (available < 9 + 2 * (exited + entered)) {
+                    break;
+                }
+                recordLength = 9 + 2 * (exited + entered);
+                NSMutableSet *configuration = [contents configurationOfMachine:TBSMReadUInt16(record + 1)];
+                for (NSUInteger index = 0; index < exited; index++) {
+                    [configuration removeObject:@(TBSMReadUInt16(record + 9 + 2 * index))];
+                }
+                for (NSUInteger index = 0; index < entered; index++) {
+                    [configuration addObject:@(TBSMReadUInt16(record + 9 + 2 * (exited + index)))];
+                }
+                break;
+            }
+            case TBSMJournalLogRecordSnapshot: {
+                if (available < 5) {
+                    break;
+                }
+                NSUInteger count = TBSMReadUInt16(record + 3);
+                if (available < 5 + 2 * count) {
+                    break;
+                }
+                recordLength = 5 + 2 * count;
+                NSMutableSet *configuration = [contents configurationOfMachine:TBSMReadUInt16(record + 1)];
+                [configuration removeAllObjects];
+                for (NSUInteger index = 0; index < count; index++) {
+                    [configuration addObject:@(TBSMReadUInt16(record + 5 + 2 * index))];
+                }
+                break;
+            }
+            default:
+                if (error) {
+                    *error = [NSError tbsm_invalidEventLogError:offset];
+                }
+                return nil;
+        }
+        if (recordLength == 0) {
+            // The last record has not been written completely.
+            break;
+        }
+        offset += recordLength;
+        contents.length = offset;
+    }
+    return contents;
+}
+
+- (void)_appendUInt8:(uint8_t)value
+{
+    [self.priv_buffer appendBytes:&value length:sizeof(value)];
+}
+
+- (void)_appendUInt16:(uint16_t)value
+{
+    value = CFSwapInt16HostToLittle(value);
+    [self.priv_buffer appendBytes:&value length:sizeof(value)];
+}
+
+@end
@@ -0,0 +1,31 @@
+//
+//  TBSMEventLog.h
+//  TBStateMachine
+//
+
+#ifndef Pods_TBSMEventLog_h
+#define Pods_TBSMEventLog_h
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Binary event log format. All integers are stored little endian.
+ *
+ *  header:       'T' 'B' 'S' 'M' | uint8 version | 3 bytes reserved
+ *  event name:   uint8 0x01 | uint16 identifier | uint16 length | UTF-8 name
+ *  event:        uint8 0x02 | uint16 identifier | uint8 priority | uint64 nanoseconds since start | uint32 length | payload
+ *  active state: uint8 0x03 | uint16 length | UTF-8 path
+ *
+ *  The payload is a binary property list. Events whose payload can not be serialized are stored with an empty payload.
+ */
+static const char TBSMEventLogMagic[4] = {'T', 'B', 'S', 'M'};
+static const uint8_t TBSMEventLogVersion = 1;
+static const NSUInteger TBSMEventLogHeaderLength = 8;
+
+typedef NS_ENUM(uint8_t, TBSMEventLogRecord) {
+    TBSMEventLogRecordEventName = 0x01,
+    TBSMEventLogRecordEvent = 0x02,
+    TBSMEventLogRecordActiveState = 0x03
+};
+
+#endif
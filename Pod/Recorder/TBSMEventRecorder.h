@@ -0,0 +1,85 @@
+//
+//  TBSMEventRecorder.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMStateMachine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This class records the events scheduled on a state machine into a compact binary log.
+ *
+ *  Only events which have been added to the event queue from outside of a run-to-completion step are recorded.
+ *  Events rejected, dropped or coalesced by the queue never reach the state machine, and events scheduled by
+ *  actions are scheduled again when the recorded events are replayed.
+ *
+ *  Every record contains the event name identifier, the priority, the payload and the point in time
+ *  the event has been scheduled at. The log can be fed back into a state machine built from the same
+ *  definition with `TBSMEventReplayer`.
+ *
+ *  Payloads are stored as binary property lists. Payloads which are not property lists are recorded as empty
+ *  and replayed as `nil`. They are counted in `droppedPayloadCount`.
+ */
+@interface TBSMEventRecorder : NSObject <TBSMEventRecording>
+
+/**
+ *  The state machine the recorder is attached to.
+ */
+@property (nonatomic, weak, readonly) TBSMStateMachine *stateMachine;
+
+/**
+ *  `YES` between `-start` and `-stop`.
+ */
+@property (nonatomic, assign, readonly, getter=isRecording) BOOL recording;
+
+/**
+ *  The number of events recorded so far.
+ */
+@property (nonatomic, assign, readonly) NSUInteger eventCount;
+
+/**
+ *  The number of recorded events whose payload could not be stored because it is not a property list.
+ *  A replay of such a log may diverge from the recorded run.
+ */
+@property (nonatomic, assign, readonly) NSUInteger droppedPayloadCount;
+
+/**
+ *  Creates a recorder and attaches it as `eventRecorder` to the specified state machine.
+ *
+ *  @param stateMachine The state machine at the top of the hierarchy.
+ *
+ *  @return The recorder instance.
+ */
+- (instancetype)initWithStateMachine:(TBSMStateMachine *)stateMachine;
+
+/**
+ *  Discards previous recordings and starts recording.
+ */
+- (void)start;
+
+/**
+ *  Stops recording and appends the active state configuration of the state machine to the log.
+ */
+- (void)stop;
+
+/**
+ *  Returns a copy of the binary log recorded so far.
+ *
+ *  @return The log data.
+ */
+- (NSData *)data;
+
+/**
+ *  Writes the binary log to the specified file.
+ *
+ *  @param path  The path of the file.
+ *  @param error Set if the file could not be written.
+ *
+ *  @return `YES` if the log has been written.
+ */
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)error;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,163 @@
+//
+//  TBSMEventRecorder.m
+//  TBStateMachine
+//
+
+#import "TBSMEventRecorder.h"
+#import "TBSMEventLog.h"
+
+@interface TBSMEventRecorder ()
+@property (nonatomic, weak) TBSMStateMachine *stateMachine;
+@property (nonatomic, assign, getter=isRecording) BOOL recording;
+@property (nonatomic, assign) NSUInteger eventCount;
+@property (nonatomic, assign) NSUInteger droppedPayloadCount;
+@property (nonatomic, strong) NSMutableData *priv_data;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *priv_identifiers;
+@property (nonatomic, strong) NSLock *priv_lock;
+@property (nonatomic, assign) NSTimeInterval priv_startTime;
+@end
+
+@implementation TBSMEventRecorder
+
+- (instancetype)initWithStateMachine:(TBSMStateMachine *)stateMachine
+{
+    self = [super init];
+    if (self) {
+        _stateMachine = stateMachine;
+        _priv_data = [NSMutableData new];
+        _priv_identifiers = [NSMutableDictionary new];
+        _priv_lock = [NSLock new];
+        stateMachine.eventRecorder = self;
+    }
+    return self;
+}
+
+- (void)start
+{
+    [self.priv_lock lock];
+    [self.priv_data setLength:0];
+    [self.priv_data appendBytes:TBSMEventLogMagic length:sizeof(TBSMEventLogMagic)];
+    uint8_t header[4] = {TBSMEventLogVersion, 0, 0, 0};
+    [self.priv_data appendBytes:header length:sizeof(header)];
+    [self.priv_identifiers removeAllObjects];
+    self.eventCount = 0;
+    self.droppedPayloadCount = 0;
+    self.priv_startTime = [NSProcessInfo processInfo].systemUptime;
+    self.recording = YES;
+    [self.priv_lock unlock];
+}
+
+- (void)stop
+{
+    [self.priv_lock lock];
+    if (self.recording) {
+        self.recording = NO;
+        [self.stateMachine enumerateActiveLeafStatesUsingBlock:^(TBSMState *state, BOOL *stop) {
+            NSData *path = [[self.stateMachine pathOfState:state] dataUsingEncoding:NSUTF8StringEncoding];
+            [self _appendUInt8:TBSMEventLogRecordActiveState];
+            [self _appendUInt16:(uint16_t)path.length];
+            [self.priv_data appendData:path];
+        }];
+    }
+    [self.priv_lock unlock];
+}
+
+- (NSData *)data
+{
+    [self.priv_lock lock];
+    NSData *data = self.priv_data.copy;
+    [self.priv_lock unlock];
+    return data;
+}
+
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)error
+{
+    return [[self data] writeToFile:path options:NSDataWritingAtomic error:error];
+}
+
+#pragma mark - TBSMEventRecording
+
+- (void)stateMachine:(TBSMStateMachine *)stateMachine didScheduleEvent:(TBSMEvent *)event status:(TBSMEventQueueStatus)status
+{
+    if (status != TBSMEventQueueStatusEnqueued || event.parentIdentifier != 0) {
+        return;
+    }
+    NSData *payload = [self _payloadForData:event.data];
+    
+    [self.priv_lock lock];
+    if (self.recording) {
+        if (payload == nil) {
+            payload = [NSData data];
+            self.droppedPayloadCount++;
+        }
+        uint16_t identifier = [self _identifierForEventName:event.name];
+        NSTimeInterval offset = MAX(event.enqueueTime - self.priv_startTime, 0.0);
+        uint64_t nanoseconds = (uint64_t)(offset * NSEC_PER_SEC);
+        [self _appendUInt8:TBSMEventLogRecordEvent];
+        [self _appendUInt16:identifier];
+        [self _appendUInt8:(uint8_t)event.priority];
+        [self _appendUInt64:nanoseconds];
+        [self _appendUInt32:(uint32_t)payload.length];
+        [self.priv_data appendData:payload];
+        self.eventCount++;
+    }
+    [self.priv_lock unlock];
+}
+
+#pragma mark - private
+
+- (uint16_t)_identifierForEventName:(NSString *)name
+{
+    NSNumber *identifier = self.priv_identifiers[name];
+    if (identifier) {
+        return identifier.unsignedShortValue;
+    }
+    uint16_t newIdentifier = (uint16_t)self.priv_identifiers.count;
+    self.priv_identifiers[name] = @(newIdentifier);
+    
+    NSData *bytes = [name dataUsingEncoding:NSUTF8StringEncoding];
+    [self _appendUInt8:TBSMEventLogRecordEventName];
+    [self _appendUInt16:newIdentifier];
+    [self _appendUInt16:(uint16_t)bytes.length];
+    [self.priv_data appendData:bytes];
+    return newIdentifier;
+}
+
+/**
+ *  Returns the payload as binary property list, empty data for no payload or `nil` if it is not a property list.
+ */
+- (NSData *)_payloadForData:(id)data
+{
+    if (data == nil) {
+        return [NSData data];
+    }
+    if (![NSPropertyListSerialization propertyList:data isValidForFormat:NSPropertyListBinaryFormat_v1_0]) {
+        return nil;
+    }
+    return [NSPropertyListSerialization dataWithPropertyList:data format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+}
+
+- (void)_appendUInt8:(uint8_t)value
+{
+    [self.priv_data appendBytes:&value length:sizeof(value)];
+}
+
+- (void)_appendUInt16:(uint16_t)value
+{
+    value = CFSwapInt16HostToLittle(value);
+    [self.priv_data appendBytes:&value length:sizeof(value)];
+}
+
+- (void)_appendUInt32:(uint32_t)value
+{
+    value = CFSwapInt32HostToLittle(value);
+    [self.priv_data appendBytes:&value length:sizeof(value)];
+}
+
+- (void)_appendUInt64:(uint64_t)value
+{
+    value = CFSwapInt64HostToLittle(value);
+    [self.priv_data appendBytes:&value length:sizeof(value)];
+}
+
+@end
@@ -0,0 +1,87 @@
+//
+//  TBSMEventReplayer.h
+//  TBStateMachine
+//
+
+#import <Foundation/Foundation.h>
+#import "TBSMStateMachine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  This enum defines the pacing of a replay.
+ */
+typedef NS_ENUM(NSUInteger, TBSMEventReplayPacing) {
+    /**
+     *  Events are handled at the points in time they have been recorded at.
+     */
+    TBSMEventReplayPacingOriginal,
+    /**
+     *  Events are handled back to back as fast as possible.
+     */
+    TBSMEventReplayPacingMaximum
+};
+
+/**
+ *  This class feeds an event log recorded by `TBSMEventRecorder` back into a state machine.
+ *
+ *  Events are scheduled with their recorded priority through `-scheduleEvent:`, so the event queue of the state machine
+ *  applies the same lane ordering, coalescing and overflow handling as during the recording. The replay waits until
+ *  the `scheduledEventsQueue` of the state machine has handled all events. The measured duration is a throughput
+ *  benchmark of the event dispatch.
+ */
+@interface TBSMEventReplayer : NSObject
+
+/**
+ *  The number of recorded events.
+ */
+@property (nonatomic, assign, readonly) NSUInteger eventCount;
+
+/**
+ *  The paths of all active leaf states at the end of the recording.
+ */
+@property (nonatomic, strong, readonly) NSArray<NSString *> *activeStatePaths;
+
+/**
+ *  The number of events which have been added to the event queue during the last replay.
+ */
+@property (nonatomic, assign, readonly) NSUInteger enqueuedEventCount;
+
+/**
+ *  The time the last replay took to schedule and handle all events.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/**
+ *  Creates a replayer from a binary event log.
+ *
+ *  @param data  The recorded log.
+ *  @param error Set to a `TBSMErrorCodeInvalidEventLog` error if the log could not be read.
+ *
+ *  @return The replayer instance or `nil`.
+ */
++ (nullable instancetype)replayerWithData:(NSData *)data error:(NSError **)error;
+
+/**
+ *  Initializes a replayer from a binary event log.
+ *
+ *  @param data  The recorded log.
+ *  @param error Set to a `TBSMErrorCodeInvalidEventLog` error if the log could not be read.
+ *
+ *  @return The replayer instance or `nil`.
+ */
+- (nullable instancetype)initWithData:(NSData *)data error:(NSError **)error;
+
+/**
+ *  Schedules all recorded events on the specified state machine which needs to be set up beforehand
+ *  and waits until they have been handled. Must not be called on the `scheduledEventsQueue` of the state machine.
+ *
+ *  @param stateMachine The state machine at the top of the hierarchy.
+ *  @param pacing       The pacing of the replay.
+ *
+ *  @return `YES` if the active state configuration after the replay matches the recorded one.
+ */
+- (BOOL)replayOnStateMachine:(TBSMStateMachine *)stateMachine pacing:(TBSMEventReplayPacing)pacing;
+
+@end
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,202 @@
+//
+//  TBSMEventReplayer.m
+//  TBStateMachine
+//
+
+#import "TBSMEventReplayer.h"
+#import "TBSMEventLog.h"
+
+@interface TBSMEventReplayer ()
+@property (nonatomic, strong) NSArray<NSString *> *activeStatePaths;
+@property (nonatomic, assign) NSUInteger enqueuedEventCount;
+@property (nonatomic, assign) NSTimeInterval duration;
+@property (nonatomic, strong) NSArray<NSString *> *priv_names;
+@property (nonatomic, strong) NSArray<NSNumber *> *priv_priorities;
+@property (nonatomic, strong) NSArray<NSNumber *> *priv_timestamps;
+@property (nonatomic, strong) NSArray *priv_payloads;
+@end
+
+static inline uint16_t TBSMReadUInt16(const uint8_t *bytes)
+{
+    uint16_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return CFSwapInt16LittleToHost(value);
+}
+
+static inline uint32_t TBSMReadUInt32(const uint8_t *bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return CFSwapInt32LittleToHost(value);
+}
+
+static inline uint64_t TBSMReadUInt64(const uint8_t *bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return CFSwapInt64LittleToHost(value);
+}
+
+@implementation TBSMEventReplayer
+
++ (instancetype)replayerWithData:(NSData *)data error:(NSError **)error
+{
+    return [[[self class] alloc] initWithData:data error:error];
+}
+
+- (instancetype)initWithData:(NSData *)data error:(NSError **)error
+{
+    self = [super init];
+    if (self) {
+        NSUInteger offset = [self _parseData:data];
+        if (offset != NSNotFound) {
+            if (error) {
+                *error = [NSError tbsm_invalidEventLogError:offset];
+            }
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (NSUInteger)eventCount
+{
+    return self.priv_names.count;
+}
+
+- (BOOL)replayOnStateMachine:(TBSMStateMachine *)stateMachine pacing:(TBSMEventReplayPacing)pacing
+{
+    NSMutableArray *events = [NSMutableArray arrayWithCapacity:self.eventCount];
+    for (NSUInteger index = 0; index < self.eventCount; index++) {
+        id payload = self.priv_payloads[index];
+        TBSMEvent *event = [TBSMEvent eventWithName:self.priv_names[index] data:(payload == [NSNull null]) ? nil : payload];
+        event.priority = self.priv_priorities[index].unsignedIntegerValue;
+        [events addObject:event];
+    }
+    
+    NSUInteger enqueuedEventCount = 0;
+    NSTimeInterval startTime = [NSProcessInfo processInfo].systemUptime;
+    for (NSUInteger index = 0; index < events.count; index++) {
+        if (pacing == TBSMEventReplayPacingOriginal) {
+            NSTimeInterval offset = self.priv_timestamps[index].unsignedLongLongValue / (NSTimeInterval)NSEC_PER_SEC;
+            NSTimeInterval delay = startTime + offset - [NSProcessInfo processInfo].systemUptime;
+            if (delay > 0) {
+                [NSThread sleepForTimeInterval:delay];
+            }
+        }
+        if ([stateMachine scheduleEvent:events[index]] == TBSMEventQueueStatusEnqueued) {
+            enqueuedEventCount++;
+        }
+    }
+    [stateMachine.scheduledEventsQueue waitUntilAllOperationsAreFinished];
+    self.duration = [NSProcessInfo processInfo].systemUptime - startTime;
+    self.enqueuedEventCount = enqueuedEventCount;
+    
+    for (NSString *path in self.activeStatePaths) {
+        TBSMState *state = [stateMachine stateWithPath:path error:nil];
+        if (state == nil || ![stateMachine isActive:state]) {
+            return NO;
+        }
+    }
+    __block NSUInteger activeLeafStateCount = 0;
+    [stateMachine enumerateActiveLeafStatesUsingBlock:^(TBSMState *state, BOOL *stop) {
+        activeLeafStateCount++;
+    }];
+    return (activeLeafStateCount == self.activeStatePaths.count);
+}
+
+#pragma mark - private
+
+- (NSUInteger)_parseData:(NSData *)data
+{
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    
+    if (length < TBSMEventLogHeaderLength || memcmp(bytes, TBSMEventLogMagic, sizeof(TBSMEventLogMagic)) != 0 || bytes[4] != TBSMEventLogVersion) {
+        return 0;
+    }
+    NSMutableDictionary<NSNumber *, NSString *> *eventNames = [NSMutableDictionary new];
+    NSMutableArray *names = [NSMutableArray new];
+    NSMutableArray *priorities = [NSMutableArray new];
+    NSMutableArray *timestamps = [NSMutableArray new];
+    NSMutableArray *payloads = [NSMutableArray new];
+    NSMutableArray *activeStatePaths = [NSMutableArray new];
+    
+    NSUInteger offset = TBSMEventLogHeaderLength;
+    while (offset < length) {
+        NSUInteger recordOffset = offset;
+        uint8_t record = bytes[offset++];
+        
+        if (record == TBSMEventLogRecordEventName) {
+            if (offset + 4 > length) {
+                return recordOffset;
+            }
+            uint16_t identifier = TBSMReadUInt16(bytes + offset);
+            uint16_t nameLength = TBSMReadUInt16(bytes + offset + 2);
+            offset += 4;
+            if (offset + nameLength > length) {
+                return recordOffset;
+            }
+            NSString *name = [[NSString alloc] initWithBytes:bytes + offset length:nameLength encoding:NSUTF8StringEncoding];
+            if (name.length == 0) {
+                return recordOffset;
+            }
+            eventNames[@(identifier)] = name;
+            offset += nameLength;
+            
+        } else if (record == TBSMEventLogRecordEvent) {
+            if (offset + 15 > length) {
+                return recordOffset;
+            }
+            uint16_t identifier = TBSMReadUInt16(bytes + offset);
+            uint8_t priority = bytes[offset + 2];
+            uint64_t timestamp = TBSMReadUInt64(bytes + offset + 3);
+            uint32_t payloadLength = TBSMReadUInt32(bytes + offset + 11);
+            offset += 15;
+            NSString *name = eventNames[@(identifier)];
+            if (name == nil || priority > TBSMEventPriorityHigh || offset + payloadLength > length) {
+                return recordOffset;
+            }
+            id payload = [NSNull null];
+            if (payloadLength > 0) {
+                NSData *payloadData = [data subdataWithRange:NSMakeRange(offset, payloadLength)];
+                payload = [NSPropertyListSerialization propertyListWithData:payloadData options:NSPropertyListImmutable format:NULL error:nil];
+                if (payload == nil) {
+                    return recordOffset;
+                }
+            }
+            offset += payloadLength;
+            [names addObject:name];
+            [priorities addObject:@(priority)];
+            [timestamps addObject:@(timestamp)];
+            [payloads addObject:payload];
+            
+        } else if (record == TBSMEventLogRecordActiveState) {
+            if (offset + 2 > length) {
+                return recordOffset;
+            }
+            uint16_t pathLength = TBSMReadUInt16(bytes + offset);
+            offset += 2;
+            if (offset + pathLength > length) {
+                return recordOffset;
+            }
+            NSString *path = [[NSString alloc] initWithBytes:bytes + offset length:pathLength encoding:NSUTF8StringEncoding];
+            if (path.length == 0) {
+                return recordOffset;
+            }
+            [activeStatePaths addObject:path];
+            offset += pathLength;
+            
+        } else {
+            return recordOffset;
+        }
+    }
+    self.priv_names = names;
+    self.priv_priorities = priorities;
+    self.priv_timestamps = timestamps;
+    self.priv_payloads = payloads;
+    self.activeStatePaths = activeStatePaths;
+    return NSNotFound;
+}
+
+@end